@@ -19,6 +19,7 @@
 
 
 FOUNDATION_EXPORT NSString * const WPOperationFailingURLResponseDataErrorKey;
+FOUNDATION_EXPORT NSString * const WPOperationFailingURLResponseErrorKey;
 
 /**
  WPAPIClient is an implementation of AFHTTPClient that handles authentication to the API.
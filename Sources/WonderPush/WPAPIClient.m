@@ -73,6 +73,9 @@ NSString * const WPOperationFailingURLResponseErrorKey = @"WPOperationFailingURL
 
 @interface WPAPIClient ()
 @property (strong, nonatomic) NSMutableArray *tokenFetchedHandlers;
+
+/// The given attempt counts the access token fetches made by this call, from 1, and drives the backoff of its next retry.
+- (void) fetchAccessTokenAndCall:(void (^)(NSURLSessionTask *task, id responseObject))handler failure:(void (^)(NSURLSessionTask *task, NSError *error))failure nbRetry:(NSInteger)nbRetry attempt:(NSUInteger)attempt forUserId:(NSString *)userId;
 @end
 
 @implementation WPBaseAPIClient
@@ -212,6 +215,12 @@ NSString * const WPOperationFailingURLResponseErrorKey = @"WPOperationFailingURL
         }
 
         NSError *wpError = [WPUtil errorFromJSON:jsonError];
+        if (wpError && error.userInfo[WPOperationFailingURLResponseErrorKey]) {
+            // Keep the HTTP response, for its status code
+            NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithDictionary:wpError.userInfo];
+            userInfo[WPOperationFailingURLResponseErrorKey] = error.userInfo[WPOperationFailingURLResponseErrorKey];
+            wpError = [NSError errorWithDomain:wpError.domain code:wpError.code userInfo:userInfo];
+        }
         if (wpError) {
 
             // Handle invalid access token by requesting a new one.
@@ -228,12 +237,10 @@ NSString * const WPOperationFailingURLResponseErrorKey = @"WPOperationFailingURL
                 configuration.installationId = nil;
                 [configuration changeUserId:prevUserId];
 
-                // Retry later
-                double delayInSeconds = RETRY_INTERVAL;
-                dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delayInSeconds * NSEC_PER_SEC));
-                dispatch_after(popTime, dispatch_get_main_queue(), ^(void){
+                // Retry later, backing off further each time the new access token is refused too
+                [self.requestVault.retryScheduler scheduleRetry:^{
                     [self executeRequest:request];
-                });
+                } attempt:[self.requestVault recordFailedAttemptOfRequest:request]];
 
             } else if (wpError.code == WPErrorInvalidCredentials) {
 
@@ -455,13 +462,18 @@ NSString * const WPOperationFailingURLResponseErrorKey = @"WPOperationFailingURL
 #pragma mark - Access Token
 
 - (void) fetchAccessTokenAndCall:(void (^)(NSURLSessionTask *task, id responseObject))handler failure:(void (^)(NSURLSessionTask *task, NSError *error))failure nbRetry:(NSInteger)nbRetry forUserId:(NSString *)userId
+{
+    [self fetchAccessTokenAndCall:handler failure:failure nbRetry:nbRetry attempt:1 forUserId:userId];
+}
+
+- (void) fetchAccessTokenAndCall:(void (^)(NSURLSessionTask *task, id responseObject))handler failure:(void (^)(NSURLSessionTask *task, NSError *error))failure nbRetry:(NSInteger)nbRetry attempt:(NSUInteger)attempt forUserId:(NSString *)userId
 {
     
     [WonderPush.remoteConfigManager read:^(WPRemoteConfig *config, NSError *error) {
 
         // Refuse to get an access token for non-subscribers
         if (![WonderPush subscriptionStatusIsOptIn]
-            && ![config.data[WP_REMOTE_CONFIG_ALLOW_ACCESS_TOKEN_FOR_NON_SUBSCRIBERS] boolValue]) {
+            && !config.snapshot.allowAccessTokenForNonSubscribers) {
             if (failure) {
                 failure(nil, [NSError errorWithDomain:WPErrorDomain code:WPErrorClientDisabled userInfo:@{NSLocalizedDescriptionKey: @"Not opt-in"}]);
             }
@@ -505,6 +517,7 @@ NSString * const WPOperationFailingURLResponseErrorKey = @"WPOperationFailingURL
             [self POST:resource parameters:[params copy] success:^(NSURLSessionTask *task, id response) {
                 // Success
                 WPLogDebug(@"Got access token response: %@", response);
+                [self.requestVault.retryScheduler recordSuccess];
                 
                 NSDictionary *responseJson = (NSDictionary *)response;
                 NSString *accessToken = [WPNSUtil stringForKey:@"token" inDictionary:responseJson];
@@ -609,12 +622,21 @@ NSString * const WPOperationFailingURLResponseErrorKey = @"WPOperationFailingURL
                 }
                 
                 // Retry later
-                double delayInSeconds = RETRY_INTERVAL;
-                dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delayInSeconds * NSEC_PER_SEC));
-                dispatch_after(popTime, dispatch_get_main_queue(), ^(void){
+                void (^retry)(void) = ^{
                     self.isFetchingAccessToken = NO;
-                    [self fetchAccessTokenAndCall:handler failure:failure nbRetry:nbRetry - 1 forUserId:userId];
-                });
+                    [self fetchAccessTokenAndCall:handler failure:failure nbRetry:nbRetry - 1 attempt:attempt + 1 forUserId:userId];
+                };
+                if ([WPRequestVault isClientDisabledError:error]) {
+                    // The API was not reached, retry after a fixed delay like the request vault does
+                    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.requestVault.clientDisabledRetryDelay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), retry);
+                    return;
+                }
+                if ([self.requestVault isTransientError:error]) {
+                    [self.requestVault.retryScheduler recordFailure];
+                } else {
+                    [self.requestVault.retryScheduler recordSuccess];
+                }
+                [self.requestVault.retryScheduler scheduleRetry:retry attempt:attempt];
             }];
         }];
     }];
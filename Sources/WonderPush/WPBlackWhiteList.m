@@ -8,9 +8,127 @@
 
 #import "WPBlackWhiteList.h"
 
+/**
+ A trie of UTF-16 code units, telling whether a string starts with one of its words,
+ or ends with one of them when the words are added reversed.
+ */
+@interface WPBlackWhiteListTrie : NSObject
+- (void) addWord:(NSString *)word reversed:(BOOL)reversed;
+- (BOOL) hasWordAtEdgeOf:(NSString *)item reversed:(BOOL)reversed;
+@end
+
+/**
+ The rules of one list compiled once: exact rules are looked up in a set, `foo*` and `*foo` rules in tries,
+ and rules with other wildcards are kept split around their `*`s, to be matched without backtracking.
+ */
+@interface WPBlackWhiteListMatcher : NSObject
+- (instancetype) initWithRules:(NSArray<NSString *> *)rules;
+- (BOOL) matches:(NSString *)item;
+@end
+
 @interface WPBlackWhiteList ()
 @property (nonatomic, nonnull, strong) NSArray<NSString *> * blackList;
 @property (nonatomic, nonnull, strong) NSArray<NSString *> * whiteList;
+@property (nonatomic, nonnull, strong) WPBlackWhiteListMatcher *blackListMatcher;
+@property (nonatomic, nonnull, strong) WPBlackWhiteListMatcher *whiteListMatcher;
+@end
+
+@implementation WPBlackWhiteListTrie {
+    NSMutableDictionary<NSNumber *, WPBlackWhiteListTrie *> *_children;
+    BOOL _terminal;
+}
+
+- (void) addWord:(NSString *)word reversed:(BOOL)reversed {
+    WPBlackWhiteListTrie *node = self;
+    NSUInteger length = word.length;
+    for (NSUInteger i = 0; i < length; i++) {
+        NSNumber *character = @([word characterAtIndex:reversed ? length - 1 - i : i]);
+        if (!node->_children) node->_children = [NSMutableDictionary new];
+        WPBlackWhiteListTrie *child = node->_children[character];
+        if (!child) {
+            child = [WPBlackWhiteListTrie new];
+            node->_children[character] = child;
+        }
+        node = child;
+    }
+    node->_terminal = YES;
+}
+
+- (BOOL) hasWordAtEdgeOf:(NSString *)item reversed:(BOOL)reversed {
+    WPBlackWhiteListTrie *node = self;
+    NSUInteger length = item.length;
+    for (NSUInteger i = 0; ; i++) {
+        if (node->_terminal) return YES;
+        if (i == length) return NO;
+        node = node->_children[@([item characterAtIndex:reversed ? length - 1 - i : i])];
+        if (!node) return NO;
+    }
+}
+
+@end
+
+@implementation WPBlackWhiteListMatcher {
+    NSSet<NSString *> *_exactRules;
+    WPBlackWhiteListTrie *_prefixes;
+    WPBlackWhiteListTrie *_suffixes;
+    NSArray<NSArray<NSString *> *> *_otherRules;
+}
+
+- (instancetype) initWithRules:(NSArray<NSString *> *)rules {
+    if (self = [super init]) {
+        NSMutableSet *exactRules = [NSMutableSet new];
+        NSMutableArray *otherRules = [NSMutableArray new];
+        for (NSString *rule in rules) {
+            NSArray<NSString *> *tokens = [rule componentsSeparatedByString:@"*"];
+            if (tokens.count == 1) {
+                [exactRules addObject:rule];
+            } else if (tokens.count == 2 && tokens[1].length == 0) {
+                if (!_prefixes) _prefixes = [WPBlackWhiteListTrie new];
+                [_prefixes addWord:tokens[0] reversed:NO];
+            } else if (tokens.count == 2 && tokens[0].length == 0) {
+                if (!_suffixes) _suffixes = [WPBlackWhiteListTrie new];
+                [_suffixes addWord:tokens[1] reversed:YES];
+            } else {
+                [otherRules addObject:tokens];
+            }
+        }
+        _exactRules = [NSSet setWithSet:exactRules];
+        _otherRules = [NSArray arrayWithArray:otherRules];
+    }
+    return self;
+}
+
+- (BOOL) matches:(NSString *)item {
+    if ([_exactRules containsObject:item]) return YES;
+    if (_prefixes && [_prefixes hasWordAtEdgeOf:item reversed:NO]) return YES;
+    if (_suffixes && [_suffixes hasWordAtEdgeOf:item reversed:YES]) return YES;
+    for (NSArray<NSString *> *tokens in _otherRules) {
+        if ([WPBlackWhiteListMatcher item:item matchesTokens:tokens]) return YES;
+    }
+    return NO;
+}
+
+// Matches the first token as a prefix and the last one as a suffix, then finds the others in order in between.
+// Taking the leftmost occurrence of each token always leaves the most room for the next ones, so there is no need to backtrack.
++ (BOOL) item:(NSString *)item matchesTokens:(NSArray<NSString *> *)tokens {
+    NSString *first = tokens.firstObject;
+    NSString *last = tokens.lastObject;
+    if (tokens.count == 1) return [item isEqualToString:first];
+    if (item.length < first.length + last.length) return NO;
+    if (first.length > 0 && [item rangeOfString:first options:NSLiteralSearch | NSAnchoredSearch].location == NSNotFound) return NO;
+    if (last.length > 0 && [item rangeOfString:last options:NSLiteralSearch | NSAnchoredSearch | NSBackwardsSearch].location == NSNotFound) return NO;
+    NSUInteger start = first.length;
+    NSUInteger end = item.length - last.length;
+    for (NSUInteger i = 1; i + 1 < tokens.count; i++) {
+        NSString *token = tokens[i];
+        if (token.length == 0) continue;
+        NSRange found = [item rangeOfString:token options:NSLiteralSearch range:NSMakeRange(start, end - start)];
+        if (found.location == NSNotFound) return NO;
+        start = NSMaxRange(found);
+    }
+    return YES;
+}
+
 @end
 
 @implementation WPBlackWhiteList
@@ -30,37 +148,22 @@
         }
         _blackList = [NSArray arrayWithArray:blackList];
         _whiteList = [NSArray arrayWithArray:whiteList];
+        _blackListMatcher = [[WPBlackWhiteListMatcher alloc] initWithRules:_blackList];
+        _whiteListMatcher = [[WPBlackWhiteListMatcher alloc] initWithRules:_whiteList];
     }
     return self;
 }
 
 - (BOOL)allow:(NSString *)item {
-    for (NSString *rule in self.whiteList) {
-        if ([[self class] item:item matches:rule]) return YES;
-    }
-    for (NSString *rule in self.blackList) {
-        if ([[self class] item:item matches:rule]) return NO;
-    }
+    if (!item) return YES;
+    if ([self.whiteListMatcher matches:item]) return YES;
+    if ([self.blackListMatcher matches:item]) return NO;
     return YES;
 }
 
 + (BOOL)item:(NSString *)item matches:(NSString *)rule {
     if (!item || !rule) return NO;
-    NSArray *tokens = [rule componentsSeparatedByString:@"*"];
-    NSMutableString *buffer = [NSMutableString new];
-    [buffer appendString:@"^"];
-    
-    for (NSInteger i = 0; i < tokens.count; i++) {
-        [buffer appendString:[NSRegularExpression escapedPatternForString:tokens[i]]];
-        if (i < tokens.count - 1) [buffer appendString:@".*"];
-    }
-    [buffer appendString:@"$"];
-    NSError *error = nil;
-    NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:buffer options:0 error:&error];
-    if (error) {
-        return NO;
-    }
-    return [regex numberOfMatchesInString:item options:0 range:NSMakeRange(0, item.length)] > 0;
+    return [WPBlackWhiteListMatcher item:item matchesTokens:[rule componentsSeparatedByString:@"*"]];
 }
 
 @end
@@ -15,6 +15,7 @@
  */
 
 #import <Foundation/Foundation.h>
+#import "WPSyncStateStore.h"
 
 #define USER_DEFAULTS_CLIENT_ID_KEY @"__wonderpush_client_id"
 #define USER_DEFAULTS_QUEUED_NOTIFICATIONS @"__wonderpush_queued_notifications"
@@ -119,7 +120,8 @@
 @property (nonatomic, strong) NSDictionary *cachedInstallationCustomPropertiesUpdated;
 @property (nonatomic, strong) NSDate *cachedInstallationCustomPropertiesUpdatedDate;
 @property (nonatomic, strong) NSDate *cachedInstallationCustomPropertiesFirstDelayedWriteDate;
-@property (nonatomic, strong) NSDictionary *installationCustomSyncStatePerUserId;
+@property (readonly) NSDictionary *installationCustomSyncStatePerUserId;
+@property (nonatomic, readonly) WPSyncStateStore *installationCustomSyncStateStore;
 @property (nonatomic, strong) NSDictionary *installationCoreSyncStatePerUserId;
 
 @property (nonatomic, strong) NSDictionary *lastReceivedNotification;
@@ -167,12 +169,29 @@
 
 - (void) clearStorageKeepUserConsent:(BOOL)keepUserConsent keepDeviceId:(BOOL)keepDeviceId;
 
+/// Saves the installation sync state of the given user, written to disk shortly after unless flushed.
+- (void) setInstallationCustomSyncState:(NSDictionary *)state forUserId:(NSString *)userId;
+
+/// Writes the pending installation sync states to disk.
+- (void) flushInstallationCustomSyncStates;
+
 - (void) rememberTrackedEvent:(NSDictionary *)eventParams;
 
 - (void) rememberTrackedEvent:(NSDictionary *)eventParams occurrences:(NSDictionary **)occurrences;
 
+/// The tracked events with their `creationDate` filled from their `actionDate`, kept until they change.
 - (NSArray *) trackedEvents;
 
+/// Incremented each time the tracked events change.
+@property (readonly) NSUInteger trackedEventsVersion;
+
+/**
+ The tracked events of the given type, or whose type starts with the given prefix, and those whose type is neither a string nor null,
+ in no particular order, with their `creationDate` filled like `trackedEvents`.
+ Looked up in an in-memory index instead of walking the whole list.
+ */
+- (NSArray *) trackedEventsOfType:(NSString *)type typePrefix:(NSString *)typePrefix;
+
 - (NSDictionary<NSString *, NSArray<NSString *> *> *) liveActivitySyncActivityIdsPerAttributesTypeName;
 
 @end
@@ -21,6 +21,8 @@
 #import "WPRequestVault.h"
 #import "WPUtil.h"
 #import "WPJsonSyncLiveActivity.h"
+#import "WPTrackedEventsJournal.h"
+#import "WPTrackedEventsIndex.h"
 #import <WonderPushCommon/WPNSUtil.h>
 
 static WPConfiguration *sharedConfiguration = nil;
@@ -33,6 +35,10 @@ static WPConfiguration *sharedConfiguration = nil;
 
 @property (nonatomic, strong) NSNumber *_notificationEnabled;
 
+@property (nonatomic, strong) WPTrackedEventsJournal *trackedEventsJournal;
+@property (nonatomic, strong) WPTrackedEventsIndex *trackedEventsIndex;
+@property (nonatomic, strong) WPSyncStateStore *installationCustomSyncStateStore;
+
 - (void) rememberTrackedEvent:(NSDictionary *)eventParams now:(NSDate *)now;
 
 @end
@@ -204,6 +210,8 @@ static WPConfiguration *sharedConfiguration = nil;
             rtn[key] = [WPJsonUtil ensureJSONEncodable:obj];
         }
     }];
+    rtn[USER_DEFAULTS_TRACKED_EVENTS_KEY] = [WPJsonUtil ensureJSONEncodable:self.trackedEventsJournal.events];
+    rtn[USER_DEFAULTS_INSTALLATION_CUSTOM_SYNC_STATE_PER_USER_ID_KEY] = [WPJsonUtil ensureJSONEncodable:self.installationCustomSyncStatePerUserId];
     return [NSDictionary dictionaryWithDictionary:rtn];
 }
 
@@ -939,19 +947,41 @@ static WPConfiguration *sharedConfiguration = nil;
     }
 }
 
-- (NSDictionary *) installationCustomSyncStatePerUserId
+- (WPSyncStateStore *) installationCustomSyncStateStore
 {
     @synchronized (self) {
-        return [self _getNSDictionaryFromJSONForKey:USER_DEFAULTS_INSTALLATION_CUSTOM_SYNC_STATE_PER_USER_ID_KEY];
-
+        if (!_installationCustomSyncStateStore) {
+            _installationCustomSyncStateStore = [[WPSyncStateStore alloc] initWithDirectory:[WPSyncStateStore directoryForName:@"installationCustom"]];
+            // Migrate states previously stored in the user defaults, all users in one blob
+            NSDictionary *legacyStatePerUserId = [self _getNSDictionaryFromJSONForKey:USER_DEFAULTS_INSTALLATION_CUSTOM_SYNC_STATE_PER_USER_ID_KEY];
+            if (legacyStatePerUserId) {
+                if (!_installationCustomSyncStateStore.exists) {
+                    for (NSString *userId in legacyStatePerUserId) {
+                        NSDictionary *state = [WPNSUtil dictionaryForKey:userId inDictionary:legacyStatePerUserId];
+                        if (state) [_installationCustomSyncStateStore setState:state forKey:userId];
+                    }
+                    [_installationCustomSyncStateStore flush];
+                }
+                [self _setNSDictionaryAsJSON:nil forKey:USER_DEFAULTS_INSTALLATION_CUSTOM_SYNC_STATE_PER_USER_ID_KEY];
+            }
+        }
+        return _installationCustomSyncStateStore;
     }
 }
 
-- (void) setInstallationCustomSyncStatePerUserId:(NSDictionary *)installationCustomSyncStatePerUserId
+- (NSDictionary *) installationCustomSyncStatePerUserId
 {
-    @synchronized (self) {
-        [self _setNSDictionaryAsJSON:installationCustomSyncStatePerUserId forKey:USER_DEFAULTS_INSTALLATION_CUSTOM_SYNC_STATE_PER_USER_ID_KEY];
-    }
+    return self.installationCustomSyncStateStore.states;
+}
+
+- (void) setInstallationCustomSyncState:(NSDictionary *)state forUserId:(NSString *)userId
+{
+    [self.installationCustomSyncStateStore setState:state forKey:userId ?: @""];
+}
+
+- (void) flushInstallationCustomSyncStates
+{
+    [self.installationCustomSyncStateStore flush];
 }
 
 - (NSDictionary *) installationCoreSyncStatePerUserId
@@ -986,6 +1016,10 @@ static WPConfiguration *sharedConfiguration = nil;
             [defaults removeObjectForKey:key];
         }];
         [defaults synchronize];
+        [self.trackedEventsJournal clear];
+        [self.installationCustomSyncStateStore clear];
+        _trackedEventsIndex = nil;
+        _trackedEventsVersion++;
 
         _accessToken = nil;
         _deviceToken = nil;
@@ -1003,12 +1037,6 @@ static WPConfiguration *sharedConfiguration = nil;
     [self rememberTrackedEvent:eventParams now: self.now ? self.now() : [NSDate date]];
 }
 
-- (NSArray *)removeExcessEventsFromStart:(NSArray *)list max:(NSInteger) max {
-    NSInteger excessEvents = list.count - max;
-    if (excessEvents < 0) excessEvents = 0;
-    return [list subarrayWithRange:NSMakeRange(excessEvents, list.count - excessEvents)];
-}
-
 - (void) rememberTrackedEvent:(NSDictionary *)eventParams now:(NSDate *)nowDate {
     [self rememberTrackedEvent:eventParams occurrences:nil now:nowDate];
 }
@@ -1019,216 +1047,112 @@ static WPConfiguration *sharedConfiguration = nil;
 
 - (void) rememberTrackedEvent:(NSDictionary *)eventParams occurrences:(NSDictionary **)occurrencesOut now:(NSDate *)nowDate {
     if (!eventParams) return;
+    @synchronized (self) {
+        [self _rememberTrackedEvent:eventParams occurrences:occurrencesOut now:nowDate];
+    }
+}
 
-    NSInteger allTime = 0;
-
+- (void) _rememberTrackedEvent:(NSDictionary *)eventParams occurrences:(NSDictionary **)occurrencesOut now:(NSDate *)nowDate {
     // Note: It is assumed that the given event is more recent than any other already stored events
     NSString *type = eventParams[@"type"];
     if (!type) return;
 
     NSString *campaignId = eventParams[@"campaignId"];
     NSString *collapsing = eventParams[@"collapsing"];
-
-    NSArray *oldTrackedEvents = self.trackedEvents;
-    uint uncollapsedEventsEstimate = 0; // collapsing == null
-    uint collapsedLastBuiltinEventsEstimate = 0; // collapsing.equals("last") && type.startsWith("@")
-    uint collapsedLastCustomEventsEstimate = 0; // collapsing.equals("last") && !type.startsWith("@")
-    uint collapsedOtherEventsEstimate = 0; // collapsing != null && !collapsing.equals("last") // ie.
-    for (NSDictionary *oldTrackedEvent in oldTrackedEvents) {
-        NSString *oldTrackedEventCollapsing = oldTrackedEvent[@"collapsing"];
-        NSString *oldTrackedEventType = oldTrackedEvent[@"type"];
-        if (!oldTrackedEventCollapsing) {
-            uncollapsedEventsEstimate++;
-        } else if ([@"last" isEqualToString:oldTrackedEventCollapsing]) {
-            if ([oldTrackedEventType hasPrefix:@"@"]) {
-                collapsedLastBuiltinEventsEstimate++;
-            } else {
-                collapsedLastCustomEventsEstimate++;
-            }
-        } else {
-            collapsedOtherEventsEstimate++;
-        }
-    }
-
-    NSMutableArray *uncollapsedEvents = [[NSMutableArray alloc] initWithCapacity:uncollapsedEventsEstimate + 1]; // collapsing == null
-    NSMutableArray *collapsedLastBuiltinEvents = [[NSMutableArray alloc] initWithCapacity:collapsedLastBuiltinEventsEstimate + 1]; // collapsing.equals("last") && type.startsWith("@")
-    NSMutableArray *collapsedLastCustomEvents = [[NSMutableArray alloc] initWithCapacity:collapsedLastCustomEventsEstimate + 1]; // collapsing.equals("last") && !type.startsWith("@")
-    NSMutableArray *collapsedOtherEvents  = [[NSMutableArray alloc] initWithCapacity:collapsedOtherEventsEstimate + 1]; // collapsing != null && !collapsing.equals("last") // ie. collapsing.equals("campaign"), as of this writing
-
     NSInteger now = nowDate.timeIntervalSince1970 * 1000;
-    NSInteger getMaximumUncollapsedTrackedEventsAgeMs = self.maximumUncollapsedTrackedEventsAgeMs;
-    for (NSDictionary *oldTrackedEvent in oldTrackedEvents) {
-        NSString *oldTrackedEventCollapsing = oldTrackedEvent[@"collapsing"];
-        NSString *oldTrackedEventType = oldTrackedEvent[@"type"];
-        // Filter out the collapsing=last event of the same type as the new event we want to add
-        if ((!collapsing || [@"last" isEqualToString:collapsing])
-            && [@"last" isEqualToString:oldTrackedEventCollapsing]
-            && [type isEqualToString:oldTrackedEventType]) {
-            allTime = MAX(1, oldTrackedEvent[@"occurrences"] && oldTrackedEvent[@"occurrences"][@"allTime"] ? [oldTrackedEvent[@"occurrences"][@"allTime"] integerValue] : 1);
-            continue;
-        }
-        // Filter out the collapsing=campaign event of the same type and campaign as the new event we want to add
-        if (campaignId
-            && [@"campaign" isEqualToString:collapsing]
-            && [@"campaign" isEqualToString:oldTrackedEventCollapsing]
-            && [type isEqualToString:oldTrackedEventType]
-            && [campaignId isEqualToString:oldTrackedEvent[@"campaignId"]]) {
-            allTime = MAX(1, oldTrackedEvent[@"occurrences"] && oldTrackedEvent[@"occurrences"][@"allTime"] ? [oldTrackedEvent[@"occurrences"][@"allTime"] integerValue] : 1);
-            continue;
-        }
-        // Filter out old uncollapsed events
-        NSInteger oldTrackedEventActionDate = oldTrackedEvent[@"actionDate"] ? [oldTrackedEvent[@"actionDate"] integerValue] : now;
-        if (!oldTrackedEventCollapsing && now - oldTrackedEventActionDate >= getMaximumUncollapsedTrackedEventsAgeMs) {
-            continue;
-        }
-        // TODO We may want to filter out old collapsing=campaign (or any non-null value other than "last") events too
-        // Store the event in the proper, per-collapsing list
-        if (!oldTrackedEventCollapsing) {
-            [uncollapsedEvents addObject:oldTrackedEvent];
-        } else if ([@"last" isEqualToString:oldTrackedEventCollapsing]) {
-            if ([oldTrackedEventType hasPrefix:@"@"]) {
-                [collapsedLastBuiltinEvents addObject:oldTrackedEvent];
-            } else {
-                [collapsedLastCustomEvents addObject:oldTrackedEvent];
-            }
-        } else {
-            [collapsedOtherEvents addObject:oldTrackedEvent];
-        }
-    }
-    oldTrackedEvents = nil; // let GC collect this
 
-    // Add the new event, uncollapsed
-    NSMutableDictionary *uncollapsedEventData;
-    NSMutableDictionary *collapsedEventData;
-    if (!collapsing) {
+    // Let make a deep copy by serializing / deserializing to/from JSON
+    // The result is immutable, so both stored events can share its nested values
+    NSDictionary *eventData = nil;
+    {
         NSError *error = nil;
-        // Let make a deep copy by serializing / deserializing to/from JSON
         NSData *data = [NSJSONSerialization dataWithJSONObject:eventParams options:0 error:&error];
-        uncollapsedEventData = error ? nil : [[NSJSONSerialization JSONObjectWithData:data options:0 error:&error] mutableCopy];
+        eventData = error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error];
         if (error) {
-            WPLog(@"Could not store uncollapsed tracked event: %@", error);
-        } else {
-            NSNumber *actionDateNumber = uncollapsedEventData[@"actionDate"] ?: @(now);
-            NSInteger actionDate = actionDateNumber.integerValue;
-            // Only add uncollapsed if it's not too old
-            if (now - actionDate < getMaximumUncollapsedTrackedEventsAgeMs) {
-                [uncollapsedEvents addObject:uncollapsedEventData];
-            }
+            WPLog(@"Could not store tracked event: %@", error);
+            eventData = nil;
         }
     }
 
-    // Add the new event with collapsing
+    // Add the new event uncollapsed, and with collapsing
     // We default to collapsing=last, but we otherwise keep any existing collapsing
-    {
-        NSError *error = nil;
-        NSData *data = [NSJSONSerialization dataWithJSONObject:eventParams options:0 error:&error];
-        collapsedEventData = error ? nil : [[NSJSONSerialization JSONObjectWithData:data options:0 error:&error] mutableCopy];
-        if (error) {
-            WPLog(@"Could not store collapsed tracked event: %@", error);
-        } else {
-            allTime += 1;
-            if (!collapsing) {
-                collapsedEventData[@"collapsing"] = @"last";
-                collapsing = @"last";
-            }
-            if ([@"last" isEqualToString:collapsing]) {
-                if ([type hasPrefix:@"@"]) {
-                    [collapsedLastBuiltinEvents addObject:collapsedEventData];
-                } else {
-                    [collapsedLastCustomEvents addObject:collapsedEventData];
-                }
-            } else {
-                [collapsedOtherEvents addObject:collapsedEventData];
+    NSMutableDictionary *uncollapsedEventData = collapsing ? nil : [eventData mutableCopy];
+    NSMutableDictionary *collapsedEventData = [eventData mutableCopy];
+    if (!collapsing) collapsedEventData[@"collapsing"] = @"last";
+
+    WPTrackedEventsIndex *index = self.trackedEventsIndex;
+    index.maximumCollapsedLastBuiltinTrackedEventsCount = self.maximumCollapsedLastBuiltinTrackedEventsCount;
+    index.maximumCollapsedLastCustomTrackedEventsCount = self.maximumCollapsedLastCustomTrackedEventsCount;
+    index.maximumCollapsedOtherTrackedEventsCount = self.maximumCollapsedOtherTrackedEventsCount;
+    index.maximumUncollapsedTrackedEventsCount = self.maximumUncollapsedTrackedEventsCount;
+    index.maximumUncollapsedTrackedEventsAgeMs = self.maximumUncollapsedTrackedEventsAgeMs;
+    NSArray *removedIndexes = nil;
+    NSArray *insertions = nil;
+    NSDictionary *occurrences = [index rememberEventOfType:type
+                                                collapsing:collapsing
+                                                campaignId:campaignId
+                                          uncollapsedEvent:uncollapsedEventData
+                                            collapsedEvent:collapsedEventData
+                                                       now:now
+                                            removedIndexes:&removedIndexes
+                                                insertions:&insertions];
+
+    [collapsedEventData setObject:occurrences forKey:@"occurrences"];
+    [uncollapsedEventData setObject:occurrences forKey:@"occurrences"];
+
+    // Store the changes
+    [self.trackedEventsJournal commitRemovedIndexes:removedIndexes insertions:insertions];
+    _trackedEventsVersion++;
+
+    if (occurrencesOut != nil) *occurrencesOut = occurrences;
+}
+
+- (WPTrackedEventsIndex *)trackedEventsIndex {
+    @synchronized (self) {
+        if (!_trackedEventsIndex) {
+            _trackedEventsIndex = [[WPTrackedEventsIndex alloc] initWithEvents:self.trackedEventsJournal.events];
+            if (!_trackedEventsIndex.canonical) {
+                [self.trackedEventsJournal replaceEvents:_trackedEventsIndex.events];
             }
         }
+        return _trackedEventsIndex;
     }
+}
 
-    // Sort events by date
-    NSComparator comparator = ^(id o1, id o2) {
-        NSInteger delta = (o1[@"actionDate"] ? [o1[@"actionDate"] integerValue] : -1)
-        - (o2[@"actionDate"] ? [o2[@"actionDate"] integerValue] : -1);
-        if (delta < 0) return NSOrderedAscending;
-        if (delta > 0) return NSOrderedDescending;
-        return NSOrderedSame;
-    };
-    uncollapsedEvents = [[uncollapsedEvents sortedArrayUsingComparator:comparator] mutableCopy];
-    collapsedLastBuiltinEvents = [[collapsedLastBuiltinEvents sortedArrayUsingComparator:comparator] mutableCopy];
-    collapsedLastCustomEvents = [[collapsedLastCustomEvents sortedArrayUsingComparator:comparator] mutableCopy];
-    collapsedOtherEvents = [[collapsedOtherEvents sortedArrayUsingComparator:comparator] mutableCopy];
-
-    // Impose a limit on the maximum number of tracked events
-    uncollapsedEvents = [[self removeExcessEventsFromStart:uncollapsedEvents max:self.maximumUncollapsedTrackedEventsCount] mutableCopy];
-    collapsedLastBuiltinEvents = [[self removeExcessEventsFromStart:collapsedLastBuiltinEvents max:self.maximumCollapsedLastBuiltinTrackedEventsCount] mutableCopy];
-    collapsedLastCustomEvents = [[self removeExcessEventsFromStart:collapsedLastCustomEvents max:self.maximumCollapsedLastCustomTrackedEventsCount] mutableCopy];
-    collapsedOtherEvents = [[self removeExcessEventsFromStart:collapsedOtherEvents max:self.maximumCollapsedOtherTrackedEventsCount] mutableCopy];
-
-    // Compute occurrences
-    NSMutableDictionary *occurrences = [NSMutableDictionary new];
-    NSInteger last1days=0, last3days=0, last7days=0, last15days=0, last30days=0, last60days=0, last90days=0;
-
-    // Reconstruct the whole list
-    NSMutableArray *storeTrackedEvents = [NSMutableArray new];
-    for (NSDictionary *e in collapsedLastBuiltinEvents) [storeTrackedEvents addObject:e];
-    for (NSDictionary *e in collapsedLastCustomEvents) [storeTrackedEvents addObject:e];
-    for (NSDictionary *e in collapsedOtherEvents) [storeTrackedEvents addObject:e];
-    NSInteger uncollapsedCount = 0;
-    for (NSDictionary *e in uncollapsedEvents) {
-        [storeTrackedEvents addObject:e];
-        if ([e[@"type"] isEqualToString:type]) {
-            ++uncollapsedCount;
-            NSNumber *actionDate = e[@"actionDate"] ?: @(now);
-            NSInteger numberOfDaysSinceNow = floor((now - actionDate.integerValue) / 86400000);
-            if (numberOfDaysSinceNow <= 1) ++last1days;
-            if (numberOfDaysSinceNow <= 3) ++last3days;
-            if (numberOfDaysSinceNow <= 7) ++last7days;
-            if (numberOfDaysSinceNow <= 15) ++last15days;
-            if (numberOfDaysSinceNow <= 30) ++last30days;
-            if (numberOfDaysSinceNow <= 60) ++last60days;
-            if (numberOfDaysSinceNow <= 90) ++last90days;
+- (WPTrackedEventsJournal *)trackedEventsJournal {
+    @synchronized (self) {
+        if (!_trackedEventsJournal) {
+            _trackedEventsJournal = [[WPTrackedEventsJournal alloc] initWithDirectory:[WPTrackedEventsJournal defaultDirectory] name:@"trackedEvents"];
+            // Migrate events previously stored in the user defaults
+            NSArray *legacyTrackedEvents = [self _getNSArrayFromJSONForKey:USER_DEFAULTS_TRACKED_EVENTS_KEY];
+            if (legacyTrackedEvents) {
+                if (!_trackedEventsJournal.exists) {
+                    [_trackedEventsJournal replaceEvents:legacyTrackedEvents];
+                }
+                [self _setNSArrayAsJSON:nil forKey:USER_DEFAULTS_TRACKED_EVENTS_KEY];
+            }
         }
+        return _trackedEventsJournal;
     }
-    uncollapsedEvents = nil; // let GC collect this
-    collapsedLastBuiltinEvents = nil; // let GC collect this
-    collapsedLastCustomEvents = nil; // let GC collect this
-    collapsedOtherEvents = nil; // let GC collect this
-
-    occurrences[@"allTime"] = @(MAX(uncollapsedCount, allTime));
-    occurrences[@"last1days"] = @(last1days);
-    occurrences[@"last3days"] = @(last3days);
-    occurrences[@"last7days"] = @(last7days);
-    occurrences[@"last15days"] = @(last15days);
-    occurrences[@"last30days"] = @(last30days);
-    occurrences[@"last60days"] = @(last60days);
-    occurrences[@"last90days"] = @(last90days);
-
-    [collapsedEventData setObject:occurrences forKey:@"occurrences"];
-    [uncollapsedEventData setObject:occurrences forKey:@"occurrences"];
-
-    // Store the new list
-    [self setTrackedEvents:storeTrackedEvents];
-
-    if (occurrencesOut != nil) *occurrencesOut = [NSDictionary dictionaryWithDictionary:occurrences];
 }
 
 - (NSArray *)trackedEvents {
-    NSArray *storedTrackedEvents = [self _getNSArrayFromJSONForKey:USER_DEFAULTS_TRACKED_EVENTS_KEY];
-    NSMutableArray *result = [[NSMutableArray alloc] initWithCapacity:[storedTrackedEvents count]];
-    for (NSInteger i = 0; storedTrackedEvents && i < storedTrackedEvents.count; i++) {
-        id event = [storedTrackedEvents objectAtIndex:i];
-        if (!event[@"creationDate"] && event[@"actionDate"]) {
-            NSMutableDictionary *event2 = [event mutableCopy];
-            event2[@"creationDate"] = event2[@"actionDate"];
-            [result addObject:event2];
-        } else {
-            [result addObject:event];
-        }
+    @synchronized (self) {
+        return self.trackedEventsIndex.eventsWithCreationDate;
+    }
+}
+
+- (NSArray *)trackedEventsOfType:(NSString *)type typePrefix:(NSString *)typePrefix {
+    @synchronized (self) {
+        return [self.trackedEventsIndex eventsWithCreationDateOfType:type typePrefix:typePrefix];
     }
-    return result;
 }
 
 - (void)setTrackedEvents:(NSArray *)trackedEvents {
     @synchronized (self) {
-        [self _setNSArrayAsJSON:trackedEvents forKey:USER_DEFAULTS_TRACKED_EVENTS_KEY];
+        [self.trackedEventsJournal replaceEvents:trackedEvents];
+        _trackedEventsIndex = nil;
+        _trackedEventsVersion++;
     }
 }
 
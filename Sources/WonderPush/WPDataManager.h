@@ -8,9 +8,17 @@
 
 #import <Foundation/Foundation.h>
 
+/// Called on the main queue each time the data of a user has been exported.
+typedef void (^WPDataManagerProgressBlock)(NSUInteger exportedUserCount, NSUInteger userCount);
+
 @interface WPDataManager : NSObject
 + (instancetype) sharedInstance;
 - (void)downloadAllData:(void (^)(NSData *, NSError *))completion;
+/// Exports all the data to the given file, one JSON object per line, written as it gets fetched.
+- (void) downloadAllDataToFile:(NSString *)path progress:(WPDataManagerProgressBlock)progress completion:(void (^)(NSError *))completion;
+/// Exports all the data to the given stream, which is opened if needed but left open.
+/// Users are fetched one at a time, but the events of a few of them are paged through at once, holding only one page per user in memory.
+- (void) downloadAllDataToStream:(NSOutputStream *)stream progress:(WPDataManagerProgressBlock)progress completion:(void (^)(NSError *))completion;
 - (void)clearEventsHistory;
 - (void)clearEventsHistoryForUserId:(NSString *)userId;
 - (void) clearPreferences;
@@ -11,10 +11,98 @@
 #import "WPAPIClient.h"
 #import "WPJsonSyncInstallation.h"
 #import <WonderPushCommon/WPNSUtil.h>
+#import <WonderPushCommon/WPErrors.h>
+
+#define WP_DATA_MANAGER_MAX_CONCURRENT_USERS 3
+#define WP_DATA_MANAGER_COPY_CHUNK_SIZE 65536
 
 static WPDataManager *instance = nil;
 static dispatch_queue_t dataManagerQueue;
 
+// Writes all the bytes, as an output stream may accept only part of them at once
+static BOOL WPDataManagerWrite(NSOutputStream *stream, NSData *data, NSError **error)
+{
+    const uint8_t *bytes = data.bytes;
+    NSUInteger offset = 0;
+    while (offset < data.length) {
+        NSInteger written = [stream write:bytes + offset maxLength:data.length - offset];
+        if (written <= 0) {
+            if (error) *error = stream.streamError ?: [NSError errorWithDomain:WPErrorDomain code:0 userInfo:@{NSLocalizedDescriptionKey: @"Could not write the exported data"}];
+            return NO;
+        }
+        offset += written;
+    }
+    return YES;
+}
+
+static BOOL WPDataManagerCopyFile(NSString *path, NSOutputStream *stream, NSError **error)
+{
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingAtPath:path];
+    NSError *writeError = nil;
+    while (fileHandle && !writeError) {
+        @autoreleasepool {
+            NSData *chunk = [fileHandle readDataOfLength:WP_DATA_MANAGER_COPY_CHUNK_SIZE];
+            if (chunk.length == 0) break;
+            WPDataManagerWrite(stream, chunk, &writeError);
+        }
+    }
+    [fileHandle closeFile];
+    if (writeError && error) *error = writeError;
+    return writeError == nil;
+}
+
+/// A file the data of one user is exported to, which is no longer written to after the first failure
+@interface WPDataManagerExportFile : NSObject
+- (instancetype) initWithPath:(NSString *)path append:(BOOL)append;
+@property (nonatomic, strong) NSOutputStream *stream;
+@property (nonatomic, strong) NSError *error;
+@end
+
+@implementation WPDataManagerExportFile
+
+- (instancetype) initWithPath:(NSString *)path append:(BOOL)append
+{
+    if (self = [super init]) {
+        _stream = [NSOutputStream outputStreamToFileAtPath:path append:append];
+        [_stream open];
+    }
+    return self;
+}
+
+- (void) appendData:(NSData *)data
+{
+    @synchronized (self) {
+        NSError *error = nil;
+        if (!self.error && data && !WPDataManagerWrite(self.stream, data, &error)) self.error = error;
+    }
+}
+
+- (void) appendString:(NSString *)string
+{
+    [self appendData:[string dataUsingEncoding:NSUTF8StringEncoding]];
+}
+
+- (NSError *) appendJSON:(id)object
+{
+    NSError *error = nil;
+    [self appendData:[NSJSONSerialization dataWithJSONObject:object options:0 error:&error]];
+    return error;
+}
+
+- (NSError *) error
+{
+    @synchronized (self) {
+        return _error;
+    }
+}
+
+- (void) close
+{
+    [self.stream close];
+}
+
+@end
+
 @implementation WPDataManager
 + (void) initialize
 {
@@ -29,127 +117,267 @@ static dispatch_queue_t dataManagerQueue;
     return instance;
 }
 - (void) downloadAllData:(void (^)(NSData *, NSError *))completion
+{
+    // Export to a temporary file and hand out a mapping of it, rather than building the export in memory
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"WonderPushExport-%@.ndjson", [[NSUUID UUID] UUIDString]]];
+    [self downloadAllDataToFile:path progress:nil completion:^(NSError *error) {
+        NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+        // The mapping outlives the file name
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        completion(data, error);
+    }];
+}
+
+- (void) downloadAllDataToFile:(NSString *)path progress:(WPDataManagerProgressBlock)progress completion:(void (^)(NSError *))completion
+{
+    NSOutputStream *stream = [NSOutputStream outputStreamToFileAtPath:path append:NO];
+    [stream open];
+    [self downloadAllDataToStream:stream progress:progress completion:^(NSError *error) {
+        [stream close];
+        completion(error);
+    }];
+}
+
+- (void) downloadAllDataToStream:(NSOutputStream *)stream progress:(WPDataManagerProgressBlock)progress completion:(void (^)(NSError *))completion
 {
     dispatch_async(dataManagerQueue, ^{
-        void(^callCompletion)(NSData *, NSError*) = ^(NSData *data, NSError *error) {
+        void(^callCompletion)(NSError*) = ^(NSError *error) {
             dispatch_async(dispatch_get_main_queue(), ^{
-                completion(data, error);
+                completion(error);
             });
         };
-        __block NSError *error = nil;
-        NSMutableData *buffer = [NSMutableData new];
-        WPConfiguration *configuration = [WPConfiguration sharedConfiguration];
-        void(^appendString)(NSString *) = ^(NSString *s) {
-            [buffer appendData:[s dataUsingEncoding:NSUTF8StringEncoding]];
-        };
+        NSError *error = nil;
+        if (stream.streamStatus == NSStreamStatusNotOpen) [stream open];
 
         // Write WPConfiguration data
-        appendString(@"{\"sharedPreferences\":");
-        NSData *configurationData = [NSJSONSerialization dataWithJSONObject:[configuration dumpState] options:0 error:&error];
-        if (error) return callCompletion(nil, error);
-        [buffer appendData:configurationData];
-        appendString(@"}\n");
-        
-        // Iterate on known user Ids
-        for (NSString *userId in [configuration listKnownUserIds]) {
-            NSString *accessToken = [configuration getAccessTokenForUserId:userId];
-            if (accessToken == nil) continue; // That user was cleaned up, don't try to reach the API or it will re-create an accessToken
-            
-            // Get a new access token
-            appendString(@"{\"accessToken\":");
-            dispatch_semaphore_t sem = dispatch_semaphore_create(0);
-            [[WPAPIClient sharedClient] fetchAccessTokenAndCall:^(NSURLSessionTask *task, id response) {
-                NSData *responseData = [NSJSONSerialization dataWithJSONObject:response options:0 error:&error];
-                if (responseData) {
-                    [buffer appendData:responseData];
+        NSData *configurationData = [NSJSONSerialization dataWithJSONObject:[self configurationState] options:0 error:&error];
+        if (error) return callCompletion(error);
+        NSMutableData *line = [NSMutableData dataWithData:[@"{\"sharedPreferences\":" dataUsingEncoding:NSUTF8StringEncoding]];
+        [line appendData:configurationData];
+        [line appendData:[@"}\n" dataUsingEncoding:NSUTF8StringEncoding]];
+        if (!WPDataManagerWrite(stream, line, &error)) return callCompletion(error);
+        line = nil;
+        configurationData = nil;
+
+        NSArray<NSString *> *userIds = [self exportedUserIds];
+        NSUInteger userCount = userIds.count;
+        if (progress) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                progress(0, userCount);
+            });
+        }
+
+        // Each user is exported into its own temporary file so that their lines don't interleave,
+        // and these files are copied to the stream in order as they complete.
+        // The access token, user and installation are fetched one user at a time,
+        // as fetching an access token is not safe to do for several users at once.
+        // Only the event pages of a few users are fetched at the same time.
+        NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"WonderPushExport-%@", [[NSUUID UUID] UUIDString]]];
+        [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+        NSMutableArray *userErrors = [NSMutableArray new];
+        NSMutableArray<dispatch_semaphore_t> *userDone = [NSMutableArray new];
+        for (NSUInteger i = 0; i < userCount; i++) {
+            [userErrors addObject:[NSNull null]];
+            [userDone addObject:dispatch_semaphore_create(0)];
+        }
+        NSString *(^pathForUser)(NSUInteger) = ^(NSUInteger i) {
+            return [directory stringByAppendingPathComponent:[NSString stringWithFormat:@"%lu.ndjson", (unsigned long)i]];
+        };
+        void(^userFinished)(NSUInteger, NSError *) = ^(NSUInteger i, NSError *userError) {
+            if (userError) {
+                @synchronized (userErrors) {
+                    userErrors[i] = userError;
                 }
-                dispatch_semaphore_signal(sem);
-            } failure:^(NSURLSessionTask *task, NSError *responseError) {
-                appendString(responseError.description);
-                dispatch_semaphore_signal(sem);
-            } nbRetry:0 forUserId:userId];
-            dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
-            appendString(@"}\n");
-            if (error) return callCompletion(buffer, error);
-            
-            // Get user and installation objects
-            NSMutableArray *resources = [NSMutableArray new];
-            if (userId.length) [resources addObject:@"user"];
-            [resources addObject:@"installation"];
-            
-            for (NSString *resource in [resources copy]) {
-                WPRequest *request = [WPRequest new];
-                request.userId = userId;
-                request.resource = [NSString stringWithFormat:@"/%@", resource];
-                request.method = @"GET";
-                request.handler = ^(WPResponse *response, NSError *responseError) {
-                    if (responseError) {
-                        appendString(responseError.description);
-                    } else if (response) {
-                        NSData *responseData = [NSJSONSerialization dataWithJSONObject:response.object options:0 error:&error];
-                        if (responseData) [buffer appendData:responseData];
-                    }
-                    dispatch_semaphore_signal(sem);
-                };
-                appendString([NSString stringWithFormat:@"{\"%@\":", resource]);
-                [[WPAPIClient sharedClient] executeRequest:request];
-                dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
-                appendString(@"}\n");
             }
-            
-            // Get events
-            __block void(^getNextEventPage)(NSDictionary *params);
-            WPRequestHandler handler = ^(WPResponse *response, NSError *responseError) {
-                if (responseError) {
-                    appendString(responseError.description);
-                    appendString(@"}\n");
-                } else if (response) {
-                    NSArray *events = [WPNSUtil arrayForKey:@"data" inDictionary:response.object];
-                    if (events.count) {
-                        NSData *responseData = [NSJSONSerialization dataWithJSONObject:events options:0 error:&error];
-                        appendString(@"{\"eventsPage\":");
-                        if (responseData) [buffer appendData:responseData];
-                        appendString(@"}\n");
-                    }
-                }
-                // Extract pagination info from response
-                NSDictionary *pagination = [WPNSUtil dictionaryForKey:@"pagination" inDictionary:response.object];
-                NSString *next = [WPNSUtil stringForKey:@"next" inDictionary:pagination];
-                // When a 'next' is specified, continue to next page
-                if (next) {
-                    // Parse the next URL to extract its parameters
-                    NSURL *URL = [NSURL URLWithString:next];
-                    NSURLComponents *URLComponents = [NSURLComponents componentsWithURL:URL resolvingAgainstBaseURL:NO];
-                    NSMutableDictionary *parameters = [NSMutableDictionary new];
-                    for (NSURLQueryItem *queryItem in URLComponents.queryItems) {
-                        if (queryItem.name && queryItem.value) {
-                            parameters[queryItem.name] = queryItem.value;
-                        }
-                    }
-                    // Loop as long as there's a next page
-                    getNextEventPage([parameters copy]);
-
-                } else {
-                    // Finish
-                    dispatch_semaphore_signal(sem);
+            dispatch_semaphore_signal(userDone[i]);
+        };
+        BOOL(^hasFailed)(void) = ^BOOL{
+            @synchronized (userErrors) {
+                return [userErrors indexOfObjectPassingTest:^BOOL(id userError, NSUInteger idx, BOOL *stop) {
+                    return userError != [NSNull null];
+                }] != NSNotFound;
+            }
+        };
+        dispatch_queue_t workQueue = dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+        dispatch_semaphore_t slots = dispatch_semaphore_create(WP_DATA_MANAGER_MAX_CONCURRENT_USERS);
+        dispatch_async(workQueue, ^{
+            for (NSUInteger i = 0; i < userCount; i++) {
+                dispatch_semaphore_wait(slots, DISPATCH_TIME_FOREVER);
+                // Like before, the users after the first one that failed are not exported
+                NSError *profileError = hasFailed() ? nil : [self exportProfileOfUserId:userIds[i] toFile:pathForUser(i)];
+                if (profileError || hasFailed()) {
+                    userFinished(i, profileError);
+                    dispatch_semaphore_signal(slots);
+                    continue;
                 }
-            };
-            getNextEventPage = ^(NSDictionary *params) {
-                WPRequest *request = [WPRequest new];
-                request.userId = userId;
-                request.resource = @"/events";
-                request.method = @"GET";
-                request.params = params;
-                request.handler = handler;
-                [[WPAPIClient sharedClient] executeRequest:request];
-            };
-            getNextEventPage(@{@"limit": @1000});
-            dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
+                dispatch_async(workQueue, ^{
+                    userFinished(i, [self exportEventsOfUserId:userIds[i] toFile:pathForUser(i)]);
+                    dispatch_semaphore_signal(slots);
+                });
+            }
+        });
+        for (NSUInteger i = 0; i < userCount; i++) {
+            dispatch_semaphore_wait(userDone[i], DISPATCH_TIME_FOREVER);
+            NSError *userError;
+            @synchronized (userErrors) {
+                userError = userErrors[i] == [NSNull null] ? nil : userErrors[i];
+            }
+            // Stop at the first user that failed, keeping what was fetched for it
+            if (!error) {
+                WPDataManagerCopyFile(pathForUser(i), stream, &error);
+                if (!error) error = userError;
+            }
+            [[NSFileManager defaultManager] removeItemAtPath:pathForUser(i) error:nil];
+            if (progress) {
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    progress(i + 1, userCount);
+                });
+            }
         }
-        
-        callCompletion([buffer copy], nil);
+        [[NSFileManager defaultManager] removeItemAtPath:directory error:nil];
+
+        callCompletion(error);
     });
 }
+
+- (NSDictionary *) configurationState
+{
+    return [[WPConfiguration sharedConfiguration] dumpState];
+}
+
+- (NSArray<NSString *> *) exportedUserIds
+{
+    WPConfiguration *configuration = [WPConfiguration sharedConfiguration];
+    NSMutableArray<NSString *> *userIds = [NSMutableArray new];
+    for (NSString *userId in [configuration listKnownUserIds]) {
+        if ([configuration getAccessTokenForUserId:userId] == nil) continue; // That user was cleaned up, don't try to reach the API or it will re-create an accessToken
+        [userIds addObject:userId];
+    }
+    return userIds;
+}
+
+- (void) fetchAccessTokenForUserId:(NSString *)userId success:(void (^)(id))success failure:(void (^)(NSError *))failure
+{
+    [[WPAPIClient sharedClient] fetchAccessTokenAndCall:^(NSURLSessionTask *task, id response) {
+        success(response);
+    } failure:^(NSURLSessionTask *task, NSError *error) {
+        failure(error);
+    } nbRetry:0 forUserId:userId];
+}
+
+- (void) executeRequest:(WPRequest *)request
+{
+    [[WPAPIClient sharedClient] executeRequest:request];
+}
+
+// Blocks until the access token, user and installation of the given user are written to the given file
+- (NSError *) exportProfileOfUserId:(NSString *)userId toFile:(NSString *)path
+{
+    WPDataManagerExportFile *file = [[WPDataManagerExportFile alloc] initWithPath:path append:NO];
+    dispatch_semaphore_t sem = dispatch_semaphore_create(0);
+
+    // Get a new access token
+    __block NSError *accessTokenError = nil;
+    [file appendString:@"{\"accessToken\":"];
+    [self fetchAccessTokenForUserId:userId success:^(id response) {
+        accessTokenError = [file appendJSON:response];
+        dispatch_semaphore_signal(sem);
+    } failure:^(NSError *responseError) {
+        [file appendString:responseError.description];
+        dispatch_semaphore_signal(sem);
+    }];
+    dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
+    [file appendString:@"}\n"];
+    if (file.error || accessTokenError) {
+        [file close];
+        return file.error ?: accessTokenError;
+    }
+
+    // Get user and installation objects
+    NSMutableArray *resources = [NSMutableArray new];
+    if (userId.length) [resources addObject:@"user"];
+    [resources addObject:@"installation"];
+
+    for (NSString *resource in resources) {
+        WPRequest *request = [WPRequest new];
+        request.userId = userId;
+        request.resource = [NSString stringWithFormat:@"/%@", resource];
+        request.method = @"GET";
+        request.handler = ^(WPResponse *response, NSError *responseError) {
+            if (responseError) {
+                [file appendString:responseError.description];
+            } else if (response) {
+                [file appendJSON:response.object];
+            }
+            dispatch_semaphore_signal(sem);
+        };
+        [file appendString:[NSString stringWithFormat:@"{\"%@\":", resource]];
+        [self executeRequest:request];
+        dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
+        [file appendString:@"}\n"];
+    }
+    [file close];
+    return file.error;
+}
+
+// Blocks until all the events of the given user are appended to the given file
+- (NSError *) exportEventsOfUserId:(NSString *)userId toFile:(NSString *)path
+{
+    WPDataManagerExportFile *file = [[WPDataManagerExportFile alloc] initWithPath:path append:YES];
+    dispatch_semaphore_t sem = dispatch_semaphore_create(0);
+
+    // Write each page as it arrives so that only one page is held in memory at a time
+    __block void(^getNextEventPage)(NSDictionary *params);
+    WPRequestHandler handler = ^(WPResponse *response, NSError *responseError) {
+        if (responseError) {
+            [file appendString:responseError.description];
+            [file appendString:@"}\n"];
+        } else if (response) {
+            NSArray *events = [WPNSUtil arrayForKey:@"data" inDictionary:response.object];
+            if (events.count) {
+                [file appendString:@"{\"eventsPage\":"];
+                [file appendJSON:events];
+                [file appendString:@"}\n"];
+            }
+        }
+        // Extract pagination info from response
+        NSDictionary *pagination = [WPNSUtil dictionaryForKey:@"pagination" inDictionary:response.object];
+        NSString *next = [WPNSUtil stringForKey:@"next" inDictionary:pagination];
+        // When a 'next' is specified, continue to next page, unless we can no longer write
+        if (next && !file.error) {
+            // Parse the next URL to extract its parameters
+            NSURL *URL = [NSURL URLWithString:next];
+            NSURLComponents *URLComponents = [NSURLComponents componentsWithURL:URL resolvingAgainstBaseURL:NO];
+            NSMutableDictionary *parameters = [NSMutableDictionary new];
+            for (NSURLQueryItem *queryItem in URLComponents.queryItems) {
+                if (queryItem.name && queryItem.value) {
+                    parameters[queryItem.name] = queryItem.value;
+                }
+            }
+            // Loop as long as there's a next page
+            getNextEventPage([parameters copy]);
+
+        } else {
+            // Finish
+            dispatch_semaphore_signal(sem);
+        }
+    };
+    getNextEventPage = ^(NSDictionary *params) {
+        WPRequest *request = [WPRequest new];
+        request.userId = userId;
+        request.resource = @"/events";
+        request.method = @"GET";
+        request.params = params;
+        request.handler = handler;
+        [self executeRequest:request];
+    };
+    getNextEventPage(@{@"limit": @1000});
+    dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
+    getNextEventPage = nil;
+    [file close];
+    return file.error;
+}
+
 - (void) clearEventsHistory
 {
     for (NSString *userId in [[WPConfiguration sharedConfiguration] listKnownUserIds]) {
@@ -16,6 +16,7 @@
 
 #import "WPIAMBannerViewController.h"
 #import "WPCore+InAppMessagingDisplay.h"
+#import "WPInAppMessagingRenderingPrivate.h"
 
 @interface WPIAMBannerViewController ()
 
@@ -125,7 +126,7 @@ static const CGFloat kSwipeDownThreshold = 10.0f;
     if (self.bannerDisplayMessage.imageData) {
         self.imageView.contentMode = UIViewContentModeScaleAspectFit;
         
-        UIImage *image = [UIImage imageWithData:self.bannerDisplayMessage.imageData.imageRawData];
+        UIImage *image = self.bannerDisplayMessage.imageData.image;
         
         // Adapt image aspect ratio if needed
         if (fabs(image.size.width / image.size.height - 1) > 0.02) {
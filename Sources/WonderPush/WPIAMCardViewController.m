@@ -16,6 +16,7 @@
 
 #import "WPIAMCardViewController.h"
 #import "WPCore+InAppMessagingDisplay.h"
+#import "WPInAppMessagingRenderingPrivate.h"
 
 @interface WPIAMCardViewController ()
 
@@ -128,13 +129,12 @@
     // 2. The iOS device is in "landscape" mode (regular width or compact height).
     if (self.traitCollection.horizontalSizeClass == UIUserInterfaceSizeClassRegular ||
         self.traitCollection.verticalSizeClass == UIUserInterfaceSizeClassCompact) {
-        NSData *imageData = self.cardDisplayMessage.landscapeImageData
-        ? self.cardDisplayMessage.landscapeImageData.imageRawData
-        : self.cardDisplayMessage.portraitImageData.imageRawData;
-        self.imageView.image = [UIImage imageWithData:imageData];
+        WPInAppMessagingImageData *imageData = self.cardDisplayMessage.landscapeImageData
+        ? self.cardDisplayMessage.landscapeImageData
+        : self.cardDisplayMessage.portraitImageData;
+        self.imageView.image = imageData.image;
     } else {
-        self.imageView.image =
-        [UIImage imageWithData:self.cardDisplayMessage.portraitImageData.imageRawData];
+        self.imageView.image = self.cardDisplayMessage.portraitImageData.image;
     }
     
     self.textAreaScrollView.contentSize = self.bodyTextView.frame.size;
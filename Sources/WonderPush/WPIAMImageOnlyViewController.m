@@ -16,6 +16,7 @@
 
 #import "WPIAMImageOnlyViewController.h"
 #import "WPCore+InAppMessagingDisplay.h"
+#import "WPInAppMessagingRenderingPrivate.h"
 #import "WPIAMHitTestDelegateView.h"
 
 @interface WPIAMImageOnlyViewController () <WPIAMHitTestDelegate>
@@ -94,7 +95,7 @@
     self.backgroundCloseButton.backgroundColor = UIColor.clearColor;
 
     if (self.imageOnlyMessage.imageData) {
-        UIImage *image = [UIImage imageWithData:self.imageOnlyMessage.imageData.imageRawData];
+        UIImage *image = self.imageOnlyMessage.imageData.image;
         self.imageOriginalSize = image.size;
         [self.imageView setImage:image];
         self.imageView.contentMode = UIViewContentModeScaleAspectFit;
@@ -20,9 +20,16 @@
 #import "WPIAMFetchResponseParser.h"
 #import "WPIAMMessageClientCache.h"
 #import "WonderPush_private.h"
+#import "WPRemoteConfig.h"
 #import "WPSPSegmenter.h"
 #import <WonderPushCommon/WPNSUtil.h>
 
+// a regular message rendered on an event, once it occurred at least minOccurrences times
+@interface WPIAMEventTriggerCandidate : NSObject
+@property(nonatomic) WPIAMMessageDefinition *message;
+@property(nonatomic) NSInteger minOccurrences;
+@end
+
 @interface WPIAMMessageClientCache ()
 
 // messages not for client-side testing
@@ -30,22 +37,46 @@
 // messages for client-side testing
 @property(nonatomic) NSMutableArray<WPIAMMessageDefinition *> *testMessages;
 @property(nonatomic) NSMutableSet<NSString *> *wonderpushEventsToWatch;
+// regular messages rendered on each event, in display priority order
+@property(nonatomic) NSDictionary<NSString *, NSArray<WPIAMEventTriggerCandidate *> *> *candidatesByEvent;
+// regular messages rendered on app launch and on app foreground, in display priority order
+@property(nonatomic) NSDictionary<NSNumber *, NSArray<WPIAMMessageDefinition *> *> *candidatesByTrigger;
+// regular messages by ascending start time, and those having an end time by ascending end time,
+// walked as time passes to keep activeMessages up to date
+@property(nonatomic) NSArray<WPIAMMessageDefinition *> *messagesByStartTime;
+@property(nonatomic) NSArray<WPIAMMessageDefinition *> *messagesByEndTime;
+@property(nonatomic) NSUInteger startedCount;
+@property(nonatomic) NSUInteger expiredCount;
+@property(nonatomic) NSTimeInterval activeMessagesTime;
+// regular messages that have started and have not expired as of activeMessagesTime
+@property(nonatomic) NSHashTable<WPIAMMessageDefinition *> *activeMessages;
+// parsed and compiled segment of each regular message having one, or NSNull if it's invalid
+@property(nonatomic) NSMapTable<WPIAMMessageDefinition *, id> *parsedSegments;
 @property(nonatomic) id<WPIAMBookKeeper> bookKeeper;
 
 @end
 
+@implementation WPIAMEventTriggerCandidate
+@end
+
 // Methods doing read and write operations on messages field is synchronized to avoid
 // race conditions like change the array while iterating through it
 @implementation WPIAMMessageClientCache
 - (instancetype)initWithBookkeeper:(id<WPIAMBookKeeper>)bookKeeper {
     if (self = [super init]) {
         _bookKeeper = bookKeeper;
+        _parsedSegments = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
     }
     return self;
 }
 
 // reset messages data
 - (void)setMessageData:(NSArray<WPIAMMessageDefinition *> *)messages {
+    [self setMessageData:messages snapshot:nil];
+}
+
+// reset messages data, reusing the segments the given remote config snapshot compiled for them
+- (void)setMessageData:(NSArray<WPIAMMessageDefinition *> *)messages snapshot:(WPRemoteConfigSnapshot *)snapshot {
     @synchronized(self) {
         
         NSDictionary<NSString *, WPIAMImpressionRecord *> *impressionRecords = [self getImpressionRecords];
@@ -75,6 +106,7 @@
         }];
         
         self.regularMessages = [[regularMessages filteredArrayUsingPredicate:notOverImpressedPredicate] mutableCopy];
+        [self parseSegmentsWithSnapshot:snapshot];
         [self setupWonderPushEventListening];
     }
     
@@ -86,19 +118,33 @@
 //                (unsigned long)self.wonderpushEventsToWatch.count);
 }
 
+// parse and compile the segments of all regular messages once, so that display checks only have to evaluate them
+- (void)parseSegmentsWithSnapshot:(WPRemoteConfigSnapshot *)snapshot {
+    NSMapTable<WPIAMMessageDefinition *, id> *parsedSegments = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    NSDate *start = [NSDate date];
+    NSUInteger invalidCount = 0;
+    for (WPIAMMessageDefinition *next in self.regularMessages) {
+        if (!next.segmentDefinition) continue;
+        id parsedSegment = [snapshot compiledSegmentOfInAppMessage:next] ?: [self parseSegmentOfMessage:next];
+        if (parsedSegment == [NSNull null]) invalidCount++;
+        [parsedSegments setObject:parsedSegment forKey:next];
+    }
+    self.parsedSegments = parsedSegments;
+    WPLogDebug(@"Parsed %lu in-app segments in %.1fms, %lu invalid",
+               (unsigned long)parsedSegments.count, -start.timeIntervalSinceNow * 1000, (unsigned long)invalidCount);
+}
+
+- (id)parseSegmentOfMessage:(WPIAMMessageDefinition *)message {
+    return [WPRemoteConfigSnapshot compileSegmentOfInAppMessage:message];
+}
+
 // triggered after self.messages are updated so that we can correctly enable/disable listening
 // on analytics event based on current IAM message set
 - (void)setupWonderPushEventListening {
-    self.wonderpushEventsToWatch = [[NSMutableSet alloc] init];
-    for (WPIAMMessageDefinition *nextMessage in self.regularMessages) {
-        // if it's event based triggering, add it to the watch set
-        for (WPIAMDisplayTriggerDefinition *nextTrigger in nextMessage.renderTriggers) {
-            if (nextTrigger.triggerType == WPIAMRenderTriggerOnWonderPushEvent) {
-                [self.wonderpushEventsToWatch addObject:nextTrigger.eventName];
-            }
-        }
-    }
-    
+    [self indexMessages];
+    // if it's event based triggering, add it to the watch set
+    self.wonderpushEventsToWatch = [NSMutableSet setWithArray:self.candidatesByEvent.allKeys];
+
     if (self.analycisEventDislayCheckFlow) {
         if ([self.wonderpushEventsToWatch count] > 0) {
             WPLogDebug(
@@ -111,6 +157,78 @@
     }
 }
 
+// index the regular messages by trigger, so that finding the next message only looks at those the trigger can render
+- (void)indexMessages {
+    NSMutableDictionary<NSString *, NSMutableArray<WPIAMEventTriggerCandidate *> *> *candidatesByEvent = [NSMutableDictionary new];
+    NSMutableArray<WPIAMMessageDefinition *> *appLaunchCandidates = [NSMutableArray new];
+    NSMutableArray<WPIAMMessageDefinition *> *appForegroundCandidates = [NSMutableArray new];
+    for (WPIAMMessageDefinition *next in self.regularMessages) {
+        if ([next messageRenderedOnTrigger:WPIAMRenderTriggerOnAppLaunch]) [appLaunchCandidates addObject:next];
+        if ([next messageRenderedOnTrigger:WPIAMRenderTriggerOnAppForeground]) [appForegroundCandidates addObject:next];
+        for (WPIAMDisplayTriggerDefinition *nextTrigger in next.renderTriggers) {
+            if (nextTrigger.triggerType != WPIAMRenderTriggerOnWonderPushEvent || !nextTrigger.eventName) continue;
+            NSMutableArray<WPIAMEventTriggerCandidate *> *candidates = candidatesByEvent[nextTrigger.eventName];
+            if (!candidates) {
+                candidates = [NSMutableArray new];
+                candidatesByEvent[nextTrigger.eventName] = candidates;
+            }
+            // several triggers of a message on the same event: the lowest minOccurrences is the one that matters
+            NSInteger minOccurrences = nextTrigger.minOccurrences.integerValue;
+            WPIAMEventTriggerCandidate *candidate = candidates.lastObject;
+            if (candidate.message == next) {
+                candidate.minOccurrences = MIN(candidate.minOccurrences, minOccurrences);
+                continue;
+            }
+            candidate = [WPIAMEventTriggerCandidate new];
+            candidate.message = next;
+            candidate.minOccurrences = minOccurrences;
+            [candidates addObject:candidate];
+        }
+    }
+    self.candidatesByEvent = candidatesByEvent;
+    self.candidatesByTrigger = @{
+        @(WPIAMRenderTriggerOnAppLaunch): appLaunchCandidates,
+        @(WPIAMRenderTriggerOnAppForeground): appForegroundCandidates,
+    };
+
+    self.messagesByStartTime = [self.regularMessages sortedArrayUsingComparator:^NSComparisonResult(WPIAMMessageDefinition *a, WPIAMMessageDefinition *b) {
+        return [@(a.startTime) compare:@(b.startTime)];
+    }];
+    self.messagesByEndTime = [[self.regularMessages filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(WPIAMMessageDefinition *message, NSDictionary *bindings) {
+        return message.endTime != 0;
+    }]] sortedArrayUsingComparator:^NSComparisonResult(WPIAMMessageDefinition *a, WPIAMMessageDefinition *b) {
+        return [@(a.endTime) compare:@(b.endTime)];
+    }];
+    self.startedCount = 0;
+    self.expiredCount = 0;
+    self.activeMessagesTime = 0;
+    self.activeMessages = [NSHashTable hashTableWithOptions:NSPointerFunctionsObjectPointerPersonality];
+}
+
+// bring activeMessages up to date, only walking past the start and end times reached since the last call
+- (void)updateActiveMessagesAt:(NSTimeInterval)timeSince1970 {
+    if (timeSince1970 < self.activeMessagesTime) {
+        // the clock went back, start over
+        self.startedCount = 0;
+        self.expiredCount = 0;
+        [self.activeMessages removeAllObjects];
+    }
+    self.activeMessagesTime = timeSince1970;
+    while (self.startedCount < self.messagesByStartTime.count) {
+        WPIAMMessageDefinition *next = self.messagesByStartTime[self.startedCount];
+        // same as messageHasStarted and messageHasExpired
+        if (!(next.startTime < timeSince1970)) break;
+        if (!(next.endTime && next.endTime < timeSince1970)) [self.activeMessages addObject:next];
+        self.startedCount++;
+    }
+    while (self.expiredCount < self.messagesByEndTime.count) {
+        WPIAMMessageDefinition *next = self.messagesByEndTime[self.expiredCount];
+        if (!(next.endTime < timeSince1970)) break;
+        [self.activeMessages removeObject:next];
+        self.expiredCount++;
+    }
+}
+
 - (NSArray<WPIAMMessageDefinition *> *)allRegularMessages {
     return [self.regularMessages copy];
 }
@@ -141,18 +259,23 @@
 }
 
 - (nullable WPIAMMessageDefinition *)nextMessageForTrigger:(WPIAMRenderTrigger)trigger {
-    return [self nextMsgMatchingCondition:^(WPIAMMessageDefinition *next) {
-        return [next messageRenderedOnTrigger:trigger];
-    }];
+    NSArray<WPIAMMessageDefinition *> *candidates;
+    @synchronized(self) {
+        candidates = self.candidatesByTrigger[@(trigger)];
+    }
+    return [self nextMsgAmongCandidates:candidates];
 }
 
 - (nullable WPIAMMessageDefinition *)nextOnEventDisplayMsg:(NSString *)eventName allTimeOccurrences:(NSInteger)allTimeOccurrences {
-    if (![self.wonderpushEventsToWatch containsObject:eventName]) {
-        return nil;
+    NSMutableArray<WPIAMMessageDefinition *> *candidates = [NSMutableArray new];
+    @synchronized(self) {
+        for (WPIAMEventTriggerCandidate *candidate in self.candidatesByEvent[eventName]) {
+            // minOccurrences criteria not met
+            if (candidate.minOccurrences > allTimeOccurrences) continue;
+            [candidates addObject:candidate.message];
+        }
     }
-    return [self nextMsgMatchingCondition:^(WPIAMMessageDefinition *next) {
-        return [next messageRenderedOnWonderPushEvent:eventName allTimeOccurrences:allTimeOccurrences];
-    }];
+    return [self nextMsgAmongCandidates:candidates];
 }
 
 - (NSDictionary<NSString *, WPIAMImpressionRecord *> *)getImpressionRecords {
@@ -166,34 +289,47 @@
     return [NSDictionary dictionaryWithDictionary:result];
 }
 
-- (nullable WPIAMMessageDefinition *)nextMsgMatchingCondition:(BOOL(^)(WPIAMMessageDefinition *))condition {
+// candidates are the messages rendered by the trigger, in display priority order
+- (nullable WPIAMMessageDefinition *)nextMsgAmongCandidates:(NSArray<WPIAMMessageDefinition *> *)candidates {
+    if (candidates.count == 0) return nil;
     NSDictionary<NSString *, WPIAMImpressionRecord *> *impressionRecords = [self getImpressionRecords];
-    WPSPSegmenter *segmenter = [[WPSPSegmenter alloc] initWithData:[WPSPSegmenterData forCurrentUser]];
+    WPSPSegmenter *segmenter = nil;
+    for (WPIAMMessageDefinition *next in candidates) {
+        if (!next.segmentDefinition) continue;
+        segmenter = [[WPSPSegmenter alloc] initWithData:[WPSPSegmenterData forCurrentUser]];
+        break;
+    }
     @synchronized(self) {
         NSTimeInterval timeSince1970 = [NSDate date].timeIntervalSince1970;
+        [self updateActiveMessagesAt:timeSince1970];
         // search from the start to end in the list (which implies the display priority) for the
         // first match (some messages in the cache may not be eligible for the current display
         // message fetch
-        for (WPIAMMessageDefinition *next in self.regularMessages) {
+        for (WPIAMMessageDefinition *next in candidates) {
             NSString *campaignId = next.renderData.reportingData.campaignId;
             WPIAMImpressionRecord *impressionRecord = impressionRecords[campaignId];
             NSInteger impressionCount = impressionRecord ? impressionRecord.impressionCount : 0;
             NSTimeInterval timeSinceLastImpression = impressionRecord ? timeSince1970 - impressionRecord.lastImpressionTimestamp : timeSince1970;
-            // message being active and message not impressed yet and the contextual trigger condition
-            // match
-            if ([next messageHasStarted] && ![next messageHasExpired]
+            // message being active (and still cached) and message not impressed yet
+            if ([self.activeMessages containsObject:next]
                 && impressionCount < next.capping.maxImpressions
-                && timeSinceLastImpression > next.capping.snoozeTime
-                && condition(next)) {
+                && timeSinceLastImpression > next.capping.snoozeTime) {
                 if (next.segmentDefinition) {
+                    id parsedSegment = [self.parsedSegments objectForKey:next];
+                    if (!parsedSegment) {
+                        parsedSegment = [self parseSegmentOfMessage:next];
+                        [self.parsedSegments setObject:parsedSegment forKey:next];
+                    }
+                    if (parsedSegment == [NSNull null]) {
+                        // Let's not use this in-app with a buggy segment
+                        continue;
+                    }
                     @try {
-                        WPSPASTCriterionNode *parsedSegment = [WPSPSegmenter parseInstallationSegment:next.segmentDefinition];
-                        if (![segmenter parsedSegmentMatchesInstallation:parsedSegment]) {
+                        if (![segmenter compiledSegmentMatchesInstallation:parsedSegment]) {
                             continue; // Segmentation check
                         }
                     } @catch (NSException *exception) {
-                        WPLog(@"Invalid segment: %@", next.segmentDefinition);
-                        // Let's not use this in-app with a buggy segment
+                        WPLog(@"Could not evaluate segment: %@", next.segmentDefinition);
                         continue;
                     }
                 }
@@ -216,6 +352,9 @@
         
         if (messagesToRemove.count > 0) {
             [self.regularMessages removeObjectsInArray:[messagesToRemove copy]];
+            for (WPIAMMessageDefinition *next in messagesToRemove) {
+                [self.parsedSegments removeObjectForKey:next];
+            }
             [self setupWonderPushEventListening];
         }
     }
@@ -232,12 +371,9 @@
             if (completion) completion(NO);
             return;
         }
-        NSDictionary *inAppConfig = [WPNSUtil dictionaryForKey:@"inAppConfig" inDictionary:config.data] ?: @{};
-        NSInteger discardCount;
-        NSArray<WPIAMMessageDefinition *> *messagesFromStorage = [WPIAMFetchResponseParser
-                                                                  parseAPIResponseDictionary:inAppConfig
-                                                                  discardedMsgCount:&discardCount];
-        [self setMessageData:messagesFromStorage];
+        // messages and their segments were parsed once along with the config
+        WPRemoteConfigSnapshot *snapshot = config.snapshot;
+        [self setMessageData:snapshot.inAppMessages ?: @[] snapshot:snapshot];
         if (completion) completion(YES);
 
     }];
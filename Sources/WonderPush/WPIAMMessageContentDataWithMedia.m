@@ -22,6 +22,7 @@
 #import "WPIAMWebViewPreloaderViewController.h"
 #import "WonderPush_private.h"
 #import "WPCore+InAppMessagingDisplay.h"
+#import <WonderPushCommon/WPMediaCache.h>
 
 static NSInteger const SuccessHTTPStatusCode = 200;
 
@@ -226,10 +227,10 @@ static NSInteger const SuccessHTTPStatusCode = 200;
 
 - (void)fetchImageFromURL:(NSURL *)imageURL
                 withBlock:(void (^)(NSData *_Nullable imageData, NSError *_Nullable error))block {
-    NSURLRequest *imageDataRequest = [NSURLRequest requestWithURL:imageURL];
-    NSURLSessionDataTask *task = [_URLSession
-                                  dataTaskWithRequest:imageDataRequest
-                                  completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+    // Images already displayed or shown in a notification come from the cache, without network access
+    [[WPMediaCache sharedCache] fetchURL:imageURL
+                                 session:_URLSession
+                              completion:^(NSData *data, NSURLResponse *response, NSError *error) {
         if (error) {
             WPLog( @"Error in fetching image: %@",
                           error);
@@ -277,7 +278,6 @@ static NSInteger const SuccessHTTPStatusCode = 200;
             }
         }
     }];
-    [task resume];
 }
 
 @end
@@ -16,6 +16,7 @@
 
 #import <UIKit/UIKit.h>
 #import "WPCore+InAppMessagingDisplay.h"
+#import "WPInAppMessagingRenderingPrivate.h"
 #import "WPIAMModalViewController.h"
 #import "WPIAMHitTestDelegateView.h"
 
@@ -131,7 +132,7 @@ static CGFloat LandScapePaddingBetweenImageAndTextColumn = 24;
     
     if (self.modalDisplayMessage.imageData) {
         [self.imageView
-         setImage:[UIImage imageWithData:self.modalDisplayMessage.imageData.imageRawData]];
+         setImage:self.modalDisplayMessage.imageData.image];
         self.imageView.contentMode = UIViewContentModeScaleAspectFit;
     }
     
@@ -334,7 +335,7 @@ struct TitleBodyButtonHeightInfo {
     self.bodyTextViewHeightConstraint.constant = heights.bodyHeight;
     
     if (self.modalDisplayMessage.imageData) {
-        UIImage *image = [UIImage imageWithData:self.modalDisplayMessage.imageData.imageRawData];
+        UIImage *image = self.modalDisplayMessage.imageData.image;
         CGSize imageAvailableSpace = CGSizeMake(self.titleLabel.frame.size.width,
                                                 heightCalcReference - heights.totaColumnlHeight -
                                                 self.imageTopToTitleBottomInPortraitMode.constant);
@@ -394,7 +395,7 @@ struct TitleBodyButtonHeightInfo {
     }
     
     if (self.modalDisplayMessage.imageData) {
-        UIImage *image = [UIImage imageWithData:self.modalDisplayMessage.imageData.imageRawData];
+        UIImage *image = self.modalDisplayMessage.imageData.image;
         
         CGFloat maxImageHeight = self.view.window.frame.size.height -
         TopBottomPaddingAroundContent * 2 - TopBottomPaddingAroundMsgCard * 2;
@@ -41,6 +41,8 @@
 
     self.webView.onNavigationSuccess = successBlock;
     self.webView.onNavigationError = errorBlock;
+    // Neither the page nor its images go through WPMediaCache: WebKit cannot hand http(s) loads to the app,
+    // and its own HTTP cache already follows the same Cache-Control, Expires and ETag headers.
     NSURLRequest *requestToLoad = [NSURLRequest requestWithURL: webViewURL];
     [self.webView loadRequest:requestToLoad];
 }
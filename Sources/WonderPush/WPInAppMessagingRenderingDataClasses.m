@@ -214,6 +214,29 @@
     return self;
 }
 
+- (UIImage *)image {
+    if (!_imageRawData) return nil;
+    if (!_imageURL) return [UIImage imageWithData:_imageRawData];
+    static NSCache<NSString *, NSArray *> *images;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        images = [NSCache new];
+    });
+    // Cached per URL along with its data, in case the image behind the URL changed.
+    // Copies share the same immutable data, so the bytes are only compared for data fetched again.
+    NSArray *cached = [images objectForKey:_imageURL];
+    NSData *cachedData = cached[0];
+    if (cached && (cachedData == _imageRawData
+                   || (cachedData.length == _imageRawData.length && [cachedData isEqualToData:_imageRawData]))) {
+        return cached[1];
+    }
+    UIImage *image = [UIImage imageWithData:_imageRawData];
+    if (image) {
+        [images setObject:@[_imageRawData, image] forKey:_imageURL];
+    }
+    return image;
+}
+
 - (id)copyWithZone:(NSZone *)zone {
     WPInAppMessagingImageData *imageData = [[[self class] allocWithZone:zone] init];
     imageData->_imageURL = [_imageURL copyWithZone:zone];
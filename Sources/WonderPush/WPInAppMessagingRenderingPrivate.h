@@ -50,6 +50,9 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (instancetype)initWithImageURL:(NSString *)imageURL imageData:(NSData *)imageData;
 
+/// The image, shared with other messages showing the same image data so that it is decoded only once.
+- (nullable UIImage *)image;
+
 @end
 
 @interface WPInAppMessagingDisplayMessage (Private)
@@ -0,0 +1,49 @@
+//
+//  WPJsonMap.h
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ An immutable JSON object backed by a hash array mapped trie.
+
+ Deriving a new map copies only the trie nodes on the path of the changed keys, and shares every other node,
+ as well as every untouched value, with the original map.
+ This makes `mapByMerging:nullFieldRemoves:` cost proportional to the size of the diff rather than to the size of the map,
+ and lets `diff:with:` skip every subtree two maps share.
+
+ Nested objects are stored as `WPJsonMap`s too, so that sharing also applies inside them.
+ Being an `NSDictionary`, a map can be read, enumerated and serialized like any other JSON object.
+ */
+@interface WPJsonMap : NSDictionary
+
+/// Returns the given dictionary if it is already a map, or a map with the same content, nested objects included.
++ (WPJsonMap *) mapWithDictionary:(NSDictionary *)dictionary;
+
+- (WPJsonMap *) mapBySettingObject:(id)object forKey:(id<NSCopying>)key;
+
+- (WPJsonMap *) mapByRemovingObjectForKey:(id)key;
+
+/// Same as `+[WPJsonUtil merge:with:nullFieldRemoves:]`.
+- (WPJsonMap *) mapByMerging:(nullable NSDictionary *)diff nullFieldRemoves:(BOOL)nullFieldRemoves;
+
+/// Same as `+[WPJsonUtil diff:with:]`, only walking the parts of two maps that are not shared.
++ (nullable NSDictionary *) diff:(nullable NSDictionary *)from with:(nullable NSDictionary *)to;
+
+/**
+ Same as `diff:with:`, only looking at the given paths.
+
+ Paths are given as nested dictionaries: a dictionary value restricts the diff to its keys inside the object at that key,
+ any other value covers the whole value at that key.
+ */
++ (nullable NSDictionary *) diff:(nullable NSDictionary *)from with:(nullable NSDictionary *)to paths:(NSDictionary *)paths;
+
+@end
+
+NS_ASSUME_NONNULL_END
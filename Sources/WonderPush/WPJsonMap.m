@@ -0,0 +1,477 @@
+//
+//  WPJsonMap.m
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import "WPJsonMap.h"
+
+// Each level of the trie consumes 5 bits of the hash, starting from the lowest ones
+#define WP_JSON_MAP_BITS 5
+#define WP_JSON_MAP_MASK 31
+#define WP_JSON_MAP_HASH_BITS 64
+
+@interface WPJsonMapEntry : NSObject {
+@public
+    id _key;
+    id _value;
+    uint64_t _hash;
+}
+@end
+
+@implementation WPJsonMapEntry
+@end
+
+/// An inner node of the trie. Its slots hold entries or child nodes, in the order of the bits set in the bitmap.
+@interface WPJsonMapNode : NSObject {
+@public
+    uint32_t _bitmap;
+    NSArray *_slots;
+}
+@end
+
+@implementation WPJsonMapNode
+@end
+
+/// A node holding the entries whose keys have the very same hash, found once all the bits of the hash are consumed.
+@interface WPJsonMapCollisionNode : NSObject {
+@public
+    NSArray<WPJsonMapEntry *> *_entries;
+}
+@end
+
+@implementation WPJsonMapCollisionNode
+@end
+
+#pragma mark - Trie
+
+static uint64_t WPJsonMapHash(id key)
+{
+    // Mix the bits, as NSString hashes of similar keys mostly differ in their highest bits
+    uint64_t hash = (uint64_t)[key hash];
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static inline uint32_t WPJsonMapBit(uint64_t hash, unsigned shift)
+{
+    return 1u << ((hash >> shift) & WP_JSON_MAP_MASK);
+}
+
+static inline NSUInteger WPJsonMapIndex(uint32_t bitmap, uint32_t bit)
+{
+    return __builtin_popcount(bitmap & (bit - 1));
+}
+
+static inline BOOL WPJsonMapIsEntry(id slot)
+{
+    return [slot class] == [WPJsonMapEntry class];
+}
+
+static inline BOOL WPJsonMapIsNode(id slot)
+{
+    return [slot class] == [WPJsonMapNode class];
+}
+
+static id WPJsonMapValue(id value)
+{
+    return [value isKindOfClass:[NSDictionary class]] ? [WPJsonMap mapWithDictionary:value] : value;
+}
+
+static WPJsonMapEntry *WPJsonMapEntryMake(id key, id value)
+{
+    WPJsonMapEntry *entry = [WPJsonMapEntry new];
+    entry->_key = [key copyWithZone:nil];
+    entry->_value = WPJsonMapValue(value);
+    entry->_hash = WPJsonMapHash(entry->_key);
+    return entry;
+}
+
+static WPJsonMapNode *WPJsonMapNodeMake(uint32_t bitmap, NSArray *slots)
+{
+    WPJsonMapNode *node = [WPJsonMapNode new];
+    node->_bitmap = bitmap;
+    node->_slots = slots;
+    return node;
+}
+
+static WPJsonMapCollisionNode *WPJsonMapCollisionNodeMake(NSArray<WPJsonMapEntry *> *entries)
+{
+    WPJsonMapCollisionNode *node = [WPJsonMapCollisionNode new];
+    node->_entries = entries;
+    return node;
+}
+
+static NSArray *WPJsonMapArrayByReplacing(NSArray *array, NSUInteger index, id object)
+{
+    NSMutableArray *rtn = [array mutableCopy];
+    rtn[index] = object;
+    return rtn;
+}
+
+/// Looks a key up in the subtree found at the given depth.
+static id WPJsonMapFind(id slot, id key, uint64_t hash, unsigned shift)
+{
+    while (slot != nil) {
+        if (WPJsonMapIsEntry(slot)) {
+            WPJsonMapEntry *entry = slot;
+            return entry->_hash == hash && [entry->_key isEqual:key] ? entry->_value : nil;
+        }
+        if (!WPJsonMapIsNode(slot)) {
+            for (WPJsonMapEntry *entry in ((WPJsonMapCollisionNode *)slot)->_entries) {
+                if ([entry->_key isEqual:key]) return entry->_value;
+            }
+            return nil;
+        }
+        WPJsonMapNode *node = slot;
+        uint32_t bit = WPJsonMapBit(hash, shift);
+        if (!(node->_bitmap & bit)) return nil;
+        slot = node->_slots[WPJsonMapIndex(node->_bitmap, bit)];
+        shift += WP_JSON_MAP_BITS;
+    }
+    return nil;
+}
+
+/// Builds the subtree holding two entries of different keys, at the given depth.
+static id WPJsonMapPair(WPJsonMapEntry *a, WPJsonMapEntry *b, unsigned shift)
+{
+    if (shift >= WP_JSON_MAP_HASH_BITS) {
+        return WPJsonMapCollisionNodeMake(@[a, b]);
+    }
+    uint32_t bitA = WPJsonMapBit(a->_hash, shift);
+    uint32_t bitB = WPJsonMapBit(b->_hash, shift);
+    if (bitA == bitB) {
+        return WPJsonMapNodeMake(bitA, @[WPJsonMapPair(a, b, shift + WP_JSON_MAP_BITS)]);
+    }
+    return WPJsonMapNodeMake(bitA | bitB, bitA < bitB ? @[a, b] : @[b, a]);
+}
+
+/// Returns the subtree found at the given depth with the given entry set, copying only the nodes on its path.
+/// Returns the subtree itself if it already holds this very value.
+static id WPJsonMapSet(id slot, WPJsonMapEntry *entry, unsigned shift, BOOL *added)
+{
+    if (slot == nil) {
+        *added = YES;
+        return entry;
+    }
+    if (WPJsonMapIsEntry(slot)) {
+        WPJsonMapEntry *existing = slot;
+        if (existing->_hash == entry->_hash && [existing->_key isEqual:entry->_key]) {
+            return existing->_value == entry->_value ? existing : entry;
+        }
+        *added = YES;
+        return WPJsonMapPair(existing, entry, shift);
+    }
+    if (!WPJsonMapIsNode(slot)) {
+        NSArray<WPJsonMapEntry *> *entries = ((WPJsonMapCollisionNode *)slot)->_entries;
+        for (NSUInteger i = 0; i < entries.count; i++) {
+            if ([entries[i]->_key isEqual:entry->_key]) {
+                if (entries[i]->_value == entry->_value) return slot;
+                return WPJsonMapCollisionNodeMake(WPJsonMapArrayByReplacing(entries, i, entry));
+            }
+        }
+        *added = YES;
+        return WPJsonMapCollisionNodeMake([entries arrayByAddingObject:entry]);
+    }
+    WPJsonMapNode *node = slot;
+    uint32_t bit = WPJsonMapBit(entry->_hash, shift);
+    NSUInteger index = WPJsonMapIndex(node->_bitmap, bit);
+    if (!(node->_bitmap & bit)) {
+        *added = YES;
+        NSMutableArray *slots = [node->_slots mutableCopy];
+        [slots insertObject:entry atIndex:index];
+        return WPJsonMapNodeMake(node->_bitmap | bit, slots);
+    }
+    id child = node->_slots[index];
+    id newChild = WPJsonMapSet(child, entry, shift + WP_JSON_MAP_BITS, added);
+    if (newChild == child) return node;
+    return WPJsonMapNodeMake(node->_bitmap, WPJsonMapArrayByReplacing(node->_slots, index, newChild));
+}
+
+/// Returns the subtree found at the given depth without the given key, or nil if nothing is left.
+/// Returns the subtree itself if it does not hold the key.
+static id WPJsonMapRemove(id slot, id key, uint64_t hash, unsigned shift, BOOL *removed)
+{
+    if (slot == nil) return nil;
+    if (WPJsonMapIsEntry(slot)) {
+        WPJsonMapEntry *entry = slot;
+        if (entry->_hash != hash || ![entry->_key isEqual:key]) return slot;
+        *removed = YES;
+        return nil;
+    }
+    if (!WPJsonMapIsNode(slot)) {
+        NSArray<WPJsonMapEntry *> *entries = ((WPJsonMapCollisionNode *)slot)->_entries;
+        for (NSUInteger i = 0; i < entries.count; i++) {
+            if ([entries[i]->_key isEqual:key]) {
+                *removed = YES;
+                if (entries.count == 2) return entries[1 - i];
+                NSMutableArray *rest = [entries mutableCopy];
+                [rest removeObjectAtIndex:i];
+                return WPJsonMapCollisionNodeMake(rest);
+            }
+        }
+        return slot;
+    }
+    WPJsonMapNode *node = slot;
+    uint32_t bit = WPJsonMapBit(hash, shift);
+    if (!(node->_bitmap & bit)) return node;
+    NSUInteger index = WPJsonMapIndex(node->_bitmap, bit);
+    id child = node->_slots[index];
+    id newChild = WPJsonMapRemove(child, key, hash, shift + WP_JSON_MAP_BITS, removed);
+    if (newChild == child) return node;
+    if (newChild == nil) {
+        if (node->_slots.count == 1) return nil;
+        NSMutableArray *slots = [node->_slots mutableCopy];
+        [slots removeObjectAtIndex:index];
+        // Entries hold their whole hash, so a lone one can take the place of its node
+        if (slots.count == 1 && WPJsonMapIsEntry(slots[0])) return slots[0];
+        return WPJsonMapNodeMake(node->_bitmap & ~bit, slots);
+    }
+    if (node->_slots.count == 1 && WPJsonMapIsEntry(newChild)) return newChild;
+    return WPJsonMapNodeMake(node->_bitmap, WPJsonMapArrayByReplacing(node->_slots, index, newChild));
+}
+
+static void WPJsonMapEnumerate(id slot, void (NS_NOESCAPE ^block)(WPJsonMapEntry *entry, BOOL *stop), BOOL *stop)
+{
+    if (slot == nil || *stop) return;
+    if (WPJsonMapIsEntry(slot)) {
+        block(slot, stop);
+        return;
+    }
+    NSArray *children = WPJsonMapIsNode(slot) ? ((WPJsonMapNode *)slot)->_slots : ((WPJsonMapCollisionNode *)slot)->_entries;
+    for (id child in children) {
+        WPJsonMapEnumerate(child, block, stop);
+        if (*stop) return;
+    }
+}
+
+#pragma mark - Diff
+
+static void WPJsonMapDiffValue(id key, id vFrom, id vTo, NSMutableDictionary *rtn)
+{
+    if (vTo == nil) {
+        rtn[key] = [NSNull null];
+    } else if (vFrom == vTo) {
+        // Shared value
+    } else if ([vFrom isKindOfClass:[NSDictionary class]] && [vTo isKindOfClass:[NSDictionary class]]) {
+        NSDictionary *diff = [WPJsonMap diff:vFrom with:vTo];
+        if (diff.count > 0) rtn[key] = diff;
+    } else if (![vTo isEqual:vFrom]) {
+        rtn[key] = vTo;
+    }
+}
+
+/// Diffs the subtrees found at the same place in two tries, at the given depth.
+static void WPJsonMapDiffSlots(id from, id to, unsigned shift, NSMutableDictionary *rtn)
+{
+    if (from == to) return;
+    if (WPJsonMapIsNode(from) && WPJsonMapIsNode(to)) {
+        WPJsonMapNode *a = from;
+        WPJsonMapNode *b = to;
+        uint32_t bitmap = a->_bitmap | b->_bitmap;
+        while (bitmap) {
+            uint32_t bit = bitmap & (~bitmap + 1);
+            bitmap &= ~bit;
+            id childA = a->_bitmap & bit ? a->_slots[WPJsonMapIndex(a->_bitmap, bit)] : nil;
+            id childB = b->_bitmap & bit ? b->_slots[WPJsonMapIndex(b->_bitmap, bit)] : nil;
+            WPJsonMapDiffSlots(childA, childB, shift + WP_JSON_MAP_BITS, rtn);
+        }
+        return;
+    }
+    BOOL done = NO;
+    WPJsonMapEnumerate(from, ^(WPJsonMapEntry *entry, BOOL *stop) {
+        WPJsonMapDiffValue(entry->_key, entry->_value, WPJsonMapFind(to, entry->_key, entry->_hash, shift), rtn);
+    }, &done);
+    WPJsonMapEnumerate(to, ^(WPJsonMapEntry *entry, BOOL *stop) {
+        if (WPJsonMapFind(from, entry->_key, entry->_hash, shift) == nil) {
+            rtn[entry->_key] = entry->_value;
+        }
+    }, &done);
+}
+
+static void WPJsonMapDiffPaths(NSDictionary *from, NSDictionary *to, NSDictionary *paths, NSMutableDictionary *rtn)
+{
+    for (id key in paths) {
+        id vFrom = from[key];
+        id vTo = to[key];
+        if (vFrom == nil) {
+            if (vTo != nil) rtn[key] = vTo;
+            continue;
+        }
+        id subpaths = paths[key];
+        if ([subpaths isKindOfClass:[NSDictionary class]] && [vFrom isKindOfClass:[NSDictionary class]] && [vTo isKindOfClass:[NSDictionary class]]) {
+            NSMutableDictionary *diff = [NSMutableDictionary new];
+            WPJsonMapDiffPaths(vFrom, vTo, subpaths, diff);
+            if (diff.count > 0) rtn[key] = [NSDictionary dictionaryWithDictionary:diff];
+        } else {
+            WPJsonMapDiffValue(key, vFrom, vTo, rtn);
+        }
+    }
+}
+
+#pragma mark - WPJsonMap
+
+@implementation WPJsonMap {
+    id _root;
+    NSUInteger _count;
+}
+
+- (instancetype) initWithRoot:(id)root count:(NSUInteger)count
+{
+    if (self = [super init]) {
+        _root = root;
+        _count = count;
+    }
+    return self;
+}
+
+- (instancetype) init
+{
+    return [self initWithRoot:nil count:0];
+}
+
+- (instancetype) initWithObjects:(const id _Nonnull [_Nullable])objects forKeys:(const id<NSCopying> _Nonnull [_Nullable])keys count:(NSUInteger)count
+{
+    id root = nil;
+    NSUInteger size = 0;
+    for (NSUInteger i = 0; i < count; i++) {
+        BOOL added = NO;
+        root = WPJsonMapSet(root, WPJsonMapEntryMake(keys[i], objects[i]), 0, &added);
+        if (added) size++;
+    }
+    return [self initWithRoot:root count:size];
+}
+
++ (WPJsonMap *) mapWithDictionary:(NSDictionary *)dictionary
+{
+    if ([dictionary isKindOfClass:[WPJsonMap class]]) return (WPJsonMap *)dictionary;
+    __block id root = nil;
+    __block NSUInteger count = 0;
+    [dictionary enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+        BOOL added = NO;
+        root = WPJsonMapSet(root, WPJsonMapEntryMake(key, obj), 0, &added);
+        if (added) count++;
+    }];
+    return [[WPJsonMap alloc] initWithRoot:root count:count];
+}
+
+- (NSUInteger) count
+{
+    return _count;
+}
+
+- (id) objectForKey:(id)key
+{
+    if (key == nil) return nil;
+    return WPJsonMapFind(_root, key, WPJsonMapHash(key), 0);
+}
+
+- (NSEnumerator *) keyEnumerator
+{
+    NSMutableArray *keys = [NSMutableArray arrayWithCapacity:_count];
+    BOOL done = NO;
+    WPJsonMapEnumerate(_root, ^(WPJsonMapEntry *entry, BOOL *stop) {
+        [keys addObject:entry->_key];
+    }, &done);
+    return [keys objectEnumerator];
+}
+
+- (void) enumerateKeysAndObjectsUsingBlock:(void (NS_NOESCAPE ^)(id key, id obj, BOOL *stop))block
+{
+    BOOL done = NO;
+    WPJsonMapEnumerate(_root, ^(WPJsonMapEntry *entry, BOOL *stop) {
+        block(entry->_key, entry->_value, stop);
+    }, &done);
+}
+
+- (void) enumerateKeysAndObjectsWithOptions:(NSEnumerationOptions)opts usingBlock:(void (NS_NOESCAPE ^)(id key, id obj, BOOL *stop))block
+{
+    [self enumerateKeysAndObjectsUsingBlock:block];
+}
+
+- (id) copyWithZone:(NSZone *)zone
+{
+    return self;
+}
+
+- (Class) classForCoder
+{
+    return [NSDictionary class];
+}
+
+- (WPJsonMap *) mapBySettingObject:(id)object forKey:(id<NSCopying>)key
+{
+    BOOL added = NO;
+    id root = WPJsonMapSet(_root, WPJsonMapEntryMake(key, object), 0, &added);
+    if (root == _root) return self;
+    return [[WPJsonMap alloc] initWithRoot:root count:_count + (added ? 1 : 0)];
+}
+
+- (WPJsonMap *) mapByRemovingObjectForKey:(id)key
+{
+    BOOL removed = NO;
+    id root = WPJsonMapRemove(_root, key, WPJsonMapHash(key), 0, &removed);
+    if (!removed) return self;
+    return [[WPJsonMap alloc] initWithRoot:root count:_count - 1];
+}
+
+- (WPJsonMap *) mapByMerging:(NSDictionary *)diff nullFieldRemoves:(BOOL)nullFieldRemoves
+{
+    WPJsonMap *rtn = self;
+    for (id key in diff) {
+        id vDiff = diff[key];
+        id vBase = rtn[key];
+        if (vDiff == [NSNull null] && nullFieldRemoves) {
+            rtn = [rtn mapByRemovingObjectForKey:key];
+        } else if ([vBase isKindOfClass:[NSDictionary class]] && [vDiff isKindOfClass:[NSDictionary class]]) {
+            // Like WPJsonUtil, nested nulls always remove fields
+            rtn = [rtn mapBySettingObject:[[WPJsonMap mapWithDictionary:vBase] mapByMerging:vDiff nullFieldRemoves:YES] forKey:key];
+        } else {
+            rtn = [rtn mapBySettingObject:vDiff forKey:key];
+        }
+    }
+    return rtn;
+}
+
++ (NSDictionary *) diff:(NSDictionary *)from with:(NSDictionary *)to
+{
+    if (from == nil) {
+        return [to copy];
+    } else if (to == nil) {
+        return nil;
+    }
+
+    NSMutableDictionary *rtn = [NSMutableDictionary new];
+    if ([from isKindOfClass:[WPJsonMap class]] && [to isKindOfClass:[WPJsonMap class]]) {
+        WPJsonMapDiffSlots(((WPJsonMap *)from)->_root, ((WPJsonMap *)to)->_root, 0, rtn);
+    } else {
+        for (id key in from) {
+            WPJsonMapDiffValue(key, from[key], to[key], rtn);
+        }
+        for (id key in to) {
+            if (from[key] == nil) rtn[key] = to[key];
+        }
+    }
+    return [NSDictionary dictionaryWithDictionary:rtn];
+}
+
++ (NSDictionary *) diff:(NSDictionary *)from with:(NSDictionary *)to paths:(NSDictionary *)paths
+{
+    if (from == nil) {
+        return [to copy];
+    } else if (to == nil) {
+        return nil;
+    }
+
+    NSMutableDictionary *rtn = [NSMutableDictionary new];
+    WPJsonMapDiffPaths(from, to, paths, rtn);
+    return [NSDictionary dictionaryWithDictionary:rtn];
+}
+
+@end
@@ -1,5 +1,6 @@
 #import "WPJsonSync.h"
 
+#import "WPJsonMap.h"
 #import <WonderPushCommon/WPJsonUtil.h>
 #import <WonderPushCommon/WPLog.h>
 #import <WonderPushCommon/WPNSUtil.h>
@@ -17,6 +18,43 @@
 #define SAVED_STATE_FIELD_SCHEDULED_PATCH_CALL @"scheduledPatchCall"
 #define SAVED_STATE_FIELD_INFLIGHT_PATCH_CALL @"inflightPatchCall"
 
+#define DIRTY_PATH_LEAF @YES
+
+
+/// The paths of the state that merging the given diff into the given base changes, see `+[WPJsonMap diff:with:paths:]`.
+static NSDictionary *WPJsonSyncPathsOfDiff(NSDictionary *diff, NSDictionary *base)
+{
+    NSMutableDictionary *rtn = [NSMutableDictionary new];
+    for (id key in diff) {
+        id vDiff = diff[key];
+        id vBase = base[key];
+        if ([vDiff isKindOfClass:[NSDictionary class]] && [vBase isKindOfClass:[NSDictionary class]]) {
+            rtn[key] = WPJsonSyncPathsOfDiff(vDiff, vBase);
+        } else {
+            rtn[key] = DIRTY_PATH_LEAF;
+        }
+    }
+    return [NSDictionary dictionaryWithDictionary:rtn];
+}
+
+/// The union of two sets of paths, nil standing for every path.
+static NSDictionary *WPJsonSyncUnionOfPaths(NSDictionary *a, NSDictionary *b)
+{
+    if (a == nil || b == nil) return nil;
+    if (a.count == 0) return b;
+    NSMutableDictionary *rtn = [a mutableCopy];
+    for (id key in b) {
+        id vA = a[key];
+        id vB = b[key];
+        if ([vA isKindOfClass:[NSDictionary class]] && [vB isKindOfClass:[NSDictionary class]]) {
+            rtn[key] = WPJsonSyncUnionOfPaths(vA, vB);
+        } else if (vA == nil || [vA isKindOfClass:[NSDictionary class]]) {
+            rtn[key] = vB;
+        }
+    }
+    return [NSDictionary dictionaryWithDictionary:rtn];
+}
+
 
 
 @interface WPJsonSync ()
@@ -26,16 +64,21 @@
 @property WPJsonSyncSaveCallback saveCallback;
 @property WPJsonSyncCallback schedulePatchCallCallback;
 
-@property (atomic, strong) NSDictionary *sdkState;
-@property (atomic, strong) NSDictionary *serverState;
+// States are persistent maps, so that writes and diffs only walk the paths that changed
+@property (atomic, strong) WPJsonMap *sdkState;
+@property (atomic, strong) WPJsonMap *serverState;
 @property (copy) NSDictionary *upgradeMeta;
-@property (copy) NSDictionary *putAccumulator;
+@property (copy) WPJsonMap *putAccumulator;
 @property (copy) NSDictionary *inflightDiff;
 @property (copy) NSDictionary *inflightPutAccumulator;
+// The paths where sdkState may differ from serverState, nil when unknown, see `+[WPJsonMap diff:with:paths:]`
+@property (copy) NSDictionary *dirtyPaths;
+@property (copy) NSDictionary *inflightDirtyPaths;
 
 - (void) schedulePatchCallAndSave;
 - (void) save;
 - (void) callPatch;
+- (NSDictionary *) diffDirtyPaths;
 
 - (void) onSuccess;
 - (void) onFailure;
@@ -59,13 +102,16 @@
         NSNumber *syncStateVersion;
         syncStateVersion        = [WPNSUtil numberForKey:SAVED_STATE_FIELD__SYNC_STATE_VERSION inDictionary:savedState] ?: @0;
         _upgradeMeta            = [WPNSUtil dictionaryForKey:SAVED_STATE_FIELD_UPGRADE_META inDictionary:savedState] ?: @{};
-        self.sdkState           = [WPNSUtil dictionaryForKey:SAVED_STATE_FIELD_SDK_STATE inDictionary:savedState] ?: @{};
-        self.serverState        = [WPNSUtil dictionaryForKey:SAVED_STATE_FIELD_SERVER_STATE inDictionary:savedState] ?: @{};
-        _putAccumulator         = [WPNSUtil dictionaryForKey:SAVED_STATE_FIELD_PUT_ACCUMULATOR inDictionary:savedState] ?: @{};
+        self.sdkState           = [WPJsonMap mapWithDictionary:[WPNSUtil dictionaryForKey:SAVED_STATE_FIELD_SDK_STATE inDictionary:savedState] ?: @{}];
+        self.serverState        = [WPJsonMap mapWithDictionary:[WPNSUtil dictionaryForKey:SAVED_STATE_FIELD_SERVER_STATE inDictionary:savedState] ?: @{}];
+        _putAccumulator         = [WPJsonMap mapWithDictionary:[WPNSUtil dictionaryForKey:SAVED_STATE_FIELD_PUT_ACCUMULATOR inDictionary:savedState] ?: @{}];
         _inflightDiff           = [WPNSUtil dictionaryForKey:SAVED_STATE_FIELD_INFLIGHT_DIFF inDictionary:savedState] ?: @{};
         _inflightPutAccumulator = [WPNSUtil dictionaryForKey:SAVED_STATE_FIELD_INFLIGHT_PUT_ACCUMULATOR inDictionary:savedState] ?: @{};
         _scheduledPatchCall     = [([WPNSUtil numberForKey:SAVED_STATE_FIELD_SCHEDULED_PATCH_CALL inDictionary:savedState] ?: @NO) boolValue];
         _inflightPatchCall      = [([WPNSUtil numberForKey:SAVED_STATE_FIELD_INFLIGHT_PATCH_CALL inDictionary:savedState] ?: @NO) boolValue];
+        // Dirty paths are not saved, the first diff covers the whole state
+        _dirtyPaths             = nil;
+        _inflightDirtyPaths     = nil;
 
         // Handle state version upgrades (syncStateVersion)
         // - 0 -> 1: No-op. 0 means no previous state.
@@ -92,13 +138,15 @@
         _schedulePatchCallCallback = schedulePatchCallCallback;
 
         _upgradeMeta = @{};
-        self.sdkState = [WPJsonUtil stripNulls:sdkState ?: @{}];
-        self.serverState = [WPJsonUtil stripNulls:serverState ?: @{}];
-        _putAccumulator = [WPJsonUtil diff:self.serverState with:self.sdkState];
+        self.sdkState = [WPJsonMap mapWithDictionary:[WPJsonUtil stripNulls:sdkState ?: @{}]];
+        self.serverState = [WPJsonMap mapWithDictionary:[WPJsonUtil stripNulls:serverState ?: @{}]];
+        _putAccumulator = [WPJsonMap mapWithDictionary:[WPJsonMap diff:self.serverState with:self.sdkState]];
         _inflightDiff = @{};
         _inflightPutAccumulator = @{};
         _scheduledPatchCall = true;
         _inflightPatchCall = false;
+        _dirtyPaths = nil;
+        _inflightDirtyPaths = nil;
 
         [self applyUpgradeCallback:upgradeCallback];
     }
@@ -115,9 +163,9 @@
         NSMutableDictionary *inflightPutAccumulator = [NSMutableDictionary dictionaryWithDictionary:_inflightPutAccumulator];
         upgradeCallback(upgradeMeta, sdkState, serverState, putAccumulator, inflightDiff, inflightPutAccumulator);
         _upgradeMeta            = [NSDictionary dictionaryWithDictionary:upgradeMeta];
-        self.sdkState           = [NSDictionary dictionaryWithDictionary:sdkState];
-        self.serverState        = [NSDictionary dictionaryWithDictionary:serverState];
-        _putAccumulator         = [NSDictionary dictionaryWithDictionary:putAccumulator];
+        self.sdkState           = [WPJsonMap mapWithDictionary:sdkState];
+        self.serverState        = [WPJsonMap mapWithDictionary:serverState];
+        _putAccumulator         = [WPJsonMap mapWithDictionary:putAccumulator];
         _inflightDiff           = [NSDictionary dictionaryWithDictionary:inflightDiff];
         _inflightPutAccumulator = [NSDictionary dictionaryWithDictionary:inflightPutAccumulator];
     }
@@ -142,8 +190,9 @@
 - (void) put:(NSDictionary *)diff {
     @synchronized (self) {
         diff = diff ?: @{};
-        self.sdkState = [WPJsonUtil merge:self.sdkState with:diff];
-        _putAccumulator = [WPJsonUtil merge:_putAccumulator with:diff nullFieldRemoves:NO];
+        _dirtyPaths = WPJsonSyncUnionOfPaths(_dirtyPaths, WPJsonSyncPathsOfDiff(diff, self.sdkState));
+        self.sdkState = [self.sdkState mapByMerging:diff nullFieldRemoves:YES];
+        _putAccumulator = [_putAccumulator mapByMerging:diff nullFieldRemoves:NO];
         dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
             [self schedulePatchCallAndSave];
         });
@@ -153,13 +202,14 @@
 - (void) receiveState:(NSDictionary *)state resetSdkState:(bool)reset {
     @synchronized (self) {
         state = state ?: @{};
-        self.serverState = [WPJsonUtil stripNulls:[state copy]];
-        self.sdkState = [self.serverState copy];
+        self.serverState = [WPJsonMap mapWithDictionary:[WPJsonUtil stripNulls:state]];
+        self.sdkState = self.serverState;
         if (reset) {
-            _putAccumulator = @{};
+            _putAccumulator = [WPJsonMap new];
         } else {
-            self.sdkState = [WPJsonUtil merge:[WPJsonUtil merge:self.sdkState with:_inflightDiff] with:_putAccumulator];
+            self.sdkState = [[self.sdkState mapByMerging:_inflightDiff nullFieldRemoves:YES] mapByMerging:_putAccumulator nullFieldRemoves:YES];
         }
+        _dirtyPaths = nil;
         [self schedulePatchCallAndSave];
     }
 }
@@ -167,7 +217,8 @@
 - (void) receiveServerState:(NSDictionary *)state {
     @synchronized (self) {
         state = state ?: @{};
-        self.serverState = [WPJsonUtil stripNulls:[state copy]];
+        self.serverState = [WPJsonMap mapWithDictionary:[WPJsonUtil stripNulls:state]];
+        _dirtyPaths = nil;
         [self schedulePatchCallAndSave];
     }
 }
@@ -176,7 +227,7 @@
     @synchronized (self) {
         diff = diff ?: @{};
         // The diff is already server-side, by contract
-        self.serverState = [WPJsonUtil merge:self.serverState with:diff];
+        self.serverState = [self.serverState mapByMerging:diff nullFieldRemoves:YES];
         [self put:diff];
     }
 }
@@ -213,27 +264,47 @@
         }
         _scheduledPatchCall = false;
 
-        _inflightDiff = [WPJsonUtil diff:self.serverState with:self.sdkState];
+        _inflightDiff = [self diffDirtyPaths];
         if (_inflightDiff.count == 0) {
             WPLogDebug(@"[%@] No diff to send to server", _logIdentifier);
+            _dirtyPaths = @{};
             [self save];
             return;
         }
         _inflightPatchCall = true;
+        _inflightDirtyPaths = _dirtyPaths;
+        _dirtyPaths = @{};
 
-        _inflightPutAccumulator = [_putAccumulator copy];
-        _putAccumulator = @{};
+        _inflightPutAccumulator = _putAccumulator;
+        _putAccumulator = [WPJsonMap new];
 
         [self save];
         _serverPatchCallback(_inflightDiff, ^(){[self onSuccess];}, ^(){[self onFailure];});
     }
 }
 
+/// Diffs the states on the paths written since the last successful PATCH call only.
+- (NSDictionary *) diffDirtyPaths {
+    if (_dirtyPaths == nil) {
+        return [WPJsonMap diff:self.serverState with:self.sdkState];
+    }
+    NSDictionary *diff = [WPJsonMap diff:self.serverState with:self.sdkState paths:_dirtyPaths];
+#if DEBUG
+    NSDictionary *fullDiff = [WPJsonMap diff:self.serverState with:self.sdkState];
+    if (![diff isEqualToDictionary:fullDiff]) {
+        WPLog(@"[%@] Diff of dirty paths %@ does not match full diff %@", _logIdentifier, diff, fullDiff);
+        return fullDiff;
+    }
+#endif
+    return diff;
+}
+
 - (void) onSuccess {
     @synchronized (self) {
         _inflightPatchCall = false;
         _inflightPutAccumulator = @{};
-        self.serverState = [WPJsonUtil merge:self.serverState with:_inflightDiff];
+        _inflightDirtyPaths = @{};
+        self.serverState = [self.serverState mapByMerging:_inflightDiff nullFieldRemoves:YES];
         _inflightDiff = @{};
         [self save];
     }
@@ -242,8 +313,10 @@
 - (void) onFailure {
     @synchronized (self) {
         _inflightPatchCall = false;
-        _putAccumulator = [WPJsonUtil merge:_inflightPutAccumulator with:_putAccumulator nullFieldRemoves:NO];
+        _putAccumulator = [[WPJsonMap mapWithDictionary:_inflightPutAccumulator] mapByMerging:_putAccumulator nullFieldRemoves:NO];
         _inflightPutAccumulator = @{};
+        _dirtyPaths = WPJsonSyncUnionOfPaths(_inflightDirtyPaths, _dirtyPaths);
+        _inflightDirtyPaths = @{};
         [self schedulePatchCallAndSave];
     }
 }
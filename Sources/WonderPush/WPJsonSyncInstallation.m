@@ -16,8 +16,6 @@ static NSMutableDictionary *instancePerUserId = nil;
 
 static BOOL patchCallDisabled = NO;
 
-static NSObject *saveLock = nil;
-
 @interface WPJsonSyncInstallation ()
 
 
@@ -42,7 +40,6 @@ static NSObject *saveLock = nil;
 
 + (void) initialize {
     instancePerUserId = [NSMutableDictionary new];
-    saveLock = [NSObject new];
     WPConfiguration *conf = [WPConfiguration sharedConfiguration];
     @synchronized (instancePerUserId) {
         // Populate entries
@@ -71,6 +68,12 @@ static NSObject *saveLock = nil;
                 [self flush];
             }
         }];
+        // Write the pending saved states before the app may be suspended or killed
+        for (NSNotificationName name in @[UIApplicationDidEnterBackgroundNotification, UIApplicationWillTerminateNotification]) {
+            [center addObserverForName:name object:nil queue:nil usingBlock:^(NSNotification *notification) {
+                [conf flushInstallationCustomSyncStates];
+            }];
+        }
     }
 }
 
@@ -107,6 +110,9 @@ static NSObject *saveLock = nil;
             [jsonSync flushSync:sync];
         }
     }
+    if (sync) {
+        [[WPConfiguration sharedConfiguration] flushInstallationCustomSyncStates];
+    }
 }
 
 + (void)setDisabled:(BOOL)disabled {
@@ -212,12 +218,8 @@ static NSObject *saveLock = nil;
 }
 
 - (void) save:(NSDictionary *)state {
-    @synchronized (saveLock) {
-        WPConfiguration *conf = [WPConfiguration sharedConfiguration];
-        NSMutableDictionary *installationCustomSyncStatePerUserId = [(conf.installationCustomSyncStatePerUserId ?: @{}) mutableCopy];
-        installationCustomSyncStatePerUserId[_userId ?: @""] = state ?: @{};
-        conf.installationCustomSyncStatePerUserId = [installationCustomSyncStatePerUserId copy];
-    }
+    // Written behind, see flushSync:
+    [[WPConfiguration sharedConfiguration] setInstallationCustomSyncState:state ?: @{} forUserId:_userId];
 }
 
 - (void) scheduleServerPatchCallCallback {
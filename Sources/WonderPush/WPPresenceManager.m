@@ -29,6 +29,9 @@
 @interface WPPresenceManager ()
 @property (nonatomic, strong, nullable) NSTimer *autoRenewTimer;
 @property (nonatomic, strong, nullable) WPPresencePayload *lastPresencePayload;
+@property (nonatomic, strong) NSDate * (^now)(void);
+/// The number of times the auto-renew timer fired
+@property (nonatomic, assign) NSUInteger wakeUpCount;
 - (void) extendPresence;
 - (BOOL) autoRenew;
 @end
@@ -45,41 +48,66 @@
         _autoRenewDelegate = autoRenewDelegate;
         _anticipatedTime = anticipatedTime;
         _safetyMarginTime = MAX(0.1, safetyMarginTime); // minimum 100ms
+        _now = ^{
+            return [NSDate date];
+        };
     }
     return self;
 }
 
 - (WPPresencePayload *)presenceDidStart {
-    [self.autoRenewTimer invalidate];
-    if (self.autoRenew) {
-        self.autoRenewTimer = [NSTimer
-                               scheduledTimerWithTimeInterval:self.safetyMarginTime / 10
-                               target:self
-                               selector:@selector(extendPresence)
-                               userInfo:nil
-                               repeats:YES];
-    }
-    NSDate *startDate = [NSDate date];
+    NSDate *startDate = self.now();
     NSDate *untilDate = [startDate dateByAddingTimeInterval:self.anticipatedTime];
     self.lastPresencePayload = [[WPPresencePayload alloc] initWithFromDate:startDate untilDate:untilDate];
+    [self scheduleAutoRenew];
     return self.lastPresencePayload;
 }
 
 - (WPPresencePayload *)presenceWillStop {
     [self.autoRenewTimer invalidate];
-    NSDate *now = [NSDate date];
+    self.autoRenewTimer = nil;
+    NSDate *now = self.now();
     NSDate *fromDate = self.lastPresencePayload ? self.lastPresencePayload.fromDate : now;
     WPPresencePayload *payload = [[WPPresencePayload alloc] initWithFromDate:fromDate untilDate:now];
     self.lastPresencePayload = nil;
     return payload;
 }
 
+/// The date when the last presence payload needs renewing
+- (nullable NSDate *)autoRenewDeadline {
+    return [self.lastPresencePayload.untilDate dateByAddingTimeInterval:-self.safetyMarginTime];
+}
+
+// Wakes up once, when the last payload needs renewing, rather than polling until then.
+// Never sooner than the former polling interval, as a deadline already passed when the anticipated time
+// does not exceed the safety margin would otherwise renew in a tight loop.
+- (void)scheduleAutoRenew {
+    [self.autoRenewTimer invalidate];
+    self.autoRenewTimer = nil;
+    NSDate *deadline = [self autoRenewDeadline];
+    if (!self.autoRenew || !deadline) return;
+    self.autoRenewTimer = [NSTimer
+                           scheduledTimerWithTimeInterval:MAX(self.safetyMarginTime / 10, [deadline timeIntervalSinceDate:self.now()])
+                           target:self
+                           selector:@selector(autoRenewTimerFired)
+                           userInfo:nil
+                           repeats:NO];
+}
+
+- (void)autoRenewTimerFired {
+    self.wakeUpCount++;
+    [self extendPresence];
+}
+
 - (void)extendPresence {
-    NSDate *now = [NSDate date];
+    NSDate *now = self.now();
     NSTimeInterval timeUntilPresenceEnds = self.lastPresencePayload ? [self.lastPresencePayload.untilDate timeIntervalSinceDate:now] : 0;
     
-    // Not time to update yet.
-    if (timeUntilPresenceEnds > self.safetyMarginTime) return;
+    // Not time to update yet, which happens if the clock was changed.
+    if (timeUntilPresenceEnds > self.safetyMarginTime) {
+        [self scheduleAutoRenew];
+        return;
+    }
     
     // Compute fromDate
     NSDate *fromDate;
@@ -96,6 +124,7 @@
 
     // Payload
     self.lastPresencePayload = [[WPPresencePayload alloc] initWithFromDate:fromDate untilDate:untilDate];
+    [self scheduleAutoRenew];
     
     // Tell the delegate
     [self.autoRenewDelegate presenceManager:self wantsToRenewPresence:self.lastPresencePayload];
@@ -104,7 +133,7 @@
 
 - (BOOL)isCurrentlyPresent {
     if (!self.lastPresencePayload) return NO;
-    return [self.lastPresencePayload.untilDate timeIntervalSinceNow] > 0;
+    return [self.lastPresencePayload.untilDate timeIntervalSinceDate:self.now()] > 0;
 }
 
 @end
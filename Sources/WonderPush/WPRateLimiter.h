@@ -17,7 +17,16 @@ NS_ASSUME_NONNULL_BEGIN
 - (instancetype) initWithKey:(NSString *)key timeToLive:(NSTimeInterval)timeToLive limit:(NSUInteger)limit;
 @end
 
+/**
+ Counts increments per key over a sliding window.
+
+ Each key keeps the times of its last `limit` increments in a ring buffer,
+ so that checking a rate limit only looks at the oldest of them and never writes anything.
+ Increments and clears are appended to a log file, which is rewritten once it holds mostly forgotten increments.
+ */
 @interface WPRateLimiter : NSObject
+/// A rate limiter persisted in the given log file. Instances sharing a file see each other's writes when created afterwards.
+- (instancetype) initWithPath:(NSString *)path;
 - (void) increment:(WPRateLimit *)rateLimit;
 - (BOOL) isRateLimited:(WPRateLimit *)rateLimit;
 - (void) clear:(WPRateLimit *)rateLimit;
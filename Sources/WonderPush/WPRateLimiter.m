@@ -9,21 +9,44 @@
 #import "WPRateLimiter.h"
 #import <WonderPushCommon/WPLog.h>
 
+#define WPRateLimiterUserDefaultsKey @"_WPRateLimiter"
+#define WPRateLimiterMicroseconds(timeInterval) ((int64_t)llround((timeInterval) * 1000000))
+// Never rewrite the log before it holds this many records, to keep frequent increments from rewriting it too often
+#define WP_RATE_LIMITER_COMPACTION_MIN_RECORDS 256
+
 @interface WPRateLimit ()
 @property (nonatomic, strong) NSString *key;
 @property (nonatomic, assign) NSTimeInterval timeToLive;
 @property (nonatomic, assign) NSUInteger limit;
 @end
 
+/// The format the increments were stored in NSUserDefaults, only read to migrate them.
 @interface WPRateLimiterData : NSObject<NSSecureCoding>
-- (instancetype) initWithKey:(NSString *)key;
 @property (readonly) NSString *key;
-@property (readonly) NSMutableArray<NSDate *> *incrementDates;
-- (void) removeIncrementsOlderThan:(NSTimeInterval)timeToLive;
+@property (readonly) NSArray<NSDate *> *incrementDates;
+@end
+
+/**
+ The times of the last increments of a key, in microseconds since the epoch, oldest first.
+ The buffer grows as needed up to the largest limit it was incremented with, then the newest times overwrite the oldest.
+ */
+@interface WPRateLimiterWindow : NSObject
+@property (readonly) NSUInteger count;
+/// The time to live of the last increment, in microseconds.
+@property (nonatomic, assign) int64_t timeToLive;
+- (void) addTime:(int64_t)time limit:(NSUInteger)limit;
+/// Whether the `limit`-th most recent increment happened at or after `start`.
+- (BOOL) hasReachedLimit:(NSUInteger)limit since:(int64_t)start;
+/// The time of the `index`-th oldest increment.
+- (int64_t) timeAtIndex:(NSUInteger)index;
 @end
 
 @interface WPRateLimiter ()
-@property (nonatomic, strong) NSMutableDictionary<NSString *, WPRateLimiterData *> *limiterData;
+@property (nonatomic, strong) NSString *path;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, WPRateLimiterWindow *> *windows;
+/// The number of records in the log file.
+@property (nonatomic, assign) NSUInteger recordCount;
+@property (nonatomic, strong) NSDate * (^now)(void);
 @end
 
 @implementation WPRateLimit
@@ -45,39 +68,68 @@
     return YES;
 }
 
-- (instancetype)initWithKey:(NSString *)key {
+- (instancetype)initWithCoder:(NSCoder *)coder {
     if (self = [super init]) {
-        _key = key;
-        _incrementDates = [NSMutableArray new];
+        _key = [coder decodeObjectOfClass:NSString.class forKey:@"key"];
+        _incrementDates = [coder decodeObjectOfClasses:[NSSet setWithObjects:NSArray.class, NSDate.class, nil] forKey:@"incrementDates"];
     }
     return self;
 }
 
-- (instancetype)initWithCoder:(NSCoder *)coder {
+- (void)encodeWithCoder:(NSCoder *)coder {
+    [coder encodeObject:self.key forKey:@"key"];
+    [coder encodeObject:self.incrementDates forKey:@"incrementDates"];
+}
+
+@end
+
+@implementation WPRateLimiterWindow {
+    NSMutableData *_times;
+    NSUInteger _capacity;
+    NSUInteger _next;
+}
+
+- (instancetype)init {
     if (self = [super init]) {
-        _key = [coder decodeObjectOfClass:NSString.class forKey:@"key"];
-        _incrementDates = [[coder decodeObjectOfClasses:[NSSet setWithObjects:NSArray.class, NSDate.class, nil] forKey:@"incrementDates"] mutableCopy];
+        _times = [NSMutableData new];
     }
     return self;
 }
 
-- (void)encodeWithCoder:(NSCoder *)coder {
-    [coder encodeObject:self.key forKey:@"key"];
-    [coder encodeObject:[NSArray arrayWithArray:self.incrementDates] forKey:@"incrementDates"];
+- (int64_t)timeAtIndex:(NSUInteger)index {
+    const int64_t *times = _times.bytes;
+    return times[(_next + _capacity - _count + index) % _capacity];
 }
 
-- (void)removeIncrementsOlderThan:(NSTimeInterval)timeToLive {
-    NSTimeInterval start = [NSDate date].timeIntervalSince1970 - timeToLive;
-    while(_incrementDates.count > 0
-          && _incrementDates[0].timeIntervalSince1970 < start) {
-        [_incrementDates removeObjectAtIndex:0];
+- (void)addTime:(int64_t)time limit:(NSUInteger)limit {
+    if (_count == _capacity && _capacity < limit) {
+        // Grow, unrolling the buffer so that the oldest time comes first
+        NSUInteger capacity = MIN(MAX(_capacity * 2, 4), limit);
+        NSMutableData *times = [NSMutableData dataWithLength:capacity * sizeof(int64_t)];
+        int64_t *bytes = times.mutableBytes;
+        for (NSUInteger i = 0; i < _count; i++) {
+            bytes[i] = [self timeAtIndex:i];
+        }
+        _times = times;
+        _capacity = capacity;
+        _next = _count;
     }
+    if (_capacity == 0) return;
+    int64_t *times = _times.mutableBytes;
+    times[_next] = time;
+    _next = (_next + 1) % _capacity;
+    if (_count < _capacity) _count++;
+}
+
+- (BOOL)hasReachedLimit:(NSUInteger)limit since:(int64_t)start {
+    if (limit == 0) return YES;
+    if (_count < limit) return NO;
+    return [self timeAtIndex:_count - limit] >= start;
 }
 
 @end
 
 static WPRateLimiter *rateLimiter = nil;
-#define WPRateLimiterUserDefaultsKey @"_WPRateLimiter"
 
 @implementation WPRateLimiter
 
@@ -90,94 +142,211 @@ static WPRateLimiter *rateLimiter = nil;
 }
 
 - (instancetype) init {
+    NSString *applicationSupport = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject] ?: NSTemporaryDirectory();
+    return [self initWithPath:[applicationSupport stringByAppendingPathComponent:@"WonderPush/RateLimiter.log"]];
+}
+
+- (instancetype) initWithPath:(NSString *)path {
     if (self = [super init]) {
-        _limiterData = [NSMutableDictionary new];
-        NSArray *storedLimiterData = [NSUserDefaults.standardUserDefaults objectForKey:WPRateLimiterUserDefaultsKey];
-        if (storedLimiterData) {
-            for (NSData *data in storedLimiterData) {
-                NSError *error = nil;
-                WPRateLimiterData *limiterData = nil;
-                if (@available(iOS 11.0, *)) {
-                    limiterData = [NSKeyedUnarchiver unarchivedObjectOfClass:WPRateLimiterData.class fromData:data error:&error];
-                } else {
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wdeprecated-declarations"
-                    limiterData = [NSKeyedUnarchiver unarchiveObjectWithData:data];
-#pragma clang diagnostic pop
-                }
-                if (error) {
-                    WPLog(@"Error unarchiving: %@", error);
-                    continue;
-                }
-                if (limiterData) {
-                    _limiterData[limiterData.key] = limiterData;
-                }
-            }
+        _path = path;
+        _windows = [NSMutableDictionary new];
+        if ([[NSFileManager defaultManager] fileExistsAtPath:path]) {
+            [self load];
+        } else {
+            [self migrateUserDefaults];
         }
     }
     return self;
 }
 
-- (void) save {
-    @synchronized (self) {
-        NSUserDefaults *defaults = NSUserDefaults.standardUserDefaults;
-        NSMutableArray *limiterDataArray = [NSMutableArray new];
-        for (WPRateLimiterData *limiterData in self.limiterData.allValues) {
-            NSError *error = nil;
-            NSData *archivedData = nil;
-            if (@available(iOS 11.0, *)) {
-                archivedData = [NSKeyedArchiver archivedDataWithRootObject:limiterData requiringSecureCoding:YES error:&error];
-            } else {
+- (int64_t) currentTime {
+    NSDate *date = self.now ? self.now() : [NSDate date];
+    return WPRateLimiterMicroseconds(date.timeIntervalSince1970);
+}
+
+#pragma mark - Log file
+
+- (void) load {
+    NSData *data = [NSData dataWithContentsOfFile:self.path];
+    const char *bytes = data.bytes;
+    NSUInteger length = data.length;
+    NSUInteger lineStart = 0;
+    BOOL corrupted = NO;
+    while (lineStart < length) {
+        const char *newline = memchr(bytes + lineStart, '\n', length - lineStart);
+        if (!newline) {
+            // A record is only valid once its trailing newline is written, this one was interrupted,
+            // drop it so that the next record starts on a line of its own
+            corrupted = YES;
+            NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:self.path];
+            [fileHandle truncateFileAtOffset:lineStart];
+            [fileHandle closeFile];
+            break;
+        }
+        NSUInteger lineEnd = newline - bytes;
+        NSData *line = [data subdataWithRange:NSMakeRange(lineStart, lineEnd - lineStart)];
+        lineStart = lineEnd + 1;
+        self.recordCount++;
+        id record = [NSJSONSerialization JSONObjectWithData:line options:kNilOptions error:nil];
+        if (![record isKindOfClass:[NSDictionary class]] || ![self applyRecord:record]) {
+            corrupted = YES;
+        }
+    }
+    if (corrupted) {
+        WPLog(@"WPRateLimiter: Ignoring unreadable records of %@", self.path);
+    }
+}
+
+- (BOOL) applyRecord:(NSDictionary *)record {
+    id key = record[@"k"];
+    if (![key isKindOfClass:[NSString class]]) return NO;
+    if ([record[@"c"] isEqual:@YES]) {
+        [self.windows removeObjectForKey:key];
+        return YES;
+    }
+    id time = record[@"t"];
+    id limit = record[@"n"];
+    id timeToLive = record[@"l"];
+    if (![time isKindOfClass:[NSNumber class]] || ![limit isKindOfClass:[NSNumber class]] || ![timeToLive isKindOfClass:[NSNumber class]]) return NO;
+    [self addTime:[time longLongValue] limit:[limit unsignedIntegerValue] timeToLive:[timeToLive longLongValue] forKey:key];
+    return YES;
+}
+
+- (void) addTime:(int64_t)time limit:(NSUInteger)limit timeToLive:(int64_t)timeToLive forKey:(NSString *)key {
+    WPRateLimiterWindow *window = self.windows[key];
+    if (!window) {
+        window = [WPRateLimiterWindow new];
+        self.windows[key] = window;
+    }
+    [window addTime:time limit:limit];
+    window.timeToLive = timeToLive;
+}
+
+- (NSData *) lineForRecord:(NSDictionary *)record {
+    NSMutableData *line = [[NSJSONSerialization dataWithJSONObject:record options:kNilOptions error:nil] mutableCopy];
+    [line appendBytes:"\n" length:1];
+    return line;
+}
+
+- (BOOL) ensureDirectory {
+    NSError *error = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:[self.path stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:&error]) {
+        WPLog(@"WPRateLimiter: Failed to create directory: %@", error);
+        return NO;
+    }
+    return YES;
+}
+
+- (void) appendRecord:(NSDictionary *)record {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    if (![fileManager fileExistsAtPath:self.path]) {
+        if (![self ensureDirectory]) return;
+        [fileManager createFileAtPath:self.path contents:nil attributes:nil];
+    }
+    // Other instances may append to or rewrite the same file, so it is opened for each record
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:self.path];
+    if (!fileHandle) {
+        WPLog(@"WPRateLimiter: Failed to open %@", self.path);
+        return;
+    }
+    @try {
+        [fileHandle seekToEndOfFile];
+        [fileHandle writeData:[self lineForRecord:record]];
+        self.recordCount++;
+    } @catch (NSException *exception) {
+        WPLog(@"WPRateLimiter: Failed to append to %@: %@", self.path, exception);
+    } @finally {
+        [fileHandle closeFile];
+    }
+}
+
+/// Rewrites the log with one record per remembered increment, leaving out the expired ones.
+- (void) compact {
+    int64_t now = [self currentTime];
+    NSMutableData *data = [NSMutableData new];
+    NSUInteger recordCount = 0;
+    for (NSString *key in self.windows) {
+        WPRateLimiterWindow *window = self.windows[key];
+        for (NSUInteger i = 0; i < window.count; i++) {
+            int64_t time = [window timeAtIndex:i];
+            if (time < now - window.timeToLive) continue;
+            [data appendData:[self lineForRecord:@{@"k": key, @"t": @(time), @"n": @(window.count), @"l": @(window.timeToLive)}]];
+            recordCount++;
+        }
+    }
+    if (![self ensureDirectory]) return;
+    NSError *error = nil;
+    if (![data writeToFile:self.path options:NSDataWritingAtomic error:&error]) {
+        WPLog(@"WPRateLimiter: Failed to write %@: %@", self.path, error);
+        return;
+    }
+    self.recordCount = recordCount;
+}
+
+- (void) compactIfNeeded {
+    if (self.recordCount < WP_RATE_LIMITER_COMPACTION_MIN_RECORDS) return;
+    NSUInteger liveCount = 0;
+    for (WPRateLimiterWindow *window in self.windows.allValues) {
+        liveCount += window.count;
+    }
+    if (self.recordCount > 2 * liveCount) {
+        [self compact];
+    }
+}
+
+- (void) migrateUserDefaults {
+    NSArray *storedLimiterData = [NSUserDefaults.standardUserDefaults objectForKey:WPRateLimiterUserDefaultsKey];
+    if (![storedLimiterData isKindOfClass:[NSArray class]]) return;
+    for (NSData *data in storedLimiterData) {
+        NSError *error = nil;
+        WPRateLimiterData *limiterData = nil;
+        if (@available(iOS 11.0, *)) {
+            limiterData = [NSKeyedUnarchiver unarchivedObjectOfClass:WPRateLimiterData.class fromData:data error:&error];
+        } else {
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
-                archivedData = [NSKeyedArchiver archivedDataWithRootObject:limiterData];
+            limiterData = [NSKeyedUnarchiver unarchiveObjectWithData:data];
 #pragma clang diagnostic pop
-            }
-            if (error) {
-                NSLog(@"Error unarchiving: %@", error);
-                continue;
-            }
-            if (archivedData) {
-                [limiterDataArray addObject:archivedData];
-            }
         }
-        [defaults setObject:[NSArray arrayWithArray:limiterDataArray] forKey:WPRateLimiterUserDefaultsKey];
-        [defaults synchronize];
+        if (error) {
+            WPLog(@"Error unarchiving: %@", error);
+            continue;
+        }
+        if (!limiterData.key) continue;
+        // The limits and time to live were not stored, keep every increment until the next one tells them
+        for (NSDate *date in limiterData.incrementDates) {
+            [self addTime:WPRateLimiterMicroseconds(date.timeIntervalSince1970) limit:limiterData.incrementDates.count timeToLive:INT64_MAX / 2 forKey:limiterData.key];
+        }
     }
+    [self compact];
+    [NSUserDefaults.standardUserDefaults removeObjectForKey:WPRateLimiterUserDefaultsKey];
 }
 
+#pragma mark - Rate limits
+
 - (void) increment:(WPRateLimit *)rateLimit {
     @synchronized (self) {
-        WPRateLimiterData *existingData = self.limiterData[rateLimit.key];
-        WPRateLimiterData *data = existingData ?: [[WPRateLimiterData alloc] initWithKey:rateLimit.key];
-
-        // Remove all dates prior to the rateLimit's timeToLive
-        [data removeIncrementsOlderThan:rateLimit.timeToLive];
-
-        // Increment
-        [data.incrementDates addObject:[NSDate date]];
-
-        // Store
-        self.limiterData[data.key] = data;
-        [self save];
+        int64_t time = [self currentTime];
+        int64_t timeToLive = WPRateLimiterMicroseconds(rateLimit.timeToLive);
+        [self addTime:time limit:rateLimit.limit timeToLive:timeToLive forKey:rateLimit.key];
+        [self appendRecord:@{@"k": rateLimit.key, @"t": @(time), @"n": @(rateLimit.limit), @"l": @(timeToLive)}];
+        [self compactIfNeeded];
     }
 }
 
 - (BOOL)isRateLimited:(WPRateLimit *)rateLimit {
     @synchronized (self) {
-        WPRateLimiterData *data = self.limiterData[rateLimit.key];
-        if (!data) return NO;
-        // Remove all dates prior to the rateLimit's timeToLive
-        [data removeIncrementsOlderThan:rateLimit.timeToLive];
-        [self save];
-        return data.incrementDates.count >= rateLimit.limit;
+        WPRateLimiterWindow *window = self.windows[rateLimit.key];
+        if (!window) return NO;
+        return [window hasReachedLimit:rateLimit.limit since:[self currentTime] - WPRateLimiterMicroseconds(rateLimit.timeToLive)];
     }
 }
 
 - (void)clear:(WPRateLimit *)rateLimit {
     @synchronized (self) {
-        [self.limiterData removeObjectForKey:rateLimit.key];
-        [self save];
+        [self.windows removeObjectForKey:rateLimit.key];
+        [self appendRecord:@{@"k": rateLimit.key, @"c": @YES}];
+        [self compactIfNeeded];
     }
 }
 @end
@@ -34,8 +34,51 @@ NS_ASSUME_NONNULL_BEGIN
 
 extern NSString * const WPRemoteConfigUpdatedNotification;
 
+@class WPBlackWhiteList;
+@class WPIAMMessageDefinition;
+
+/**
+ What the SDK derives from the data of a remote config, built once along with the config.
+
+ Snapshots are never mutated after being built, so that they can be read from any thread without locking
+ until a config of another version replaces them.
+ */
+@interface WPRemoteConfigSnapshot : NSObject
+- (instancetype) init NS_UNAVAILABLE;
+- (instancetype) initWithData:(NSDictionary *)data NS_DESIGNATED_INITIALIZER;
+
+/// The events black/white list, or nil if the config has none.
+@property (nonatomic, nullable, readonly) WPBlackWhiteList *eventsBlackWhiteList;
+
+/// The in-app messages, test ones included.
+@property (nonatomic, nonnull, readonly) NSArray<WPIAMMessageDefinition *> *inAppMessages;
+
+@property (nonatomic, readonly) BOOL disableApiClient;
+@property (nonatomic, readonly) BOOL disableAnonymousApiClient;
+@property (nonatomic, readonly) BOOL disableJsonSync;
+@property (nonatomic, readonly) BOOL disableMeasurementsApiClient;
+@property (nonatomic, readonly) BOOL trackEventsForNonSubscribers;
+@property (nonatomic, readonly) BOOL allowAccessTokenForNonSubscribers;
+@property (nonatomic, readonly) BOOL doNotSendPresenceOnApplicationWillResignActive;
+@property (nonatomic, nullable, readonly) NSNumber *anonymousApiClientRateLimitLimit;
+@property (nonatomic, nullable, readonly) NSNumber *anonymousApiClientRateLimitTimeToLiveMilliseconds;
+@property (nonatomic, readonly) NSInteger trackedEventsUncollapsedMaximumAgeMs;
+@property (nonatomic, readonly) NSInteger trackedEventsUncollapsedMaximumCount;
+@property (nonatomic, readonly) NSInteger trackedEventsCollapsedLastBuiltinMaximumCount;
+@property (nonatomic, readonly) NSInteger trackedEventsCollapsedLastCustomMaximumCount;
+@property (nonatomic, readonly) NSInteger trackedEventsCollapsedOtherMaximumCount;
+
+/// The compiled segment of the given in-app message, NSNull if it is invalid, or nil if the message has no segment or is not part of this snapshot.
+- (nullable id) compiledSegmentOfInAppMessage:(WPIAMMessageDefinition *)message;
+
+/// Parses and compiles the segment of the given in-app message, or returns NSNull if it is invalid.
++ (id) compileSegmentOfInAppMessage:(WPIAMMessageDefinition *)message;
+@end
+
 @interface WPRemoteConfig : NSObject<NSCoding, NSSecureCoding>
 @property (nonatomic, nonnull, readonly) NSDictionary *data;
+/// Built from `data` once, when the config is created.
+@property (nonatomic, nonnull, readonly) WPRemoteConfigSnapshot *snapshot;
 @property (nonatomic, nonnull, readonly) NSString *version;
 @property (nonatomic, nonnull, readonly) NSDate *fetchDate;
 /**
@@ -12,9 +12,80 @@
 #import "WonderPush_private.h"
 #import <WonderPushCommon/WPErrors.h>
 #import <WonderPushCommon/WPNSUtil.h>
+#import "WPBlackWhiteList.h"
+#import "WPConfiguration.h"
+#import "WPIAMFetchResponseParser.h"
+#import "WPSPSegmenter.h"
 
 NSString * const WPRemoteConfigUpdatedNotification = @"WPRemoteConfigUpdatedNotification";
 
+#pragma mark - Snapshot
+
+@interface WPRemoteConfigSnapshot ()
+// compiled segment of each regular in-app message having one, or NSNull if it's invalid
+@property (nonatomic, nonnull, strong) NSMapTable<WPIAMMessageDefinition *, id> *inAppSegments;
+@end
+
+@implementation WPRemoteConfigSnapshot
+
+- (instancetype) initWithData:(NSDictionary *)data {
+    if (self = [super init]) {
+        NSArray<NSString *> *rules = [WPNSUtil arrayForKey:WP_REMOTE_CONFIG_EVENTS_BLACK_WHITE_LIST_KEY inDictionary:data];
+        if (rules) {
+            _eventsBlackWhiteList = [[WPBlackWhiteList alloc] initWithRules:rules];
+        }
+
+        NSDictionary *inAppConfig = [WPNSUtil dictionaryForKey:@"inAppConfig" inDictionary:data] ?: @{};
+        NSInteger discardCount;
+        _inAppMessages = [WPIAMFetchResponseParser parseAPIResponseDictionary:inAppConfig discardedMsgCount:&discardCount] ?: @[];
+        _inAppSegments = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+        for (WPIAMMessageDefinition *message in _inAppMessages) {
+            if (message.isTestMessage || !message.segmentDefinition) continue;
+            [_inAppSegments setObject:[[self class] compileSegmentOfInAppMessage:message] forKey:message];
+        }
+
+        _disableApiClient = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_DISABLE_API_CLIENT_KEY inDictionary:data] boolValue];
+        _disableAnonymousApiClient = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_DISABLE_ANONYMOUS_API_CLIENT_KEY inDictionary:data] boolValue];
+        _disableJsonSync = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_DISABLE_JSON_SYNC_KEY inDictionary:data] boolValue];
+        _disableMeasurementsApiClient = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_DISABLE_MEASUREMENTS_API_CLIENT_KEY inDictionary:data] boolValue];
+        _trackEventsForNonSubscribers = [self boolForKey:WP_REMOTE_CONFIG_TRACK_EVENTS_FOR_NON_SUBSCRIBERS inDictionary:data];
+        _allowAccessTokenForNonSubscribers = [self boolForKey:WP_REMOTE_CONFIG_ALLOW_ACCESS_TOKEN_FOR_NON_SUBSCRIBERS inDictionary:data];
+        _doNotSendPresenceOnApplicationWillResignActive = [self boolForKey:WP_REMOTE_CONFIG_DO_NOT_SEND_PRESENCE_ON_APPLICATION_WILL_RESIGN_ACTIVE inDictionary:data];
+        _anonymousApiClientRateLimitLimit = [WPNSUtil numberForKey:WP_REMOTE_CONFIG_ANONYMOUS_API_CLIENT_RATE_LIMIT_LIMIT inDictionary:data];
+        _anonymousApiClientRateLimitTimeToLiveMilliseconds = [WPNSUtil numberForKey:WP_REMOTE_CONFIG_ANONYMOUS_API_CLIENT_RATE_LIMIT_TIME_TO_LIVE_MILLISECONDS inDictionary:data];
+        _trackedEventsUncollapsedMaximumAgeMs = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_TRACKED_EVENTS_UNCOLLAPSED_MAXIMUM_AGE_MS_KEY inDictionary:data defaultValue:[NSNumber numberWithInteger:DEFAULT_MAXIMUM_UNCOLLAPSED_TRACKED_EVENTS_AGE_MS]] integerValue];
+        _trackedEventsUncollapsedMaximumCount = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_TRACKED_EVENTS_UNCOLLAPSED_MAXIMUM_COUNT_KEY inDictionary:data defaultValue:[NSNumber numberWithInteger:DEFAULT_MAXIMUM_UNCOLLAPSED_TRACKED_EVENTS_COUNT]] integerValue];
+        _trackedEventsCollapsedLastBuiltinMaximumCount = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_TRACKED_EVENTS_COLLAPSED_LAST_BUILTIN_MAXIMUM_COUNT_KEY inDictionary:data defaultValue:[NSNumber numberWithInteger:DEFAULT_MAXIMUM_COLLAPSED_LAST_BUILTIN_TRACKED_EVENTS_COUNT]] integerValue];
+        _trackedEventsCollapsedLastCustomMaximumCount = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_TRACKED_EVENTS_COLLAPSED_LAST_CUSTOM_MAXIMUM_COUNT_KEY inDictionary:data defaultValue:[NSNumber numberWithInteger:DEFAULT_MAXIMUM_COLLAPSED_LAST_CUSTOM_TRACKED_EVENTS_COUNT]] integerValue];
+        _trackedEventsCollapsedOtherMaximumCount = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_TRACKED_EVENTS_COLLAPSED_OTHER_MAXIMUM_COUNT_KEY inDictionary:data defaultValue:[NSNumber numberWithInteger:DEFAULT_MAXIMUM_COLLAPSED_OTHER_TRACKED_EVENTS_COUNT]] integerValue];
+    }
+    return self;
+}
+
+// These flags used to be read with -boolValue straight from the data, which accepts strings as well as numbers
+- (BOOL) boolForKey:(NSString *)key inDictionary:(NSDictionary *)data {
+    id value = data[key];
+    if (![value isKindOfClass:NSNumber.class] && ![value isKindOfClass:NSString.class]) return NO;
+    return [value boolValue];
+}
+
+- (id) compiledSegmentOfInAppMessage:(WPIAMMessageDefinition *)message {
+    return [self.inAppSegments objectForKey:message];
+}
+
++ (id) compileSegmentOfInAppMessage:(WPIAMMessageDefinition *)message {
+    @try {
+        WPSPASTCriterionNode *parsedSegment = [WPSPSegmenter parseInstallationSegment:message.segmentDefinition];
+        if (!parsedSegment) return [NSNull null];
+        return [[WPSPCompiledSegment alloc] initWithCriterion:parsedSegment];
+    } @catch (NSException *exception) {
+        WPLog(@"Invalid segment: %@", message.segmentDefinition);
+        return [NSNull null];
+    }
+}
+
+@end
+
 #pragma mark - Data
 
 @interface WPRemoteConfig ()
@@ -22,6 +93,7 @@ NSString * const WPRemoteConfigUpdatedNotification = @"WPRemoteConfigUpdatedNoti
 - (instancetype) initWithData:(NSDictionary *)data version:(NSString *)version fetchDate:(NSDate *)fetchDate;
 - (instancetype) initWithData:(NSDictionary *)data version:(NSString *)version fetchDate:(NSDate *)fetchDate maxAge:(NSTimeInterval)maxAge;
 - (instancetype) initWithData:(NSDictionary *)data version:(NSString *)version fetchDate:(NSDate *)fetchDate maxAge:(NSTimeInterval)maxAge minAge:(NSTimeInterval)minAge;
+- (instancetype) initWithData:(NSDictionary *)data version:(NSString *)version fetchDate:(NSDate *)fetchDate maxAge:(NSTimeInterval)maxAge minAge:(NSTimeInterval)minAge snapshot:(WPRemoteConfigSnapshot * _Nullable)snapshot;
 @end
 
 @implementation WPRemoteConfig
@@ -69,8 +141,13 @@ NSString * const WPRemoteConfigUpdatedNotification = @"WPRemoteConfigUpdatedNoti
 }
 
 - (instancetype) initWithData:(NSDictionary *)data version:(NSString *)version fetchDate:(NSDate *)fetchDate maxAge:(NSTimeInterval)maxAge minAge:(NSTimeInterval)minAge {
+    return [self initWithData:data version:version fetchDate:fetchDate maxAge:maxAge minAge:minAge snapshot:nil];
+}
+
+- (instancetype) initWithData:(NSDictionary *)data version:(NSString *)version fetchDate:(NSDate *)fetchDate maxAge:(NSTimeInterval)maxAge minAge:(NSTimeInterval)minAge snapshot:(WPRemoteConfigSnapshot *)snapshot {
     if (self = [super init]) {
         _data = data;
+        _snapshot = snapshot ?: [[WPRemoteConfigSnapshot alloc] initWithData:data ?: @{}];
         _version = version;
         _fetchDate = fetchDate;
         _maxAge = maxAge;
@@ -323,7 +400,7 @@ NSString * const WPRemoteConfigUpdatedNotification = @"WPRemoteConfigUpdatedNoti
 
                 // If we're declaring the same version as the current config, update the current config's fetchDate
                 if ([WPRemoteConfig compareVersion:config.version withVersion:version] == NSOrderedSame) {
-                    WPRemoteConfig *configWithUpdatedDate = [[WPRemoteConfig alloc] initWithData:config.data version:config.version fetchDate:[NSDate date] maxAge:config.maxAge minAge:config.minAge];
+                    WPRemoteConfig *configWithUpdatedDate = [[WPRemoteConfig alloc] initWithData:config.data version:config.version fetchDate:[NSDate date] maxAge:config.maxAge minAge:config.minAge snapshot:config.snapshot];
                     [self.remoteConfigStorage storeRemoteConfig:configWithUpdatedDate completion:^(NSError *error) {
                         if (!error) self.storedConfig = configWithUpdatedDate;
                     }];
@@ -18,13 +18,35 @@
 #import <WonderPushCommon/WPRequest.h>
 #import "WPAPIClient.h"
 #import "WPNetworkReachabilityManager.h"
+#import "WPRetryScheduler.h"
 
 #define USER_DEFAULTS_REQUEST_VAULT_QUEUE_PREFIX @"__wonderpush_request_vault_"
 
+#define WP_REQUEST_VAULT_DEFAULT_BATCH_MAX_COUNT 50
+#define WP_REQUEST_VAULT_DEFAULT_BATCH_MAX_BYTES (64 * 1024)
+#define WP_REQUEST_VAULT_DEFAULT_BATCH_DELAY 1
+#define WP_REQUEST_VAULT_BATCH_REJECTION_DURATION (60 * 60)
+#define WP_REQUEST_VAULT_DEFAULT_CLIENT_DISABLED_RETRY_DELAY 10
+
 @interface WPRequestVault : NSObject
 
 @property (nonatomic, weak) id<WPRequestExecutor> requestExecutor;
 
+/// Schedules the retries of the requests that failed to reach the API.
+@property (readonly, nonatomic) WPRetryScheduler *retryScheduler;
+
+/// The maximum number of event requests sent together in a bulk request, 1 disables batching.
+@property (nonatomic, assign) NSUInteger batchMaxCount;
+
+/// The maximum size of the requests sent together in a bulk request, in bytes.
+@property (nonatomic, assign) NSUInteger batchMaxBytes;
+
+/// How long new event requests wait for others to join their batch, in seconds.
+@property (nonatomic, assign) NSTimeInterval batchDelay;
+
+/// How long requests wait before being sent again when the client was disabled, in seconds.
+@property (nonatomic, assign) NSTimeInterval clientDisabledRetryDelay;
+
 - (id) initWithRequestExecutor:(id<WPRequestExecutor>)requestExecutor userDefaultsKey:(NSString *)userDefaultsKey;
 
 - (void) restoreQueue;
@@ -35,4 +57,13 @@
 
 - (void) reset;
 
+/// Counts a failed attempt of the given request, saved along with it if it is in the vault, and returns the number of attempts so far.
+- (NSUInteger) recordFailedAttemptOfRequest:(WPRequest *)request;
+
+/// Whether the given error means the API could not be reached, such failures are retried with a backoff.
+- (BOOL) isTransientError:(NSError *)error;
+
+/// Whether the given error means the client is disabled, such requests are sent again after `clientDisabledRetryDelay`.
++ (BOOL) isClientDisabledError:(NSError *)error;
+
 @end
@@ -15,6 +15,8 @@
  */
 
 #import "WPRequestVault.h"
+#import "WPRequestVaultLog.h"
+#import "WPRequestVaultBatch.h"
 #import "WonderPush_private.h"
 #import <WonderPushCommon/WPLog.h>
 #import <WonderPushCommon/WPErrors.h>
@@ -32,6 +34,18 @@
 @end
 
 
+#pragma mark - RequestVaultBatchOperation
+
+/// Sends the oldest pending batchable requests, there is one such operation per request made pending.
+@interface WPRequestVaultBatchOperation : NSOperation
+
+- (id) initWithVault:(WPRequestVault *)vault;
+
+@property (weak, nonatomic) WPRequestVault *vault;
+
+@end
+
+
 #pragma mark - Request vault
 
 @interface WPRequestVault ()
@@ -40,30 +54,70 @@
 
 - (void) forgetRequest:(WPRequest *)request;
 
-- (void) addToQueue:(WPRequest *)request delay:(NSTimeInterval)delay;
-
 - (void) addToQueue:(WPRequest *)request;
 
+- (void) retryRequest:(WPRequest *)request;
+
+- (void) requeueRequest:(WPRequest *)request;
+
 @property (readonly, strong, nonatomic) NSString *userDefaultsKey;
 
+@property (readonly, strong, nonatomic) WPRequestVaultLog *log;
+
 @property (atomic) bool queueRestored;
 
 @property (strong, nonatomic) NSOperationQueue *operationQueue;
 
+/// Failed attempts of the requests that are not in the vault, by request id
+@property (strong, nonatomic) NSCache<NSString *, NSNumber *> *unsavedRequestAttempts;
+
 - (void) updateOperationQueueStatus;
 
-- (NSMutableArray<NSDictionary *> *) loadQueue;
+- (void) migrateUserDefaultsQueue;
+
+/// Requests waiting to be sent in a batch, oldest first
+@property (strong, nonatomic) NSMutableArray<WPRequest *> *pendingBatchRequests;
+
+/// Set when the API said it does not support bulk requests, requests are then sent one by one until that date.
+/// Saved in the user defaults, so that following launches do not try bulk requests again meanwhile.
+@property (atomic, strong) NSDate *batchingRejectedUntil;
+
+@property (readonly, strong, nonatomic) NSString *batchingRejectedUntilUserDefaultsKey;
+
+- (BOOL) batchingRejected;
+
+- (void) sendIndividually:(NSArray<WPRequest *> *)requests;
+
+- (BOOL) shouldBatchRequest:(WPRequest *)request;
+
+- (void) addToPendingBatch:(WPRequest *)request sendDelay:(NSTimeInterval)delay;
+
+- (void) sendNextBatch;
 
 @end
 
 
-@implementation WPRequestVault
+@implementation WPRequestVault {
+    NSDate *_batchingRejectedUntil;
+}
+
 - (id)initWithRequestExecutor:(id<WPRequestExecutor>)requestExecutor userDefaultsKey:(NSString *)userDefaultsKey
 {
     if (self = [super init]) {
         self.requestExecutor = requestExecutor;
         _userDefaultsKey = userDefaultsKey;
+        _log = [[WPRequestVaultLog alloc] initWithDirectory:[WPRequestVaultLog directoryForName:userDefaultsKey]];
         _queueRestored = false;
+        _batchMaxCount = WP_REQUEST_VAULT_DEFAULT_BATCH_MAX_COUNT;
+        _batchMaxBytes = WP_REQUEST_VAULT_DEFAULT_BATCH_MAX_BYTES;
+        _batchDelay = WP_REQUEST_VAULT_DEFAULT_BATCH_DELAY;
+        _clientDisabledRetryDelay = WP_REQUEST_VAULT_DEFAULT_CLIENT_DISABLED_RETRY_DELAY;
+        _batchingRejectedUntilUserDefaultsKey = [NSString stringWithFormat:@"%@_batchingRejectedUntil", userDefaultsKey];
+        id batchingRejectedUntil = [[NSUserDefaults standardUserDefaults] objectForKey:_batchingRejectedUntilUserDefaultsKey];
+        _batchingRejectedUntil = [batchingRejectedUntil isKindOfClass:[NSDate class]] ? batchingRejectedUntil : nil;
+        self.pendingBatchRequests = [NSMutableArray new];
+        self.unsavedRequestAttempts = [NSCache new];
+        _retryScheduler = [[WPRetryScheduler alloc] initWithName:userDefaultsKey];
         self.operationQueue = [[NSOperationQueue alloc] init];
         self.operationQueue.name = [NSString stringWithFormat:@"WonderPush-RequestVault:%@", userDefaultsKey];
         self.operationQueue.maxConcurrentOperationCount = 1;
@@ -83,19 +137,17 @@
             NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
             [userDefaults removeObjectForKey:@"__wonderpush_request_vault"]; // cleanup older name
             [userDefaults synchronize];
+            [self migrateUserDefaultsQueue];
 
             // Add saved operations to queue
-            NSMutableArray<NSDictionary *> *requestQueue = [self loadQueue];
-            NSUInteger requestQueueInitialCount = [requestQueue count];
-            [requestQueue filterUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(id  _Nullable evaluatedObject, NSDictionary<NSString *,id> * _Nullable bindings) {
-                WPRequest *request = [[WPRequest alloc] initFromJSON:evaluatedObject];
-                if (!request) return false;
+            for (NSDictionary *requestJson in self.log.requests) {
+                WPRequest *request = [[WPRequest alloc] initFromJSON:requestJson];
+                if (!request) {
+                    // Not valid, forget it
+                    [self.log removeRequestId:requestJson[@"requestId"]];
+                    continue;
+                }
                 [self addToQueue:request];
-                return true;
-            }]];
-            if (requestQueueInitialCount != [requestQueue count]) {
-                // Some requests were not valid and got removed, save new queue
-                [self saveQueue:requestQueue];
             }
 
             _queueRestored = true;
@@ -107,67 +159,37 @@
 
 - (void) saveRequest:(WPRequest *)request
 {
-    @synchronized(self) {
-        NSMutableArray<NSDictionary *> *requestQueue = [self loadQueue];
-        [requestQueue addObject:[request toJSON]];
-        [self saveQueue:requestQueue];
-    }
+    [self.log appendRequest:[request toJSON]];
 }
 
 - (void) forgetRequest:(WPRequest *)request
 {
-    @synchronized(self) {
-        NSMutableArray<NSDictionary *> *requestQueue = [self loadQueue];
-        [requestQueue filterUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(id  _Nullable evaluatedObject, NSDictionary<NSString *,id> * _Nullable bindings) {
-            return [evaluatedObject isKindOfClass:[NSDictionary class]] // keep objects of the right class
-                && ![evaluatedObject[@"requestId"] isEqualToString:request.requestId] // keep requestIds different from the one we want to forget
-            ;
-        }]];
-        [self saveQueue:requestQueue];
-    }
+    [self.log removeRequestId:request.requestId];
 }
 
-// Returns NSDictionary not parsed into WPRequests
-- (NSMutableArray<NSDictionary *> *) loadQueue
+// Moves the queue saved in the user defaults by previous versions into the log
+- (void) migrateUserDefaultsQueue
 {
     @synchronized(self) {
         NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
-
-        NSMutableArray<NSDictionary *> *requestQueue = nil;
-
         NSData *queueJson = [userDefaults dataForKey:self.userDefaultsKey];
-        if (queueJson != nil) {
-            NSError *error = NULL;
-            requestQueue = [NSJSONSerialization JSONObjectWithData:queueJson options:NSJSONReadingMutableContainers error:&error];
-            if (error) {
-                WPLogDebug(@"Error while reading request vault %@: %@", self.userDefaultsKey, error);
-            }
-        }
+        if (queueJson == nil) return;
 
-        if (![requestQueue isKindOfClass:[NSMutableArray class]]) {
-            if (requestQueue != nil) {
-                WPLogDebug(@"Error while reading request vault %@: unexpected value of class %@: %@", self.userDefaultsKey, [requestQueue class], requestQueue);
-            }
-            requestQueue = [[NSMutableArray alloc] init];
-        }
-
-        return requestQueue;
-    }
-}
-
-- (void) saveQueue:(NSArray<NSDictionary *> *)requestQueue
-{
-    @synchronized(self) {
-        // Save
         NSError *error = NULL;
-        NSData *queueJson = [NSJSONSerialization dataWithJSONObject:requestQueue options:0 error:&error];
+        id requestQueue = [NSJSONSerialization JSONObjectWithData:queueJson options:0 error:&error];
         if (error) {
-            WPLogDebug(@"Error while serializing request vault %@: %@", self.userDefaultsKey, error);
-            return;
+            WPLogDebug(@"Error while reading request vault %@: %@", self.userDefaultsKey, error);
+        } else if (![requestQueue isKindOfClass:[NSArray class]]) {
+            WPLogDebug(@"Error while reading request vault %@: unexpected value of class %@: %@", self.userDefaultsKey, [requestQueue class], requestQueue);
+        } else {
+            // Requests already migrated before an interruption are ignored by the log
+            for (id requestJson in requestQueue) {
+                if (![requestJson isKindOfClass:[NSDictionary class]]) continue;
+                [self.log appendRequest:requestJson];
+            }
         }
 
-        NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
-        [userDefaults setObject:queueJson forKey:self.userDefaultsKey];
+        [userDefaults removeObjectForKey:self.userDefaultsKey];
         [userDefaults synchronize];
     }
 }
@@ -175,6 +197,7 @@
 - (void) reset
 {
     @synchronized(self) {
+        [self.log clear];
         NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
         [userDefaults removeObjectForKey:self.userDefaultsKey];
         [userDefaults synchronize];
@@ -188,28 +211,217 @@
 {
     [self restoreQueue]; // ensure queue is restored at first use, even though the creator of the current instance should have done so already
     [self saveRequest:request];
-    [self addToQueue:request];
+    if ([self shouldBatchRequest:request]) {
+        // Give the following events a chance to join the same batch
+        [self addToPendingBatch:request sendDelay:self.batchDelay];
+    } else {
+        [self addToQueue:request];
+    }
+}
+
+- (void) addToQueue:(WPRequest *)request
+{
+    WPLogDebug(@"Adding request to queue: %@ client: %@", request, self.requestExecutor);
+    if ([self shouldBatchRequest:request]) {
+        [self addToPendingBatch:request sendDelay:0];
+        return;
+    }
+    WPRequestVaultOperation *operation = [[WPRequestVaultOperation alloc] initWithRequest:request vault:self];
+    [self.operationQueue addOperation:operation];
+}
+
+// Counts a failed attempt of the given request and queues it again after a backoff
+- (void) retryRequest:(WPRequest *)request
+{
+    NSUInteger attempts = [self recordFailedAttemptOfRequest:request];
+    WPLogDebug(@"Retrying request %@ after %lu attempts", request.requestId, (unsigned long)attempts);
+    [self.retryScheduler scheduleRetry:^{
+        [self addToQueue:request];
+    } attempt:attempts];
+}
+
+- (NSUInteger) recordFailedAttemptOfRequest:(WPRequest *)request
+{
+    @synchronized (self) {
+        NSString *requestId = request.requestId;
+        NSUInteger attempts = MAX([self.log attemptsForRequestId:requestId], [self.unsavedRequestAttempts objectForKey:requestId].unsignedIntegerValue) + 1;
+        [self.log setAttempts:attempts forRequestId:requestId];
+        [self.unsavedRequestAttempts setObject:@(attempts) forKey:requestId];
+        return attempts;
+    }
+}
+
+// Queues the given request again after a fixed delay, without counting an attempt, as the API was not reached
+- (void) requeueRequest:(WPRequest *)request
+{
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.clientDisabledRetryDelay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [self addToQueue:request];
+    });
+}
+
+- (BOOL) isTransientError:(NSError *)error
+{
+    if (![error isKindOfClass:[NSError class]]) return NO;
+    // Handle network errors
+    if ([NSURLErrorDomain isEqualToString:error.domain] && error.code <= NSURLErrorBadURL) return YES;
+    return NO;
+}
+
+// Client disabled errors occur when the APIClient and MeasurementsApiClient are disabled, they say nothing about the API
++ (BOOL) isClientDisabledError:(NSError *)error
+{
+    return [error isKindOfClass:[NSError class]] && [WPErrorDomain isEqualToString:error.domain] && error.code == WPErrorClientDisabled;
+}
+
+#pragma mark - Batching
+
+- (NSDate *) batchingRejectedUntil
+{
+    @synchronized (self) {
+        return _batchingRejectedUntil;
+    }
+}
+
+- (void) setBatchingRejectedUntil:(NSDate *)batchingRejectedUntil
+{
+    @synchronized (self) {
+        if (batchingRejectedUntil == _batchingRejectedUntil || [batchingRejectedUntil isEqualToDate:_batchingRejectedUntil]) return;
+        _batchingRejectedUntil = batchingRejectedUntil;
+        NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
+        if (batchingRejectedUntil) {
+            [userDefaults setObject:batchingRejectedUntil forKey:self.batchingRejectedUntilUserDefaultsKey];
+        } else {
+            [userDefaults removeObjectForKey:self.batchingRejectedUntilUserDefaultsKey];
+        }
+    }
 }
 
-- (void) addToQueue:(WPRequest *)request {
-    [self addToQueue:request delay:0];
+- (BOOL) batchingRejected
+{
+    NSDate *batchingRejectedUntil = self.batchingRejectedUntil;
+    return batchingRejectedUntil && [batchingRejectedUntil timeIntervalSinceNow] > 0;
 }
 
-- (void) addToQueue:(WPRequest *)request delay:(NSTimeInterval)delay
+// Whether the API answered a bulk request in a way that means it does not support them
++ (BOOL) isBatchingUnsupportedError:(NSError *)error
 {
-    WPLogDebug(@"Adding request to queue: %@ with delay: %f client: %@", request, delay, self.requestExecutor);
+    NSHTTPURLResponse *response = error.userInfo[WPOperationFailingURLResponseErrorKey];
+    if (![response isKindOfClass:[NSHTTPURLResponse class]]) return NO;
+    return response.statusCode == 404 || response.statusCode == 405 || response.statusCode == 501;
+}
+
+// Sends the given requests on their own, bypassing batching, so that each gets its own outcome
+- (void) sendIndividually:(NSArray<WPRequest *> *)requests
+{
+    for (WPRequest *request in requests) {
+        [self.operationQueue addOperation:[[WPRequestVaultOperation alloc] initWithRequest:request vault:self]];
+    }
+}
+
+- (BOOL) shouldBatchRequest:(WPRequest *)request
+{
+    return self.batchMaxCount > 1 && !self.batchingRejected && [WPRequestVaultBatch canBatchRequest:request];
+}
+
+- (void) addToPendingBatch:(WPRequest *)request sendDelay:(NSTimeInterval)delay
+{
+    @synchronized (self) {
+        [self.pendingBatchRequests addObject:request];
+    }
     void(^addToQueue)(void) = ^{
-        WPRequestVaultOperation *operation = [[WPRequestVaultOperation alloc] initWithRequest:request vault:self];
-        [self.operationQueue addOperation:operation];
+        [self.operationQueue addOperation:[[WPRequestVaultBatchOperation alloc] initWithVault:self]];
     };
     if (delay > 0) {
-        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
             addToQueue();
         });
     } else {
         addToQueue();
     }
+}
 
+// Takes the oldest pending request, along with the following ones of the same user, within the batch bounds
+- (NSArray<WPRequest *> *) takeNextBatch
+{
+    @synchronized (self) {
+        WPRequest *first = self.pendingBatchRequests.firstObject;
+        if (!first) return @[];
+        NSUInteger maxCount = self.batchingRejected ? 1 : MAX(1, self.batchMaxCount);
+        NSUInteger bytes = [WPRequestVaultBatch estimatedSizeOfRequest:first];
+        NSMutableIndexSet *indexes = [NSMutableIndexSet indexSetWithIndex:0];
+        for (NSUInteger i = 1; i < self.pendingBatchRequests.count && indexes.count < maxCount; i++) {
+            WPRequest *request = self.pendingBatchRequests[i];
+            if (request.userId != first.userId && ![request.userId isEqualToString:first.userId]) continue;
+            NSUInteger size = [WPRequestVaultBatch estimatedSizeOfRequest:request];
+            if (bytes + size > self.batchMaxBytes) break;
+            bytes += size;
+            [indexes addIndex:i];
+        }
+        NSArray *batch = [self.pendingBatchRequests objectsAtIndexes:indexes];
+        [self.pendingBatchRequests removeObjectsAtIndexes:indexes];
+        return batch;
+    }
+}
+
+- (void) sendNextBatch
+{
+    NSArray<WPRequest *> *requests = [self takeNextBatch];
+    if (requests.count == 0) return;
+    if (requests.count == 1) {
+        [self sendIndividually:requests];
+        return;
+    }
+
+    WPRequestVaultBatch *batch = [[WPRequestVaultBatch alloc] initWithRequests:requests];
+    WPRequest *bulkRequest = [batch bulkRequest];
+    bulkRequest.handler = ^(WPResponse *response, NSError *error) {
+        WPLogDebug(@"Bulk request of %lu requests complete with response:%@ error:%@", (unsigned long)requests.count, response, error);
+        if ([WPRequestVault isClientDisabledError:error]) {
+            for (WPRequest *request in requests) {
+                [self requeueRequest:request];
+            }
+            return;
+        }
+        if ([self isTransientError:error]) {
+            // Make sure to stop the queue
+            if (![WonderPush isReachable]) {
+                WPLogDebug(@"Declaring not reachable");
+                [self reachabilityChanged:WPNetworkReachabilityStatusNotReachable];
+            }
+            [self.retryScheduler recordFailure];
+            for (WPRequest *request in requests) {
+                [self retryRequest:request];
+            }
+            return;
+        }
+        [self.retryScheduler recordSuccess];
+        if (error) {
+            if ([WPRequestVault isBatchingUnsupportedError:error]) {
+                WPLog(@"Bulk requests unsupported, sending requests one by one for a while: %@", error);
+                self.batchingRejectedUntil = [NSDate dateWithTimeIntervalSinceNow:WP_REQUEST_VAULT_BATCH_REJECTION_DURATION];
+            } else {
+                WPLogDebug(@"Bulk request rejected, sending its requests one by one: %@", error);
+            }
+            // Let each request get its own outcome, a single bad request must not hold the others back
+            [self sendIndividually:requests];
+            return;
+        }
+        self.batchingRejectedUntil = nil;
+        NSArray<WPRequest *> *retry = [batch requestsToRetryForResponse:response.object];
+        if (!retry) {
+            WPLog(@"Bulk response does not detail every request, sending them one by one: %@", response.object);
+            [self sendIndividually:requests];
+            return;
+        }
+        for (WPRequest *request in requests) {
+            if ([retry containsObject:request]) {
+                [self retryRequest:request];
+            } else {
+                [self forgetRequest:request];
+            }
+        }
+    };
+    [self.requestExecutor executeRequest:bulkRequest];
 }
 
 - (void) updateOperationQueueStatus;
@@ -271,26 +483,24 @@
             }
         }
 
-        BOOL handleError = NO;
-        // Handle network errors
-        if ([error isKindOfClass:[NSError class]] && [NSURLErrorDomain isEqualToString:error.domain] && error.code <= NSURLErrorBadURL) {
-            handleError = YES;
-        }
-        // Handle cliend disabled errors (they occur when the APIClient and MeasurementsApiClient are disabled)
-        if ([error isKindOfClass:NSError.class] && [WPErrorDomain isEqualToString:error.domain] && error.code == WPErrorClientDisabled) {
-            handleError = YES;
+        if ([WPRequestVault isClientDisabledError:error]) {
+            [self.vault requeueRequest:self.request];
+            return;
         }
-        if (handleError) {
+
+        if ([self.vault isTransientError:error]) {
             // Make sure to stop the queue
             if (![WonderPush isReachable]) {
                 WPLogDebug(@"Declaring not reachable");
                 [self.vault reachabilityChanged:WPNetworkReachabilityStatusNotReachable];
             }
-            [self.vault addToQueue:self.request delay:10];
+            [self.vault.retryScheduler recordFailure];
+            [self.vault retryRequest:self.request];
 
             return;
         }
 
+        [self.vault.retryScheduler recordSuccess];
         [self.vault forgetRequest:self.request];
     };
 
@@ -299,3 +509,24 @@
 }
 
 @end
+
+
+#pragma mark - Request vault batch operation
+
+@implementation WPRequestVaultBatchOperation
+
+- (id) initWithVault:(WPRequestVault *)vault
+{
+    if (self = [super init]) {
+        self.queuePriority = NSOperationQueuePriorityLow;
+        self.vault = vault;
+    }
+    return self;
+}
+
+- (void) main
+{
+    [self.vault sendNextBatch];
+}
+
+@end
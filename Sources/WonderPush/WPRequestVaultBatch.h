@@ -0,0 +1,52 @@
+//
+//  WPRequestVaultBatch.h
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <WonderPushCommon/WPRequest.h>
+
+#define WP_REQUEST_VAULT_BATCH_RESOURCE @"/events/bulk"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A group of queued event requests sent to the API as a single bulk request.
+
+ The bulk request is a `POST /events/bulk` whose body lists the original requests:
+
+     {"events": [{"id": "<requestId>", "params": {<original params>}}, ...]}
+
+ The response may detail the outcome of each request:
+
+     {"results": [{"id": "<requestId>", "status": 200}, ...]}
+
+ Requests reported with a 429 or 5xx status, or missing from the results, are to be retried,
+ the others are done with. A response without one result per request tells nothing about them.
+ */
+@interface WPRequestVaultBatch : NSObject
+
+/// Whether the given request can be part of a batch, namely an event `POST`.
++ (BOOL) canBatchRequest:(WPRequest *)request;
+
+/// The size of the given request within a bulk request body, in bytes.
++ (NSUInteger) estimatedSizeOfRequest:(WPRequest *)request;
+
+- (instancetype) initWithRequests:(NSArray<WPRequest *> *)requests;
+
+@property (readonly) NSArray<WPRequest *> *requests;
+
+/// A new bulk request carrying all the requests, without a handler.
+- (WPRequest *) bulkRequest;
+
+/// The requests that must be retried, given the response to the bulk request,
+/// or nil if the response does not have one result per request.
+/// Requests whose result is missing or has no numeric status are retried.
+- (nullable NSArray<WPRequest *> *) requestsToRetryForResponse:(nullable id)responseObject;
+
+@end
+
+NS_ASSUME_NONNULL_END
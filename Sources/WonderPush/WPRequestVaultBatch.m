@@ -0,0 +1,81 @@
+//
+//  WPRequestVaultBatch.m
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import "WPRequestVaultBatch.h"
+#import <WonderPushCommon/WPLog.h>
+
+@implementation WPRequestVaultBatch
+
++ (BOOL) canBatchRequest:(WPRequest *)request
+{
+    // Resources are stored without their leading slash
+    return [@"POST" isEqualToString:request.method.uppercaseString]
+        && [@"events" isEqualToString:request.resource]
+        && [request.params isKindOfClass:[NSDictionary class]]
+        && [request.params[@"body"] isKindOfClass:[NSDictionary class]];
+}
+
++ (NSUInteger) estimatedSizeOfRequest:(WPRequest *)request
+{
+    @try {
+        NSData *data = [NSJSONSerialization dataWithJSONObject:request.params options:kNilOptions error:nil];
+        // Account for the id and the surrounding keys
+        return data.length + request.requestId.length + 20;
+    } @catch (NSException *exception) {
+        WPLog(@"WPRequestVaultBatch: Error while serializing request %@: %@", request, exception);
+        return NSUIntegerMax;
+    }
+}
+
+- (instancetype) initWithRequests:(NSArray<WPRequest *> *)requests
+{
+    if (self = [super init]) {
+        _requests = [requests copy];
+    }
+    return self;
+}
+
+- (WPRequest *) bulkRequest
+{
+    NSMutableArray *events = [NSMutableArray arrayWithCapacity:self.requests.count];
+    for (WPRequest *request in self.requests) {
+        [events addObject:@{@"id": request.requestId, @"params": request.params}];
+    }
+    WPRequest *bulkRequest = [WPRequest new];
+    bulkRequest.method = @"POST";
+    bulkRequest.resource = WP_REQUEST_VAULT_BATCH_RESOURCE;
+    bulkRequest.userId = self.requests.firstObject.userId;
+    bulkRequest.params = @{@"body": @{@"events": events}};
+    return bulkRequest;
+}
+
+- (NSArray<WPRequest *> *) requestsToRetryForResponse:(id)responseObject
+{
+    id results = [responseObject isKindOfClass:[NSDictionary class]] ? responseObject[@"results"] : nil;
+    // Do not take a response that does not detail every request as accepting them all
+    if (![results isKindOfClass:[NSArray class]] || [(NSArray *)results count] != self.requests.count) return nil;
+
+    NSMutableDictionary<NSString *, NSNumber *> *statuses = [NSMutableDictionary new];
+    for (id result in results) {
+        if (![result isKindOfClass:[NSDictionary class]] || ![result[@"id"] isKindOfClass:[NSString class]]) continue;
+        id status = result[@"status"];
+        // A result without a status does not confirm its request
+        if (![status isKindOfClass:[NSNumber class]]) continue;
+        statuses[result[@"id"]] = status;
+    }
+    NSMutableArray *retry = [NSMutableArray new];
+    for (WPRequest *request in self.requests) {
+        NSNumber *status = statuses[request.requestId];
+        if (!status || status.integerValue == 429 || status.integerValue >= 500) {
+            [retry addObject:request];
+        }
+    }
+    return retry;
+}
+
+@end
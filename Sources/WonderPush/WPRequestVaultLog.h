@@ -0,0 +1,62 @@
+//
+//  WPRequestVaultLog.h
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ An on-disk, append-only store for the requests of a `WPRequestVault`.
+
+ Requests are persisted in a directory of segment files holding one JSON record per line:
+ saving a request appends it, forgetting a request appends a tombstone bearing its `requestId`,
+ and each failed attempt appends the number of attempts of the request so far.
+ A record is only valid once its trailing newline is written, so an interrupted write is ignored when reloading.
+
+ Segments are rolled over once they grow larger than `segmentMaxBytes`.
+ The oldest segments are deleted as soon as all their requests are forgotten,
+ and once too many dead records accumulate, the live requests are rewritten into a single compacted segment
+ on a background queue.
+ */
+@interface WPRequestVaultLog : NSObject
+
+- (instancetype) initWithDirectory:(NSString *)directory;
+
+/// The size above which the segment being appended to is closed and a new one is started.
+@property (nonatomic, assign) NSUInteger segmentMaxBytes;
+
+/// The saved requests, in the order they were appended, loaded from disk on first access and kept in memory afterwards.
+@property (readonly) NSArray<NSDictionary *> *requests;
+
+/// The number of segment files on disk.
+@property (readonly) NSUInteger segmentCount;
+
+/// Appends the given request, identified by its `requestId` key. Does nothing if it is already saved.
+- (void) appendRequest:(NSDictionary *)request;
+
+/// Appends a tombstone for the given request. Does nothing if it is not saved.
+- (void) removeRequestId:(NSString *)requestId;
+
+/// The number of failed attempts recorded for the given request.
+- (NSUInteger) attemptsForRequestId:(NSString *)requestId;
+
+/// Appends the number of failed attempts of the given request. Does nothing if it is not saved.
+- (void) setAttempts:(NSUInteger)attempts forRequestId:(NSString *)requestId;
+
+/// Rewrites the live requests into a single segment and removes the others.
+- (void) compact;
+
+/// Removes all the segment files, and forgets all the requests.
+- (void) clear;
+
+/// A directory suitable to store the log of the request vault of the given name.
++ (NSString *) directoryForName:(NSString *)name;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,454 @@
+//
+//  WPRequestVaultLog.m
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import "WPRequestVaultLog.h"
+#import <WonderPushCommon/WPLog.h>
+
+#define DEFAULT_SEGMENT_MAX_BYTES (256 * 1024)
+// Never compact before this many dead records, to keep small queues from being rewritten too often
+#define MINIMUM_DEAD_RECORDS_BEFORE_COMPACTION 100
+
+static NSString * const WPRequestVaultLogSegmentExtension = @".log";
+static NSString * const WPRequestVaultLogCompactedSegmentExtension = @".compact.log";
+
+@interface WPRequestVaultLog ()
+@property (nonatomic, strong) NSString *directory;
+@property (nonatomic, assign) BOOL loaded;
+@property (nonatomic, strong) NSMutableOrderedSet<NSString *> *order;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSDictionary *> *requestsById;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *segmentOfRequestId;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *attemptsByRequestId;
+/// The number of records, and of live requests, of each segment on disk
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSNumber *> *segmentRecordCounts;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSNumber *> *segmentLiveCounts;
+/// The segment holding the result of the last compaction, which replaces all the segments up to its own number, or -1
+@property (nonatomic, assign) NSInteger compactedSegment;
+@property (nonatomic, assign) NSInteger activeSegment;
+@property (nonatomic, assign) unsigned long long activeSegmentBytes;
+@property (nonatomic, strong, nullable) NSFileHandle *activeFileHandle;
+@property (nonatomic, assign) BOOL compactionScheduled;
+@end
+
+@implementation WPRequestVaultLog
+
++ (NSString *) directoryForName:(NSString *)name
+{
+    NSString *applicationSupport = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject] ?: NSTemporaryDirectory();
+    // Names hold client ids and colons, keep them safe for the file system
+    NSCharacterSet *unsafe = [[NSCharacterSet characterSetWithCharactersInString:@"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-."] invertedSet];
+    NSString *safeName = [[name componentsSeparatedByCharactersInSet:unsafe] componentsJoinedByString:@"_"];
+    return [[applicationSupport stringByAppendingPathComponent:@"WonderPush/RequestVault"] stringByAppendingPathComponent:safeName];
+}
+
++ (dispatch_queue_t) compactionQueue
+{
+    static dispatch_queue_t queue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        queue = dispatch_queue_create("com.wonderpush.requestvaultlog.compaction", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+    });
+    return queue;
+}
+
+- (instancetype) initWithDirectory:(NSString *)directory
+{
+    if (self = [super init]) {
+        _directory = directory;
+        _segmentMaxBytes = DEFAULT_SEGMENT_MAX_BYTES;
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [_activeFileHandle closeFile];
+}
+
+- (NSArray<NSDictionary *> *) requests
+{
+    @synchronized (self) {
+        [self load];
+        NSMutableArray *requests = [NSMutableArray arrayWithCapacity:self.order.count];
+        for (NSString *requestId in self.order) {
+            [requests addObject:self.requestsById[requestId]];
+        }
+        return requests;
+    }
+}
+
+- (NSUInteger) segmentCount
+{
+    @synchronized (self) {
+        [self load];
+        return self.segmentRecordCounts.count;
+    }
+}
+
+- (NSString *) pathForSegment:(NSInteger)segment compacted:(BOOL)compacted
+{
+    NSString *name = [NSString stringWithFormat:@"%010ld%@", (long)segment, compacted ? WPRequestVaultLogCompactedSegmentExtension : WPRequestVaultLogSegmentExtension];
+    return [self.directory stringByAppendingPathComponent:name];
+}
+
+- (NSString *) pathForSegment:(NSInteger)segment
+{
+    return [self pathForSegment:segment compacted:segment == self.compactedSegment];
+}
+
+#pragma mark - Loading
+
+- (void) load
+{
+    if (self.loaded) return;
+    self.loaded = YES;
+    self.order = [NSMutableOrderedSet new];
+    self.requestsById = [NSMutableDictionary new];
+    self.segmentOfRequestId = [NSMutableDictionary new];
+    self.attemptsByRequestId = [NSMutableDictionary new];
+    self.segmentRecordCounts = [NSMutableDictionary new];
+    self.segmentLiveCounts = [NSMutableDictionary new];
+    self.compactedSegment = -1;
+
+    NSMutableIndexSet *segments = [NSMutableIndexSet new];
+    NSMutableIndexSet *compactedSegments = [NSMutableIndexSet new];
+    for (NSString *file in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.directory error:nil]) {
+        // Leftovers of interrupted atomic writes do not match these extensions
+        BOOL compacted = [file hasSuffix:WPRequestVaultLogCompactedSegmentExtension];
+        if (!compacted && ![file hasSuffix:WPRequestVaultLogSegmentExtension]) continue;
+        NSScanner *scanner = [NSScanner scannerWithString:file];
+        NSInteger segment;
+        if (![scanner scanInteger:&segment] || segment < 0) continue;
+        [(compacted ? compactedSegments : segments) addIndex:segment];
+    }
+
+    NSInteger lastSegment = -1;
+    if (segments.count > 0) lastSegment = MAX(lastSegment, (NSInteger)segments.lastIndex);
+    if (compactedSegments.count > 0) lastSegment = MAX(lastSegment, (NSInteger)compactedSegments.lastIndex);
+    if (compactedSegments.count > 0) {
+        // The last compaction replaces every segment up to its own number,
+        // they are still there if we got interrupted before removing them
+        NSInteger compactedSegment = compactedSegments.lastIndex;
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        [compactedSegments enumerateIndexesInRange:NSMakeRange(0, compactedSegment) options:0 usingBlock:^(NSUInteger segment, BOOL *stop) {
+            [fileManager removeItemAtPath:[self pathForSegment:segment compacted:YES] error:nil];
+        }];
+        [segments enumerateIndexesInRange:NSMakeRange(0, compactedSegment + 1) options:0 usingBlock:^(NSUInteger segment, BOOL *stop) {
+            [fileManager removeItemAtPath:[self pathForSegment:segment compacted:NO] error:nil];
+        }];
+        [segments removeIndexesInRange:NSMakeRange(0, compactedSegment + 1)];
+        self.compactedSegment = compactedSegment;
+        [self loadSegment:compactedSegment];
+    }
+    [segments enumerateIndexesUsingBlock:^(NSUInteger segment, BOOL *stop) {
+        [self loadSegment:segment];
+    }];
+
+    // Never append after what could be an interrupted record
+    self.activeSegment = lastSegment < 0 ? 0 : lastSegment + 1;
+    self.activeSegmentBytes = 0;
+    [self removeLeadingDeadSegments];
+}
+
+- (void) loadSegment:(NSInteger)segment
+{
+    NSString *path = [self pathForSegment:segment];
+    NSData *data = [NSData dataWithContentsOfFile:path];
+    const char *bytes = data.bytes;
+    NSUInteger length = data.length;
+    NSUInteger lineStart = 0;
+    NSUInteger recordCount = 0;
+    BOOL corrupted = NO;
+    while (lineStart < length) {
+        const char *newline = memchr(bytes + lineStart, '\n', length - lineStart);
+        recordCount++;
+        if (!newline) {
+            // A record is only valid once its trailing newline is written, this one was interrupted
+            corrupted = YES;
+            break;
+        }
+        NSUInteger lineEnd = newline - bytes;
+        NSData *line = [data subdataWithRange:NSMakeRange(lineStart, lineEnd - lineStart)];
+        lineStart = lineEnd + 1;
+        id record = [NSJSONSerialization JSONObjectWithData:line options:kNilOptions error:nil];
+        if (![record isKindOfClass:[NSDictionary class]] || ![self applyRecord:record segment:segment]) {
+            corrupted = YES;
+        }
+    }
+    if (corrupted) {
+        WPLog(@"WPRequestVaultLog: Ignoring unreadable records of %@", path);
+    }
+    self.segmentRecordCounts[@(segment)] = @(recordCount);
+    if (!self.segmentLiveCounts[@(segment)]) self.segmentLiveCounts[@(segment)] = @0;
+}
+
+- (BOOL) applyRecord:(NSDictionary *)record segment:(NSInteger)segment
+{
+    id request = record[@"a"];
+    id tombstone = record[@"t"];
+    id retried = record[@"r"];
+    id attempts = record[@"n"];
+    if (attempts && ![attempts isKindOfClass:[NSNumber class]]) return NO;
+    if ([request isKindOfClass:[NSDictionary class]] && [request[@"requestId"] isKindOfClass:[NSString class]]) {
+        NSString *requestId = request[@"requestId"];
+        if (self.requestsById[requestId]) return YES;
+        self.requestsById[requestId] = request;
+        [self.order addObject:requestId];
+        self.segmentOfRequestId[requestId] = @(segment);
+        self.segmentLiveCounts[@(segment)] = @(self.segmentLiveCounts[@(segment)].unsignedIntegerValue + 1);
+        if ([attempts unsignedIntegerValue] > 0) self.attemptsByRequestId[requestId] = attempts;
+        return YES;
+    }
+    if ([tombstone isKindOfClass:[NSString class]]) {
+        NSNumber *requestSegment = self.segmentOfRequestId[tombstone];
+        if (!requestSegment) return YES;
+        [self.requestsById removeObjectForKey:tombstone];
+        [self.order removeObject:tombstone];
+        [self.segmentOfRequestId removeObjectForKey:tombstone];
+        [self.attemptsByRequestId removeObjectForKey:tombstone];
+        self.segmentLiveCounts[requestSegment] = @(self.segmentLiveCounts[requestSegment].unsignedIntegerValue - 1);
+        return YES;
+    }
+    if ([retried isKindOfClass:[NSString class]] && attempts) {
+        if (self.requestsById[retried]) self.attemptsByRequestId[retried] = attempts;
+        return YES;
+    }
+    return NO;
+}
+
+#pragma mark - Writing
+
+- (void) appendRequest:(NSDictionary *)request
+{
+    @synchronized (self) {
+        [self load];
+        id requestId = request[@"requestId"];
+        if (![requestId isKindOfClass:[NSString class]]) {
+            WPLog(@"WPRequestVaultLog: Ignoring request without a requestId: %@", request);
+            return;
+        }
+        if (self.requestsById[requestId]) return;
+        NSDictionary *record = @{@"a": request};
+        [self applyRecord:record segment:self.activeSegment];
+        [self appendRecord:record];
+    }
+}
+
+- (void) removeRequestId:(NSString *)requestId
+{
+    @synchronized (self) {
+        [self load];
+        if (!self.requestsById[requestId]) return;
+        NSDictionary *record = @{@"t": requestId};
+        [self applyRecord:record segment:self.activeSegment];
+        [self appendRecord:record];
+        [self removeLeadingDeadSegments];
+        [self scheduleCompactionIfNeeded];
+    }
+}
+
+- (NSUInteger) attemptsForRequestId:(NSString *)requestId
+{
+    @synchronized (self) {
+        [self load];
+        return self.attemptsByRequestId[requestId].unsignedIntegerValue;
+    }
+}
+
+- (void) setAttempts:(NSUInteger)attempts forRequestId:(NSString *)requestId
+{
+    @synchronized (self) {
+        [self load];
+        if (!self.requestsById[requestId]) return;
+        NSDictionary *record = @{@"r": requestId, @"n": @(attempts)};
+        [self applyRecord:record segment:self.activeSegment];
+        [self appendRecord:record];
+        [self scheduleCompactionIfNeeded];
+    }
+}
+
+- (void) compact
+{
+    @synchronized (self) {
+        [self load];
+        [self rollOver];
+        // Everything is now sealed, fold it into a segment bearing the number of the last one
+        NSInteger compactedSegment = self.activeSegment - 1;
+        if (compactedSegment < 0) return;
+        if (self.order.count > 0) {
+            if (![self ensureDirectory]) return;
+            NSMutableData *data = [NSMutableData new];
+            for (NSString *requestId in self.order) {
+                NSNumber *attempts = self.attemptsByRequestId[requestId];
+                NSData *line = [self serializeRecord:attempts ? @{@"a": self.requestsById[requestId], @"n": attempts} : @{@"a": self.requestsById[requestId]}];
+                if (!line) return;
+                [data appendData:line];
+            }
+            NSError *error = nil;
+            NSString *path = [self pathForSegment:compactedSegment compacted:YES];
+            if (![data writeToFile:path options:NSDataWritingAtomic error:&error]) {
+                WPLog(@"WPRequestVaultLog: Error while writing %@: %@", path, error);
+                return;
+            }
+        }
+
+        // From now on the compacted segment replaces all the others, should we get interrupted
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        for (NSNumber *segment in self.segmentRecordCounts.allKeys) {
+            NSString *path = [self pathForSegment:segment.integerValue];
+            if (self.order.count > 0 && [path isEqualToString:[self pathForSegment:compactedSegment compacted:YES]]) continue;
+            [fileManager removeItemAtPath:path error:nil];
+        }
+        [self.segmentRecordCounts removeAllObjects];
+        [self.segmentLiveCounts removeAllObjects];
+        if (self.order.count > 0) {
+            self.compactedSegment = compactedSegment;
+            self.segmentRecordCounts[@(compactedSegment)] = @(self.order.count);
+            self.segmentLiveCounts[@(compactedSegment)] = @(self.order.count);
+            for (NSString *requestId in self.order) {
+                self.segmentOfRequestId[requestId] = @(compactedSegment);
+            }
+        } else {
+            self.compactedSegment = -1;
+        }
+    }
+}
+
+- (void) clear
+{
+    @synchronized (self) {
+        [self.activeFileHandle closeFile];
+        self.activeFileHandle = nil;
+        [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+        self.loaded = NO;
+        [self load];
+    }
+}
+
+- (void) scheduleCompactionIfNeeded
+{
+    if (self.compactionScheduled || ![self needsCompaction]) return;
+    self.compactionScheduled = YES;
+    __weak WPRequestVaultLog *weakSelf = self;
+    dispatch_async([WPRequestVaultLog compactionQueue], ^{
+        WPRequestVaultLog *strongSelf = weakSelf;
+        if (!strongSelf) return;
+        @synchronized (strongSelf) {
+            strongSelf.compactionScheduled = NO;
+            if ([strongSelf needsCompaction]) [strongSelf compact];
+        }
+    });
+}
+
+- (BOOL) needsCompaction
+{
+    NSUInteger deadRecordCount = 0;
+    for (NSNumber *segment in self.segmentRecordCounts) {
+        deadRecordCount += self.segmentRecordCounts[segment].unsignedIntegerValue - self.segmentLiveCounts[segment].unsignedIntegerValue;
+    }
+    return deadRecordCount >= MAX(MINIMUM_DEAD_RECORDS_BEFORE_COMPACTION, self.order.count);
+}
+
+/// Deletes the oldest sealed segments once all their requests are forgotten.
+/// Their tombstones can only refer to requests of the same or of older segments, so none can come back.
+- (void) removeLeadingDeadSegments
+{
+    NSArray<NSNumber *> *segments = [self.segmentRecordCounts.allKeys sortedArrayUsingSelector:@selector(compare:)];
+    for (NSNumber *segment in segments) {
+        if (segment.integerValue >= self.activeSegment || self.segmentLiveCounts[segment].unsignedIntegerValue > 0) break;
+        [[NSFileManager defaultManager] removeItemAtPath:[self pathForSegment:segment.integerValue] error:nil];
+        [self.segmentRecordCounts removeObjectForKey:segment];
+        [self.segmentLiveCounts removeObjectForKey:segment];
+        if (segment.integerValue == self.compactedSegment) self.compactedSegment = -1;
+    }
+}
+
+- (void) rollOver
+{
+    [self.activeFileHandle closeFile];
+    self.activeFileHandle = nil;
+    if (self.segmentRecordCounts[@(self.activeSegment)]) {
+        self.activeSegment++;
+        self.activeSegmentBytes = 0;
+    }
+}
+
+- (BOOL) ensureDirectory
+{
+    NSError *error = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:&error]) {
+        WPLog(@"WPRequestVaultLog: Error while creating directory %@: %@", self.directory, error);
+        return NO;
+    }
+    return YES;
+}
+
+- (nullable NSData *) serializeRecord:(NSDictionary *)record
+{
+    @try {
+        NSError *error = nil;
+        NSData *data = [NSJSONSerialization dataWithJSONObject:record options:kNilOptions error:&error];
+        if (error) {
+            WPLog(@"WPRequestVaultLog: Error while serializing record: %@", error);
+            return nil;
+        }
+        NSMutableData *line = [data mutableCopy];
+        [line appendBytes:"\n" length:1];
+        return line;
+    } @catch (NSException *exception) {
+        WPLog(@"WPRequestVaultLog: Error while serializing record: %@", exception);
+        return nil;
+    }
+}
+
+- (BOOL) appendRecord:(NSDictionary *)record
+{
+    // Count the record even if it fails to be written, a failed append leaves garbage for the compaction to clean
+    NSNumber *segment = @(self.activeSegment);
+    self.segmentRecordCounts[segment] = @(self.segmentRecordCounts[segment].unsignedIntegerValue + 1);
+    if (!self.segmentLiveCounts[segment]) self.segmentLiveCounts[segment] = @0;
+
+    NSData *line = [self serializeRecord:record];
+    if (!line) return NO;
+
+    NSString *path = [self pathForSegment:self.activeSegment];
+    if (!self.activeFileHandle) {
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        if (![fileManager fileExistsAtPath:path]) {
+            if (![self ensureDirectory]) return NO;
+            if (![fileManager createFileAtPath:path contents:nil attributes:nil]) {
+                WPLog(@"WPRequestVaultLog: Could not create %@", path);
+                return NO;
+            }
+        }
+        NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:path];
+        if (!fileHandle) return NO;
+        @try {
+            self.activeSegmentBytes = [fileHandle seekToEndOfFile];
+        } @catch (NSException *exception) {
+            WPLog(@"WPRequestVaultLog: Error while opening %@: %@", path, exception);
+            [fileHandle closeFile];
+            return NO;
+        }
+        self.activeFileHandle = fileHandle;
+    }
+    @try {
+        [self.activeFileHandle writeData:line];
+    } @catch (NSException *exception) {
+        WPLog(@"WPRequestVaultLog: Error while appending to %@: %@", path, exception);
+        // Never append after what could be a partially written record
+        [self rollOver];
+        return NO;
+    }
+    self.activeSegmentBytes += line.length;
+    if (self.activeSegmentBytes >= self.segmentMaxBytes) {
+        [self rollOver];
+    }
+    return YES;
+}
+
+@end
@@ -0,0 +1,75 @@
+//
+//  WPRetryScheduler.h
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define WP_RETRY_SCHEDULER_DEFAULT_BASE_DELAY 10
+#define WP_RETRY_SCHEDULER_DEFAULT_MAX_DELAY (15 * 60)
+#define WP_RETRY_SCHEDULER_DEFAULT_FAILURE_THRESHOLD 5
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, WPRetrySchedulerState) {
+    /// Retries run when they are due
+    WPRetrySchedulerStateClosed,
+    /// Retries are held, because the network is unreachable or too many attempts failed in a row
+    WPRetrySchedulerStateOpen,
+    /// A single retry is let through, its outcome decides whether to close or to open the circuit again
+    WPRetrySchedulerStateHalfOpen,
+};
+
+/**
+ Runs retries after an exponential backoff with jitter, behind a circuit breaker.
+
+ The delay before the nth attempt doubles with each attempt, from `baseDelay` up to `maxDelay`,
+ and is drawn at random between half and all of it, so that requests failing together do not retry together.
+
+ The circuit opens while the network is unreachable, as told by `WPNetworkReachabilityManager`,
+ and after `failureThreshold` failures in a row, for a cooldown that grows like the retries delays.
+ Retries falling due meanwhile are held. Once the network is back or the cooldown elapsed, a single retry probes the API:
+ on success the circuit closes and the held retries are released a little apart from one another.
+
+ Retries run on a background queue.
+ */
+@interface WPRetryScheduler : NSObject
+
+- (instancetype) initWithName:(NSString *)name;
+
+@property (nonatomic, assign) NSTimeInterval baseDelay;
+@property (nonatomic, assign) NSTimeInterval maxDelay;
+@property (nonatomic, assign) NSUInteger failureThreshold;
+
+/// The interval between the held retries released when the circuit closes.
+@property (nonatomic, assign) NSTimeInterval releaseInterval;
+
+@property (readonly) WPRetrySchedulerState state;
+
+/// The number of failures recorded since the last success.
+@property (readonly) NSUInteger consecutiveFailureCount;
+
+/// The number of retries waiting to run.
+@property (readonly) NSUInteger pendingRetryCount;
+
+/// The delay before the given attempt, counting from 1, jitter included.
+- (NSTimeInterval) delayForAttempt:(NSUInteger)attempt;
+
+/// Runs the given block once the delay for the given attempt elapsed and the circuit lets it through.
+- (void) scheduleRetry:(dispatch_block_t)block attempt:(NSUInteger)attempt;
+
+/// Records that a request reached the API.
+- (void) recordSuccess;
+
+/// Records that a request failed to reach the API.
+- (void) recordFailure;
+
+/// Overrides the reachability last notified by `WPNetworkReachabilityManager`.
+- (void) setNetworkReachable:(BOOL)reachable;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,273 @@
+//
+//  WPRetryScheduler.m
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import "WPRetryScheduler.h"
+#import "WPNetworkReachabilityManager.h"
+#import <WonderPushCommon/WPLog.h>
+
+#define DEFAULT_RELEASE_INTERVAL 0.1
+// Let another retry probe the API if the outcome of the previous one never came
+#define PROBE_TIMEOUT 60
+
+@interface WPRetrySchedulerEntry : NSObject
+@property (nonatomic, assign) NSTimeInterval dueTime;
+@property (nonatomic, copy) dispatch_block_t block;
+@end
+
+@implementation WPRetrySchedulerEntry
+@end
+
+static NSComparisonResult WPRetrySchedulerCompareEntries(WPRetrySchedulerEntry *a, WPRetrySchedulerEntry *b) {
+    return a.dueTime < b.dueTime ? NSOrderedAscending : a.dueTime > b.dueTime ? NSOrderedDescending : NSOrderedSame;
+}
+
+@interface WPRetryScheduler ()
+@property (nonatomic, strong) dispatch_queue_t queue;
+/// Where retries run
+@property (nonatomic, strong) dispatch_queue_t callbackQueue;
+/// Monotonic time, in seconds
+@property (nonatomic, copy) NSTimeInterval (^now)(void);
+@property (nonatomic, strong, nullable) dispatch_source_t timer;
+@property (nonatomic, assign) BOOL timerSuspended;
+/// Sorted by due time
+@property (nonatomic, strong) NSMutableArray<WPRetrySchedulerEntry *> *retries;
+@property (nonatomic, assign) BOOL networkReachable;
+@property (nonatomic, assign) NSUInteger failureCount;
+@property (nonatomic, assign) NSTimeInterval openUntil;
+/// Set when the network comes back, until a request succeeds
+@property (nonatomic, assign) BOOL probeRequired;
+@property (nonatomic, assign) BOOL probeInFlight;
+@property (nonatomic, assign) NSTimeInterval probeStartTime;
+@end
+
+@implementation WPRetryScheduler
+
+- (instancetype) initWithName:(NSString *)name
+{
+    if (self = [super init]) {
+        _queue = dispatch_queue_create([[NSString stringWithFormat:@"com.wonderpush.retryscheduler.%@", name] UTF8String], DISPATCH_QUEUE_SERIAL);
+        _retries = [NSMutableArray new];
+        _networkReachable = YES;
+        _baseDelay = WP_RETRY_SCHEDULER_DEFAULT_BASE_DELAY;
+        _maxDelay = WP_RETRY_SCHEDULER_DEFAULT_MAX_DELAY;
+        _failureThreshold = WP_RETRY_SCHEDULER_DEFAULT_FAILURE_THRESHOLD;
+        _releaseInterval = DEFAULT_RELEASE_INTERVAL;
+        _callbackQueue = dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+        _now = ^{
+            return [NSProcessInfo processInfo].systemUptime;
+        };
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(reachabilityDidChange:) name:WPReachabilityDidChangeNotification object:nil];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    if (_timer) {
+        // Suspended sources must not be released
+        if (_timerSuspended) dispatch_resume(_timer);
+        dispatch_source_cancel(_timer);
+    }
+}
+
+- (NSTimeInterval) delayForAttempt:(NSUInteger)attempt
+{
+    NSTimeInterval delay = MIN(self.maxDelay, ldexp(self.baseDelay, (int)MIN(MAX(attempt, 1) - 1, 62)));
+    return delay * (0.5 + 0.5 * arc4random() / (double)UINT32_MAX);
+}
+
+#pragma mark - State
+
+- (WPRetrySchedulerState) state
+{
+    __block WPRetrySchedulerState state;
+    dispatch_sync(self.queue, ^{
+        state = [self stateAt:self.now()];
+    });
+    return state;
+}
+
+- (NSUInteger) consecutiveFailureCount
+{
+    __block NSUInteger count;
+    dispatch_sync(self.queue, ^{
+        count = self.failureCount;
+    });
+    return count;
+}
+
+- (NSUInteger) pendingRetryCount
+{
+    __block NSUInteger count;
+    dispatch_sync(self.queue, ^{
+        count = self.retries.count;
+    });
+    return count;
+}
+
+- (BOOL) tripped
+{
+    return self.failureCount >= self.failureThreshold;
+}
+
+- (WPRetrySchedulerState) stateAt:(NSTimeInterval)now
+{
+    if (!self.networkReachable) return WPRetrySchedulerStateOpen;
+    if (self.tripped && now < self.openUntil) return WPRetrySchedulerStateOpen;
+    if (self.tripped || self.probeRequired) return WPRetrySchedulerStateHalfOpen;
+    return WPRetrySchedulerStateClosed;
+}
+
+#pragma mark - Scheduling
+
+- (void) scheduleRetry:(dispatch_block_t)block attempt:(NSUInteger)attempt
+{
+    WPRetrySchedulerEntry *entry = [WPRetrySchedulerEntry new];
+    entry.block = block;
+    NSTimeInterval delay = [self delayForAttempt:attempt];
+    dispatch_async(self.queue, ^{
+        entry.dueTime = self.now() + delay;
+        NSUInteger index = [self.retries indexOfObject:entry inSortedRange:NSMakeRange(0, self.retries.count) options:NSBinarySearchingInsertionIndex | NSBinarySearchingLastEqual usingComparator:^NSComparisonResult(WPRetrySchedulerEntry *a, WPRetrySchedulerEntry *b) {
+            return WPRetrySchedulerCompareEntries(a, b);
+        }];
+        [self.retries insertObject:entry atIndex:index];
+        [self process];
+    });
+}
+
+- (void) recordSuccess
+{
+    dispatch_async(self.queue, ^{
+        BOOL wasHeld = self.tripped || self.probeRequired || !self.networkReachable;
+        self.failureCount = 0;
+        self.probeRequired = NO;
+        self.probeInFlight = NO;
+        if (wasHeld) [self spreadOverdueRetries];
+        [self process];
+    });
+}
+
+- (void) recordFailure
+{
+    dispatch_async(self.queue, ^{
+        self.failureCount++;
+        self.probeInFlight = NO;
+        if (self.tripped) {
+            NSTimeInterval cooldown = [self delayForAttempt:self.failureCount - self.failureThreshold + 1];
+            self.openUntil = self.now() + cooldown;
+            WPLogDebug(@"Retries held for %.1fs after %lu failures in a row", cooldown, (unsigned long)self.failureCount);
+        }
+        [self process];
+    });
+}
+
+- (void) setNetworkReachable:(BOOL)reachable
+{
+    dispatch_async(self.queue, ^{
+        if (reachable == self.networkReachable) return;
+        self.networkReachable = reachable;
+        // Do not release every held retry at once, the network may still be flapping
+        if (reachable) self.probeRequired = YES;
+        [self process];
+    });
+}
+
+- (void) reachabilityDidChange:(NSNotification *)notification
+{
+    NSNumber *status = notification.userInfo[WPReachabilityNotificationStatusItem];
+    if (![status isKindOfClass:[NSNumber class]]) return;
+    [self setNetworkReachable:status.integerValue == WPNetworkReachabilityStatusReachableViaWWAN || status.integerValue == WPNetworkReachabilityStatusReachableViaWiFi];
+}
+
+/// Puts some interval between the retries that fell due while held, keeping their order.
+- (void) spreadOverdueRetries
+{
+    NSTimeInterval now = self.now();
+    NSUInteger index = 0;
+    for (WPRetrySchedulerEntry *entry in self.retries) {
+        if (entry.dueTime > now) break;
+        entry.dueTime = now + index * self.releaseInterval;
+        index++;
+    }
+    [self.retries sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(WPRetrySchedulerEntry *a, WPRetrySchedulerEntry *b) {
+        return WPRetrySchedulerCompareEntries(a, b);
+    }];
+}
+
+- (void) fireFirst
+{
+    WPRetrySchedulerEntry *entry = self.retries.firstObject;
+    [self.retries removeObjectAtIndex:0];
+    dispatch_async(self.callbackQueue, entry.block);
+}
+
+/// Runs the retries the circuit lets through, then waits for the next relevant time
+- (void) process
+{
+    NSTimeInterval now = self.now();
+    NSTimeInterval wakeTime = 0;
+    switch ([self stateAt:now]) {
+        case WPRetrySchedulerStateOpen:
+            // Reachability changes wake us up otherwise
+            if (self.networkReachable) wakeTime = self.openUntil;
+            break;
+        case WPRetrySchedulerStateHalfOpen: {
+            if (self.probeInFlight && now - self.probeStartTime < PROBE_TIMEOUT) {
+                wakeTime = self.probeStartTime + PROBE_TIMEOUT;
+                break;
+            }
+            WPRetrySchedulerEntry *first = self.retries.firstObject;
+            if (!first) break;
+            if (first.dueTime <= now) {
+                self.probeInFlight = YES;
+                self.probeStartTime = now;
+                [self fireFirst];
+                wakeTime = now + PROBE_TIMEOUT;
+            } else {
+                wakeTime = first.dueTime;
+            }
+            break;
+        }
+        case WPRetrySchedulerStateClosed:
+            while (self.retries.firstObject && self.retries.firstObject.dueTime <= now) {
+                [self fireFirst];
+            }
+            wakeTime = self.retries.firstObject.dueTime;
+            break;
+    }
+    [self wakeAt:self.retries.count > 0 ? wakeTime : 0];
+}
+
+- (void) wakeAt:(NSTimeInterval)wakeTime
+{
+    if (!self.timer) {
+        self.timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.queue);
+        __weak WPRetryScheduler *weakSelf = self;
+        dispatch_source_set_event_handler(self.timer, ^{
+            [weakSelf process];
+        });
+        // Sources are created suspended
+        self.timerSuspended = YES;
+    }
+    if (wakeTime <= 0) {
+        if (!self.timerSuspended) {
+            dispatch_suspend(self.timer);
+            self.timerSuspended = YES;
+        }
+        return;
+    }
+    int64_t delay = (int64_t)(MAX(0, wakeTime - self.now()) * NSEC_PER_SEC);
+    dispatch_source_set_timer(self.timer, dispatch_time(DISPATCH_TIME_NOW, delay), DISPATCH_TIME_FOREVER, NSEC_PER_SEC / 100);
+    if (self.timerSuspended) {
+        dispatch_resume(self.timer);
+        self.timerSuspended = NO;
+    }
+}
+
+@end
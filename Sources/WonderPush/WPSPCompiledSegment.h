@@ -0,0 +1,41 @@
+//
+//  WPSPCompiledSegment.h
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "WPSPASTCriterionNode.h"
+
+@class WPSPSegmenterData;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A parsed segment lowered into a flat array of instructions.
+
+ Boolean operators become short-circuit jumps, fields are read through their pre-resolved accessors,
+ and constant values are classified at compile time so that evaluating the segment
+ does not need to dispatch through the visitors nor box intermediate results.
+ Evaluation gives the same results as `WPSPInstallationVisitor`.
+ */
+@interface WPSPCompiledSegment : NSObject
+
+/// The number of instructions, for debugging purposes.
+@property (readonly) NSUInteger instructionsCount;
+
+- (instancetype) initWithCriterion:(WPSPASTCriterionNode *)criterion;
+
+- (BOOL) matchesInstallationWithData:(WPSPSegmenterData *)data;
+
+/**
+ Evaluates the segment as of the given server time, in epoch milliseconds.
+ The whole evaluation uses this single time, and resolves each relative date once.
+ */
+- (BOOL) matchesInstallationWithData:(WPSPSegmenterData *)data now:(long long)now;
+
+@end
+
+NS_ASSUME_NONNULL_END
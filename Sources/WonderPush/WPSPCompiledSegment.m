@@ -0,0 +1,820 @@
+//
+//  WPSPCompiledSegment.m
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import "WPSPCompiledSegment.h"
+#import "WPSPSegmenter.h"
+#import "WPSPDataSource.h"
+#import "WPUtil.h"
+#import <WonderPushCommon/WPLog.h>
+#import <WonderPushCommon/WPNSUtil.h>
+#import <WonderPushCommon/WPJsonUtil.h>
+
+typedef NS_ENUM(uint8_t, WPSPOpcode) {
+    WPSPOpcodeFalse,
+    WPSPOpcodeTrue,
+    WPSPOpcodeNot,
+    WPSPOpcodeJump,
+    WPSPOpcodeJumpIfFalse,
+    WPSPOpcodeJumpIfTrue,
+    WPSPOpcodeReturn,
+    WPSPOpcodeEquality,
+    WPSPOpcodeAny,
+    WPSPOpcodeAll,
+    WPSPOpcodeComparison,
+    WPSPOpcodePrefix,
+    WPSPOpcodeInside,
+    WPSPOpcodeHasLastActivityDate,
+    WPSPOpcodeHasGeoLocation,
+    WPSPOpcodePresence,
+    WPSPOpcodeSubscriptionStatus,
+    WPSPOpcodeJoinEvents,
+    WPSPOpcodeJoinInstallation,
+};
+
+typedef struct {
+    WPSPOpcode opcode;
+    int8_t flag; // The comparator, the expected presence or the expected subscription status
+    uint32_t source; // Index in the sources, for opcodes reading values
+    uint32_t operand; // Jump target, sub-program entry point, or index of the first value
+    uint32_t count; // Number of values
+} WPSPInstruction;
+
+typedef NS_ENUM(uint8_t, WPSPSourceKind) {
+    WPSPSourceKindEmpty,
+    WPSPSourceKindField,
+    WPSPSourceKindLastActivityDate,
+    WPSPSourceKindPresenceElapsedTime,
+    WPSPSourceKindPresenceSinceDate,
+    WPSPSourceKindGeoLocation,
+    WPSPSourceKindGeoDate,
+};
+
+typedef struct {
+    WPSPSourceKind kind;
+    BOOL present;
+    __unsafe_unretained WPSPFieldAccessor *accessor; // Retained by the constants
+} WPSPSource;
+
+typedef NS_ENUM(uint8_t, WPSPValueKind) {
+    WPSPValueKindNull,
+    WPSPValueKindBoolean,
+    WPSPValueKindNumber,
+    WPSPValueKindString,
+    WPSPValueKindRelativeDate,
+    WPSPValueKindOther,
+};
+
+/// A number read once out of its NSNumber, compared as an integer when both sides are integers.
+typedef struct {
+    BOOL isInteger;
+    long long integerValue;
+    double doubleValue;
+} WPSPNumber;
+
+typedef struct {
+    WPSPValueKind kind;
+    BOOL boolValue;
+    WPSPNumber number; // What null, boolean and number values compare as
+    uint32_t relativeDate; // Index in the relative dates of the evaluation, for relative dates
+    __unsafe_unretained id object; // Retained by the constants, a WPSPISO8601Duration for relative dates
+} WPSPValue;
+
+/// Constraints of an event join that let it scan only the candidate events, see -[WPSPSegmenterData eventsOfType:typePrefix:campaignId:]
+typedef struct {
+    uint32_t entry; // Sub-program entry point
+    __unsafe_unretained NSString *type; // Retained by the constants, as the following strings
+    __unsafe_unretained NSString *typePrefix;
+    __unsafe_unretained NSString *campaignId;
+    uint32_t minimumCreationDate; // Index of the value events must be created after, or UINT32_MAX
+    BOOL minimumCreationDateInclusive;
+} WPSPEventsJoin;
+
+typedef struct {
+    const WPSPInstruction *instructions;
+    const WPSPSource *sources;
+    const WPSPValue *values;
+    const WPSPEventsJoin *eventsJoins;
+    __unsafe_unretained WPSPSegmenterData *data;
+    long long now; // Server time the whole evaluation uses
+    long long *relativeDates; // Epoch milliseconds of the relative dates, resolved against now once per evaluation
+} WPSPProgram;
+
+#define WPSP_UNRESOLVED_DATE LLONG_MIN
+
+@interface WPSPCompiledSegment () {
+    WPSPProgram _program;
+}
+
+@property (nonatomic, strong) NSMutableData *instructions;
+@property (nonatomic, strong) NSMutableData *sources;
+@property (nonatomic, strong) NSMutableData *values;
+@property (nonatomic, strong) NSMutableData *eventsJoins;
+@property (nonatomic, strong) NSMutableArray *constants;
+@property (nonatomic, assign) NSUInteger relativeDatesCount;
+
+@end
+
+#pragma mark - Evaluation
+
+/// Walks through the values of a data source, skipping nulls and reading dates where needed.
+typedef struct {
+    __unsafe_unretained id values;
+    __unsafe_unretained WPSPFieldAccessor *accessor;
+    NSUInteger index;
+    NSUInteger count;
+    BOOL isArray;
+    BOOL readsDates;
+} WPSPValueIterator;
+
+static inline void WPSPValueIteratorInit(WPSPValueIterator *iterator, id values, WPSPFieldAccessor *accessor) {
+    iterator->values = values;
+    iterator->accessor = accessor;
+    iterator->index = 0;
+    iterator->isArray = [values isKindOfClass:NSArray.class];
+    iterator->count = iterator->isArray ? [(NSArray *)values count] : (values ? 1 : 0);
+    iterator->readsDates = accessor.readsDates;
+}
+
+static id WPSPValueIteratorNext(WPSPValueIterator *iterator) {
+    while (iterator->index < iterator->count) {
+        id item = iterator->isArray ? ((NSArray *)iterator->values)[iterator->index] : iterator->values;
+        iterator->index++;
+        if (item == [NSNull null]) continue;
+        return iterator->readsDates ? [iterator->accessor coerceValue:item] : item;
+    }
+    return nil;
+}
+
+static inline BOOL WPSPHasValues(id values) {
+    WPSPValueIterator iterator;
+    WPSPValueIteratorInit(&iterator, values, nil);
+    return WPSPValueIteratorNext(&iterator) != nil;
+}
+
+static inline WPSPNumber WPSPNumberWithLongLong(long long value) {
+    return (WPSPNumber){ .isInteger = YES, .integerValue = value, .doubleValue = (double)value };
+}
+
+static inline WPSPNumber WPSPNumberWithNumber(NSNumber *number) {
+    const char *type = number.objCType;
+    if (type[0] == 'f' || type[0] == 'd' || (type[0] == 'Q' && number.unsignedLongLongValue > LLONG_MAX)) {
+        return (WPSPNumber){ .isInteger = NO, .doubleValue = number.doubleValue };
+    }
+    return WPSPNumberWithLongLong(number.longLongValue);
+}
+
+static inline NSComparisonResult WPSPNumberCompare(WPSPNumber a, WPSPNumber b) {
+    if (a.isInteger && b.isInteger) {
+        return a.integerValue < b.integerValue ? NSOrderedAscending : a.integerValue > b.integerValue ? NSOrderedDescending : NSOrderedSame;
+    }
+    return a.doubleValue < b.doubleValue ? NSOrderedAscending : a.doubleValue > b.doubleValue ? NSOrderedDescending : NSOrderedSame;
+}
+
+/**
+ Reads the sources holding a single date or duration, without boxing it.
+ Returns NO for the other sources.
+ */
+static BOOL WPSPSourceScalar(const WPSPProgram *program, const WPSPSource *source, long long *scalar) {
+    WPSPSegmenterData *data = program->data;
+    switch (source->kind) {
+        case WPSPSourceKindLastActivityDate:
+            *scalar = data.lastAppOpenDate;
+            return YES;
+        case WPSPSourceKindPresenceElapsedTime: {
+            WPSPSegmenterPresenceInfo *presenceInfo = data.presenceInfo;
+            if (source->present) {
+                *scalar = presenceInfo == nil ? 0 : MAX(0, program->now - presenceInfo.fromDate);
+            } else {
+                *scalar = presenceInfo == nil ? 0 : presenceInfo.elapsedTime;
+            }
+            return YES;
+        }
+        case WPSPSourceKindPresenceSinceDate: {
+            WPSPSegmenterPresenceInfo *presenceInfo = data.presenceInfo;
+            // When presence info is missing, assume the user just got here, and will stay indefinitely
+            if (source->present) {
+                *scalar = presenceInfo == nil ? program->now : presenceInfo.fromDate;
+            } else {
+                *scalar = presenceInfo == nil ? LONG_LONG_MAX : presenceInfo.untilDate;
+            }
+            return YES;
+        }
+        default:
+            return NO;
+    }
+}
+
+static id WPSPSourceValues(const WPSPProgram *program, const WPSPSource *source, id object) {
+    WPSPSegmenterData *data = program->data;
+    long long scalar;
+    if (WPSPSourceScalar(program, source, &scalar)) {
+        return [NSNumber numberWithLongLong:scalar];
+    }
+    switch (source->kind) {
+        case WPSPSourceKindField:
+            return [source->accessor resolveInObject:object];
+        case WPSPSourceKindGeoLocation:
+            return data.geoLocation;
+        case WPSPSourceKindGeoDate:
+            return data.geoDate;
+        default:
+            return nil;
+    }
+}
+
+static long long WPSPRelativeDate(const WPSPProgram *program, const WPSPValue *value) {
+    // The calendar arithmetic is done at most once per evaluation, not once per event
+    long long *relativeDate = program->relativeDates + value->relativeDate;
+    if (*relativeDate == WPSP_UNRESOLVED_DATE) {
+        *relativeDate = [(WPSPISO8601Duration *)value->object applyTo:[NSDate dateWithTimeIntervalSince1970:(program->now / 1000.0)]].timeIntervalSince1970 * 1000;
+    }
+    return *relativeDate;
+}
+
+/// What a null, boolean, number or relative date value compares as.
+static inline WPSPNumber WPSPValueNumber(const WPSPProgram *program, const WPSPValue *value) {
+    if (value->kind == WPSPValueKindRelativeDate) {
+        return WPSPNumberWithLongLong(WPSPRelativeDate(program, value));
+    }
+    return value->number;
+}
+
+static id WPSPValueObject(const WPSPProgram *program, const WPSPValue *value) {
+    switch (value->kind) {
+        case WPSPValueKindNull:
+            return nil;
+        case WPSPValueKindRelativeDate:
+            return [NSNumber numberWithLongLong:WPSPRelativeDate(program, value)];
+        default:
+            return value->object;
+    }
+}
+
+static inline BOOL WPSPIsBoolean(id item) {
+    return [item isKindOfClass:NSNumber.class] && [WPJsonUtil isBoolNumber:item];
+}
+
+static BOOL WPSPEquality(const WPSPProgram *program, id values, WPSPFieldAccessor *accessor, const WPSPValue *expected) {
+    if (expected->kind == WPSPValueKindNull) {
+        return !WPSPHasValues(values);
+    }
+    BOOL expectsNumber = expected->kind == WPSPValueKindNumber || expected->kind == WPSPValueKindRelativeDate;
+    WPSPNumber expectedNumber = expectsNumber ? WPSPValueNumber(program, expected) : expected->number;
+    id expectedObject = expected->object;
+    WPSPValueIterator iterator;
+    WPSPValueIteratorInit(&iterator, values, accessor);
+    id item;
+    while ((item = WPSPValueIteratorNext(&iterator))) {
+        BOOL itemIsBoolean = WPSPIsBoolean(item);
+        if (expected->kind == WPSPValueKindBoolean || itemIsBoolean) {
+            // Booleans only equal booleans, never numbers
+            if (expected->kind == WPSPValueKindBoolean && itemIsBoolean && [(NSNumber *)item boolValue] == expected->boolValue) return YES;
+        } else if (expectsNumber) {
+            if ([item isKindOfClass:NSNumber.class] && WPSPNumberCompare(WPSPNumberWithNumber(item), expectedNumber) == NSOrderedSame) return YES;
+        } else if ([expectedObject isEqual:item]) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+static BOOL WPSPContains(id values, WPSPFieldAccessor *accessor, id expectedObject) {
+    WPSPValueIterator iterator;
+    WPSPValueIteratorInit(&iterator, values, accessor);
+    id item;
+    while ((item = WPSPValueIteratorNext(&iterator))) {
+        if ([expectedObject isEqual:item]) return YES;
+    }
+    return NO;
+}
+
+static BOOL WPSPAny(const WPSPProgram *program, id values, WPSPFieldAccessor *accessor, const WPSPValue *expected, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        id expectedObject = WPSPValueObject(program, expected + i);
+        if (expectedObject == nil) {
+            if (!WPSPHasValues(values)) return YES;
+            continue;
+        }
+        if (WPSPContains(values, accessor, expectedObject)) return YES;
+    }
+    return NO;
+}
+
+static BOOL WPSPAll(const WPSPProgram *program, id values, WPSPFieldAccessor *accessor, const WPSPValue *expected, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        id expectedObject = WPSPValueObject(program, expected + i);
+        BOOL found = expectedObject == nil ? !WPSPHasValues(values) : WPSPContains(values, accessor, expectedObject);
+        if (!found) return NO;
+    }
+    return YES;
+}
+
+/**
+ Compares a number, which is not a boolean, with the expected number, taken as zero if the expected value is null.
+ Returns NO if the types cannot be compared.
+ */
+static inline BOOL WPSPCompareNumber(WPSPNumber number, const WPSPValue *expected, WPSPNumber expectedNumber, NSComparisonResult *result) {
+    if (expected->kind == WPSPValueKindString || expected->kind == WPSPValueKindOther) return NO;
+    *result = WPSPNumberCompare(number, expectedNumber);
+    return YES;
+}
+
+/**
+ Compares a value with the expected value, taking an appropriate zero-value for the latter if it is null.
+ Returns NO if the types cannot be compared.
+ */
+static BOOL WPSPCompare(id item, const WPSPValue *expected, WPSPNumber expectedNumber, NSComparisonResult *result) {
+    if ([item isKindOfClass:NSNumber.class]) {
+        if ([WPJsonUtil isBoolNumber:item]) {
+            BOOL expectedBool;
+            if (expected->kind == WPSPValueKindNull) expectedBool = NO;
+            else if (expected->kind == WPSPValueKindBoolean) expectedBool = expected->boolValue;
+            else return NO;
+            int a = [(NSNumber *)item boolValue] ? 1 : 0;
+            int b = expectedBool ? 1 : 0;
+            *result = a < b ? NSOrderedAscending : a > b ? NSOrderedDescending : NSOrderedSame;
+            return YES;
+        }
+        return WPSPCompareNumber(WPSPNumberWithNumber(item), expected, expectedNumber, result);
+    }
+    if ([item isKindOfClass:NSString.class]) {
+        if (expected->kind == WPSPValueKindNull) {
+            *result = [(NSString *)item compare:@""];
+            return YES;
+        }
+        if (expected->kind == WPSPValueKindString) {
+            *result = [(NSString *)item compare:expected->object];
+            return YES;
+        }
+    }
+    return NO;
+}
+
+static inline BOOL WPSPSatisfies(WPSPComparator comparator, NSComparisonResult comparison) {
+    switch (comparator) {
+        case WPSPComparatorGt:
+            return comparison == NSOrderedDescending;
+        case WPSPComparatorGte:
+            return comparison != NSOrderedAscending;
+        case WPSPComparatorLt:
+            return comparison == NSOrderedAscending;
+        case WPSPComparatorLte:
+            return comparison != NSOrderedDescending;
+    }
+    return NO;
+}
+
+static BOOL WPSPComparison(const WPSPProgram *program, const WPSPSource *source, id object, WPSPComparator comparator, const WPSPValue *expected) {
+    WPSPNumber expectedNumber = WPSPValueNumber(program, expected);
+    NSComparisonResult comparison;
+    long long scalar;
+    if (WPSPSourceScalar(program, source, &scalar)) {
+        return WPSPCompareNumber(WPSPNumberWithLongLong(scalar), expected, expectedNumber, &comparison) && WPSPSatisfies(comparator, comparison);
+    }
+    WPSPValueIterator iterator;
+    WPSPValueIteratorInit(&iterator, WPSPSourceValues(program, source, object), source->accessor);
+    id item;
+    while ((item = WPSPValueIteratorNext(&iterator))) {
+        if (WPSPCompare(item, expected, expectedNumber, &comparison) && WPSPSatisfies(comparator, comparison)) return YES;
+    }
+    return NO;
+}
+
+static BOOL WPSPPrefix(id values, WPSPFieldAccessor *accessor, const WPSPValue *expected) {
+    if (expected->kind != WPSPValueKindString) return NO;
+    NSString *prefix = expected->object;
+    WPSPValueIterator iterator;
+    WPSPValueIteratorInit(&iterator, values, accessor);
+    id item;
+    while ((item = WPSPValueIteratorNext(&iterator))) {
+        if (![item isKindOfClass:NSString.class]) {
+            WPLog(@"[prefix] value %@ is not a string", item);
+            continue;
+        }
+        if ([(NSString *)item hasPrefix:prefix]) return YES;
+    }
+    return NO;
+}
+
+static BOOL WPSPInside(id values, WPSPFieldAccessor *accessor, const WPSPValue *area) {
+    if (![area->object conformsToProtocol:@protocol(WPSPGeoArea)]) return NO;
+    WPSPValueIterator iterator;
+    WPSPValueIteratorInit(&iterator, values, accessor);
+    id item;
+    while ((item = WPSPValueIteratorNext(&iterator))) {
+        WPSPGeoLocation *location = [WPSPGeoLocation locationFromValue:item];
+        if (location && [(id<WPSPGeoArea>)area->object containsLocation:location]) return YES;
+    }
+    return NO;
+}
+
+static BOOL WPSPPresence(const WPSPProgram *program, BOOL expectedPresent) {
+    WPSPSegmenterPresenceInfo *presenceInfo = program->data.presenceInfo;
+    BOOL present = presenceInfo == nil || (presenceInfo.untilDate >= program->now && presenceInfo.fromDate <= program->now);
+    return present == expectedPresent;
+}
+
+static BOOL WPSPSubscriptionStatus(WPSPSegmenterData *data, WPSPSubscriptionStatus expectedStatus) {
+    NSDictionary *installation = data.installation;
+    NSString *pushTokenData = [WPNSUtil stringForKey:@"data" inDictionary:[WPNSUtil dictionaryForKey:@"pushToken" inDictionary:installation]];
+    BOOL hasPushToken = [pushTokenData isKindOfClass:NSString.class] && [(NSString *)pushTokenData length] > 0;
+    NSString *preferencesSubscriptionStatus = [WPNSUtil stringForKey:@"subscriptionStatus" inDictionary:[WPNSUtil dictionaryForKey:@"preferences" inDictionary:installation]];
+    WPSPSubscriptionStatus actualStatus;
+    if (!hasPushToken) {
+        actualStatus = WPSPSubscriptionStatusOptOut;
+    } else if ([@"optOut" isEqual:preferencesSubscriptionStatus]) {
+        actualStatus = WPSPSubscriptionStatusSoftOptOut;
+    } else {
+        actualStatus = WPSPSubscriptionStatusOptIn;
+    }
+    return actualStatus == expectedStatus;
+}
+
+static BOOL WPSPRun(const WPSPProgram *program, uint32_t pc, id object);
+
+static BOOL WPSPJoinEvents(const WPSPProgram *program, const WPSPEventsJoin *join) {
+    NSArray<NSDictionary *> *events = [program->data eventsOfType:join->type typePrefix:join->typePrefix campaignId:join->campaignId];
+    BOOL hasMinimumCreationDate = join->minimumCreationDate != UINT32_MAX;
+    WPSPNumber minimumCreationDate = hasMinimumCreationDate ? WPSPValueNumber(program, program->values + join->minimumCreationDate) : WPSPNumberWithLongLong(0);
+    for (NSDictionary *event in events) {
+        if (hasMinimumCreationDate) {
+            // Events come most recent first, none of the remaining ones can match
+            NSNumber *creationDate = [WPSPSegmenterData creationDateOfEvent:event];
+            if (creationDate) {
+                NSComparisonResult comparison = WPSPNumberCompare(WPSPNumberWithNumber(creationDate), minimumCreationDate);
+                if (comparison == NSOrderedAscending || (comparison == NSOrderedSame && !join->minimumCreationDateInclusive)) break;
+            }
+        }
+        if (WPSPRun(program, join->entry, event)) return YES;
+    }
+    return NO;
+}
+
+static BOOL WPSPRun(const WPSPProgram *program, uint32_t pc, id object) {
+    BOOL result = NO;
+    while (YES) {
+        const WPSPInstruction *instruction = program->instructions + pc++;
+        switch (instruction->opcode) {
+            case WPSPOpcodeFalse:
+                result = NO;
+                break;
+            case WPSPOpcodeTrue:
+                result = YES;
+                break;
+            case WPSPOpcodeNot:
+                result = !result;
+                break;
+            case WPSPOpcodeJump:
+                pc = instruction->operand;
+                break;
+            case WPSPOpcodeJumpIfFalse:
+                if (!result) pc = instruction->operand;
+                break;
+            case WPSPOpcodeJumpIfTrue:
+                if (result) pc = instruction->operand;
+                break;
+            case WPSPOpcodeReturn:
+                return result;
+            case WPSPOpcodeEquality:
+            case WPSPOpcodeAny:
+            case WPSPOpcodeAll:
+            case WPSPOpcodeComparison:
+            case WPSPOpcodePrefix:
+            case WPSPOpcodeInside: {
+                const WPSPSource *source = program->sources + instruction->source;
+                const WPSPValue *expected = program->values + instruction->operand;
+                if (instruction->opcode == WPSPOpcodeComparison) {
+                    // Reads its source itself, to compare dates and durations without boxing them
+                    result = WPSPComparison(program, source, object, (WPSPComparator)instruction->flag, expected);
+                    break;
+                }
+                id values = WPSPSourceValues(program, source, object);
+                switch (instruction->opcode) {
+                    case WPSPOpcodeEquality:
+                        result = WPSPEquality(program, values, source->accessor, expected);
+                        break;
+                    case WPSPOpcodeAny:
+                        result = WPSPAny(program, values, source->accessor, expected, instruction->count);
+                        break;
+                    case WPSPOpcodeAll:
+                        result = WPSPAll(program, values, source->accessor, expected, instruction->count);
+                        break;
+                    case WPSPOpcodePrefix:
+                        result = WPSPPrefix(values, source->accessor, expected);
+                        break;
+                    default:
+                        result = WPSPInside(values, source->accessor, expected);
+                        break;
+                }
+                break;
+            }
+            case WPSPOpcodeHasLastActivityDate:
+                result = program->data.lastAppOpenDate > 0;
+                break;
+            case WPSPOpcodeHasGeoLocation:
+                result = program->data.geoLocation != nil;
+                break;
+            case WPSPOpcodePresence:
+                result = WPSPPresence(program, instruction->flag != 0);
+                break;
+            case WPSPOpcodeSubscriptionStatus:
+                result = WPSPSubscriptionStatus(program->data, (WPSPSubscriptionStatus)instruction->flag);
+                break;
+            case WPSPOpcodeJoinEvents:
+                result = WPSPJoinEvents(program, program->eventsJoins + instruction->operand);
+                break;
+            case WPSPOpcodeJoinInstallation:
+                result = WPSPRun(program, instruction->operand, program->data.installation);
+                break;
+        }
+    }
+}
+
+@implementation WPSPCompiledSegment
+
+- (instancetype) initWithCriterion:(WPSPASTCriterionNode *)criterion {
+    if (self = [super init]) {
+        _instructions = [NSMutableData new];
+        _sources = [NSMutableData new];
+        _values = [NSMutableData new];
+        _eventsJoins = [NSMutableData new];
+        _constants = [NSMutableArray new];
+        [self compileCriterion:criterion];
+        [self emit:WPSPOpcodeReturn];
+        // Nothing gets appended anymore, the buffers will not move
+        _program.instructions = self.instructions.bytes;
+        _program.sources = self.sources.bytes;
+        _program.values = self.values.bytes;
+        _program.eventsJoins = self.eventsJoins.bytes;
+    }
+    return self;
+}
+
+- (NSUInteger) instructionsCount {
+    return self.instructions.length / sizeof(WPSPInstruction);
+}
+
+- (BOOL) matchesInstallationWithData:(WPSPSegmenterData *)data {
+    return [self matchesInstallationWithData:data now:[WPUtil getServerDate]];
+}
+
+- (BOOL) matchesInstallationWithData:(WPSPSegmenterData *)data now:(long long)now {
+    NSMutableData *relativeDates = [NSMutableData dataWithLength:self.relativeDatesCount * sizeof(long long)];
+    WPSPProgram program = _program;
+    program.data = data;
+    program.now = now;
+    program.relativeDates = relativeDates.mutableBytes;
+    for (NSUInteger i = 0; i < self.relativeDatesCount; i++) {
+        program.relativeDates[i] = WPSP_UNRESOLVED_DATE;
+    }
+    return WPSPRun(&program, 0, data.installation);
+}
+
+#pragma mark - Compilation
+
+- (uint32_t) emitInstruction:(WPSPInstruction)instruction {
+    uint32_t index = (uint32_t)self.instructionsCount;
+    [self.instructions appendBytes:&instruction length:sizeof(instruction)];
+    return index;
+}
+
+- (uint32_t) emit:(WPSPOpcode)opcode {
+    WPSPInstruction instruction = { .opcode = opcode };
+    return [self emitInstruction:instruction];
+}
+
+/// Makes the given jump instruction target the next instruction to be emitted.
+- (void) patchJump:(uint32_t)index {
+    ((WPSPInstruction *)self.instructions.mutableBytes)[index].operand = (uint32_t)self.instructionsCount;
+}
+
+- (void) compileCriterion:(WPSPASTCriterionNode *)node {
+    if ([node isKindOfClass:WPSPMatchAllCriterionNode.class]) {
+        [self emit:WPSPOpcodeTrue];
+    } else if ([node isKindOfClass:WPSPAndCriterionNode.class] || [node isKindOfClass:WPSPOrCriterionNode.class]) {
+        BOOL isAnd = [node isKindOfClass:WPSPAndCriterionNode.class];
+        NSArray<WPSPASTCriterionNode *> *children = isAnd ? ((WPSPAndCriterionNode *)node).children : ((WPSPOrCriterionNode *)node).children;
+        if (children.count == 0) {
+            [self emit:isAnd ? WPSPOpcodeTrue : WPSPOpcodeFalse];
+            return;
+        }
+        NSMutableArray<NSNumber *> *jumps = [NSMutableArray new];
+        for (NSUInteger i = 0; i < children.count; i++) {
+            if (i > 0) [jumps addObject:@([self emit:isAnd ? WPSPOpcodeJumpIfFalse : WPSPOpcodeJumpIfTrue])];
+            [self compileCriterion:children[i]];
+        }
+        for (NSNumber *jump in jumps) [self patchJump:jump.unsignedIntValue];
+    } else if ([node isKindOfClass:WPSPNotCriterionNode.class]) {
+        [self compileCriterion:((WPSPNotCriterionNode *)node).child];
+        [self emit:WPSPOpcodeNot];
+    } else if ([node isKindOfClass:WPSPEqualityCriterionNode.class]) {
+        [self compileLeaf:WPSPOpcodeEquality node:node flag:0 values:@[((WPSPEqualityCriterionNode *)node).value]];
+    } else if ([node isKindOfClass:WPSPAnyCriterionNode.class]) {
+        [self compileLeaf:WPSPOpcodeAny node:node flag:0 values:((WPSPAnyCriterionNode *)node).values];
+    } else if ([node isKindOfClass:WPSPAllCriterionNode.class]) {
+        [self compileLeaf:WPSPOpcodeAll node:node flag:0 values:((WPSPAllCriterionNode *)node).values];
+    } else if ([node isKindOfClass:WPSPComparisonCriterionNode.class]) {
+        WPSPComparisonCriterionNode *comparisonNode = (WPSPComparisonCriterionNode *)node;
+        [self compileLeaf:WPSPOpcodeComparison node:node flag:(int8_t)comparisonNode.comparator values:@[comparisonNode.value]];
+    } else if ([node isKindOfClass:WPSPPrefixCriterionNode.class]) {
+        [self compileLeaf:WPSPOpcodePrefix node:node flag:0 values:@[((WPSPPrefixCriterionNode *)node).value]];
+    } else if ([node isKindOfClass:WPSPLastActivityDateCriterionNode.class]) {
+        WPSPASTCriterionNode *dateComparison = ((WPSPLastActivityDateCriterionNode *)node).dateComparison;
+        if (dateComparison) {
+            [self compileCriterion:dateComparison];
+        } else {
+            [self emit:WPSPOpcodeHasLastActivityDate];
+        }
+    } else if ([node isKindOfClass:WPSPPresenceCriterionNode.class]) {
+        WPSPPresenceCriterionNode *presenceNode = (WPSPPresenceCriterionNode *)node;
+        WPSPInstruction presence = { .opcode = WPSPOpcodePresence, .flag = presenceNode.present ? 1 : 0 };
+        [self emitInstruction:presence];
+        uint32_t elapsedTimeJump = 0, sinceDateJump = 0;
+        if (presenceNode.elapsedTimeComparison) {
+            elapsedTimeJump = [self emit:WPSPOpcodeJumpIfFalse];
+            [self compileCriterion:presenceNode.elapsedTimeComparison];
+        }
+        if (presenceNode.sinceDateComparison) {
+            sinceDateJump = [self emit:WPSPOpcodeJumpIfFalse];
+            [self compileCriterion:presenceNode.sinceDateComparison];
+        }
+        if (presenceNode.elapsedTimeComparison) [self patchJump:elapsedTimeJump];
+        if (presenceNode.sinceDateComparison) [self patchJump:sinceDateJump];
+    } else if ([node isKindOfClass:WPSPGeoCriterionNode.class]) {
+        WPSPGeoCriterionNode *geoNode = (WPSPGeoCriterionNode *)node;
+        [self emit:WPSPOpcodeHasGeoLocation];
+        uint32_t locationJump = 0, dateJump = 0;
+        if (geoNode.locationComparison) {
+            locationJump = [self emit:WPSPOpcodeJumpIfFalse];
+            [self compileCriterion:geoNode.locationComparison];
+        }
+        if (geoNode.dateComparison) {
+            dateJump = [self emit:WPSPOpcodeJumpIfFalse];
+            [self compileCriterion:geoNode.dateComparison];
+        }
+        if (geoNode.locationComparison) [self patchJump:locationJump];
+        if (geoNode.dateComparison) [self patchJump:dateJump];
+    } else if ([node isKindOfClass:WPSPInsideCriterionNode.class]) {
+        [self compileLeaf:WPSPOpcodeInside node:node flag:0 values:@[((WPSPInsideCriterionNode *)node).value]];
+    } else if ([node isKindOfClass:WPSPSubscriptionStatusCriterionNode.class]) {
+        WPSPInstruction subscriptionStatus = { .opcode = WPSPOpcodeSubscriptionStatus, .flag = (int8_t)((WPSPSubscriptionStatusCriterionNode *)node).subscriptionStatus };
+        [self emitInstruction:subscriptionStatus];
+    } else if ([node isKindOfClass:WPSPJoinCriterionNode.class]) {
+        WPSPDataSource *dataSource = node.context.dataSource;
+        WPSPOpcode opcode;
+        if ([dataSource isKindOfClass:WPSPEventSource.class]) {
+            opcode = WPSPOpcodeJoinEvents;
+        } else if ([dataSource isKindOfClass:WPSPInstallationSource.class]) {
+            opcode = WPSPOpcodeJoinInstallation;
+        } else {
+            WPLog(@"Unsupported join on %@", NSStringFromClass(dataSource.class));
+            [self emit:WPSPOpcodeFalse];
+            return;
+        }
+        // The child is a sub-program run against each joined object, placed inline and jumped over
+        WPSPASTCriterionNode *child = ((WPSPJoinCriterionNode *)node).child;
+        uint32_t join;
+        uint32_t eventsJoin = 0;
+        if (opcode == WPSPOpcodeJoinEvents) {
+            eventsJoin = [self addEventsJoin:child];
+            WPSPInstruction joinEvents = { .opcode = opcode, .operand = eventsJoin };
+            join = [self emitInstruction:joinEvents];
+        } else {
+            join = [self emit:opcode];
+        }
+        uint32_t skip = [self emit:WPSPOpcodeJump];
+        if (opcode == WPSPOpcodeJoinEvents) {
+            ((WPSPEventsJoin *)self.eventsJoins.mutableBytes)[eventsJoin].entry = (uint32_t)self.instructionsCount;
+        } else {
+            [self patchJump:join];
+        }
+        [self compileCriterion:child];
+        [self emit:WPSPOpcodeReturn];
+        [self patchJump:skip];
+    } else if ([node isKindOfClass:WPSPASTUnknownCriterionNode.class]) {
+        WPSPASTUnknownCriterionNode *unknownNode = (WPSPASTUnknownCriterionNode *)node;
+        WPLog(@"Unsupported unknown criterion %@ with value %@", unknownNode.key, unknownNode.value);
+        [self emit:WPSPOpcodeFalse];
+    } else {
+        WPLog(@"Unsupported criterion %@", NSStringFromClass(node.class));
+        [self emit:WPSPOpcodeFalse];
+    }
+}
+
+- (void) compileLeaf:(WPSPOpcode)opcode node:(WPSPASTCriterionNode *)node flag:(int8_t)flag values:(NSArray<WPSPASTValueNode *> *)valueNodes {
+    WPSPInstruction instruction = {
+        .opcode = opcode,
+        .flag = flag,
+        .source = [self addSource:node.context.dataSource],
+        .operand = (uint32_t)(self.values.length / sizeof(WPSPValue)),
+        .count = (uint32_t)valueNodes.count,
+    };
+    for (WPSPASTValueNode *valueNode in valueNodes) {
+        [self addValue:valueNode];
+    }
+    [self emitInstruction:instruction];
+}
+
+- (uint32_t) addSource:(WPSPDataSource *)dataSource {
+    WPSPSource source = { .kind = WPSPSourceKindEmpty };
+    if ([dataSource isKindOfClass:WPSPFieldSource.class]) {
+        source.kind = WPSPSourceKindField;
+        source.accessor = ((WPSPFieldSource *)dataSource).accessor;
+        [self.constants addObject:source.accessor];
+    } else if ([dataSource isKindOfClass:WPSPLastActivityDateSource.class]) {
+        source.kind = WPSPSourceKindLastActivityDate;
+    } else if ([dataSource isKindOfClass:WPSPPresenceElapsedTimeSource.class]) {
+        source.kind = WPSPSourceKindPresenceElapsedTime;
+        source.present = ((WPSPPresenceElapsedTimeSource *)dataSource).present;
+    } else if ([dataSource isKindOfClass:WPSPPresenceSinceDateSource.class]) {
+        source.kind = WPSPSourceKindPresenceSinceDate;
+        source.present = ((WPSPPresenceSinceDateSource *)dataSource).present;
+    } else if ([dataSource isKindOfClass:WPSPGeoLocationSource.class]) {
+        source.kind = WPSPSourceKindGeoLocation;
+    } else if ([dataSource isKindOfClass:WPSPGeoDateSource.class]) {
+        source.kind = WPSPSourceKindGeoDate;
+    }
+    uint32_t index = (uint32_t)(self.sources.length / sizeof(WPSPSource));
+    [self.sources appendBytes:&source length:sizeof(source)];
+    return index;
+}
+
+/**
+ Looks for constraints on the type, campaign id and creation date of the joined events
+ among the criteria that must all hold.
+ They are left in the sub-program, so that they only narrow down the events to scan.
+ */
+- (uint32_t) addEventsJoin:(WPSPASTCriterionNode *)child {
+    WPSPEventsJoin join = { .minimumCreationDate = UINT32_MAX };
+    NSArray<WPSPASTCriterionNode *> *criteria = [child isKindOfClass:WPSPAndCriterionNode.class] ? ((WPSPAndCriterionNode *)child).children : @[child];
+    for (WPSPASTCriterionNode *criterion in criteria) {
+        WPSPDataSource *dataSource = criterion.context.dataSource;
+        if (![dataSource isKindOfClass:WPSPFieldSource.class]) continue;
+        NSArray<NSString *> *parts = ((WPSPFieldSource *)dataSource).accessor.path.parts;
+        if (parts.count != 1) continue;
+        NSString *field = parts[0];
+        if ([criterion isKindOfClass:WPSPEqualityCriterionNode.class]) {
+            WPSPASTValueNode *valueNode = ((WPSPEqualityCriterionNode *)criterion).value;
+            if (![valueNode isKindOfClass:WPSPStringValueNode.class]) continue;
+            if ([@"type" isEqualToString:field]) {
+                join.type = valueNode.value;
+                [self.constants addObject:join.type];
+            } else if ([@"campaignId" isEqualToString:field]) {
+                join.campaignId = valueNode.value;
+                [self.constants addObject:join.campaignId];
+            }
+        } else if ([criterion isKindOfClass:WPSPPrefixCriterionNode.class] && [@"type" isEqualToString:field]) {
+            join.typePrefix = ((WPSPPrefixCriterionNode *)criterion).value.value;
+            [self.constants addObject:join.typePrefix];
+        } else if ([criterion isKindOfClass:WPSPComparisonCriterionNode.class] && [@"creationDate" isEqualToString:field]) {
+            WPSPComparisonCriterionNode *comparison = (WPSPComparisonCriterionNode *)criterion;
+            if (comparison.comparator != WPSPComparatorGt && comparison.comparator != WPSPComparatorGte) continue;
+            uint32_t index = [self addValue:comparison.value];
+            WPSPValueKind kind = ((const WPSPValue *)self.values.bytes)[index].kind;
+            if (kind != WPSPValueKindNumber && kind != WPSPValueKindRelativeDate) continue;
+            join.minimumCreationDate = index;
+            join.minimumCreationDateInclusive = comparison.comparator == WPSPComparatorGte;
+        }
+    }
+    uint32_t index = (uint32_t)(self.eventsJoins.length / sizeof(WPSPEventsJoin));
+    [self.eventsJoins appendBytes:&join length:sizeof(join)];
+    return index;
+}
+
+- (uint32_t) addValue:(WPSPASTValueNode *)valueNode {
+    WPSPValue value = { .kind = WPSPValueKindOther, .number = { .isInteger = YES } };
+    id object = valueNode.value;
+    if ([valueNode isKindOfClass:WPSPRelativeDateValueNode.class]) {
+        value.kind = WPSPValueKindRelativeDate;
+        value.relativeDate = (uint32_t)self.relativeDatesCount++;
+        object = ((WPSPRelativeDateValueNode *)valueNode).duration;
+    } else if ([valueNode isKindOfClass:WPSPASTUnknownValueNode.class]) {
+        WPLog(@"Unsupported unknown value of type %@ with value %@", ((WPSPASTUnknownValueNode *)valueNode).key, object);
+        value.kind = WPSPValueKindNull;
+        object = nil;
+    } else if (object == nil || object == [NSNull null]) {
+        value.kind = WPSPValueKindNull;
+        object = nil;
+    } else if (WPSPIsBoolean(object)) {
+        value.kind = WPSPValueKindBoolean;
+        value.boolValue = [(NSNumber *)object boolValue];
+        value.number = WPSPNumberWithLongLong(value.boolValue ? 1 : 0);
+    } else if ([object isKindOfClass:NSNumber.class]) {
+        value.kind = WPSPValueKindNumber;
+        value.number = WPSPNumberWithNumber(object);
+    } else if ([object isKindOfClass:NSString.class]) {
+        value.kind = WPSPValueKindString;
+    }
+    if (object) [self.constants addObject:object];
+    value.object = object;
+    uint32_t index = (uint32_t)(self.values.length / sizeof(WPSPValue));
+    [self.values appendBytes:&value length:sizeof(value)];
+    return index;
+}
+
+@end
@@ -35,6 +35,8 @@ NS_ASSUME_NONNULL_BEGIN
 
 @interface WPSPFieldSource : WPSPDataSource
 @property (nonnull, readonly) WPSPFieldPath *path;
+/// Reads the full path of this field, resolved once at parse time.
+@property (nonnull, readonly) WPSPFieldAccessor *accessor;
 
 - (instancetype) initWithParent:(WPSPDataSource *)parent fieldPath:(WPSPFieldPath *)path;
 - (WPSPFieldPath *)fullPath;
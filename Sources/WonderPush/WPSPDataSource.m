@@ -83,6 +83,13 @@
 - (instancetype)initWithParent:(WPSPDataSource *)parent fieldPath:(WPSPFieldPath *)path {
     if (self = [super initWithParent:parent]) {
         _path = path;
+        NSArray <NSString *> *parts = path.parts;
+        for (WPSPDataSource *currentDataSource = parent; currentDataSource; currentDataSource = currentDataSource.parent) {
+            if ([currentDataSource isKindOfClass:WPSPFieldSource.class]) {
+                parts = [((WPSPFieldSource *)currentDataSource).path.parts arrayByAddingObjectsFromArray:parts];
+            }
+        }
+        _accessor = [[WPSPFieldAccessor alloc] initWithPath:[[WPSPFieldPath alloc] initWithParts:parts]];
     }
     return self;
 }
@@ -96,16 +103,7 @@
 }
 
 - (WPSPFieldPath *)fullPath {
-    WPSPDataSource *currentDataSource = self;
-    NSArray <NSString *> *parts = [NSArray new];
-    while (currentDataSource) {
-        if ([currentDataSource isKindOfClass:WPSPFieldSource.class]) {
-            WPSPFieldSource *currentFieldSource = (WPSPFieldSource *)currentDataSource;
-            parts = [currentFieldSource.path.parts arrayByAddingObjectsFromArray:parts];
-        }
-        currentDataSource = currentDataSource.parent;
-    }
-    return [[WPSPFieldPath alloc] initWithParts:parts];
+    return self.accessor.path;
 }
 @end
 
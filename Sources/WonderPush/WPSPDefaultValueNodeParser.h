@@ -12,7 +12,13 @@ NS_ASSUME_NONNULL_BEGIN
 
 @interface WPSPDefaultValueNodeParser : WPSPConfigurableValueNodeParser
 
-+ (NSDate * _Nullable) parseAbsoluteDate:(NSString *)input;
+/**
+ Reads an absolute ISO 8601 date like `2020-01-31T12:34:56.789+01:00` as milliseconds since epoch.
+ Trailing parts can be omitted down to the year, and default to the start of the period. A missing offset means UTC.
+ Returns NO if the input is not such a date, including when it only looks like one, like `2021-02-29` or `2020-13`.
+ Segment values are then rejected with a `WPSPBadInputException`, whereas data values are kept as strings.
+ */
++ (BOOL) parseAbsoluteDate:(NSString *)input epochMs:(long long *)epochMs;
 
 @end
 
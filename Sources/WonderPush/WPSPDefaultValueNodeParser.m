@@ -14,6 +14,110 @@
 #import "WPSPGeoPolygon.h"
 #import <WonderPushCommon/WPJsonUtil.h>
 
+// The longest absolute date accepted: "YYYY-MM-DDTHH:MM:SS.sss+HH:MM:SS.sss"
+#define ABSOLUTE_DATE_MAX_LENGTH 36
+
+/// Reads exactly `count` ASCII digits.
+static inline BOOL WPSPScanDigits(const unichar *chars, NSUInteger length, NSUInteger *pos, int count, int *value) {
+    if (*pos + count > length) return NO;
+    int result = 0;
+    for (int i = 0; i < count; i++) {
+        unichar c = chars[*pos + i];
+        if (c < '0' || c > '9') return NO;
+        result = result * 10 + (c - '0');
+    }
+    *pos += count;
+    *value = result;
+    return YES;
+}
+
+/// Reads a separator followed by exactly `count` ASCII digits. A 0 separator stands for any character but a line terminator.
+static inline BOOL WPSPScanSeparatedDigits(const unichar *chars, NSUInteger length, NSUInteger *pos, unichar separator, int count, int *value) {
+    if (*pos >= length) return NO;
+    unichar c = chars[*pos];
+    if (separator ? c != separator : (c == '\n' || c == '\r' || c == 0x85 || c == 0x2028 || c == 0x2029)) return NO;
+    NSUInteger next = *pos + 1;
+    if (!WPSPScanDigits(chars, length, &next, count, value)) return NO;
+    *pos = next;
+    return YES;
+}
+
+/// Reads the optional time and offset that must end the input, starting at `pos`.
+static BOOL WPSPScanTimeAndOffset(const unichar *chars, NSUInteger length, NSUInteger pos, int *hour, int *minute, int *second, int *millisecond, int *offsetMinutes) {
+    *hour = *minute = *second = *millisecond = *offsetMinutes = 0;
+    if (pos < length && chars[pos] == 'T') {
+        pos++;
+        if (!WPSPScanDigits(chars, length, &pos, 2, hour)) return NO;
+        if (WPSPScanSeparatedDigits(chars, length, &pos, ':', 2, minute)
+            && WPSPScanSeparatedDigits(chars, length, &pos, ':', 2, second)) {
+            WPSPScanSeparatedDigits(chars, length, &pos, 0, 3, millisecond);
+        }
+    }
+    if (pos < length && chars[pos] == 'Z') {
+        pos++;
+    } else if (pos < length && (chars[pos] == '+' || chars[pos] == '-')) {
+        int sign = chars[pos] == '-' ? -1 : 1;
+        pos++;
+        int hours, minutes = 0, ignored;
+        if (!WPSPScanDigits(chars, length, &pos, 2, &hours)) return NO;
+        // Offset seconds are accepted but ignored
+        if (WPSPScanSeparatedDigits(chars, length, &pos, ':', 2, &minutes)
+            && WPSPScanSeparatedDigits(chars, length, &pos, ':', 2, &ignored)) {
+            WPSPScanSeparatedDigits(chars, length, &pos, 0, 3, &ignored);
+        }
+        if (hours > 23 || minutes > 59) return NO;
+        *offsetMinutes = sign * (hours * 60 + minutes);
+    }
+    return pos == length;
+}
+
+static inline int WPSPDaysInMonth(int year, int month) {
+    static const int daysInMonth[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)) return 29;
+    return daysInMonth[month - 1];
+}
+
+/// Days since 1970-01-01 in the proleptic Gregorian calendar, see http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+static long long WPSPDaysFromCivil(long long year, int month, int day) {
+    year -= month <= 2;
+    long long era = (year >= 0 ? year : year - 399) / 400;
+    long long yearOfEra = year - era * 400;
+    long long dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+/**
+ Reads `YYYY[-MM[-DD]][THH[:MM[:SS[.sss]]]][Z|(+|-)HH[:MM[:SS[.sss]]]]` in a single pass.
+ Missing parts default to the start of the period, and a missing offset means UTC.
+ */
+static BOOL WPSPParseAbsoluteDate(const unichar *chars, NSUInteger length, long long *epochMs) {
+    NSUInteger pos = 0;
+    int year, month = 1, day = 1;
+    if (!WPSPScanDigits(chars, length, &pos, 4, &year)) return NO;
+    NSUInteger ends[3] = { pos, 0, 0 };
+    int parts = 1;
+    if (WPSPScanSeparatedDigits(chars, length, &pos, '-', 2, &month)) {
+        ends[parts++] = pos;
+        if (WPSPScanSeparatedDigits(chars, length, &pos, '-', 2, &day)) {
+            ends[parts++] = pos;
+        }
+    }
+    // "2020-05:30" is a year followed by an offset, back off to shorter dates until the rest can be read
+    int hour, minute, second, millisecond, offsetMinutes;
+    while (!WPSPScanTimeAndOffset(chars, length, ends[parts - 1], &hour, &minute, &second, &millisecond, &offsetMinutes)) {
+        if (--parts == 0) return NO;
+    }
+    if (parts < 3) day = 1;
+    if (parts < 2) month = 1;
+
+    if (year < 1 || month < 1 || month > 12 || day < 1 || day > WPSPDaysInMonth(year, month)) return NO;
+    if (hour > 23 || minute > 59 || second > 59) return NO;
+    long long minutes = (WPSPDaysFromCivil(year, month, day) * 24 + hour) * 60 + minute - offsetMinutes;
+    *epochMs = minutes * 60000 + second * 1000 + millisecond;
+    return YES;
+}
+
 @implementation WPSPDefaultValueNodeParser
 
 + (NSDictionary<NSString *, NSNumber *> * _Nonnull) humanReadableUnitToMs {
@@ -74,15 +178,6 @@
     return rtn;
 }
 
-+ (NSRegularExpression *) absoluteDateRegularExpression {
-    static NSRegularExpression *rtn = nil;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        rtn = [[NSRegularExpression alloc] initWithPattern:@"^([0-9][0-9][0-9][0-9](?:-[0-9][0-9](?:-[0-9][0-9])?)?)(?:T([0-9][0-9](?::[0-9][0-9](?::[0-9][0-9](?:.[0-9][0-9][0-9])?)?)?))?(Z|[+-][0-9][0-9](?::[0-9][0-9](?::[0-9][0-9](?:.[0-9][0-9][0-9])?)?)?)?$" options:0 error:nil];
-    });
-    return rtn;
-}
-
 + (NSRegularExpression *) humanReadableDurationRegularExpression {
     static NSRegularExpression *rtn = nil;
     static dispatch_once_t onceToken;
@@ -118,51 +213,24 @@
                 return [[WPSPRelativeDateValueNode alloc] initWithContext:context duration:duration];
             }
             // Detect absolute dates
-            // We're not try/catching here as we want the BadInputException to bubble up
-            NSDate *parsed = [self parseAbsoluteDate:stringValue];
-            if (parsed) {
-                NSNumber *msSince1970 = [NSNumber numberWithDouble:parsed.timeIntervalSince1970 * 1000.0];
-                return [[WPSPDateValueNode alloc] initWithContext:context value:msSince1970];
+            long long epochMs;
+            if ([self parseAbsoluteDate:stringValue epochMs:&epochMs]) {
+                return [[WPSPDateValueNode alloc] initWithContext:context value:[NSNumber numberWithLongLong:epochMs]];
             }
+            // Including those that look like dates but do not exist, like "2021-02-29" or "2020-13"
+            @throw [[WPSPBadInputException alloc] initWithReason:[NSString stringWithFormat:@"\"%@\" string values expect a valid date", key]];
         }
         
         @throw [WPSPBadInputException new];
     };
 }
 
-+ (NSDate * _Nullable) parseAbsoluteDate:(NSString *)input {
-    NSArray <NSTextCheckingResult *> *matches = [self.absoluteDateRegularExpression
-                                                 matchesInString:input
-                                                 options:0
-                                                 range:NSMakeRange(0, input.length)];
-    if (!matches.count) return nil;
-    if (matches.count != 1) {
-        @throw [WPSPBadInputException new]; // There should be exactly one match
-    }
-    NSTextCheckingResult *match = matches.firstObject;
-    NSString *date = [match rangeAtIndex:1].location == NSNotFound ? @"" : [input substringWithRange:[match rangeAtIndex:1]];
-    NSString *time = [match rangeAtIndex:2].location == NSNotFound ? @"" : [input substringWithRange:[match rangeAtIndex:2]];
-    NSString *offset = [match rangeAtIndex:3].location == NSNotFound ? @"" : [input substringWithRange:[match rangeAtIndex:3]];
-    
-    // Fill parts to default unspecified items
-    date = [date stringByAppendingString:[@"1970-01-01" substringFromIndex:date.length]];
-    time = [time stringByAppendingString:[@"00:00:00.000" substringFromIndex:time.length]];
-    if ([@"Z" isEqualToString:offset]) offset = @"";
-    offset = [offset stringByAppendingString:[@"+00:00.000" substringFromIndex:offset.length]];
-    offset = [[offset substringWithRange:NSMakeRange(0, 6)] stringByReplacingOccurrencesOfString:@":" withString:@""];
-    
-    // Create fully specified date
-    NSString *str = [date stringByAppendingFormat:@"T%@%@", time, offset];
-    static NSDateFormatter* dateFormat = nil;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        dateFormat = [NSDateFormatter new];
-        [dateFormat setDateFormat:@"yyyy-MM-dd'T'HH:mm:ss.SSSZ"];
-    });
-
-    NSDate *result = [dateFormat dateFromString:str];
-    if (!result) @throw [WPSPBadInputException new];
-    return result;
++ (BOOL) parseAbsoluteDate:(NSString *)input epochMs:(long long *)epochMs {
+    NSUInteger length = input.length;
+    if (length > ABSOLUTE_DATE_MAX_LENGTH) return NO;
+    unichar chars[ABSOLUTE_DATE_MAX_LENGTH];
+    [input getCharacters:chars range:NSMakeRange(0, length)];
+    return WPSPParseAbsoluteDate(chars, length, epochMs);
 }
 
 + (WPSPASTValueNodeParser) parseDuration {
@@ -18,4 +18,26 @@ NS_ASSUME_NONNULL_BEGIN
 + (WPSPFieldPath * _Nonnull) pathByParsing:(NSString *)dottedPath;
 @end
 
+/**
+ A field path resolved into accessor steps once, so that reading it needs neither to parse array indexes
+ nor to check whether it holds dates again.
+ */
+@interface WPSPFieldAccessor : NSObject
+@property (nonnull, readonly) WPSPFieldPath *path;
+
+/// Whether the field holds dates that may be stored as ISO 8601 strings, as `custom.date_*` fields do.
+@property (readonly) BOOL readsDates;
+
+- (instancetype) initWithPath:(WPSPFieldPath *)path;
+
+/// Returns nil, a single non-null value, or an array of values that may contain nulls.
+- (nullable id) resolveInObject:(nullable id)object;
+
+/// Turns date strings into timestamps in milliseconds if the field holds dates, returns other values as is.
+- (id) coerceValue:(id)value;
+
+/// The values of the field in the given object. Arrays are returned as is unless they hold dates, nulls included, which callers skip.
+- (NSArray<id> *) valuesInObject:(nullable id)object;
+@end
+
 NS_ASSUME_NONNULL_END
@@ -7,6 +7,7 @@
 //
 
 #import "WPSPFieldPath.h"
+#import "WPSPDefaultValueNodeParser.h"
 
 @implementation WPSPFieldPath
 
@@ -21,3 +22,75 @@
     return [[WPSPFieldPath alloc] initWithParts:[dottedPath componentsSeparatedByString:@"."]];
 }
 @end
+
+typedef struct {
+    __unsafe_unretained NSString *key; // Retained by the path
+    NSInteger index; // NSNotFound when the key is not an array index
+} WPSPFieldAccessorStep;
+
+@implementation WPSPFieldAccessor {
+    WPSPFieldAccessorStep *_steps;
+    NSUInteger _stepsCount;
+}
+
+- (instancetype)initWithPath:(WPSPFieldPath *)path {
+    if (self = [super init]) {
+        _path = path;
+        NSArray<NSString *> *parts = path.parts;
+        _readsDates = parts.count >= 2 && [@"custom" isEqualToString:parts[0]] && [parts.lastObject hasPrefix:@"date_"];
+        _stepsCount = parts.count;
+        _steps = calloc(MAX(1, _stepsCount), sizeof(WPSPFieldAccessorStep));
+        for (NSUInteger i = 0; i < _stepsCount; i++) {
+            NSInteger index = -1;
+            _steps[i].key = parts[i];
+            _steps[i].index = [[NSScanner scannerWithString:parts[i]] scanInteger:&index] ? index : NSNotFound;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_steps);
+}
+
+- (id)resolveInObject:(id)object {
+    id curr = object;
+    for (NSUInteger i = 0; i < _stepsCount && curr; i++) {
+        if ([curr isKindOfClass:NSDictionary.class]) {
+            curr = ((NSDictionary *)curr)[_steps[i].key];
+        } else if ([curr isKindOfClass:NSArray.class]) {
+            NSInteger index = _steps[i].index;
+            curr = index != NSNotFound && index >= 0 && index < (NSInteger)((NSArray *)curr).count ? ((NSArray *)curr)[index] : nil;
+        } else {
+            curr = nil;
+        }
+    }
+    return curr == [NSNull null] ? nil : curr;
+}
+
+- (id)coerceValue:(id)value {
+    if (!_readsDates || ![value isKindOfClass:NSString.class]) return value;
+    long long epochMs;
+    if ([WPSPDefaultValueNodeParser parseAbsoluteDate:(NSString *)value epochMs:&epochMs]) {
+        // Only whole seconds are kept
+        return [NSNumber numberWithLongLong:epochMs / 1000 * 1000];
+    }
+    return value;
+}
+
+- (NSArray<id> *)valuesInObject:(id)object {
+    id resolved = [self resolveInObject:object];
+    if (resolved == nil) return @[];
+    if (![resolved isKindOfClass:NSArray.class]) return @[[self coerceValue:resolved]];
+    NSArray *array = resolved;
+    // Nulls are skipped by the callers, so that the array is only copied to read dates
+    if (!_readsDates) return array;
+    NSMutableArray *values = [NSMutableArray arrayWithCapacity:array.count];
+    for (id item in array) {
+        if (item == [NSNull null]) continue;
+        [values addObject:[self coerceValue:item]];
+    }
+    return values;
+}
+
+@end
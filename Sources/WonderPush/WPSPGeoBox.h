@@ -10,7 +10,7 @@
 #import "WPSPGeoLocation.h"
 NS_ASSUME_NONNULL_BEGIN
 
-@interface WPSPGeoBox : NSObject
+@interface WPSPGeoBox : NSObject <WPSPGeoArea>
 @property (assign, readonly) double top;
 @property (assign, readonly) double right;
 @property (assign, readonly) double bottom;
@@ -25,6 +25,9 @@ NS_ASSUME_NONNULL_BEGIN
 - (WPSPGeoLocation *) bottomRight;
 - (WPSPGeoLocation *) toGeoLocation;
 
+/// Whether the given point lies within the box, edges included. A box whose left is east of its right crosses the antimeridian.
+- (BOOL) containsLat:(double)lat lon:(double)lon;
+
 @end
 
 NS_ASSUME_NONNULL_END
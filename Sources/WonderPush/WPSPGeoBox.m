@@ -53,4 +53,14 @@
 - (WPSPGeoLocation *)toGeoLocation {
     return [[WPSPGeoLocation alloc] initWithLat:self.centerLat lon:self.centerLon];
 }
+
+- (BOOL)containsLat:(double)lat lon:(double)lon {
+    if (lat < _bottom || lat > _top) return NO;
+    if (_left <= _right) return lon >= _left && lon <= _right;
+    return lon >= _left || lon <= _right;
+}
+
+- (BOOL)containsLocation:(WPSPGeoLocation *)location {
+    return [self containsLat:location.lat lon:location.lon];
+}
 @end
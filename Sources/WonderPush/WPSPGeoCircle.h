@@ -11,7 +11,7 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
-@interface WPSPGeoCircle : NSObject
+@interface WPSPGeoCircle : NSObject <WPSPGeoArea>
 @property (nonnull, readonly) WPSPGeoLocation *center;
 @property (readonly, assign) double radiusMeters;
 
@@ -17,6 +17,10 @@
     return self;
 }
 
+- (BOOL)containsLocation:(WPSPGeoLocation *)location {
+    return [self.center distanceToLocation:location] <= self.radiusMeters;
+}
+
 - (BOOL)isEqual:(id)object {
     if (![object isKindOfClass:self.class]) return NO;
     WPSPGeoCircle *other = object;
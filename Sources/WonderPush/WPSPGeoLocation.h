@@ -15,6 +15,23 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, assign, readonly) double lon;
 
 - (instancetype) initWithLat:(double)lat lon:(double)lon;
+
+/**
+ Reads a location stored in the data, either a `{"lat": …, "lon": …}` dictionary, a geohash string, or a `WPSPGeoLocation`.
+ Returns nil for anything else.
+ */
++ (instancetype _Nullable) locationFromValue:(id _Nullable)value;
+
+/// The great-circle distance to the given location, in meters, using the haversine formula.
+- (double) distanceToLocation:(WPSPGeoLocation *)location;
+
+@end
+
+/// An area that locations can be checked against.
+@protocol WPSPGeoArea <NSObject>
+
+- (BOOL) containsLocation:(WPSPGeoLocation *)location;
+
 @end
 
 NS_ASSUME_NONNULL_END
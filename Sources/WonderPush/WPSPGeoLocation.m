@@ -7,6 +7,11 @@
 //
 
 #import "WPSPGeoLocation.h"
+#import "WPSPGeohash.h"
+#import <WonderPushCommon/WPJsonUtil.h>
+
+// Mean Earth radius, in meters
+#define EARTH_RADIUS_METERS 6371008.8
 
 @implementation WPSPGeoLocation
 
@@ -18,6 +23,36 @@
     return self;
 }
 
++ (instancetype)locationFromValue:(id)value {
+    if ([value isKindOfClass:WPSPGeoLocation.class]) {
+        return value;
+    }
+    if ([value isKindOfClass:NSDictionary.class]) {
+        id lat = ((NSDictionary *)value)[@"lat"];
+        id lon = ((NSDictionary *)value)[@"lon"];
+        if (![lat isKindOfClass:NSNumber.class] || [WPJsonUtil isBoolNumber:lat]) return nil;
+        if (![lon isKindOfClass:NSNumber.class] || [WPJsonUtil isBoolNumber:lon]) return nil;
+        return [[WPSPGeoLocation alloc] initWithLat:[lat doubleValue] lon:[lon doubleValue]];
+    }
+    if ([value isKindOfClass:NSString.class] && [(NSString *)value length] > 0) {
+        @try {
+            return [WPSPGeohash parse:value].toGeoLocation;
+        } @catch (id ignored) {
+            return nil;
+        }
+    }
+    return nil;
+}
+
+- (double)distanceToLocation:(WPSPGeoLocation *)location {
+    double lat1 = self.lat * M_PI / 180;
+    double lat2 = location.lat * M_PI / 180;
+    double sinHalfDeltaLat = sin((lat2 - lat1) / 2);
+    double sinHalfDeltaLon = sin((location.lon - self.lon) * M_PI / 180 / 2);
+    double a = sinHalfDeltaLat * sinHalfDeltaLat + cos(lat1) * cos(lat2) * sinHalfDeltaLon * sinHalfDeltaLon;
+    return 2 * EARTH_RADIUS_METERS * asin(MIN(1, sqrt(a)));
+}
+
 - (BOOL)isEqual:(id)object {
     if (![object isKindOfClass:self.class]) return NO;
     WPSPGeoLocation *other = object;
@@ -8,12 +8,19 @@
 
 #import <Foundation/Foundation.h>
 #import "WPSPGeoLocation.h"
+#import "WPSPGeoBox.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
-@interface WPSPGeoPolygon : NSObject
+@interface WPSPGeoPolygon : NSObject <WPSPGeoArea>
 @property (readonly, nonnull) NSArray<WPSPGeoLocation *> *points;
 
+/**
+ The smallest box enclosing all the points, used to reject most locations before walking the edges.
+ Edges spanning more than 180° of longitude are taken to cross the antimeridian, and so does the box then.
+ */
+@property (readonly, nonnull) WPSPGeoBox *boundingBox;
+
 - (instancetype) initWithPoints:(NSArray<WPSPGeoLocation *> *)points;
 @end
 
@@ -8,15 +8,84 @@
 
 #import "WPSPGeoPolygon.h"
 
+@interface WPSPGeoPolygon () {
+    // Copies of the points coordinates, so the edges can be walked without messaging
+    double *_lats;
+    double *_lons;
+    NSUInteger _count;
+    // Whether an edge crosses the antimeridian, in which case longitudes are stored within [0, 360)
+    BOOL _crossesAntimeridian;
+}
+@end
+
 @implementation WPSPGeoPolygon
 
 - (instancetype)initWithPoints:(NSArray<WPSPGeoLocation *> *)points {
     if (self = [super init]) {
         _points = [NSArray arrayWithArray:points];
+        _count = _points.count;
+        _lats = calloc(MAX(_count, 1), sizeof(double));
+        _lons = calloc(MAX(_count, 1), sizeof(double));
+        for (NSUInteger i = 0; i < _count; i++) {
+            WPSPGeoLocation *point = _points[i];
+            _lats[i] = point.lat;
+            _lons[i] = point.lon;
+        }
+        // Edges take the shortest way, an edge spanning more than 180° of longitude goes across ±180
+        for (NSUInteger i = 0, j = _count - 1; i < _count; j = i++) {
+            if (fabs(_lons[i] - _lons[j]) > 180) {
+                _crossesAntimeridian = YES;
+                break;
+            }
+        }
+        if (_crossesAntimeridian) {
+            for (NSUInteger i = 0; i < _count; i++) {
+                _lons[i] = [self unwrappedLon:_lons[i]];
+            }
+        }
+        double top = -90, right = -180, bottom = 90, left = 360;
+        for (NSUInteger i = 0; i < _count; i++) {
+            top = MAX(top, _lats[i]);
+            bottom = MIN(bottom, _lats[i]);
+            right = MAX(right, _lons[i]);
+            left = MIN(left, _lons[i]);
+        }
+        if (_crossesAntimeridian) {
+            // Back within [-180, 180], a box crossing the antimeridian has its left side east of its right side
+            if (left > 180) left -= 360;
+            if (right > 180) right -= 360;
+        }
+        _boundingBox = [[WPSPGeoBox alloc] initWithTop:top right:right bottom:bottom left:left];
     }
     return self;
 }
 
+- (void)dealloc {
+    free(_lats);
+    free(_lons);
+}
+
+- (double)unwrappedLon:(double)lon {
+    return lon < 0 ? lon + 360 : lon;
+}
+
+- (BOOL)containsLocation:(WPSPGeoLocation *)location {
+    if (_count < 3) return NO;
+    double lat = location.lat;
+    double lon = location.lon;
+    if (![self.boundingBox containsLat:lat lon:lon]) return NO;
+    if (_crossesAntimeridian) lon = [self unwrappedLon:lon];
+    // Even-odd rule: count the edges crossed by a ray going east from the location
+    BOOL inside = NO;
+    for (NSUInteger i = 0, j = _count - 1; i < _count; j = i++) {
+        if ((_lats[i] > lat) != (_lats[j] > lat)
+            && lon < (_lons[j] - _lons[i]) * (lat - _lats[i]) / (_lats[j] - _lats[i]) + _lons[i]) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
 - (BOOL)isEqual:(id)object {
     if (![object isKindOfClass:self.class]) return NO;
     WPSPGeoPolygon *other = object;
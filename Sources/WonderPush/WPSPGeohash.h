@@ -11,13 +11,51 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/// The longest geohash handled, well beyond what double precision coordinates can distinguish.
+#define WPSP_GEOHASH_MAX_PRECISION 24
+
+typedef NS_ENUM(NSInteger, WPSPGeohashDirection) {
+    WPSPGeohashDirectionNorth,
+    WPSPGeohashDirectionNorthEast,
+    WPSPGeohashDirectionEast,
+    WPSPGeohashDirectionSouthEast,
+    WPSPGeohashDirectionSouth,
+    WPSPGeohashDirectionSouthWest,
+    WPSPGeohashDirectionWest,
+    WPSPGeohashDirectionNorthWest,
+};
+
+/**
+ Decodes the bounds of the `length` first characters of `geohash`, case insensitively.
+ Returns NO if one of them is not a valid geohash character.
+ */
+FOUNDATION_EXPORT BOOL WPSPGeohashDecode(const char *geohash, size_t length, double *top, double *right, double *bottom, double *left);
+
+/// Writes the `precision` characters long geohash of the given location, followed by a NUL, to `buffer`.
+FOUNDATION_EXPORT void WPSPGeohashEncode(double lat, double lon, size_t precision, char *buffer);
+
+/**
+ Writes the geohash of the same length adjacent to the given one in the given direction, followed by a NUL, to `buffer`.
+ Wraps around the antimeridian. Returns NO past a pole, or if the geohash is invalid.
+ */
+FOUNDATION_EXPORT BOOL WPSPGeohashNeighbour(const char *geohash, size_t length, WPSPGeohashDirection direction, char *buffer);
+
 @interface WPSPGeohash : WPSPGeoBox
 @property (nonnull, readonly) NSString *geohash;
 
 + (instancetype _Nullable) parse:(NSString *)geohash;
 
+/// The geohash of the given location, `precision` is capped to `WPSP_GEOHASH_MAX_PRECISION`.
++ (NSString *) geohashWithLat:(double)lat lon:(double)lon precision:(NSUInteger)precision;
+
 - (instancetype) initWithGeohash:(NSString *)geohash top:(double)top right:(double)right bottom:(double)bottom left:(double)left;
 
+/// The adjacent geohash of the same length in the given direction, nil past a pole.
+- (WPSPGeohash * _Nullable) neighbourInDirection:(WPSPGeohashDirection)direction;
+
+/// The 8 adjacent geohashes, clockwise starting north, omitting those past a pole.
+- (NSArray<WPSPGeohash *> *) neighbours;
+
 @end
 
 NS_ASSUME_NONNULL_END
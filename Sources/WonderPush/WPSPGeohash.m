@@ -9,39 +9,35 @@
 #import "WPSPGeohash.h"
 #import "WPSPExceptions.h"
 
-@implementation WPSPGeohash
+static const char base32EncodeTable[] = "0123456789bcdefghjkmnpqrstuvwxyz";
 
+// Maps every byte to its 5 bits value, or -1, both cases are accepted
+static int8_t base32DecodeTable[256];
 
-+ (NSDictionary<NSNumber *, NSNumber *> *) base32CodesDict {
-    static NSDictionary *rtn = nil;
+static void initBase32DecodeTable(void) {
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
-        NSString *base32EncodeTable = @"0123456789bcdefghjkmnpqrstuvwxyz";
-        NSMutableDictionary *dict = [NSMutableDictionary new];
-        for (NSInteger i = 0; i < base32EncodeTable.length; i++) {
-            [dict setObject:[NSNumber numberWithInteger:i] forKey:[NSNumber numberWithUnsignedShort:[base32EncodeTable characterAtIndex:i]]];
+        memset(base32DecodeTable, -1, sizeof(base32DecodeTable));
+        for (int8_t i = 0; i < 32; i++) {
+            unsigned char c = base32EncodeTable[i];
+            base32DecodeTable[c] = i;
+            base32DecodeTable[toupper(c)] = i;
         }
-        rtn = [NSDictionary dictionaryWithDictionary:dict];
     });
-    return rtn;
 }
 
-+ (instancetype _Nullable) parse:(NSString *)geohash {
-    if (!geohash) return nil;
-    geohash = [geohash lowercaseString];
+BOOL WPSPGeohashDecode(const char *geohash, size_t length, double *top, double *right, double *bottom, double *left) {
+    initBase32DecodeTable();
     BOOL isLon = YES;
     double maxLat = +90;
     double minLat = -90;
     double maxLon = +180;
     double minLon = -180;
     double mid;
-    NSDictionary<NSNumber *, NSNumber *> *base32CodesDict = self.base32CodesDict;
     // See: https://github.com/sunng87/node-geohash/blob/87ca0f9d6213a13b3335a6889659cad59e83d286/main.js#L170-L204
-    for (NSUInteger i = 0, l = geohash.length; i < l; i++) {
-        unichar c = [geohash characterAtIndex:i];
-        NSNumber *hashValueNumber = base32CodesDict[[NSNumber numberWithUnsignedShort:c]];
-        if (!hashValueNumber) @throw [WPSPBadInputException new]; // "character \"" + c + "\" is not valid in a geohash"
-        NSInteger hashValue = hashValueNumber.integerValue;
+    for (size_t i = 0; i < length; i++) {
+        int8_t hashValue = base32DecodeTable[(unsigned char)geohash[i]];
+        if (hashValue < 0) return NO;
         for (int bits = 4; bits >= 0; bits--) {
             int bit = (hashValue >> bits) & 1;
             if (isLon) {
@@ -62,7 +58,94 @@
             isLon = !isLon;
         }
     }
-    return [[WPSPGeohash alloc] initWithGeohash:geohash top:maxLat right:maxLon bottom:minLat left:minLon];
+    *top = maxLat;
+    *right = maxLon;
+    *bottom = minLat;
+    *left = minLon;
+    return YES;
+}
+
+void WPSPGeohashEncode(double lat, double lon, size_t precision, char *buffer) {
+    BOOL isLon = YES;
+    double maxLat = +90;
+    double minLat = -90;
+    double maxLon = +180;
+    double minLon = -180;
+    double mid;
+    int hashValue = 0;
+    int bits = 0;
+    size_t i = 0;
+    while (i < precision) {
+        if (isLon) {
+            mid = (maxLon + minLon) / 2;
+            if (lon >= mid) {
+                hashValue = (hashValue << 1) | 1;
+                minLon = mid;
+            } else {
+                hashValue = hashValue << 1;
+                maxLon = mid;
+            }
+        } else {
+            mid = (maxLat + minLat) / 2;
+            if (lat >= mid) {
+                hashValue = (hashValue << 1) | 1;
+                minLat = mid;
+            } else {
+                hashValue = hashValue << 1;
+                maxLat = mid;
+            }
+        }
+        isLon = !isLon;
+        if (++bits == 5) {
+            buffer[i++] = base32EncodeTable[hashValue];
+            hashValue = 0;
+            bits = 0;
+        }
+    }
+    buffer[precision] = '\0';
+}
+
+BOOL WPSPGeohashNeighbour(const char *geohash, size_t length, WPSPGeohashDirection direction, char *buffer) {
+    double top, right, bottom, left;
+    if (length == 0 || !WPSPGeohashDecode(geohash, length, &top, &right, &bottom, &left)) return NO;
+    int latSteps = 0, lonSteps = 0;
+    switch (direction) {
+        case WPSPGeohashDirectionNorth:     latSteps = +1; lonSteps =  0; break;
+        case WPSPGeohashDirectionNorthEast: latSteps = +1; lonSteps = +1; break;
+        case WPSPGeohashDirectionEast:      latSteps =  0; lonSteps = +1; break;
+        case WPSPGeohashDirectionSouthEast: latSteps = -1; lonSteps = +1; break;
+        case WPSPGeohashDirectionSouth:     latSteps = -1; lonSteps =  0; break;
+        case WPSPGeohashDirectionSouthWest: latSteps = -1; lonSteps = -1; break;
+        case WPSPGeohashDirectionWest:      latSteps =  0; lonSteps = -1; break;
+        case WPSPGeohashDirectionNorthWest: latSteps = +1; lonSteps = -1; break;
+    }
+    // Aim at the center of the adjacent cell, which has the same size
+    double lat = (top + bottom) / 2 + latSteps * (top - bottom);
+    double lon = (left + right) / 2 + lonSteps * (right - left);
+    if (lat > 90 || lat < -90) return NO;
+    if (lon >= 180) lon -= 360;
+    if (lon < -180) lon += 360;
+    WPSPGeohashEncode(lat, lon, length, buffer);
+    return YES;
+}
+
+@implementation WPSPGeohash
+
++ (instancetype _Nullable) parse:(NSString *)geohash {
+    if (!geohash) return nil;
+    // Non-ASCII strings cannot be valid geohashes
+    const char *chars = [geohash cStringUsingEncoding:NSASCIIStringEncoding];
+    double top, right, bottom, left;
+    if (!chars || !WPSPGeohashDecode(chars, strlen(chars), &top, &right, &bottom, &left)) {
+        @throw [WPSPBadInputException new]; // "character \"" + c + "\" is not valid in a geohash"
+    }
+    return [[WPSPGeohash alloc] initWithGeohash:[geohash lowercaseString] top:top right:right bottom:bottom left:left];
+}
+
++ (NSString *) geohashWithLat:(double)lat lon:(double)lon precision:(NSUInteger)precision {
+    char buffer[WPSP_GEOHASH_MAX_PRECISION + 1];
+    WPSPGeohashEncode(lat, lon, MIN(precision, WPSP_GEOHASH_MAX_PRECISION), buffer);
+    return [NSString stringWithCString:buffer encoding:NSASCIIStringEncoding];
 }
 
 - (instancetype) initWithGeohash:(NSString *)geohash top:(double)top right:(double)right bottom:(double)bottom left:(double)left {
@@ -72,6 +155,24 @@
     return self;
 }
 
+- (WPSPGeohash *) neighbourInDirection:(WPSPGeohashDirection)direction {
+    const char *chars = [self.geohash cStringUsingEncoding:NSASCIIStringEncoding];
+    size_t length = chars ? strlen(chars) : 0;
+    if (length > WPSP_GEOHASH_MAX_PRECISION) return nil;
+    char buffer[WPSP_GEOHASH_MAX_PRECISION + 1];
+    if (!WPSPGeohashNeighbour(chars, length, direction, buffer)) return nil;
+    return [WPSPGeohash parse:[NSString stringWithCString:buffer encoding:NSASCIIStringEncoding]];
+}
+
+- (NSArray<WPSPGeohash *> *) neighbours {
+    NSMutableArray<WPSPGeohash *> *neighbours = [NSMutableArray arrayWithCapacity:8];
+    for (WPSPGeohashDirection direction = WPSPGeohashDirectionNorth; direction <= WPSPGeohashDirectionNorthWest; direction++) {
+        WPSPGeohash *neighbour = [self neighbourInDirection:direction];
+        if (neighbour) [neighbours addObject:neighbour];
+    }
+    return neighbours;
+}
+
 - (BOOL)isEqual:(id)object {
     if (![object isKindOfClass:self.class]) return NO;
     WPSPGeohash *other = object;
@@ -11,6 +11,8 @@
 #import "WPSPASTCriterionVisitor.h"
 #import "WPSPASTValueVisitor.h"
 #import "WPSPDataSourceVisitor.h"
+#import "WPSPCompiledSegment.h"
+#import "WPSPGeoLocation.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -31,9 +33,33 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nullable, readonly) WPSPSegmenterPresenceInfo *presenceInfo;
 @property (nonatomic, assign, readonly) long long lastAppOpenDate;
 
+/// A snapshot of the current user data, reused across segment checks until the installation, events, presence or last app open date change.
+/// The installation and the events are only read when first accessed, and events of a given type or type prefix are looked up in the tracked events index.
 + (instancetype)forCurrentUser;
 - (instancetype)initWithInstallation:(NSDictionary *)installation allEvents:(NSArray<NSDictionary *> *)allEvents presenceInfo:(WPSPSegmenterPresenceInfo * _Nullable)presenceInfo lastAppOpenDate:(long long)lastAppOpenDate;
 
+/**
+ The events that may have the given type, or a type starting with the given prefix, and the given campaign id.
+ Nil constraints are ignored. Events whose type or campaign id is not a string are always included.
+
+ Events are sorted by creation date, most recent first, after the events whose creation date is not a number.
+ Results are computed once per constraints and reused.
+ */
+- (NSArray<NSDictionary *> *)eventsOfType:(NSString * _Nullable)type typePrefix:(NSString * _Nullable)typePrefix campaignId:(NSString * _Nullable)campaignId;
+
+/// The creation date of the given event, or nil if it is not a number.
++ (NSNumber * _Nullable)creationDateOfEvent:(NSDictionary *)event;
+
+/**
+ The last known location: the `location` of the most recently created event that has one,
+ or else the `location` of the installation.
+ Computed once and reused.
+ */
+@property (nullable, readonly) WPSPGeoLocation *geoLocation;
+
+/// The creation date of the event `geoLocation` was read from, nil if it was read from the installation.
+@property (nullable, readonly) NSNumber *geoDate;
+
 @end
 
 @interface WPSPSegmenter : NSObject
@@ -44,15 +70,26 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (instancetype)initWithData:(WPSPSegmenterData *)data;
 
+/// Returns the segment compiled from the given parsed segment, compiling it only the first time.
++ (WPSPCompiledSegment *)compiledSegmentOfParsedSegment:(WPSPASTCriterionNode *)parsedSegment;
+
+/// Evaluates the segment compiled by `compiledSegmentOfParsedSegment:`.
 - (BOOL)parsedSegmentMatchesInstallation:(WPSPASTCriterionNode *)parsedInstallationSegment;
 
+- (BOOL)compiledSegmentMatchesInstallation:(WPSPCompiledSegment *)compiledInstallationSegment;
+
 @end
 
 @interface WPSPBaseVisitor : NSObject <WPSPASTCriterionVisitor, WPSPASTValueVisitor, WPSPDataSourceVisitor>
 
 @property (nonnull, readonly) WPSPSegmenterData *data;
 
+/// The server time the whole evaluation uses, in epoch milliseconds. Relative dates are resolved against it once.
+@property (nonatomic, assign, readonly) long long now;
+
+/// Evaluates as of the current server time.
 - (instancetype)initWithData:(WPSPSegmenterData *)data;
+- (instancetype)initWithData:(WPSPSegmenterData *)data now:(long long)now;
 
 - (NSArray<id> *)visitFieldSource:(WPSPFieldSource *)dataSource withObject:(NSDictionary *)object;
 
@@ -30,51 +30,229 @@
 
 @end
 
+@interface WPSPSegmenterData ()
+
+- (instancetype)initWithPresenceInfo:(WPSPSegmenterPresenceInfo * _Nullable)presenceInfo lastAppOpenDate:(long long)lastAppOpenDate;
+
+@property (nonatomic, copy, nullable) NSDictionary *(^installationProvider)(void);
+@property (nonatomic, copy, nullable) NSArray<NSDictionary *> *(^allEventsProvider)(void);
+// Looks up the candidate events of a type or type prefix without going through allEvents, see eventsOfType:typePrefix:campaignId:
+@property (nonatomic, copy, nullable) NSArray<NSDictionary *> *(^typedEventsProvider)(NSString * _Nullable type, NSString * _Nullable typePrefix);
+
+// What the data was built from, see forCurrentUser
+@property (nonatomic, strong, nullable) NSDictionary *sdkState;
+@property (nonatomic, strong, nullable) NSString *userId;
+@property (nonatomic, assign) NSUInteger trackedEventsVersion;
+@property (nonatomic, strong, nullable) WPPresencePayload *presence;
+
+// Events given explicitly, grouped by type, under NSNull for events whose type is not a string
+@property (nonatomic, strong, nullable) NSDictionary<id, NSArray<NSDictionary *> *> *eventsByType;
+// Results of eventsOfType:typePrefix:campaignId:
+@property (nonatomic, strong, nullable) NSMutableDictionary<NSArray *, NSArray<NSDictionary *> *> *eventsCache;
+@property (nonatomic, assign) BOOL geoResolved;
+
+@end
+
+static WPSPSegmenterData *currentUserData = nil;
+
 @implementation WPSPSegmenterData
 
+@synthesize installation = _installation;
+@synthesize allEvents = _allEvents;
+@synthesize geoLocation = _geoLocation;
+@synthesize geoDate = _geoDate;
+
 + (NSArray<NSDictionary *> *)getEvents {
-    NSArray<NSDictionary *> *trackedEvents = WPConfiguration.sharedConfiguration.trackedEvents;
-    NSMutableArray<NSDictionary *> *rtn = [[NSMutableArray alloc] initWithCapacity:trackedEvents.count];
-    for (NSDictionary *event in trackedEvents) {
-        NSMutableDictionary *evt = [[NSMutableDictionary alloc] initWithDictionary:event];
-        if (evt[@"creationDate"] == nil && evt[@"actionDate"] != nil) {
-            evt[@"creationDate"] = evt[@"actionDate"];
-        }
-        [rtn addObject:evt];
-    }
-    return [[NSArray alloc] initWithArray:rtn];
+    // Stored events already have their creationDate filled from their actionDate
+    return WPConfiguration.sharedConfiguration.trackedEvents;
 }
 
 + (instancetype)forCurrentUser {
+    // Only gather what identifies the current state, the data itself is built lazily
     NSString *userId = [WonderPush userId];
-    NSMutableDictionary *installationData = [NSMutableDictionary dictionaryWithDictionary:[WPJsonSyncInstallation forCurrentUser].sdkState];
-    if (userId) installationData[@"userId"] = userId;
-    NSArray <NSDictionary *> *events = [self getEvents];
+    NSDictionary *sdkState = [WPJsonSyncInstallation forCurrentUser].sdkState;
     WPConfiguration *configuration = WPConfiguration.sharedConfiguration;
-    
+    NSUInteger trackedEventsVersion = configuration.trackedEventsVersion;
     WPPresencePayload *presence = [[WonderPush presenceManager] lastPresencePayload];
-    WPSPSegmenterPresenceInfo *presenceInfo = presence ? [[WPSPSegmenterPresenceInfo alloc] initWithFromDate:(long long)(presence.fromDate.timeIntervalSince1970 * 1000) untilDate:(long long)(presence.untilDate.timeIntervalSince1970 * 1000) elapsedTime:(long long)(presence.elapsedTime * 1000)] : nil;
-    
-    NSDate *lastAppOpenDate = configuration.lastAppOpenDate;
-    WPLogDebug(@"Creating segmenter with installation data %@", installationData);
-    WPSPSegmenterData *data = [[WPSPSegmenterData alloc]
-                               initWithInstallation:installationData
-                               allEvents:events
-                               presenceInfo:presenceInfo
-                               lastAppOpenDate:(long long)(lastAppOpenDate.timeIntervalSince1970 * 1000)];
-    return data;
+    long long lastAppOpenDate = (long long)(configuration.lastAppOpenDate.timeIntervalSince1970 * 1000);
+
+    @synchronized (self) {
+        // The installation state is an immutable dictionary replaced on every change, and so is the presence
+        WPSPSegmenterData *data = currentUserData;
+        if (data
+            && data.sdkState == sdkState
+            && (data.userId == userId || [data.userId isEqualToString:userId])
+            && data.trackedEventsVersion == trackedEventsVersion
+            && data.presence == presence
+            && data.lastAppOpenDate == lastAppOpenDate) {
+            return data;
+        }
+
+        WPSPSegmenterPresenceInfo *presenceInfo = presence ? [[WPSPSegmenterPresenceInfo alloc] initWithFromDate:(long long)(presence.fromDate.timeIntervalSince1970 * 1000) untilDate:(long long)(presence.untilDate.timeIntervalSince1970 * 1000) elapsedTime:(long long)(presence.elapsedTime * 1000)] : nil;
+        data = [[WPSPSegmenterData alloc] initWithPresenceInfo:presenceInfo lastAppOpenDate:lastAppOpenDate];
+        data.sdkState = sdkState;
+        data.userId = userId;
+        data.trackedEventsVersion = trackedEventsVersion;
+        data.presence = presence;
+        data.installationProvider = ^NSDictionary *{
+            NSMutableDictionary *installationData = [NSMutableDictionary dictionaryWithDictionary:sdkState ?: @{}];
+            if (userId) installationData[@"userId"] = userId;
+            WPLogDebug(@"Creating segmenter with installation data %@", installationData);
+            return [NSDictionary dictionaryWithDictionary:installationData];
+        };
+        data.allEventsProvider = ^NSArray<NSDictionary *> *{
+            return [WPSPSegmenterData getEvents];
+        };
+        data.typedEventsProvider = ^NSArray<NSDictionary *> *(NSString *type, NSString *typePrefix) {
+            return [configuration trackedEventsOfType:type typePrefix:typePrefix];
+        };
+        currentUserData = data;
+        return data;
+    }
 }
 
 - (instancetype)initWithInstallation:(NSDictionary *)installation allEvents:(NSArray<NSDictionary *> *)allEvents presenceInfo:(WPSPSegmenterPresenceInfo * _Nullable)presenceInfo lastAppOpenDate:(long long)lastAppOpenDate {
-    if (self = [super init]) {
+    if (self = [self initWithPresenceInfo:presenceInfo lastAppOpenDate:lastAppOpenDate]) {
         _installation = installation;
         _allEvents = [NSArray arrayWithArray:allEvents];
+    }
+    return self;
+}
+
+- (instancetype)initWithPresenceInfo:(WPSPSegmenterPresenceInfo * _Nullable)presenceInfo lastAppOpenDate:(long long)lastAppOpenDate {
+    if (self = [super init]) {
         _presenceInfo = presenceInfo;
         _lastAppOpenDate = lastAppOpenDate;
     }
     return self;
 }
 
+- (NSDictionary *)installation {
+    @synchronized (self) {
+        if (!_installation && self.installationProvider) {
+            _installation = self.installationProvider();
+            self.installationProvider = nil;
+        }
+        return _installation ?: @{};
+    }
+}
+
+- (NSArray<NSDictionary *> *)allEvents {
+    @synchronized (self) {
+        if (!_allEvents && self.allEventsProvider) {
+            _allEvents = self.allEventsProvider();
+            self.allEventsProvider = nil;
+        }
+        return _allEvents ?: @[];
+    }
+}
+
++ (NSNumber *)creationDateOfEvent:(NSDictionary *)event {
+    id creationDate = event[@"creationDate"];
+    if (![creationDate isKindOfClass:NSNumber.class] || [WPJsonUtil isBoolNumber:creationDate]) return nil;
+    return creationDate;
+}
+
+- (NSArray<NSDictionary *> *)eventsOfType:(NSString *)type typePrefix:(NSString *)typePrefix campaignId:(NSString *)campaignId {
+    @synchronized (self) {
+        NSArray *key = @[type ?: [NSNull null], typePrefix ?: [NSNull null], campaignId ?: [NSNull null]];
+        NSArray<NSDictionary *> *events = self.eventsCache[key];
+        if (events) return events;
+
+        NSMutableArray<NSDictionary *> *candidates = [NSMutableArray new];
+        if ((type || typePrefix) && self.typedEventsProvider) {
+            [candidates addObjectsFromArray:self.typedEventsProvider(type, typePrefix)];
+        } else if (type || typePrefix) {
+            if (!self.eventsByType) {
+                NSMutableDictionary<id, NSMutableArray<NSDictionary *> *> *eventsByType = [NSMutableDictionary new];
+                for (NSDictionary *event in self.allEvents) {
+                    id eventType = event[@"type"];
+                    if (eventType == nil || eventType == [NSNull null]) continue;
+                    if (![eventType isKindOfClass:NSString.class]) eventType = [NSNull null];
+                    NSMutableArray<NSDictionary *> *typeEvents = eventsByType[eventType];
+                    if (!typeEvents) {
+                        typeEvents = [NSMutableArray new];
+                        eventsByType[eventType] = typeEvents;
+                    }
+                    [typeEvents addObject:event];
+                }
+                self.eventsByType = eventsByType;
+            }
+            if (type) {
+                [candidates addObjectsFromArray:self.eventsByType[type] ?: @[]];
+            } else {
+                [self.eventsByType enumerateKeysAndObjectsUsingBlock:^(id eventType, NSArray<NSDictionary *> *typeEvents, BOOL *stop) {
+                    if (eventType != [NSNull null] && [(NSString *)eventType hasPrefix:typePrefix]) {
+                        [candidates addObjectsFromArray:typeEvents];
+                    }
+                }];
+            }
+            [candidates addObjectsFromArray:self.eventsByType[[NSNull null]] ?: @[]];
+        } else {
+            [candidates addObjectsFromArray:self.allEvents];
+        }
+
+        if (campaignId) {
+            NSIndexSet *otherCampaigns = [candidates indexesOfObjectsPassingTest:^BOOL(NSDictionary *event, NSUInteger idx, BOOL *stop) {
+                id eventCampaignId = event[@"campaignId"];
+                if ([eventCampaignId isKindOfClass:NSString.class]) return ![campaignId isEqualToString:eventCampaignId];
+                return eventCampaignId == nil || eventCampaignId == [NSNull null];
+            }];
+            [candidates removeObjectsAtIndexes:otherCampaigns];
+        }
+
+        // Undated events first, so that scans can stop at the first event that is too old
+        NSMutableArray<NSDictionary *> *undated = [NSMutableArray new];
+        NSMutableArray<NSDictionary *> *dated = [NSMutableArray arrayWithCapacity:candidates.count];
+        for (NSDictionary *event in candidates) {
+            if ([WPSPSegmenterData creationDateOfEvent:event]) {
+                [dated addObject:event];
+            } else {
+                [undated addObject:event];
+            }
+        }
+        [dated sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(NSDictionary *a, NSDictionary *b) {
+            return [[WPSPSegmenterData creationDateOfEvent:b] compare:[WPSPSegmenterData creationDateOfEvent:a]];
+        }];
+        [undated addObjectsFromArray:dated];
+        events = [NSArray arrayWithArray:undated];
+
+        if (!self.eventsCache) self.eventsCache = [NSMutableDictionary new];
+        self.eventsCache[key] = events;
+        return events;
+    }
+}
+
+- (void)resolveGeo {
+    if (self.geoResolved) return;
+    self.geoResolved = YES;
+    for (NSDictionary *event in self.allEvents) {
+        NSNumber *creationDate = [WPSPSegmenterData creationDateOfEvent:event];
+        if (!creationDate || (_geoDate && [creationDate compare:_geoDate] != NSOrderedDescending)) continue;
+        WPSPGeoLocation *location = [WPSPGeoLocation locationFromValue:event[@"location"]];
+        if (!location) continue;
+        _geoLocation = location;
+        _geoDate = creationDate;
+    }
+    if (!_geoLocation) {
+        _geoLocation = [WPSPGeoLocation locationFromValue:self.installation[@"location"]];
+    }
+}
+
+- (WPSPGeoLocation *)geoLocation {
+    @synchronized (self) {
+        [self resolveGeo];
+        return _geoLocation;
+    }
+}
+
+- (NSNumber *)geoDate {
+    @synchronized (self) {
+        [self resolveGeo];
+        return _geoDate;
+    }
+}
+
 @end
 
 @implementation WPSPSegmenter
@@ -90,16 +268,49 @@
     return [[WPSPSegmentationDSLParser defaultParser] parse:segmentInput dataSource:[WPSPInstallationSource new]];
 }
 
-- (BOOL)parsedSegmentMatchesInstallation:(WPSPASTCriterionNode *)parsedInstallationSegment {
-    id rtn = [parsedInstallationSegment accept:[[WPSPInstallationVisitor alloc] initWithData:self.data]];
-    if ([rtn isKindOfClass:NSNumber.class]) {
-        return [rtn boolValue];
++ (WPSPCompiledSegment *)compiledSegmentOfParsedSegment:(WPSPASTCriterionNode *)parsedSegment {
+    // Compiled once per parsed segment, and forgotten along with it
+    static NSMapTable<WPSPASTCriterionNode *, WPSPCompiledSegment *> *compiledSegments = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        compiledSegments = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    });
+    @synchronized (compiledSegments) {
+        WPSPCompiledSegment *compiledSegment = [compiledSegments objectForKey:parsedSegment];
+        if (!compiledSegment) {
+            compiledSegment = [[WPSPCompiledSegment alloc] initWithCriterion:parsedSegment];
+            [compiledSegments setObject:compiledSegment forKey:parsedSegment];
+        }
+        return compiledSegment;
     }
-    return NO;
+}
+
+- (BOOL)parsedSegmentMatchesInstallation:(WPSPASTCriterionNode *)parsedInstallationSegment {
+    return [self compiledSegmentMatchesInstallation:[WPSPSegmenter compiledSegmentOfParsedSegment:parsedInstallationSegment]];
+}
+
+- (BOOL)compiledSegmentMatchesInstallation:(WPSPCompiledSegment *)compiledInstallationSegment {
+    return [compiledInstallationSegment matchesInstallationWithData:self.data];
 }
 
 @end
 
+@interface WPSPBaseVisitor ()
+
+@property (nonatomic, assign, readonly) BOOL debug;
+/// Epoch milliseconds of the visited relative dates, shared with the visitors of joins
+@property (nonatomic, strong, readonly) NSMapTable<WPSPRelativeDateValueNode *, NSNumber *> *relativeDates;
+
+- (instancetype)initWithData:(WPSPSegmenterData *)data now:(long long)now relativeDates:(NSMapTable<WPSPRelativeDateValueNode *, NSNumber *> *)relativeDates;
+
+@end
+
+@interface WPSPEventVisitor ()
+
+- (instancetype)initWithVisitor:(WPSPBaseVisitor *)visitor event:(NSDictionary *)event;
+
+@end
+
 @implementation WPSPInstallationVisitor
 
 - (id)visitFieldSource:(WPSPFieldSource *)dataSource {
@@ -117,24 +328,35 @@
     return self;
 }
 
+- (instancetype)initWithVisitor:(WPSPBaseVisitor *)visitor event:(NSDictionary *)event {
+    if (self = [super initWithData:visitor.data now:visitor.now relativeDates:visitor.relativeDates]) {
+        _event = event;
+    }
+    return self;
+}
+
 - (id)visitFieldSource:(WPSPFieldSource *)dataSource {
     return [super visitFieldSource:dataSource withObject:self.event];
 }
 
 @end
 
-@interface WPSPBaseVisitor ()
-
-@property (nonatomic, assign, readonly) BOOL debug;
-
-@end
-
 @implementation WPSPBaseVisitor
 
 - (instancetype)initWithData:(WPSPSegmenterData *)data {
+    return [self initWithData:data now:[WPUtil getServerDate]];
+}
+
+- (instancetype)initWithData:(WPSPSegmenterData *)data now:(long long)now {
+    return [self initWithData:data now:now relativeDates:[NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory]];
+}
+
+- (instancetype)initWithData:(WPSPSegmenterData *)data now:(long long)now relativeDates:(NSMapTable<WPSPRelativeDateValueNode *, NSNumber *> *)relativeDates {
     if (self = [super init]) {
         _debug = WPLogEnabled();
         _data = data;
+        _now = now;
+        _relativeDates = relativeDates;
     }
     return self;
 }
@@ -169,7 +391,13 @@
 }
 
 -(nonnull id) visitRelativeDateValueNode:(WPSPRelativeDateValueNode *)node {
-    return [NSNumber numberWithLongLong:([node.duration applyTo:[NSDate dateWithTimeIntervalSince1970:(WPUtil.getServerDate / 1000.0)]].timeIntervalSince1970 * 1000)];
+    // Visited once per event inside joins, only do the calendar arithmetic once per evaluation
+    NSNumber *result = [self.relativeDates objectForKey:node];
+    if (!result) {
+        result = [NSNumber numberWithLongLong:([node.duration applyTo:[NSDate dateWithTimeIntervalSince1970:(self.now / 1000.0)]].timeIntervalSince1970 * 1000)];
+        [self.relativeDates setObject:result forKey:node];
+    }
+    return result;
 }
 
 -(nonnull id) visitDurationValueNode:(WPSPDurationValueNode *)node {
@@ -234,6 +462,14 @@
     return rtn;
 }
 
+// Field sources leave the nulls of arrays in their values, to avoid copying them
+static BOOL WPSPHasNonNullValue(NSArray<id> *values) {
+    for (id value in values) {
+        if (value != [NSNull null]) return YES;
+    }
+    return NO;
+}
+
 - (nonnull id)visitAllCriterionNode:(nonnull WPSPAllCriterionNode *)node {
     NSArray<id> *dataSourceValues = [node.context.dataSource accept:self];
     if (![dataSourceValues isKindOfClass:NSArray.class]) {
@@ -243,7 +479,7 @@
         BOOL found = NO;
         id actualValue = [value accept:self];
         if (actualValue == nil || [[NSNull null] isEqual:actualValue]) {
-            if (dataSourceValues.count == 0) {
+            if (!WPSPHasNonNullValue(dataSourceValues)) {
                 found = YES;
             }
         } else {
@@ -271,12 +507,13 @@
     for (WPSPASTValueNode *value in node.values) {
         id actualValue = [value accept:self];
         if (actualValue == nil || [[NSNull null] isEqual:actualValue]) {
-            if (dataSourceValues.count == 0) {
+            if (!WPSPHasNonNullValue(dataSourceValues)) {
                 if (_debug) WPLog(@"[%@] return true for %@", NSStringFromSelector(_cmd), dataSourceValues);
                 return @YES;
             }
         }
         for (id dataSourceValue in dataSourceValues) {
+            if (dataSourceValue == [NSNull null]) continue;
             if ([actualValue isEqual:dataSourceValue]) {
                 if (_debug) WPLog(@"[%@] return true for %@", NSStringFromSelector(_cmd), dataSourceValues);
                 return @YES;
@@ -320,6 +557,7 @@ NSComparisonResult compareObjectOrThrow(id a, id b) {
     BOOL result = NO;
     id actualValue = [node.value accept:self];
     for (WPSPASTValueNode *dataSourceValue in dataSourceValues) {
+        if ((id)dataSourceValue == [NSNull null]) continue;
         @try {
             NSComparisonResult comparison = compareObjectOrThrow(dataSourceValue, actualValue);
             if (node.comparator == WPSPComparatorGt) {
@@ -355,7 +593,7 @@ NSComparisonResult compareObjectOrThrow(id a, id b) {
     id actualValue = [node.value accept:self];
     BOOL result = NO;
     if (actualValue == nil || [[NSNull null] isEqual:actualValue]) {
-        result = dataSourceValues.count == 0 ? YES : NO;
+        result = WPSPHasNonNullValue(dataSourceValues) ? NO : YES;
     } else {
         for (id dataSourceValue in dataSourceValues) {
             if (!dataSourceValue || [dataSourceValue isKindOfClass:NSNull.class]) continue;
@@ -382,19 +620,44 @@ NSComparisonResult compareObjectOrThrow(id a, id b) {
 }
 
 - (nonnull id)visitGeoCriterionNode:(nonnull WPSPGeoCriterionNode *)node {
-    if (_debug) WPLog(@"[%@] unsupported", NSStringFromSelector(_cmd));
-    return @NO;
+    if (self.data.geoLocation == nil) {
+        if (_debug) WPLog(@"[%@] return false because the location is unknown", NSStringFromSelector(_cmd));
+        return @NO;
+    }
+    if (node.locationComparison != nil && !((NSNumber *)[node.locationComparison accept:self]).boolValue) {
+        if (_debug) WPLog(@"[%@] return false because location mismatch", NSStringFromSelector(_cmd));
+        return @NO;
+    }
+    if (node.dateComparison != nil && !((NSNumber *)[node.dateComparison accept:self]).boolValue) {
+        if (_debug) WPLog(@"[%@] return false because date mismatch", NSStringFromSelector(_cmd));
+        return @NO;
+    }
+    if (_debug) WPLog(@"[%@] return true", NSStringFromSelector(_cmd));
+    return @YES;
 }
 
 - (nonnull id)visitInsideCriterionNode:(nonnull WPSPInsideCriterionNode *)node {
-    if (_debug) WPLog(@"[%@] unsupported", NSStringFromSelector(_cmd));
-    return @NO;
+    NSArray<id> *dataSourceValues = [node.context.dataSource accept:self];
+    if (![dataSourceValues isKindOfClass:NSArray.class]) {
+        WPLog(@"[%@] Unexpected dataSourceValues: %@", NSStringFromSelector(_cmd), dataSourceValues);
+    }
+    id<WPSPGeoArea> area = [node.value accept:self];
+    BOOL result = NO;
+    for (id dataSourceValue in dataSourceValues) {
+        if (dataSourceValue == [NSNull null]) continue;
+        WPSPGeoLocation *location = [WPSPGeoLocation locationFromValue:dataSourceValue];
+        if (location == nil) continue;
+        result = [area containsLocation:location];
+        if (result) break;
+    }
+    if (_debug) WPLog(@"[%@] return %@ because %@ %@ %@", NSStringFromSelector(_cmd), result ? @"true" : @"false", dataSourceValues, result ? @"is inside" : @"is not inside", area);
+    return result ? @YES : @NO;
 }
 
 - (nonnull id)visitJoinCriterionNode:(nonnull WPSPJoinCriterionNode *)node {
     if ([node.context.dataSource isKindOfClass:WPSPEventSource.class]) {
         for (NSDictionary *event in self.data.allEvents) {
-            WPSPEventVisitor *eventVisitor = [[WPSPEventVisitor alloc] initWithData:self.data event:event];
+            WPSPEventVisitor *eventVisitor = [[WPSPEventVisitor alloc] initWithVisitor:self event:event];
             if (((NSNumber *)[node.child accept:eventVisitor]).boolValue) {
                 if (_debug) WPLog(@"[%@] return true for event %@", NSStringFromSelector(_cmd), event);
                 return @YES;
@@ -404,7 +667,7 @@ NSComparisonResult compareObjectOrThrow(id a, id b) {
         return @NO;
     }
     if ([node.context.dataSource isKindOfClass:WPSPInstallationSource.class]) {
-        WPSPInstallationVisitor *installationVisitor = [[WPSPInstallationVisitor alloc] initWithData:self.data];
+        WPSPInstallationVisitor *installationVisitor = [[WPSPInstallationVisitor alloc] initWithData:self.data now:self.now relativeDates:self.relativeDates];
         id result = [node.child accept:installationVisitor];
         if (_debug) WPLog(@"[%@] return %@ for installation", NSStringFromSelector(_cmd), [result boolValue] ? @"true" : @"false");
         return result;
@@ -436,6 +699,7 @@ NSComparisonResult compareObjectOrThrow(id a, id b) {
     }
     BOOL result = NO;
     for (id dataSourceValue in dataSourceValues) {
+        if (dataSourceValue == [NSNull null]) continue;
         if (![dataSourceValue isKindOfClass:NSString.class]) {
             WPLog(@"[%@] value %@ is not a string", NSStringFromSelector(_cmd), dataSourceValue);
             continue;
@@ -449,7 +713,7 @@ NSComparisonResult compareObjectOrThrow(id a, id b) {
 
 - (nonnull id)visitPresenceCriterionNode:(nonnull WPSPPresenceCriterionNode *)node {
     // Are we present right now?
-    BOOL present = self.data.presenceInfo == nil || (self.data.presenceInfo.untilDate >= [WPUtil getServerDate] && self.data.presenceInfo.fromDate <= [WPUtil getServerDate]);
+    BOOL present = self.data.presenceInfo == nil || (self.data.presenceInfo.untilDate >= self.now && self.data.presenceInfo.fromDate <= self.now);
     if (present != node.present) {
         if (_debug) WPLog(@"[%@] return false because presence mismatch, expected %@", NSStringFromSelector(_cmd), node.present ? @"present" : @"absent");
         return @NO;
@@ -507,61 +771,17 @@ NSComparisonResult compareObjectOrThrow(id a, id b) {
 //}
 
 - (NSArray<id> *)visitFieldSource:(WPSPFieldSource *)dataSource withObject:(NSDictionary *)object {
-    WPSPFieldPath *fieldPath = dataSource.fullPath;
-    id curr = object;
-    for (NSString *part in fieldPath.parts) {
-        if ([curr isKindOfClass:NSDictionary.class]) {
-            curr = curr[part];
-        } else if ([curr isKindOfClass:NSArray.class]) {
-            NSInteger index = -1;
-            if ([[NSScanner scannerWithString:part] scanInteger:&index]) {
-                curr = curr[index];
-            } else {
-                curr = nil;
-            }
-        } else {
-            curr = nil;
-        }
-    }
-    NSArray<id> *rtn;
-    if ([curr isKindOfClass:NSArray.class]) {
-        // Ignore nulls
-        NSExpression *lhs = [NSExpression expressionForEvaluatedObject];
-        NSExpression *rhs = [NSExpression expressionForConstantValue:[NSNull null]];
-        NSPredicate *filterDifferent = [NSComparisonPredicate predicateWithLeftExpression:lhs rightExpression:rhs modifier:NSDirectPredicateModifier type:NSNotEqualToPredicateOperatorType options:0];
-        rtn = [curr filteredArrayUsingPredicate:filterDifferent];
-    } else if (curr == nil || [[NSNull null] isEqual:curr]) {
-        rtn = @[];
-    } else {
-        rtn = @[curr];
-    }
-    if (fieldPath.parts.count >= 2 && [@"custom" isEqualToString:fieldPath.parts[0]] && [fieldPath.parts.lastObject hasPrefix:@"date_"]) {
-        NSMutableArray<id> *parsedDates = [NSMutableArray arrayWithCapacity:rtn.count];
-        for (id item in rtn) {
-            id itemToAdd = item;
-            if ([item isKindOfClass:NSString.class]) {
-                @try {
-                    NSDate *parsed = [WPSPDefaultValueNodeParser parseAbsoluteDate:(NSString *)item];
-                    if (parsed) {
-                        itemToAdd = [NSNumber numberWithLongLong:(long long)(parsed.timeIntervalSince1970) * 1000LL];
-                    }
-                } @catch (id ignored) {}
-            }
-            [parsedDates addObject:itemToAdd];
-        }
-        rtn = [NSArray arrayWithArray:parsedDates];
-    }
-    return rtn;
+    return [dataSource.accessor valuesInObject:object];
 }
 
 - (nonnull id)visitGeoDateSource:(nonnull WPSPGeoDateSource *)dataSource {
-    // TODO Implement geo
-    return @[];
+    NSNumber *geoDate = self.data.geoDate;
+    return geoDate ? @[geoDate] : @[];
 }
 
 - (nonnull id)visitGeoLocationSource:(nonnull WPSPGeoLocationSource *)dataSource {
-    // TODO Implement geo
-    return @[];
+    WPSPGeoLocation *geoLocation = self.data.geoLocation;
+    return geoLocation ? @[geoLocation] : @[];
 }
 
 - (nonnull id)visitInstallationSource:(nonnull WPSPInstallationSource *)dataSource {
@@ -577,7 +797,7 @@ NSComparisonResult compareObjectOrThrow(id a, id b) {
 - (nonnull id)visitPresenceElapsedTimeSource:(nonnull WPSPPresenceElapsedTimeSource *)dataSource {
     if (dataSource.present) {
         return @[
-            [NSNumber numberWithLongLong:(self.data.presenceInfo == nil ? 0 : MAX(0, [WPUtil getServerDate] - self.data.presenceInfo.fromDate))],
+            [NSNumber numberWithLongLong:(self.data.presenceInfo == nil ? 0 : MAX(0, self.now - self.data.presenceInfo.fromDate))],
         ];
     }
     return @[
@@ -590,7 +810,7 @@ NSComparisonResult compareObjectOrThrow(id a, id b) {
     if (dataSource.present) {
         // When presence info is missing, assume the user just got here.
         return @[
-            [NSNumber numberWithLongLong:(self.data.presenceInfo == nil ? [WPUtil getServerDate] : self.data.presenceInfo.fromDate)],
+            [NSNumber numberWithLongLong:(self.data.presenceInfo == nil ? self.now : self.data.presenceInfo.fromDate)],
         ];
     }
     // When presence info is missing, assume the user will stay here indefinitely (yay!).
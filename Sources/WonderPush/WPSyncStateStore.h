@@ -0,0 +1,59 @@
+//
+//  WPSyncStateStore.h
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define WP_SYNC_STATE_STORE_DEFAULT_MAX_STALENESS 1
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A write-behind, on-disk store for the saved states of `WPJsonSync`s, one JSON file per key.
+ Files are named after the SHA-256 of their key, which they hold along with the state, so that keys of any length fit.
+
+ Saving a state only keeps it in memory and schedules a write, at most `maxStaleness` seconds later.
+ Saving the same key again meanwhile replaces the pending state, so that a burst of saves costs a single write.
+ Call `flush` to write the pending states right away, before the process may be suspended or killed.
+ */
+@interface WPSyncStateStore : NSObject
+
+- (instancetype) initWithDirectory:(NSString *)directory;
+
+/// The longest time a saved state is kept in memory only.
+@property (nonatomic, assign) NSTimeInterval maxStaleness;
+
+/// The saved states per key, pending ones included, loaded from disk on first access.
+@property (readonly) NSDictionary<NSString *, NSDictionary *> *states;
+
+/// Whether a state file exists on disk.
+@property (readonly) BOOL exists;
+
+/// The number of calls to `setState:forKey:`.
+@property (readonly) NSUInteger saveCount;
+
+/// The number of files written or removed.
+@property (readonly) NSUInteger writeCount;
+
+/// The number of saved states replaced by a later save before they were written.
+@property (readonly) NSUInteger avoidedWriteCount;
+
+/// Saves the state of the given key, or removes it if nil.
+- (void) setState:(nullable NSDictionary *)state forKey:(NSString *)key;
+
+/// Writes the pending states, and returns once they are on disk.
+- (void) flush;
+
+/// Removes all the state files, and forgets all the states.
+- (void) clear;
+
+/// A directory suitable to store the states of the given name.
++ (NSString *) directoryForName:(NSString *)name;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,174 @@
+//
+//  WPSyncStateStore.m
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import "WPSyncStateStore.h"
+#import <WonderPushCommon/WPLog.h>
+#import <CommonCrypto/CommonDigest.h>
+
+#define FILE_PREFIX @"state-"
+#define FILE_EXTENSION @"json"
+
+@interface WPSyncStateStore ()
+@property (nonatomic, strong) NSString *directory;
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong, nullable) NSMutableDictionary<NSString *, NSDictionary *> *loadedStates;
+/// States waiting to be written, NSNull standing for a removal
+@property (nonatomic, strong) NSMutableDictionary<NSString *, id> *pendingStates;
+@property (nonatomic, assign) BOOL writeScheduled;
+@property (nonatomic, assign) NSUInteger saveCount;
+@property (nonatomic, assign) NSUInteger writeCount;
+@property (nonatomic, assign) NSUInteger avoidedWriteCount;
+@end
+
+@implementation WPSyncStateStore
+
++ (NSString *) directoryForName:(NSString *)name
+{
+    NSString *applicationSupport = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject] ?: NSTemporaryDirectory();
+    return [[applicationSupport stringByAppendingPathComponent:@"WonderPush/SyncState"] stringByAppendingPathComponent:name];
+}
+
+- (instancetype) initWithDirectory:(NSString *)directory
+{
+    if (self = [super init]) {
+        _directory = directory;
+        _queue = dispatch_queue_create("com.wonderpush.syncstatestore", DISPATCH_QUEUE_SERIAL);
+        _pendingStates = [NSMutableDictionary new];
+        _maxStaleness = WP_SYNC_STATE_STORE_DEFAULT_MAX_STALENESS;
+    }
+    return self;
+}
+
+#pragma mark - File names
+
+// Keys are user ids of any length, hash them to get file names that are safe and fit NAME_MAX,
+// the key itself is stored inside the file
+- (NSString *) pathForKey:(NSString *)key
+{
+    NSData *data = [key dataUsingEncoding:NSUTF8StringEncoding];
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+    NSMutableString *name = [NSMutableString stringWithString:FILE_PREFIX];
+    for (int i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+        [name appendFormat:@"%02x", digest[i]];
+    }
+    return [self.directory stringByAppendingPathComponent:[name stringByAppendingPathExtension:FILE_EXTENSION]];
+}
+
+- (NSArray<NSString *> *) fileNames
+{
+    NSArray *fileNames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.directory error:nil] ?: @[];
+    return [fileNames filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(NSString *fileName, NSDictionary *bindings) {
+        return [fileName hasPrefix:FILE_PREFIX] && [fileName.pathExtension isEqualToString:FILE_EXTENSION];
+    }]];
+}
+
+#pragma mark - States
+
+- (void) load
+{
+    if (self.loadedStates) return;
+    self.loadedStates = [NSMutableDictionary new];
+    for (NSString *fileName in [self fileNames]) {
+        NSData *data = [NSData dataWithContentsOfFile:[self.directory stringByAppendingPathComponent:fileName]];
+        id file = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+        id key = [file isKindOfClass:[NSDictionary class]] ? file[@"key"] : nil;
+        id state = [file isKindOfClass:[NSDictionary class]] ? file[@"state"] : nil;
+        if (![key isKindOfClass:[NSString class]] || ![state isKindOfClass:[NSDictionary class]]) {
+            WPLog(@"Ignoring unreadable sync state file %@", fileName);
+            continue;
+        }
+        self.loadedStates[key] = state;
+    }
+}
+
+- (NSDictionary<NSString *, NSDictionary *> *) states
+{
+    @synchronized (self) {
+        [self load];
+        return [NSDictionary dictionaryWithDictionary:self.loadedStates];
+    }
+}
+
+- (BOOL) exists
+{
+    return [self fileNames].count > 0;
+}
+
+- (void) setState:(NSDictionary *)state forKey:(NSString *)key
+{
+    @synchronized (self) {
+        [self load];
+        self.loadedStates[key] = state;
+        self.saveCount++;
+        if (self.pendingStates[key]) {
+            self.avoidedWriteCount++;
+        }
+        self.pendingStates[key] = state ?: [NSNull null];
+        if (self.writeScheduled) return;
+        self.writeScheduled = YES;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.maxStaleness * NSEC_PER_SEC)), self.queue, ^{
+            [self writePendingStates];
+        });
+    }
+}
+
+- (void) flush
+{
+    dispatch_sync(self.queue, ^{
+        [self writePendingStates];
+    });
+}
+
+// Runs on the queue, so that writes happen in the order of the saves
+- (void) writePendingStates
+{
+    NSDictionary<NSString *, id> *pendingStates;
+    @synchronized (self) {
+        pendingStates = [self.pendingStates copy];
+        [self.pendingStates removeAllObjects];
+        self.writeScheduled = NO;
+    }
+    if (pendingStates.count == 0) return;
+
+    [[NSFileManager defaultManager] createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+    [pendingStates enumerateKeysAndObjectsUsingBlock:^(NSString *key, id state, BOOL *stop) {
+        NSString *path = [self pathForKey:key];
+        if (state == [NSNull null]) {
+            [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        } else {
+            NSError *error = nil;
+            NSData *data = nil;
+            @try {
+                data = [NSJSONSerialization dataWithJSONObject:@{@"key": key, @"state": state} options:0 error:&error];
+            } @catch (id exception) {
+                WPLog(@"Failed to serialize sync state: %@", exception);
+            }
+            if (!data || ![data writeToFile:path options:NSDataWritingAtomic error:&error]) {
+                WPLog(@"Failed to write sync state file %@: %@", path.lastPathComponent, error);
+                return;
+            }
+        }
+        @synchronized (self) {
+            self.writeCount++;
+        }
+    }];
+}
+
+- (void) clear
+{
+    @synchronized (self) {
+        self.loadedStates = [NSMutableDictionary new];
+        [self.pendingStates removeAllObjects];
+    }
+    dispatch_sync(self.queue, ^{
+        [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+    });
+}
+
+@end
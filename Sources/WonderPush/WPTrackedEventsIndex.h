@@ -0,0 +1,71 @@
+//
+//  WPTrackedEventsIndex.h
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ An in-memory index over the list of tracked events.
+
+ Events are kept in the same four buckets as the stored list, in this order:
+ collapsing=last builtin events, collapsing=last custom events, other collapsed events and uncollapsed events,
+ each sorted by action date.
+ Per event type, it keeps the sorted action dates of uncollapsed events and the collapsing=last event,
+ so that remembering an event and computing its occurrences does not need to walk the whole history.
+ */
+@interface WPTrackedEventsIndex : NSObject
+
+@property (nonatomic, assign) NSInteger maximumCollapsedLastBuiltinTrackedEventsCount;
+@property (nonatomic, assign) NSInteger maximumCollapsedLastCustomTrackedEventsCount;
+@property (nonatomic, assign) NSInteger maximumCollapsedOtherTrackedEventsCount;
+@property (nonatomic, assign) NSInteger maximumUncollapsedTrackedEventsCount;
+@property (nonatomic, assign) NSInteger maximumUncollapsedTrackedEventsAgeMs;
+
+/// Whether the events given at initialization were already bucketed and sorted, and can be stored as is.
+@property (readonly) BOOL canonical;
+
+/// The events of all buckets, in stored order.
+@property (readonly) NSArray<NSDictionary *> *events;
+
+/**
+ The events of all buckets, in stored order, with their `creationDate` filled from their `actionDate` if missing.
+ The list is kept until the events change, and events keep their completed copy until they are dropped.
+ */
+@property (readonly) NSArray<NSDictionary *> *eventsWithCreationDate;
+
+- (instancetype) initWithEvents:(NSArray<NSDictionary *> *)events;
+
+/**
+ The events of the given type, or whose type starts with the given prefix, and the events whose type is neither a string nor null,
+ of all buckets, in no particular order, completed like `eventsWithCreationDate`.
+ */
+- (NSArray<NSDictionary *> *) eventsWithCreationDateOfType:(nullable NSString *)type typePrefix:(nullable NSString *)typePrefix;
+
+/**
+ Adds the given events, drops the events they collapse, the uncollapsed events that are too old,
+ and the oldest events of any bucket exceeding its maximum count.
+
+ @param uncollapsedEvent The event to store uncollapsed, if any.
+ @param collapsedEvent The event to store with its collapsing, if any.
+ @param removedIndexesOut The indexes of the removed events in the list of events before this call, in ascending order.
+ @param insertionsOut The inserted events, as `[index, event]` pairs relative to the resulting list, in ascending order.
+ @return The occurrences of the given event type.
+ */
+- (NSDictionary *) rememberEventOfType:(NSString *)type
+                            collapsing:(nullable NSString *)collapsing
+                            campaignId:(nullable NSString *)campaignId
+                      uncollapsedEvent:(nullable NSDictionary *)uncollapsedEvent
+                        collapsedEvent:(nullable NSDictionary *)collapsedEvent
+                                   now:(NSInteger)now
+                        removedIndexes:(NSArray<NSNumber *> * _Nullable * _Nullable)removedIndexesOut
+                            insertions:(NSArray<NSArray *> * _Nullable * _Nullable)insertionsOut;
+
+@end
+
+NS_ASSUME_NONNULL_END
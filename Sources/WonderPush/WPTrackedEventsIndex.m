@@ -0,0 +1,449 @@
+//
+//  WPTrackedEventsIndex.m
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import "WPTrackedEventsIndex.h"
+
+#define DAY_MS 86400000
+
+typedef NS_ENUM(NSUInteger, WPTrackedEventsBucket) {
+    WPTrackedEventsBucketCollapsedLastBuiltin = 0, // collapsing.equals("last") && type.startsWith("@")
+    WPTrackedEventsBucketCollapsedLastCustom, // collapsing.equals("last") && !type.startsWith("@")
+    WPTrackedEventsBucketCollapsedOther, // collapsing != null && !collapsing.equals("last") // ie. collapsing.equals("campaign"), as of this writing
+    WPTrackedEventsBucketUncollapsed, // collapsing == null
+    WPTrackedEventsBucketCount,
+};
+
+static WPTrackedEventsBucket bucketForEvent(id collapsing, id type) {
+    if (!collapsing) return WPTrackedEventsBucketUncollapsed;
+    if ([collapsing isKindOfClass:[NSString class]] && [@"last" isEqualToString:collapsing]) {
+        if ([type isKindOfClass:[NSString class]] && [type hasPrefix:@"@"]) {
+            return WPTrackedEventsBucketCollapsedLastBuiltin;
+        }
+        return WPTrackedEventsBucketCollapsedLastCustom;
+    }
+    return WPTrackedEventsBucketCollapsedOther;
+}
+
+static NSInteger sortKeyForEvent(NSDictionary *event) {
+    return event[@"actionDate"] ? [event[@"actionDate"] integerValue] : -1;
+}
+
+static NSInteger allTimeOccurrencesOfEvent(NSDictionary *event) {
+    return MAX(1, event[@"occurrences"] && event[@"occurrences"][@"allTime"] ? [event[@"occurrences"][@"allTime"] integerValue] : 1);
+}
+
+// Index of the first event strictly more recent than the given sort key
+static NSUInteger upperBoundInBucket(NSArray<NSDictionary *> *bucket, NSInteger sortKey) {
+    NSUInteger lo = 0, hi = bucket.count;
+    while (lo < hi) {
+        NSUInteger mid = lo + (hi - lo) / 2;
+        if (sortKeyForEvent(bucket[mid]) <= sortKey) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Index of the first date strictly greater than the given one
+static NSUInteger upperBoundInDates(NSArray<NSNumber *> *dates, NSInteger date) {
+    NSUInteger lo = 0, hi = dates.count;
+    while (lo < hi) {
+        NSUInteger mid = lo + (hi - lo) / 2;
+        if (dates[mid].integerValue <= date) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+@interface WPTrackedEventsTypeIndex : NSObject
+@property (nonatomic, strong) NSMutableArray<NSDictionary *> *events;
+/// Sorted action dates of the uncollapsed events
+@property (nonatomic, strong) NSMutableArray<NSNumber *> *uncollapsedActionDates;
+/// Uncollapsed events without an action date, which always count as happening now
+@property (nonatomic, assign) NSInteger undatedUncollapsedCount;
+@property (nonatomic, strong, nullable) NSDictionary *collapsedLastEvent;
+@end
+
+@implementation WPTrackedEventsTypeIndex
+
+- (instancetype) init
+{
+    if (self = [super init]) {
+        _events = [NSMutableArray new];
+        _uncollapsedActionDates = [NSMutableArray new];
+    }
+    return self;
+}
+
+@end
+
+@interface WPTrackedEventsIndex ()
+@property (nonatomic, strong) NSArray<NSMutableArray<NSDictionary *> *> *buckets;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, WPTrackedEventsTypeIndex *> *types;
+@property (nonatomic, strong) NSMutableDictionary<NSArray *, NSDictionary *> *collapsedCampaignEvents;
+/// Events whose type is neither a string nor null
+@property (nonatomic, strong) NSMutableArray<NSDictionary *> *irregularlyTypedEvents;
+/// Copies of the events missing a creationDate, by stored event identity, see eventWithCreationDate:
+@property (nonatomic, strong) NSMapTable<NSDictionary *, NSDictionary *> *completedEvents;
+@property (nonatomic, strong, nullable) NSArray<NSDictionary *> *cachedEventsWithCreationDate;
+@property (nonatomic, assign) BOOL canonical;
+@end
+
+@implementation WPTrackedEventsIndex
+
+- (instancetype) initWithEvents:(NSArray<NSDictionary *> *)events
+{
+    if (self = [super init]) {
+        NSMutableArray *buckets = [NSMutableArray new];
+        for (NSUInteger i = 0; i < WPTrackedEventsBucketCount; i++) {
+            [buckets addObject:[NSMutableArray new]];
+        }
+        for (NSDictionary *event in events) {
+            [buckets[bucketForEvent(event[@"collapsing"], event[@"type"])] addObject:event];
+        }
+        NSComparator comparator = ^(id o1, id o2) {
+            NSInteger delta = sortKeyForEvent(o1) - sortKeyForEvent(o2);
+            if (delta < 0) return NSOrderedAscending;
+            if (delta > 0) return NSOrderedDescending;
+            return NSOrderedSame;
+        };
+        for (NSMutableArray *bucket in buckets) {
+            [bucket sortWithOptions:NSSortStable usingComparator:comparator];
+        }
+        _buckets = [NSArray arrayWithArray:buckets];
+        _types = [NSMutableDictionary new];
+        _collapsedCampaignEvents = [NSMutableDictionary new];
+        _irregularlyTypedEvents = [NSMutableArray new];
+        _completedEvents = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+
+        // Only the most recent collapsed event of a given kind is kept
+        for (NSUInteger bucket = 0; bucket < WPTrackedEventsBucketUncollapsed; bucket++) {
+            NSMutableArray *bucketEvents = _buckets[bucket];
+            NSMutableSet *seenKeys = [NSMutableSet new];
+            NSMutableIndexSet *duplicates = [NSMutableIndexSet new];
+            for (NSInteger i = bucketEvents.count - 1; i >= 0; i--) {
+                id key = [self collapsingKeyForEvent:bucketEvents[i] inBucket:bucket];
+                if (!key) continue;
+                if ([seenKeys containsObject:key]) [duplicates addIndex:i];
+                else [seenKeys addObject:key];
+            }
+            [bucketEvents removeObjectsAtIndexes:duplicates];
+        }
+
+        for (NSUInteger bucket = 0; bucket < WPTrackedEventsBucketCount; bucket++) {
+            for (NSDictionary *event in _buckets[bucket]) {
+                [self indexEvent:event inBucket:bucket];
+            }
+        }
+
+        NSArray *canonicalEvents = self.events;
+        _canonical = canonicalEvents.count == events.count;
+        for (NSUInteger i = 0; _canonical && i < events.count; i++) {
+            _canonical = canonicalEvents[i] == events[i];
+        }
+    }
+    return self;
+}
+
+- (NSArray<NSDictionary *> *) events
+{
+    NSMutableArray *rtn = [NSMutableArray new];
+    for (NSArray *bucket in self.buckets) {
+        [rtn addObjectsFromArray:bucket];
+    }
+    return [NSArray arrayWithArray:rtn];
+}
+
+- (NSArray<NSDictionary *> *) eventsWithCreationDateOfType:(NSString *)type typePrefix:(NSString *)typePrefix
+{
+    NSMutableArray *rtn = [NSMutableArray new];
+    if (type) {
+        for (NSDictionary *event in self.types[type].events) {
+            [rtn addObject:[self eventWithCreationDate:event]];
+        }
+    } else if (typePrefix) {
+        [self.types enumerateKeysAndObjectsUsingBlock:^(NSString *eventType, WPTrackedEventsTypeIndex *typeIndex, BOOL *stop) {
+            if (![eventType hasPrefix:typePrefix]) return;
+            for (NSDictionary *event in typeIndex.events) {
+                [rtn addObject:[self eventWithCreationDate:event]];
+            }
+        }];
+    } else {
+        return self.eventsWithCreationDate;
+    }
+    for (NSDictionary *event in self.irregularlyTypedEvents) {
+        [rtn addObject:[self eventWithCreationDate:event]];
+    }
+    return [NSArray arrayWithArray:rtn];
+}
+
+- (NSArray<NSDictionary *> *) eventsWithCreationDate
+{
+    if (!self.cachedEventsWithCreationDate) {
+        NSMutableArray *rtn = [NSMutableArray new];
+        for (NSArray *bucket in self.buckets) {
+            for (NSDictionary *event in bucket) {
+                [rtn addObject:[self eventWithCreationDate:event]];
+            }
+        }
+        self.cachedEventsWithCreationDate = [NSArray arrayWithArray:rtn];
+    }
+    return self.cachedEventsWithCreationDate;
+}
+
+- (NSDictionary *) eventWithCreationDate:(NSDictionary *)event
+{
+    if (event[@"creationDate"] || !event[@"actionDate"]) return event;
+    NSDictionary *completed = [self.completedEvents objectForKey:event];
+    if (!completed) {
+        NSMutableDictionary *copy = [event mutableCopy];
+        copy[@"creationDate"] = copy[@"actionDate"];
+        completed = [NSDictionary dictionaryWithDictionary:copy];
+        [self.completedEvents setObject:completed forKey:event];
+    }
+    return completed;
+}
+
+#pragma mark - Indexing
+
+- (id) collapsingKeyForEvent:(NSDictionary *)event inBucket:(NSUInteger)bucket
+{
+    id type = event[@"type"];
+    if (![type isKindOfClass:[NSString class]]) return nil;
+    if (bucket == WPTrackedEventsBucketCollapsedLastBuiltin || bucket == WPTrackedEventsBucketCollapsedLastCustom) {
+        return type;
+    }
+    if (bucket == WPTrackedEventsBucketCollapsedOther) {
+        id campaignId = event[@"campaignId"];
+        if ([@"campaign" isEqual:event[@"collapsing"]] && [campaignId isKindOfClass:[NSString class]]) {
+            return @[type, campaignId];
+        }
+    }
+    return nil;
+}
+
+- (void) indexEvent:(NSDictionary *)event inBucket:(NSUInteger)bucket
+{
+    NSString *type = event[@"type"];
+    if (![type isKindOfClass:[NSString class]]) {
+        if (type && (id)type != [NSNull null]) [self.irregularlyTypedEvents addObject:event];
+        return;
+    }
+    WPTrackedEventsTypeIndex *typeIndex = self.types[type];
+    if (!typeIndex) {
+        typeIndex = [WPTrackedEventsTypeIndex new];
+        self.types[type] = typeIndex;
+    }
+    [typeIndex.events addObject:event];
+    switch (bucket) {
+        case WPTrackedEventsBucketUncollapsed: {
+            NSNumber *actionDate = event[@"actionDate"];
+            if (actionDate) {
+                [typeIndex.uncollapsedActionDates insertObject:actionDate atIndex:upperBoundInDates(typeIndex.uncollapsedActionDates, actionDate.integerValue)];
+            } else {
+                typeIndex.undatedUncollapsedCount++;
+            }
+            break;
+        }
+        case WPTrackedEventsBucketCollapsedLastBuiltin:
+        case WPTrackedEventsBucketCollapsedLastCustom:
+            typeIndex.collapsedLastEvent = event;
+            break;
+        case WPTrackedEventsBucketCollapsedOther: {
+            id key = [self collapsingKeyForEvent:event inBucket:bucket];
+            if (key) self.collapsedCampaignEvents[key] = event;
+            break;
+        }
+    }
+}
+
+- (void) unindexEvent:(NSDictionary *)event inBucket:(NSUInteger)bucket
+{
+    [self.completedEvents removeObjectForKey:event];
+    NSString *type = event[@"type"];
+    if (![type isKindOfClass:[NSString class]]) {
+        NSUInteger index = [self.irregularlyTypedEvents indexOfObjectIdenticalTo:event];
+        if (index != NSNotFound) [self.irregularlyTypedEvents removeObjectAtIndex:index];
+        return;
+    }
+    WPTrackedEventsTypeIndex *typeIndex = self.types[type];
+    if (!typeIndex) return;
+    // Events are mostly removed from the oldest, which come first
+    NSUInteger index = [typeIndex.events indexOfObjectIdenticalTo:event];
+    if (index != NSNotFound) [typeIndex.events removeObjectAtIndex:index];
+    switch (bucket) {
+        case WPTrackedEventsBucketUncollapsed: {
+            NSNumber *actionDate = event[@"actionDate"];
+            if (actionDate) {
+                NSUInteger dateIndex = upperBoundInDates(typeIndex.uncollapsedActionDates, actionDate.integerValue);
+                if (dateIndex > 0 && typeIndex.uncollapsedActionDates[dateIndex - 1].integerValue == actionDate.integerValue) {
+                    [typeIndex.uncollapsedActionDates removeObjectAtIndex:dateIndex - 1];
+                }
+            } else {
+                typeIndex.undatedUncollapsedCount--;
+            }
+            break;
+        }
+        case WPTrackedEventsBucketCollapsedLastBuiltin:
+        case WPTrackedEventsBucketCollapsedLastCustom:
+            if (typeIndex.collapsedLastEvent == event) typeIndex.collapsedLastEvent = nil;
+            break;
+        case WPTrackedEventsBucketCollapsedOther: {
+            id key = [self collapsingKeyForEvent:event inBucket:bucket];
+            if (key && self.collapsedCampaignEvents[key] == event) [self.collapsedCampaignEvents removeObjectForKey:key];
+            break;
+        }
+    }
+    if (typeIndex.events.count == 0) [self.types removeObjectForKey:type];
+}
+
+- (NSInteger) maximumCountForBucket:(NSUInteger)bucket
+{
+    switch (bucket) {
+        case WPTrackedEventsBucketCollapsedLastBuiltin: return self.maximumCollapsedLastBuiltinTrackedEventsCount;
+        case WPTrackedEventsBucketCollapsedLastCustom: return self.maximumCollapsedLastCustomTrackedEventsCount;
+        case WPTrackedEventsBucketCollapsedOther: return self.maximumCollapsedOtherTrackedEventsCount;
+        default: return self.maximumUncollapsedTrackedEventsCount;
+    }
+}
+
+#pragma mark - Remembering
+
+- (NSDictionary *) rememberEventOfType:(NSString *)type
+                            collapsing:(NSString *)collapsing
+                            campaignId:(NSString *)campaignId
+                      uncollapsedEvent:(NSDictionary *)uncollapsedEvent
+                        collapsedEvent:(NSDictionary *)collapsedEvent
+                                   now:(NSInteger)now
+                        removedIndexes:(NSArray<NSNumber *> **)removedIndexesOut
+                            insertions:(NSArray<NSArray *> **)insertionsOut
+{
+    NSInteger allTime = 0;
+    NSMutableIndexSet *removed[WPTrackedEventsBucketCount];
+    NSDictionary *inserted[WPTrackedEventsBucketCount];
+    NSUInteger insertionPoints[WPTrackedEventsBucketCount];
+    for (NSUInteger bucket = 0; bucket < WPTrackedEventsBucketCount; bucket++) {
+        removed[bucket] = [NSMutableIndexSet new];
+        inserted[bucket] = nil;
+        insertionPoints[bucket] = NSNotFound;
+    }
+
+    // Filter out the collapsing=last event of the same type as the new event we want to add
+    if (!collapsing || [@"last" isEqualToString:collapsing]) {
+        NSDictionary *previous = self.types[type].collapsedLastEvent;
+        if (previous) {
+            allTime = allTimeOccurrencesOfEvent(previous);
+            WPTrackedEventsBucket bucket = bucketForEvent(@"last", type);
+            NSUInteger index = [self.buckets[bucket] indexOfObjectIdenticalTo:previous];
+            if (index != NSNotFound) [removed[bucket] addIndex:index];
+        }
+    }
+    // Filter out the collapsing=campaign event of the same type and campaign as the new event we want to add
+    if (campaignId && [@"campaign" isEqualToString:collapsing]) {
+        NSDictionary *previous = self.collapsedCampaignEvents[@[type, campaignId]];
+        if (previous) {
+            allTime = allTimeOccurrencesOfEvent(previous);
+            NSUInteger index = [self.buckets[WPTrackedEventsBucketCollapsedOther] indexOfObjectIdenticalTo:previous];
+            if (index != NSNotFound) [removed[WPTrackedEventsBucketCollapsedOther] addIndex:index];
+        }
+    }
+    // Filter out old uncollapsed events, they come first as the bucket is sorted
+    // TODO We may want to filter out old collapsing=campaign (or any non-null value other than "last") events too
+    NSArray *uncollapsedBucket = self.buckets[WPTrackedEventsBucketUncollapsed];
+    for (NSUInteger i = 0; i < uncollapsedBucket.count; i++) {
+        NSNumber *actionDate = uncollapsedBucket[i][@"actionDate"];
+        if (!actionDate) continue;
+        if (now - actionDate.integerValue < self.maximumUncollapsedTrackedEventsAgeMs) break;
+        [removed[WPTrackedEventsBucketUncollapsed] addIndex:i];
+    }
+
+    // Add the new event, uncollapsed, only if it's not too old
+    if (uncollapsedEvent) {
+        NSNumber *actionDate = uncollapsedEvent[@"actionDate"] ?: @(now);
+        if (now - actionDate.integerValue < self.maximumUncollapsedTrackedEventsAgeMs) {
+            inserted[WPTrackedEventsBucketUncollapsed] = uncollapsedEvent;
+        }
+    }
+    // Add the new event with collapsing
+    if (collapsedEvent) {
+        allTime += 1;
+        inserted[bucketForEvent(collapsedEvent[@"collapsing"], type)] = collapsedEvent;
+    }
+
+    // Impose a limit on the maximum number of tracked events, by removing the oldest
+    for (NSUInteger bucket = 0; bucket < WPTrackedEventsBucketCount; bucket++) {
+        NSArray *bucketEvents = self.buckets[bucket];
+        if (inserted[bucket]) insertionPoints[bucket] = upperBoundInBucket(bucketEvents, sortKeyForEvent(inserted[bucket]));
+        NSInteger excess = (NSInteger)bucketEvents.count - (NSInteger)removed[bucket].count + (inserted[bucket] ? 1 : 0) - [self maximumCountForBucket:bucket];
+        NSUInteger i = 0;
+        while (excess > 0) {
+            if (inserted[bucket] && i == insertionPoints[bucket]) {
+                inserted[bucket] = nil;
+                excess--;
+                continue;
+            }
+            if (i >= bucketEvents.count) break;
+            if (![removed[bucket] containsIndex:i]) {
+                [removed[bucket] addIndex:i];
+                excess--;
+            }
+            i++;
+        }
+    }
+
+    // Apply, and describe the changes relative to the whole list
+    self.cachedEventsWithCreationDate = nil;
+    NSMutableArray<NSNumber *> *removedIndexes = [NSMutableArray new];
+    NSMutableArray<NSArray *> *insertions = [NSMutableArray new];
+    NSUInteger oldOffset = 0, newOffset = 0;
+    for (NSUInteger bucket = 0; bucket < WPTrackedEventsBucketCount; bucket++) {
+        NSMutableArray *bucketEvents = self.buckets[bucket];
+        NSUInteger oldCount = bucketEvents.count;
+        [removed[bucket] enumerateIndexesUsingBlock:^(NSUInteger idx, BOOL * _Nonnull stop) {
+            [removedIndexes addObject:@(oldOffset + idx)];
+            [self unindexEvent:bucketEvents[idx] inBucket:bucket];
+        }];
+        NSUInteger insertionIndex = 0;
+        if (inserted[bucket]) {
+            insertionIndex = insertionPoints[bucket] - [removed[bucket] countOfIndexesInRange:NSMakeRange(0, insertionPoints[bucket])];
+        }
+        [bucketEvents removeObjectsAtIndexes:removed[bucket]];
+        if (inserted[bucket]) {
+            [bucketEvents insertObject:inserted[bucket] atIndex:insertionIndex];
+            [self indexEvent:inserted[bucket] inBucket:bucket];
+            [insertions addObject:@[@(newOffset + insertionIndex), inserted[bucket]]];
+        }
+        oldOffset += oldCount;
+        newOffset += bucketEvents.count;
+    }
+
+    // Compute occurrences
+    WPTrackedEventsTypeIndex *typeIndex = self.types[type];
+    NSArray<NSNumber *> *dates = typeIndex.uncollapsedActionDates;
+    NSInteger undated = typeIndex.undatedUncollapsedCount;
+    NSInteger uncollapsedCount = dates.count + undated;
+    // An event counts for the last N days if floor((now - actionDate) / DAY_MS) <= N
+    NSInteger (^countLastDays)(NSInteger) = ^NSInteger(NSInteger days) {
+        return undated + (NSInteger)dates.count - (NSInteger)upperBoundInDates(dates, now - (days + 1) * (NSInteger)DAY_MS);
+    };
+    NSDictionary *occurrences = @{
+        @"allTime": @(MAX(uncollapsedCount, allTime)),
+        @"last1days": @(countLastDays(1)),
+        @"last3days": @(countLastDays(3)),
+        @"last7days": @(countLastDays(7)),
+        @"last15days": @(countLastDays(15)),
+        @"last30days": @(countLastDays(30)),
+        @"last60days": @(countLastDays(60)),
+        @"last90days": @(countLastDays(90)),
+    };
+
+    if (removedIndexesOut) *removedIndexesOut = [NSArray arrayWithArray:removedIndexes];
+    if (insertionsOut) *insertionsOut = [NSArray arrayWithArray:insertions];
+    return occurrences;
+}
+
+@end
@@ -0,0 +1,56 @@
+//
+//  WPTrackedEventsJournal.h
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ An on-disk, append-only store for the list of tracked events.
+
+ The list is persisted as a JSON snapshot file plus a journal file holding one JSON record per line.
+ Each call to `commitRemovedIndexes:insertions:` appends a single record describing the removed and inserted events,
+ so remembering an event costs a constant amount of I/O instead of rewriting the whole history.
+ The journal is folded back into the snapshot once it grows larger than the list itself.
+ */
+@interface WPTrackedEventsJournal : NSObject
+
+- (instancetype) initWithDirectory:(NSString *)directory name:(NSString *)name;
+
+/// Whether a snapshot or a journal file exists on disk.
+@property (readonly) BOOL exists;
+
+/// The current list of events, loaded from disk on first access and kept in memory afterwards.
+/// The same immutable array is returned until the events change.
+@property (readonly) NSArray<NSDictionary *> *events;
+
+/// The number of records appended to the journal since the last compaction.
+@property (readonly) NSUInteger journalRecordCount;
+
+/**
+ Applies the given changes to the current list and appends them to the journal.
+
+ @param removedIndexes The indexes of the events to remove from the current list, in ascending order.
+ @param insertions The events to insert, as `[index, event]` pairs relative to the resulting list, in ascending order.
+ */
+- (void) commitRemovedIndexes:(NSArray<NSNumber *> *)removedIndexes insertions:(NSArray<NSArray *> *)insertions;
+
+/// Rewrites the snapshot with the given events and truncates the journal.
+- (void) replaceEvents:(nullable NSArray<NSDictionary *> *)events;
+
+/// Rewrites the snapshot with the current events and truncates the journal.
+- (void) compact;
+
+/// Removes the snapshot and the journal files, and empties the list.
+- (void) clear;
+
++ (NSString *) defaultDirectory;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,295 @@
+//
+//  WPTrackedEventsJournal.m
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import "WPTrackedEventsJournal.h"
+#import <WonderPushCommon/WPLog.h>
+
+// Never compact before this many journal records, to keep small histories from being rewritten too often
+#define MINIMUM_JOURNAL_RECORDS_BEFORE_COMPACTION 100
+
+@interface WPTrackedEventsJournal ()
+@property (nonatomic, strong) NSString *snapshotPath;
+@property (nonatomic, strong) NSString *journalPath;
+@property (nonatomic, strong) NSMutableArray<NSDictionary *> *loadedEvents;
+/// An immutable copy of `loadedEvents`, nil until asked for after they changed
+@property (nonatomic, strong, nullable) NSArray<NSDictionary *> *eventsSnapshot;
+@property (nonatomic, assign) NSInteger generation;
+@property (nonatomic, assign) NSUInteger journalRecordCount;
+@end
+
+@implementation WPTrackedEventsJournal
+
++ (NSString *) defaultDirectory
+{
+    NSString *applicationSupport = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject] ?: NSTemporaryDirectory();
+    return [applicationSupport stringByAppendingPathComponent:@"WonderPush"];
+}
+
+- (instancetype) initWithDirectory:(NSString *)directory name:(NSString *)name
+{
+    if (self = [super init]) {
+        _snapshotPath = [directory stringByAppendingPathComponent:[name stringByAppendingString:@".snapshot.json"]];
+        _journalPath = [directory stringByAppendingPathComponent:[name stringByAppendingString:@".journal"]];
+    }
+    return self;
+}
+
+- (BOOL) exists
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    return [fileManager fileExistsAtPath:self.snapshotPath] || [fileManager fileExistsAtPath:self.journalPath];
+}
+
+- (NSArray<NSDictionary *> *) events
+{
+    @synchronized (self) {
+        [self load];
+        if (!self.eventsSnapshot) {
+            self.eventsSnapshot = [NSArray arrayWithArray:self.loadedEvents];
+        }
+        return self.eventsSnapshot;
+    }
+}
+
+- (NSUInteger) journalRecordCount
+{
+    @synchronized (self) {
+        [self load];
+        return _journalRecordCount;
+    }
+}
+
+#pragma mark - Loading
+
+- (void) load
+{
+    if (self.loadedEvents) return;
+
+    NSMutableArray *events = [NSMutableArray new];
+    NSInteger generation = 0;
+    NSData *snapshotData = [NSData dataWithContentsOfFile:self.snapshotPath];
+    if (snapshotData) {
+        NSError *error = nil;
+        id snapshot = [NSJSONSerialization JSONObjectWithData:snapshotData options:kNilOptions error:&error];
+        if (error || ![snapshot isKindOfClass:[NSDictionary class]]) {
+            WPLog(@"WPTrackedEventsJournal: Error while reading snapshot %@: %@", self.snapshotPath, error);
+        } else {
+            id snapshotEvents = snapshot[@"events"];
+            if ([snapshotEvents isKindOfClass:[NSArray class]]) {
+                [events addObjectsFromArray:snapshotEvents];
+            }
+            if ([snapshot[@"generation"] isKindOfClass:[NSNumber class]]) {
+                generation = [snapshot[@"generation"] integerValue];
+            }
+        }
+    }
+
+    NSUInteger recordCount = 0;
+    BOOL corrupted = NO;
+    NSData *journalData = [NSData dataWithContentsOfFile:self.journalPath];
+    const char *bytes = journalData.bytes;
+    NSUInteger length = journalData.length;
+    NSUInteger lineStart = 0;
+    while (lineStart < length) {
+        const char *newline = memchr(bytes + lineStart, '\n', length - lineStart);
+        if (!newline) {
+            // A record is only valid once its trailing newline is written, this one was interrupted
+            corrupted = YES;
+            break;
+        }
+        NSUInteger lineEnd = newline - bytes;
+        NSData *line = [journalData subdataWithRange:NSMakeRange(lineStart, lineEnd - lineStart)];
+        lineStart = lineEnd + 1;
+        if (line.length == 0) continue;
+        NSError *error = nil;
+        id record = [NSJSONSerialization JSONObjectWithData:line options:kNilOptions error:&error];
+        if (error || ![record isKindOfClass:[NSDictionary class]]) {
+            corrupted = YES;
+            break;
+        }
+        // Records left over from before the last compaction were already folded into the snapshot
+        if (![record[@"g"] isKindOfClass:[NSNumber class]] || [record[@"g"] integerValue] != generation) continue;
+        if (![self applyRecord:record toEvents:events]) {
+            corrupted = YES;
+            break;
+        }
+        recordCount++;
+    }
+
+    self.loadedEvents = events;
+    self.eventsSnapshot = nil;
+    self.generation = generation;
+    _journalRecordCount = recordCount;
+
+    if (corrupted) {
+        WPLog(@"WPTrackedEventsJournal: Ignoring the unreadable end of %@", self.journalPath);
+        [self writeSnapshot];
+    }
+}
+
+- (BOOL) applyRecord:(NSDictionary *)record toEvents:(NSMutableArray *)events
+{
+    id removed = record[@"r"];
+    id inserted = record[@"i"];
+    if (removed && ![removed isKindOfClass:[NSArray class]]) return NO;
+    if (inserted && ![inserted isKindOfClass:[NSArray class]]) return NO;
+
+    NSMutableIndexSet *removedIndexes = [NSMutableIndexSet new];
+    for (id index in (NSArray *)removed) {
+        if (![index isKindOfClass:[NSNumber class]]) return NO;
+        NSInteger i = [index integerValue];
+        if (i < 0 || i >= (NSInteger)events.count) return NO;
+        [removedIndexes addIndex:i];
+    }
+    [events removeObjectsAtIndexes:removedIndexes];
+
+    for (id insertion in (NSArray *)inserted) {
+        if (![insertion isKindOfClass:[NSArray class]] || [insertion count] != 2) return NO;
+        id position = insertion[0];
+        id event = insertion[1];
+        if (![position isKindOfClass:[NSNumber class]] || ![event isKindOfClass:[NSDictionary class]]) return NO;
+        NSInteger i = [position integerValue];
+        if (i < 0 || i > (NSInteger)events.count) return NO;
+        [events insertObject:event atIndex:i];
+    }
+    return YES;
+}
+
+#pragma mark - Writing
+
+- (void) commitRemovedIndexes:(NSArray<NSNumber *> *)removedIndexes insertions:(NSArray<NSArray *> *)insertions
+{
+    @synchronized (self) {
+        [self load];
+        if (removedIndexes.count == 0 && insertions.count == 0) return;
+
+        NSDictionary *record = @{
+            @"g": @(self.generation),
+            @"r": removedIndexes,
+            @"i": insertions,
+        };
+        self.eventsSnapshot = nil;
+        if (![self applyRecord:record toEvents:self.loadedEvents]) {
+            WPLog(@"WPTrackedEventsJournal: Ignoring changes that do not apply to the current events");
+            return;
+        }
+        if (self.journalRecordCount + 1 > MAX(MINIMUM_JOURNAL_RECORDS_BEFORE_COMPACTION, self.loadedEvents.count)
+            || ![self appendRecord:record]) {
+            [self writeSnapshot];
+        }
+    }
+}
+
+- (void) replaceEvents:(NSArray<NSDictionary *> *)events
+{
+    @synchronized (self) {
+        self.loadedEvents = [(events ?: @[]) mutableCopy];
+        self.eventsSnapshot = nil;
+        [self writeSnapshot];
+    }
+}
+
+- (void) compact
+{
+    @synchronized (self) {
+        [self load];
+        [self writeSnapshot];
+    }
+}
+
+- (void) clear
+{
+    @synchronized (self) {
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        [fileManager removeItemAtPath:self.snapshotPath error:nil];
+        [fileManager removeItemAtPath:self.journalPath error:nil];
+        self.loadedEvents = [NSMutableArray new];
+        self.eventsSnapshot = nil;
+        self.generation = 0;
+        _journalRecordCount = 0;
+    }
+}
+
+- (BOOL) ensureDirectory
+{
+    NSError *error = nil;
+    NSString *directory = [self.snapshotPath stringByDeletingLastPathComponent];
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:&error]) {
+        WPLog(@"WPTrackedEventsJournal: Error while creating directory %@: %@", directory, error);
+        return NO;
+    }
+    return YES;
+}
+
+- (BOOL) appendRecord:(NSDictionary *)record
+{
+    NSMutableData *line;
+    @try {
+        NSError *error = nil;
+        NSData *data = [NSJSONSerialization dataWithJSONObject:record options:kNilOptions error:&error];
+        if (error) {
+            WPLog(@"WPTrackedEventsJournal: Error while serializing record: %@", error);
+            return NO;
+        }
+        line = [data mutableCopy];
+        [line appendBytes:"\n" length:1];
+    } @catch (NSException *exception) {
+        WPLog(@"WPTrackedEventsJournal: Error while serializing record: %@", exception);
+        return NO;
+    }
+
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    if (![fileManager fileExistsAtPath:self.journalPath]) {
+        if (![self ensureDirectory]) return NO;
+        if (![fileManager createFileAtPath:self.journalPath contents:nil attributes:nil]) {
+            WPLog(@"WPTrackedEventsJournal: Could not create %@", self.journalPath);
+            return NO;
+        }
+    }
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:self.journalPath];
+    if (!fileHandle) return NO;
+    @try {
+        [fileHandle seekToEndOfFile];
+        [fileHandle writeData:line];
+    } @catch (NSException *exception) {
+        WPLog(@"WPTrackedEventsJournal: Error while appending to %@: %@", self.journalPath, exception);
+        return NO;
+    } @finally {
+        [fileHandle closeFile];
+    }
+    _journalRecordCount++;
+    return YES;
+}
+
+- (void) writeSnapshot
+{
+    if (![self ensureDirectory]) return;
+    // Bumping the generation invalidates any record still present in the journal,
+    // should we get interrupted before it is removed
+    NSInteger generation = self.generation + 1;
+    @try {
+        NSError *error = nil;
+        NSData *data = [NSJSONSerialization dataWithJSONObject:@{@"generation": @(generation), @"events": self.loadedEvents} options:kNilOptions error:&error];
+        if (error) {
+            WPLog(@"WPTrackedEventsJournal: Error while serializing snapshot: %@", error);
+            return;
+        }
+        if (![data writeToFile:self.snapshotPath options:NSDataWritingAtomic error:&error]) {
+            WPLog(@"WPTrackedEventsJournal: Error while writing %@: %@", self.snapshotPath, error);
+            return;
+        }
+    } @catch (NSException *exception) {
+        WPLog(@"WPTrackedEventsJournal: Error while serializing snapshot: %@", exception);
+        return;
+    }
+    self.generation = generation;
+    [[NSFileManager defaultManager] removeItemAtPath:self.journalPath error:nil];
+    _journalRecordCount = 0;
+}
+
+@end
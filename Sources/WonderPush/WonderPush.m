@@ -410,33 +410,34 @@ NSString * const WPEventFiredNotificationEventOccurrencesKey = @"WPEventFiredNot
             });
             return;
         }
+        WPRemoteConfigSnapshot *snapshot = config.snapshot;
         // API client
-        WPAPIClient.sharedClient.disabled = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_DISABLE_API_CLIENT_KEY inDictionary:config.data] boolValue];
+        WPAPIClient.sharedClient.disabled = snapshot.disableApiClient;
         if (!WPAPIClient.sharedClient.disabled) {
             [WPAPIClient.sharedClient restoreQueue];
         }
         // Anonymous API client
-        WPAnonymousAPIClient.sharedClient.disabled = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_DISABLE_ANONYMOUS_API_CLIENT_KEY inDictionary:config.data] boolValue];
+        WPAnonymousAPIClient.sharedClient.disabled = snapshot.disableAnonymousApiClient;
         if (!WPAnonymousAPIClient.sharedClient.disabled) {
             [WPAnonymousAPIClient.sharedClient restoreQueue];
         }
         // JSONSync
-        WPJsonSyncInstallation.disabled = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_DISABLE_JSON_SYNC_KEY inDictionary:config.data] boolValue];
+        WPJsonSyncInstallation.disabled = snapshot.disableJsonSync;
         if (!WPJsonSyncInstallation.disabled) {
             [WPJsonSyncInstallation flush];
         }
         // Measurements API
-        [self measurementsApiClient].disabled = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_DISABLE_MEASUREMENTS_API_CLIENT_KEY inDictionary:config.data] boolValue];
+        [self measurementsApiClient].disabled = snapshot.disableMeasurementsApiClient;
         if (![self measurementsApiClient].disabled) {
             // Ensure request vault is started
             [[self measurementsApiRequestVault] restoreQueue];
         }
         // Events collapsing
-        WPConfiguration.sharedConfiguration.maximumUncollapsedTrackedEventsAgeMs = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_TRACKED_EVENTS_UNCOLLAPSED_MAXIMUM_AGE_MS_KEY inDictionary:config.data defaultValue:[NSNumber numberWithInteger:DEFAULT_MAXIMUM_UNCOLLAPSED_TRACKED_EVENTS_AGE_MS]] integerValue];
-        WPConfiguration.sharedConfiguration.maximumUncollapsedTrackedEventsCount = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_TRACKED_EVENTS_UNCOLLAPSED_MAXIMUM_COUNT_KEY inDictionary:config.data defaultValue:[NSNumber numberWithInteger:DEFAULT_MAXIMUM_UNCOLLAPSED_TRACKED_EVENTS_COUNT]] integerValue];
-        WPConfiguration.sharedConfiguration.maximumCollapsedLastBuiltinTrackedEventsCount = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_TRACKED_EVENTS_COLLAPSED_LAST_BUILTIN_MAXIMUM_COUNT_KEY inDictionary:config.data defaultValue:[NSNumber numberWithInteger:DEFAULT_MAXIMUM_COLLAPSED_LAST_BUILTIN_TRACKED_EVENTS_COUNT]] integerValue];
-        WPConfiguration.sharedConfiguration.maximumCollapsedLastCustomTrackedEventsCount = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_TRACKED_EVENTS_COLLAPSED_LAST_CUSTOM_MAXIMUM_COUNT_KEY inDictionary:config.data defaultValue:[NSNumber numberWithInteger:DEFAULT_MAXIMUM_COLLAPSED_LAST_CUSTOM_TRACKED_EVENTS_COUNT]] integerValue];
-        WPConfiguration.sharedConfiguration.maximumCollapsedOtherTrackedEventsCount = [[WPNSUtil numberForKey:WP_REMOTE_CONFIG_TRACKED_EVENTS_COLLAPSED_OTHER_MAXIMUM_COUNT_KEY inDictionary:config.data defaultValue:[NSNumber numberWithInteger:DEFAULT_MAXIMUM_COLLAPSED_OTHER_TRACKED_EVENTS_COUNT]] integerValue];
+        WPConfiguration.sharedConfiguration.maximumUncollapsedTrackedEventsAgeMs = snapshot.trackedEventsUncollapsedMaximumAgeMs;
+        WPConfiguration.sharedConfiguration.maximumUncollapsedTrackedEventsCount = snapshot.trackedEventsUncollapsedMaximumCount;
+        WPConfiguration.sharedConfiguration.maximumCollapsedLastBuiltinTrackedEventsCount = snapshot.trackedEventsCollapsedLastBuiltinMaximumCount;
+        WPConfiguration.sharedConfiguration.maximumCollapsedLastCustomTrackedEventsCount = snapshot.trackedEventsCollapsedLastCustomMaximumCount;
+        WPConfiguration.sharedConfiguration.maximumCollapsedOtherTrackedEventsCount = snapshot.trackedEventsCollapsedOtherMaximumCount;
     }];
 }
 
@@ -1368,7 +1369,7 @@ NSString * const WPEventFiredNotificationEventOccurrencesKey = @"WPEventFiredNot
         [self sendPresenceAndAppOpenIfNecessary:presence];
     } else {
         [WonderPush.remoteConfigManager read:^(WPRemoteConfig *config, NSError *error) {
-            if ([config.data[WP_REMOTE_CONFIG_DO_NOT_SEND_PRESENCE_ON_APPLICATION_WILL_RESIGN_ACTIVE] boolValue]) {
+            if (config.snapshot.doNotSendPresenceOnApplicationWillResignActive) {
                 return;
             }
             WPPresencePayload *presence = [WonderPush presenceManager].isCurrentlyPresent ? [[WonderPush presenceManager] presenceWillStop] : nil;
@@ -242,7 +242,7 @@
             }
 
             [WonderPush.remoteConfigManager read:^(WPRemoteConfig *config, NSError *error) {
-                if ([config.data[WP_REMOTE_CONFIG_TRACK_EVENTS_FOR_NON_SUBSCRIBERS] boolValue]) {
+                if (config.snapshot.trackEventsForNonSubscribers) {
                     // Save in request vault
                     [WonderPush postEventually:eventEndPoint params:params];
                     if (sentCallback) sentCallback();
@@ -265,15 +265,7 @@
 
 - (void) eventsBlackWhiteList:(void(^)(WPBlackWhiteList * _Nullable, NSError * _Nullable))completion {
     [WonderPush.remoteConfigManager read:^(WPRemoteConfig *config, NSError *error) {
-        WPBlackWhiteList *list = nil;
-        if (config) {
-            NSArray<NSString *> *rules = [WPNSUtil arrayForKey:WP_REMOTE_CONFIG_EVENTS_BLACK_WHITE_LIST_KEY inDictionary:config.data ?: @{}];
-            if (rules) {
-                list = [[WPBlackWhiteList alloc] initWithRules:rules];
-            }
-
-        }
-        completion(list, error);
+        completion(config.snapshot.eventsBlackWhiteList, error);
     }];
 }
 
@@ -15,7 +15,6 @@
 #define REMOTE_CONFIG_BASE_URL @"https://cdn.by.wonderpush.com/config/clientids/"
 #define REMOTE_CONFIG_SUFFIX @"-iOS"
 
-#define RETRY_INTERVAL 10.0f
 #define CACHED_INSTALLATION_CUSTOM_PROPERTIES_MIN_DELAY 5
 #define CACHED_INSTALLATION_CUSTOM_PROPERTIES_MAX_DELAY 20
 #define CACHED_INSTALLATION_CORE_PROPERTIES_MIN_DELAY 5
@@ -24,6 +24,7 @@ extern NSInteger const WPErrorHTTPFailure;
 extern NSInteger const WPErrorInvalidFormat;
 extern NSInteger const WPErrorNotFound;
 extern NSInteger const WPErrorClientDisabled;
+extern NSInteger const WPErrorFileTooLarge;
 
 //extern NSInteger const WPErrorSecureConnectionRequired;
 //extern NSInteger const WPErrorInvalidPrevNextParameter;
@@ -16,3 +16,4 @@ NSInteger const WPErrorHTTPFailure = 11012;
 NSInteger const WPErrorInvalidFormat = 11013;
 NSInteger const WPErrorNotFound = 11014;
 NSInteger const WPErrorClientDisabled = 11015;
+NSInteger const WPErrorFileTooLarge = 11016;
@@ -0,0 +1,56 @@
+//
+//  WPFileDownloader.h
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "WPMediaCache.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// A file to download with a `WPFileDownloader`.
+@interface WPFileDownload : NSObject
+
+- (instancetype) init NS_UNAVAILABLE;
+- (instancetype) initWithURL:(NSURL *)URL fileURL:(NSURL *)fileURL NS_DESIGNATED_INITIALIZER;
+
+@property (readonly) NSURL *URL;
+
+/// Where the file is moved once downloaded, replacing any existing file.
+@property (readonly) NSURL *fileURL;
+
+/// The largest accepted size in bytes, 0 for no limit.
+@property (nonatomic, assign) long long maximumSize;
+
+/// Whether the file was downloaded to `fileURL`.
+@property (readonly) BOOL succeeded;
+
+/// Why the download failed, once it has.
+@property (readonly, nullable) NSError *error;
+
+@end
+
+/**
+ Downloads files in parallel through a dedicated session, under a common deadline.
+
+ Downloads still running when the deadline is reached are cancelled and fail with `NSURLErrorTimedOut`,
+ so that the ones that did complete can be used right away.
+ Downloads announcing or reaching more than their `maximumSize` are cancelled and fail with `WPErrorFileTooLarge`.
+ Given a cache, fresh entries are used without any network access, and downloaded files are stored into it.
+ */
+@interface WPFileDownloader : NSObject
+
+- (instancetype) init;
+- (instancetype) initWithSessionConfiguration:(NSURLSessionConfiguration *)configuration NS_DESIGNATED_INITIALIZER;
+
+@property (nonatomic, strong, nullable) WPMediaCache *cache;
+
+/// Downloads all the given files, and returns once they have all either succeeded or failed, or the deadline is reached.
+- (void) download:(NSArray<WPFileDownload *> *)downloads deadline:(NSDate *)deadline;
+
+@end
+
+NS_ASSUME_NONNULL_END
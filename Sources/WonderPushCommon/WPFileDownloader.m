@@ -0,0 +1,225 @@
+//
+//  WPFileDownloader.m
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import "WPFileDownloader.h"
+#import "WPErrors.h"
+#import "WPLog.h"
+
+#define MAXIMUM_CONNECTIONS_PER_HOST 4
+
+@interface WPFileDownload ()
+@property (nonatomic, strong) NSURL *URL;
+@property (nonatomic, strong) NSURL *fileURL;
+@property (nonatomic, assign) BOOL succeeded;
+@property (nonatomic, strong, nullable) NSError *error;
+@property (nonatomic, assign) BOOL finished;
+@end
+
+@implementation WPFileDownload
+
+- (instancetype) initWithURL:(NSURL *)URL fileURL:(NSURL *)fileURL
+{
+    if (self = [super init]) {
+        _URL = URL;
+        _fileURL = fileURL;
+    }
+    return self;
+}
+
+@end
+
+/// The session delegate of a single call to `-[WPFileDownloader download:deadline:]`
+@interface WPFileDownloadBatch : NSObject <NSURLSessionDownloadDelegate>
+@property (nonatomic, strong) NSDictionary<NSNumber *, WPFileDownload *> *downloadsByTaskIdentifier;
+/// The stale cache entries being revalidated
+@property (nonatomic, strong) NSDictionary<NSNumber *, WPMediaCacheEntry *> *entriesByTaskIdentifier;
+@property (nonatomic, strong, nullable) WPMediaCache *cache;
+@property (nonatomic, strong) dispatch_group_t group;
+@end
+
+@implementation WPFileDownloadBatch
+
+- (instancetype) init
+{
+    if (self = [super init]) {
+        _downloadsByTaskIdentifier = @{};
+        _entriesByTaskIdentifier = @{};
+        _group = dispatch_group_create();
+    }
+    return self;
+}
+
+- (WPFileDownload *) downloadForTask:(NSURLSessionTask *)task
+{
+    @synchronized (self) {
+        return self.downloadsByTaskIdentifier[@(task.taskIdentifier)];
+    }
+}
+
+- (WPMediaCacheEntry *) entryForTask:(NSURLSessionTask *)task
+{
+    @synchronized (self) {
+        return self.entriesByTaskIdentifier[@(task.taskIdentifier)];
+    }
+}
+
+- (BOOL) isNotModified:(NSURLSessionTask *)task
+{
+    return [task.response isKindOfClass:[NSHTTPURLResponse class]] && ((NSHTTPURLResponse *)task.response).statusCode == 304;
+}
+
+- (void) finish:(WPFileDownload *)download withEntry:(WPMediaCacheEntry *)entry response:(NSURLResponse *)response
+{
+    if (!download || download.finished) return;
+    NSError *error = nil;
+    [self.cache linkEntry:[self.cache revalidateEntry:entry response:response] toFileURL:download.fileURL error:&error];
+    [self finish:download error:error];
+}
+
+// Only the first outcome of a download counts, be it its completion, its failure or the deadline
+- (void) finish:(WPFileDownload *)download error:(nullable NSError *)error
+{
+    if (!download) return;
+    @synchronized (self) {
+        if (download.finished) return;
+        download.finished = YES;
+        download.succeeded = error == nil;
+        download.error = error;
+    }
+    dispatch_group_leave(self.group);
+}
+
+- (NSError *) tooLargeError:(WPFileDownload *)download
+{
+    return [NSError errorWithDomain:WPErrorDomain code:WPErrorFileTooLarge userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"File larger than %lld bytes", download.maximumSize]}];
+}
+
+- (void) URLSession:(NSURLSession *)session downloadTask:(NSURLSessionDownloadTask *)downloadTask didWriteData:(int64_t)bytesWritten totalBytesWritten:(int64_t)totalBytesWritten totalBytesExpectedToWrite:(int64_t)totalBytesExpectedToWrite
+{
+    WPFileDownload *download = [self downloadForTask:downloadTask];
+    if (download.maximumSize <= 0) return;
+    // The expected size is NSURLSessionTransferSizeUnknown, which is negative, without a Content-Length
+    if (totalBytesExpectedToWrite > download.maximumSize || totalBytesWritten > download.maximumSize) {
+        [self finish:download error:[self tooLargeError:download]];
+        [downloadTask cancel];
+    }
+}
+
+- (void) URLSession:(NSURLSession *)session downloadTask:(NSURLSessionDownloadTask *)downloadTask didFinishDownloadingToURL:(NSURL *)location
+{
+    WPFileDownload *download = [self downloadForTask:downloadTask];
+    if (!download || download.finished) return;
+    WPMediaCacheEntry *entry = [self entryForTask:downloadTask];
+    if (entry && [self isNotModified:downloadTask]) {
+        [self finish:download withEntry:entry response:downloadTask.response];
+        return;
+    }
+    NSError *error = nil;
+    NSInteger statusCode = [downloadTask.response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse *)downloadTask.response).statusCode : 200;
+    NSNumber *size = [[NSFileManager defaultManager] attributesOfItemAtPath:location.path error:nil][NSFileSize];
+    if (statusCode < 200 || statusCode >= 300) {
+        error = [NSError errorWithDomain:WPErrorDomain code:WPErrorHTTPFailure userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"HTTP status %ld", (long)statusCode]}];
+    } else if (download.maximumSize > 0 && size.longLongValue > download.maximumSize) {
+        error = [self tooLargeError:download];
+    } else {
+        // The downloaded file is removed as soon as we return, move it now
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        [fileManager removeItemAtURL:download.fileURL error:nil];
+        if ([fileManager moveItemAtURL:location toURL:download.fileURL error:&error]) {
+            [self.cache storeFileAtURL:download.fileURL forURL:download.URL response:downloadTask.response];
+        }
+    }
+    [self finish:download error:error];
+}
+
+- (void) URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error
+{
+    WPFileDownload *download = [self downloadForTask:task];
+    WPMediaCacheEntry *entry = [self entryForTask:task];
+    if (!error && entry && [self isNotModified:task]) {
+        [self finish:download withEntry:entry response:task.response];
+        return;
+    }
+    // Downloads that completed successfully are already finished
+    [self finish:download error:error ?: [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorUnknown userInfo:nil]];
+}
+
+@end
+
+@interface WPFileDownloader ()
+@property (nonatomic, strong) NSURLSessionConfiguration *configuration;
+@end
+
+@implementation WPFileDownloader
+
+- (instancetype) init
+{
+    // Caching is up to the media cache, which also revalidates stale entries
+    NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+    configuration.URLCache = nil;
+    configuration.HTTPMaximumConnectionsPerHost = MAXIMUM_CONNECTIONS_PER_HOST;
+    return [self initWithSessionConfiguration:configuration];
+}
+
+- (instancetype) initWithSessionConfiguration:(NSURLSessionConfiguration *)configuration
+{
+    if (self = [super init]) {
+        _configuration = [configuration copy];
+    }
+    return self;
+}
+
+- (void) download:(NSArray<WPFileDownload *> *)downloads deadline:(NSDate *)deadline
+{
+    if (downloads.count == 0) return;
+    WPFileDownloadBatch *batch = [WPFileDownloadBatch new];
+    batch.cache = self.cache;
+    NSOperationQueue *delegateQueue = [NSOperationQueue new];
+    delegateQueue.maxConcurrentOperationCount = 1;
+    // A session per batch, as sessions retain their delegate until invalidated
+    NSURLSession *session = [NSURLSession sessionWithConfiguration:self.configuration delegate:batch delegateQueue:delegateQueue];
+
+    NSMutableDictionary<NSNumber *, WPFileDownload *> *downloadsByTaskIdentifier = [NSMutableDictionary new];
+    NSMutableDictionary<NSNumber *, WPMediaCacheEntry *> *entriesByTaskIdentifier = [NSMutableDictionary new];
+    NSMutableArray<NSURLSessionTask *> *tasks = [NSMutableArray new];
+    for (WPFileDownload *download in downloads) {
+        dispatch_group_enter(batch.group);
+        WPMediaCacheEntry *entry = [self.cache entryForURL:download.URL];
+        if (entry && download.maximumSize > 0 && entry.size > (unsigned long long)download.maximumSize) {
+            entry = nil;
+        }
+        if (entry && [self.cache isEntryFresh:entry] && [self.cache linkEntry:entry toFileURL:download.fileURL error:nil]) {
+            [batch finish:download error:nil];
+            continue;
+        }
+        NSURLRequest *request = self.cache ? [self.cache requestForURL:download.URL entry:entry] : [NSURLRequest requestWithURL:download.URL];
+        NSURLSessionDownloadTask *task = [session downloadTaskWithRequest:request];
+        downloadsByTaskIdentifier[@(task.taskIdentifier)] = download;
+        if (entry) entriesByTaskIdentifier[@(task.taskIdentifier)] = entry;
+        [tasks addObject:task];
+    }
+    @synchronized (batch) {
+        batch.downloadsByTaskIdentifier = [downloadsByTaskIdentifier copy];
+        batch.entriesByTaskIdentifier = [entriesByTaskIdentifier copy];
+    }
+    for (NSURLSessionTask *task in tasks) {
+        [task resume];
+    }
+
+    NSTimeInterval remaining = MAX(0, [deadline timeIntervalSinceNow]);
+    if (dispatch_group_wait(batch.group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(remaining * NSEC_PER_SEC))) != 0) {
+        NSError *timeoutError = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:@{NSLocalizedDescriptionKey: @"Download not completed before the deadline"}];
+        for (WPFileDownload *download in downloads) {
+            if (!download.finished) WPLog(@"Download of %@ not completed before the deadline", download.URL);
+            [batch finish:download error:timeoutError];
+        }
+    }
+    [session invalidateAndCancel];
+}
+
+@end
@@ -0,0 +1,109 @@
+//
+//  WPMediaCache.h
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Key to set in the Info.plist of both the app and the notification service extension,
+ so that they share their media cache through this app group
+ */
+#define WP_APP_GROUP_IDENTIFIER_INFO_PLIST_KEY @"WonderPushAppGroupIdentifier"
+
+#define WP_MEDIA_CACHE_DEFAULT_BYTE_BUDGET (50 * 1024 * 1024)
+#define WP_MEDIA_CACHE_DEFAULT_MAX_AGE (7 * 24 * 60 * 60)
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The cached content of a URL.
+@interface WPMediaCacheEntry : NSObject
+
+@property (readonly) NSURL *URL;
+
+/// The SHA-256 of the content, which is stored once whatever the number of URLs serving it.
+@property (readonly) NSString *contentHash;
+
+/// The cached content, which must not be modified.
+@property (readonly) NSURL *fileURL;
+
+@property (readonly) unsigned long long size;
+@property (readonly, nullable) NSString *ETag;
+@property (readonly, nullable) NSString *MIMEType;
+@property (readonly, nullable) NSString *textEncodingName;
+
+/// When the content was last downloaded or revalidated.
+@property (readonly) NSDate *date;
+
+/// When the content stops being fresh according to the server, nil if the server did not tell.
+@property (readonly, nullable) NSDate *expirationDate;
+
+@end
+
+/**
+ An on-disk cache of downloaded media, shared between the app and the notification service extension
+ when they declare the same app group under `WP_APP_GROUP_IDENTIFIER_INFO_PLIST_KEY`.
+
+ Contents are stored by hash, URLs only point to them, so that the same media served under several URLs is stored once.
+ Entries are used without any network access while they are fresh according to their Cache-Control or Expires headers,
+ or their Last-Modified header, but never longer than `maxAge`. Stale entries are revalidated using their ETag.
+ Whenever the contents exceed the byte budget, the least recently used ones are evicted.
+ The contents are only listed again once the running total of their sizes exceeds the budget,
+ so storing costs the same whatever the size of the cache.
+ Several processes can use the same directory at once, the contents stored by the others are counted when listed.
+ */
+@interface WPMediaCache : NSObject
+
++ (instancetype) sharedCache;
+
+- (instancetype) init NS_UNAVAILABLE;
+- (instancetype) initWithDirectory:(NSString *)directory byteBudget:(unsigned long long)byteBudget NS_DESIGNATED_INITIALIZER;
+
+@property (readonly) NSString *directory;
+@property (readonly) unsigned long long byteBudget;
+
+/// The longest an entry is used without being revalidated, whatever the server says.
+@property (nonatomic, assign) NSTimeInterval maxAge;
+
+/// The total size of the cached contents.
+@property (readonly) unsigned long long totalSize;
+
+/// The entry of the given URL, fresh or not, counting as a use.
+- (nullable WPMediaCacheEntry *) entryForURL:(NSURL *)URL;
+
+- (BOOL) isEntryFresh:(WPMediaCacheEntry *)entry;
+
+/// A request for the given URL, conditional if the given entry has an ETag.
+- (NSURLRequest *) requestForURL:(NSURL *)URL entry:(nullable WPMediaCacheEntry *)entry;
+
+/// Stores the content of a downloaded file, which is left in place. Returns nil if the response forbids storing it.
+- (nullable WPMediaCacheEntry *) storeFileAtURL:(NSURL *)fileURL forURL:(NSURL *)URL response:(nullable NSURLResponse *)response;
+
+- (nullable WPMediaCacheEntry *) storeData:(NSData *)data forURL:(NSURL *)URL response:(nullable NSURLResponse *)response;
+
+/// Marks the entry as fresh again, after the server answered that it was not modified with the given response.
+- (WPMediaCacheEntry *) revalidateEntry:(WPMediaCacheEntry *)entry response:(nullable NSURLResponse *)response;
+
+/// Makes the content of the entry available at the given file URL, without copying it when possible.
+- (BOOL) linkEntry:(WPMediaCacheEntry *)entry toFileURL:(NSURL *)fileURL error:(NSError **)error;
+
+/// A response describing the entry as if it had just been downloaded.
+- (NSHTTPURLResponse *) responseForEntry:(WPMediaCacheEntry *)entry;
+
+/**
+ Gets the content of the given URL from the cache, or else downloads it using the given session and stores it.
+ The completion is called on the delegate queue of the session, like that of a data task.
+ */
+- (void) fetchURL:(NSURL *)URL session:(NSURLSession *)session completion:(void (^)(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error))completion;
+
+/// Evicts the least recently used contents until the total size fits the byte budget, and the URLs pointing to them.
+- (void) trim;
+
+- (void) removeAllEntries;
+
+@end
+
+NS_ASSUME_NONNULL_END
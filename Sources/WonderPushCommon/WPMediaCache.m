@@ -0,0 +1,488 @@
+//
+//  WPMediaCache.m
+//  WonderPush
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import "WPMediaCache.h"
+#import "WPNSUtil.h"
+#import "WPLog.h"
+#import <CommonCrypto/CommonDigest.h>
+
+#define URLS_DIRECTORY @"urls"
+#define CONTENTS_DIRECTORY @"contents"
+#define HASH_CHUNK_SIZE 65536
+
+static NSString *WPMediaCacheHex(const unsigned char *digest)
+{
+    NSMutableString *hex = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+    for (int i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+        [hex appendFormat:@"%02x", digest[i]];
+    }
+    return hex;
+}
+
+static NSString *WPMediaCacheHashData(NSData *data)
+{
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+    return WPMediaCacheHex(digest);
+}
+
+static NSString *WPMediaCacheHashFile(NSURL *fileURL)
+{
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingFromURL:fileURL error:nil];
+    if (!fileHandle) return nil;
+    CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+    while (YES) {
+        @autoreleasepool {
+            NSData *chunk = [fileHandle readDataOfLength:HASH_CHUNK_SIZE];
+            if (chunk.length == 0) break;
+            CC_SHA256_Update(&context, chunk.bytes, (CC_LONG)chunk.length);
+        }
+    }
+    [fileHandle closeFile];
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &context);
+    return WPMediaCacheHex(digest);
+}
+
+static NSString *WPMediaCacheHeader(NSURLResponse *response, NSString *name)
+{
+    if (![response isKindOfClass:[NSHTTPURLResponse class]]) return nil;
+    __block NSString *value = nil;
+    [[(NSHTTPURLResponse *)response allHeaderFields] enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *obj, BOOL *stop) {
+        if ([key caseInsensitiveCompare:name] == NSOrderedSame) {
+            value = obj;
+            *stop = YES;
+        }
+    }];
+    return value;
+}
+
+// Directives of a Cache-Control header, by lowercase name, with an empty value when they have none
+static NSDictionary<NSString *, NSString *> *WPMediaCacheControlDirectives(NSString *cacheControl)
+{
+    NSMutableDictionary *directives = [NSMutableDictionary new];
+    NSCharacterSet *trimmed = [NSCharacterSet characterSetWithCharactersInString:@" \t\""];
+    for (NSString *directive in [cacheControl componentsSeparatedByString:@","]) {
+        NSRange equal = [directive rangeOfString:@"="];
+        NSString *name = equal.location == NSNotFound ? directive : [directive substringToIndex:equal.location];
+        name = [[name stringByTrimmingCharactersInSet:trimmed] lowercaseString];
+        if (name.length == 0) continue;
+        directives[name] = equal.location == NSNotFound ? @"" : [[directive substringFromIndex:equal.location + 1] stringByTrimmingCharactersInSet:trimmed];
+    }
+    return directives;
+}
+
+static NSDate *WPMediaCacheParseHTTPDate(NSString *value)
+{
+    static NSDateFormatter *formatter = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        formatter = [NSDateFormatter new];
+        formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+        formatter.dateFormat = @"EEE, dd MMM yyyy HH:mm:ss zzz";
+    });
+    return value ? [formatter dateFromString:value] : nil;
+}
+
+@interface WPMediaCacheEntry ()
+@property (nonatomic, strong) NSURL *URL;
+@property (nonatomic, strong) NSString *contentHash;
+@property (nonatomic, strong) NSURL *fileURL;
+@property (nonatomic, assign) unsigned long long size;
+@property (nonatomic, strong, nullable) NSString *ETag;
+@property (nonatomic, strong, nullable) NSString *MIMEType;
+@property (nonatomic, strong, nullable) NSString *textEncodingName;
+@property (nonatomic, strong) NSDate *date;
+@property (nonatomic, strong, nullable) NSDate *expirationDate;
+@end
+
+@implementation WPMediaCacheEntry
+@end
+
+@interface WPMediaCache ()
+@property (nonatomic, strong) NSString *directory;
+@property (nonatomic, assign) unsigned long long byteBudget;
+/// The total size of the contents as last listed, plus those stored since, nil until first listed
+@property (nonatomic, strong, nullable) NSNumber *runningTotalSize;
+@end
+
+@implementation WPMediaCache
+
++ (NSString *) defaultDirectory
+{
+    NSString *appGroupIdentifier = [[NSBundle mainBundle] objectForInfoDictionaryKey:WP_APP_GROUP_IDENTIFIER_INFO_PLIST_KEY];
+    if ([appGroupIdentifier isKindOfClass:[NSString class]]) {
+        NSURL *containerURL = [[NSFileManager defaultManager] containerURLForSecurityApplicationGroupIdentifier:appGroupIdentifier];
+        if (containerURL) {
+            return [containerURL.path stringByAppendingPathComponent:@"Library/Caches/WonderPush/Media"];
+        }
+        WPLog(@"Cannot access the app group %@, the media cache will not be shared", appGroupIdentifier);
+    }
+    NSString *caches = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject] ?: NSTemporaryDirectory();
+    return [caches stringByAppendingPathComponent:@"WonderPush/Media"];
+}
+
++ (instancetype) sharedCache
+{
+    static WPMediaCache *sharedCache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedCache = [[WPMediaCache alloc] initWithDirectory:[self defaultDirectory] byteBudget:WP_MEDIA_CACHE_DEFAULT_BYTE_BUDGET];
+    });
+    return sharedCache;
+}
+
+- (instancetype) initWithDirectory:(NSString *)directory byteBudget:(unsigned long long)byteBudget
+{
+    if (self = [super init]) {
+        _directory = directory;
+        _byteBudget = byteBudget;
+        _maxAge = WP_MEDIA_CACHE_DEFAULT_MAX_AGE;
+    }
+    return self;
+}
+
+#pragma mark - Paths
+
+- (NSString *) pathForURL:(NSURL *)URL
+{
+    NSString *name = WPMediaCacheHashData([URL.absoluteString dataUsingEncoding:NSUTF8StringEncoding]);
+    return [[self.directory stringByAppendingPathComponent:URLS_DIRECTORY] stringByAppendingPathComponent:[name stringByAppendingPathExtension:@"json"]];
+}
+
+- (NSString *) pathForContentHash:(NSString *)contentHash
+{
+    return [[self.directory stringByAppendingPathComponent:CONTENTS_DIRECTORY] stringByAppendingPathComponent:contentHash];
+}
+
+- (void) createDirectories
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    [fileManager createDirectoryAtPath:[self.directory stringByAppendingPathComponent:URLS_DIRECTORY] withIntermediateDirectories:YES attributes:nil error:nil];
+    [fileManager createDirectoryAtPath:[self.directory stringByAppendingPathComponent:CONTENTS_DIRECTORY] withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+#pragma mark - Entries
+
+- (nullable WPMediaCacheEntry *) entryForURL:(NSURL *)URL
+{
+    NSString *path = [self pathForURL:URL];
+    NSData *data = [NSData dataWithContentsOfFile:path];
+    NSDictionary *dict = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+    if (![dict isKindOfClass:[NSDictionary class]]) return nil;
+    NSString *contentHash = [WPNSUtil stringForKey:@"hash" inDictionary:dict];
+    NSNumber *date = [WPNSUtil numberForKey:@"date" inDictionary:dict];
+    // Guard against hash collisions of URLs
+    if (!contentHash || !date || ![[WPNSUtil stringForKey:@"url" inDictionary:dict] isEqualToString:URL.absoluteString]) return nil;
+
+    NSString *contentPath = [self pathForContentHash:contentHash];
+    // Using the content makes it the most recently used
+    if (![[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate: [NSDate date]} ofItemAtPath:contentPath error:nil]) {
+        // The content was evicted
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        return nil;
+    }
+    WPMediaCacheEntry *entry = [WPMediaCacheEntry new];
+    entry.URL = URL;
+    entry.contentHash = contentHash;
+    entry.fileURL = [NSURL fileURLWithPath:contentPath];
+    entry.size = [[WPNSUtil numberForKey:@"size" inDictionary:dict] unsignedLongLongValue];
+    entry.ETag = [WPNSUtil stringForKey:@"etag" inDictionary:dict];
+    entry.MIMEType = [WPNSUtil stringForKey:@"mime" inDictionary:dict];
+    entry.textEncodingName = [WPNSUtil stringForKey:@"encoding" inDictionary:dict];
+    entry.date = [NSDate dateWithTimeIntervalSince1970:date.doubleValue / 1000];
+    NSNumber *expirationDate = [WPNSUtil numberForKey:@"expires" inDictionary:dict];
+    if (expirationDate) entry.expirationDate = [NSDate dateWithTimeIntervalSince1970:expirationDate.doubleValue / 1000];
+    return entry;
+}
+
+- (BOOL) isEntryFresh:(WPMediaCacheEntry *)entry
+{
+    NSTimeInterval age = -[entry.date timeIntervalSinceNow];
+    if (age < 0 || age >= self.maxAge) return NO;
+    return !entry.expirationDate || [entry.expirationDate timeIntervalSinceNow] > 0;
+}
+
+/**
+ When a response received at the given date stops being fresh: explicitly using Cache-Control or Expires,
+ or else heuristically, for a tenth of the time since it was last modified.
+ Returns nil when the response does not tell, and `maxAge` applies.
+ */
++ (nullable NSDate *) expirationDateForResponse:(nullable NSURLResponse *)response date:(NSDate *)date
+{
+    if (![response isKindOfClass:[NSHTTPURLResponse class]]) return nil;
+    NSDictionary<NSString *, NSString *> *directives = WPMediaCacheControlDirectives(WPMediaCacheHeader(response, @"Cache-Control"));
+    if (directives[@"no-cache"]) return date;
+    NSDate *serverDate = WPMediaCacheParseHTTPDate(WPMediaCacheHeader(response, @"Date")) ?: date;
+    NSString *maxAge = directives[@"max-age"];
+    if (maxAge) {
+        // Time spent in intermediate caches counts
+        NSTimeInterval age = MAX(0, [WPMediaCacheHeader(response, @"Age") doubleValue]);
+        return [date dateByAddingTimeInterval:MAX(0, maxAge.doubleValue - age)];
+    }
+    NSString *expires = WPMediaCacheHeader(response, @"Expires");
+    if (expires) {
+        NSDate *expiresDate = WPMediaCacheParseHTTPDate(expires);
+        // Invalid dates, like "0", mean already expired
+        if (!expiresDate) return date;
+        return [date dateByAddingTimeInterval:MAX(0, [expiresDate timeIntervalSinceDate:serverDate])];
+    }
+    NSDate *lastModified = WPMediaCacheParseHTTPDate(WPMediaCacheHeader(response, @"Last-Modified"));
+    if (lastModified) {
+        return [date dateByAddingTimeInterval:MAX(0, [serverDate timeIntervalSinceDate:lastModified] / 10)];
+    }
+    return nil;
+}
+
+- (BOOL) writeEntry:(WPMediaCacheEntry *)entry
+{
+    NSMutableDictionary *dict = [NSMutableDictionary dictionaryWithDictionary:@{
+        @"url": entry.URL.absoluteString,
+        @"hash": entry.contentHash,
+        @"size": @(entry.size),
+        @"date": @((long long)([entry.date timeIntervalSince1970] * 1000)),
+    }];
+    if (entry.ETag) dict[@"etag"] = entry.ETag;
+    if (entry.MIMEType) dict[@"mime"] = entry.MIMEType;
+    if (entry.textEncodingName) dict[@"encoding"] = entry.textEncodingName;
+    if (entry.expirationDate) dict[@"expires"] = @((long long)([entry.expirationDate timeIntervalSince1970] * 1000));
+    NSData *data = [NSJSONSerialization dataWithJSONObject:dict options:0 error:nil];
+    return [data writeToFile:[self pathForURL:entry.URL] options:NSDataWritingAtomic error:nil];
+}
+
+- (nullable WPMediaCacheEntry *) entryForURL:(NSURL *)URL contentHash:(NSString *)contentHash size:(unsigned long long)size response:(nullable NSURLResponse *)response
+{
+    WPMediaCacheEntry *entry = [WPMediaCacheEntry new];
+    entry.URL = URL;
+    entry.contentHash = contentHash;
+    entry.fileURL = [NSURL fileURLWithPath:[self pathForContentHash:contentHash]];
+    entry.size = size;
+    entry.MIMEType = response.MIMEType;
+    entry.textEncodingName = response.textEncodingName;
+    entry.ETag = WPMediaCacheHeader(response, @"ETag");
+    entry.date = [NSDate date];
+    entry.expirationDate = [[self class] expirationDateForResponse:response date:entry.date];
+    return entry;
+}
+
++ (BOOL) responseAllowsStoring:(nullable NSURLResponse *)response
+{
+    if (![response isKindOfClass:[NSHTTPURLResponse class]]) return YES;
+    NSHTTPURLResponse *HTTPResponse = (NSHTTPURLResponse *)response;
+    if (HTTPResponse.statusCode < 200 || HTTPResponse.statusCode >= 300) return NO;
+    return WPMediaCacheControlDirectives(WPMediaCacheHeader(response, @"Cache-Control"))[@"no-store"] == nil;
+}
+
+- (nullable WPMediaCacheEntry *) storeFileAtURL:(NSURL *)fileURL forURL:(NSURL *)URL response:(nullable NSURLResponse *)response
+{
+    if (![[self class] responseAllowsStoring:response]) return nil;
+    NSString *contentHash = WPMediaCacheHashFile(fileURL);
+    if (!contentHash) return nil;
+    [self createDirectories];
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *contentPath = [self pathForContentHash:contentHash];
+    // Contents never change once stored, an existing one is the same
+    BOOL added = NO;
+    if (![fileManager fileExistsAtPath:contentPath]) {
+        added = [fileManager linkItemAtPath:fileURL.path toPath:contentPath error:nil]
+            || [fileManager copyItemAtPath:fileURL.path toPath:contentPath error:nil];
+        if (!added && ![fileManager fileExistsAtPath:contentPath]) return nil;
+    }
+    unsigned long long size = [[fileManager attributesOfItemAtPath:contentPath error:nil] fileSize];
+    WPMediaCacheEntry *entry = [self entryForURL:URL contentHash:contentHash size:size response:response];
+    if (![self writeEntry:entry]) return nil;
+    if (added) [self didAddContentOfSize:size];
+    return entry;
+}
+
+- (nullable WPMediaCacheEntry *) storeData:(NSData *)data forURL:(NSURL *)URL response:(nullable NSURLResponse *)response
+{
+    if (![[self class] responseAllowsStoring:response]) return nil;
+    NSString *contentHash = WPMediaCacheHashData(data);
+    [self createDirectories];
+    NSString *contentPath = [self pathForContentHash:contentHash];
+    BOOL added = NO;
+    if (![[NSFileManager defaultManager] fileExistsAtPath:contentPath]) {
+        if (![data writeToFile:contentPath options:NSDataWritingAtomic error:nil]) return nil;
+        added = YES;
+    }
+    WPMediaCacheEntry *entry = [self entryForURL:URL contentHash:contentHash size:data.length response:response];
+    if (![self writeEntry:entry]) return nil;
+    if (added) [self didAddContentOfSize:data.length];
+    return entry;
+}
+
+- (WPMediaCacheEntry *) revalidateEntry:(WPMediaCacheEntry *)entry response:(nullable NSURLResponse *)response
+{
+    WPMediaCacheEntry *revalidated = [WPMediaCacheEntry new];
+    revalidated.URL = entry.URL;
+    revalidated.contentHash = entry.contentHash;
+    revalidated.fileURL = entry.fileURL;
+    revalidated.size = entry.size;
+    revalidated.ETag = entry.ETag;
+    revalidated.MIMEType = entry.MIMEType;
+    revalidated.textEncodingName = entry.textEncodingName;
+    revalidated.date = [NSDate date];
+    revalidated.expirationDate = [[self class] expirationDateForResponse:response date:revalidated.date];
+    // Without new freshness information, the entry stays fresh as long as it was
+    if (!revalidated.expirationDate && entry.expirationDate) {
+        revalidated.expirationDate = [revalidated.date dateByAddingTimeInterval:[entry.expirationDate timeIntervalSinceDate:entry.date]];
+    }
+    [self writeEntry:revalidated];
+    return revalidated;
+}
+
+- (BOOL) linkEntry:(WPMediaCacheEntry *)entry toFileURL:(NSURL *)fileURL error:(NSError **)error
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    [fileManager removeItemAtURL:fileURL error:nil];
+    return [fileManager linkItemAtURL:entry.fileURL toURL:fileURL error:nil]
+        || [fileManager copyItemAtURL:entry.fileURL toURL:fileURL error:error];
+}
+
+- (NSURLRequest *) requestForURL:(NSURL *)URL entry:(nullable WPMediaCacheEntry *)entry
+{
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:URL];
+    if (entry.ETag) {
+        [request setValue:entry.ETag forHTTPHeaderField:@"If-None-Match"];
+    }
+    return request;
+}
+
+- (NSHTTPURLResponse *) responseForEntry:(WPMediaCacheEntry *)entry
+{
+    NSMutableDictionary *headers = [NSMutableDictionary dictionaryWithDictionary:@{@"Content-Length": [@(entry.size) stringValue]}];
+    if (entry.MIMEType) {
+        headers[@"Content-Type"] = entry.textEncodingName ? [NSString stringWithFormat:@"%@; charset=%@", entry.MIMEType, entry.textEncodingName] : entry.MIMEType;
+    }
+    if (entry.ETag) headers[@"ETag"] = entry.ETag;
+    return [[NSHTTPURLResponse alloc] initWithURL:entry.URL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:headers];
+}
+
+- (void) fetchURL:(NSURL *)URL session:(NSURLSession *)session completion:(void (^)(NSData * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable))completion
+{
+    WPMediaCacheEntry *entry = [self entryForURL:URL];
+    NSData *cachedData = entry ? [NSData dataWithContentsOfURL:entry.fileURL options:NSDataReadingMappedIfSafe error:nil] : nil;
+    if (cachedData && [self isEntryFresh:entry]) {
+        [session.delegateQueue addOperationWithBlock:^{
+            completion(cachedData, [self responseForEntry:entry], nil);
+        }];
+        return;
+    }
+    NSURLSessionDataTask *task = [session dataTaskWithRequest:[self requestForURL:URL entry:cachedData ? entry : nil] completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        if (!error && cachedData && [response isKindOfClass:[NSHTTPURLResponse class]] && ((NSHTTPURLResponse *)response).statusCode == 304) {
+            completion(cachedData, [self responseForEntry:[self revalidateEntry:entry response:response]], nil);
+            return;
+        }
+        if (!error && data) {
+            [self storeData:data forURL:URL response:response];
+        }
+        completion(data, response, error);
+    }];
+    [task resume];
+}
+
+#pragma mark - Eviction
+
+- (NSArray<NSDictionary *> *) contents
+{
+    NSString *contentsDirectory = [self.directory stringByAppendingPathComponent:CONTENTS_DIRECTORY];
+    NSMutableArray *contents = [NSMutableArray new];
+    for (NSString *name in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:contentsDirectory error:nil]) {
+        NSString *path = [contentsDirectory stringByAppendingPathComponent:name];
+        NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
+        if (!attributes) continue;
+        [contents addObject:@{@"path": path, @"size": @([attributes fileSize]), @"date": [attributes fileModificationDate] ?: [NSDate distantPast]}];
+    }
+    return contents;
+}
+
+- (unsigned long long) totalSize
+{
+    unsigned long long totalSize = 0;
+    for (NSDictionary *content in [self contents]) {
+        totalSize += [content[@"size"] unsignedLongLongValue];
+    }
+    @synchronized (self) {
+        self.runningTotalSize = @(totalSize);
+    }
+    return totalSize;
+}
+
+// Only lists the contents once the running total exceeds the budget, or the first time
+- (void) didAddContentOfSize:(unsigned long long)size
+{
+    BOOL overBudget;
+    @synchronized (self) {
+        if (!self.runningTotalSize) {
+            // Lists the contents, the new one included
+            [self totalSize];
+        } else {
+            self.runningTotalSize = @(self.runningTotalSize.unsignedLongLongValue + size);
+        }
+        overBudget = self.runningTotalSize.unsignedLongLongValue > self.byteBudget;
+    }
+    if (overBudget) [self trim];
+}
+
+- (void) trim
+{
+    NSArray<NSDictionary *> *contents = [self contents];
+    unsigned long long totalSize = 0;
+    for (NSDictionary *content in contents) {
+        totalSize += [content[@"size"] unsignedLongLongValue];
+    }
+    if (totalSize > self.byteBudget) {
+        totalSize = [self evictContents:contents totalSize:totalSize];
+    }
+    @synchronized (self) {
+        self.runningTotalSize = @(totalSize);
+    }
+}
+
+// Returns the total size left
+- (unsigned long long) evictContents:(NSArray<NSDictionary *> *)contents totalSize:(unsigned long long)totalSize
+{
+    NSArray *leastRecentlyUsedFirst = [contents sortedArrayUsingComparator:^NSComparisonResult(NSDictionary *a, NSDictionary *b) {
+        return [a[@"date"] compare:b[@"date"]];
+    }];
+    for (NSDictionary *content in leastRecentlyUsedFirst) {
+        if (totalSize <= self.byteBudget) break;
+        if ([[NSFileManager defaultManager] removeItemAtPath:content[@"path"] error:nil]) {
+            totalSize -= [content[@"size"] unsignedLongLongValue];
+        }
+    }
+    [self removeURLsWithoutContent];
+    return totalSize;
+}
+
+- (void) removeURLsWithoutContent
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *urlsDirectory = [self.directory stringByAppendingPathComponent:URLS_DIRECTORY];
+    for (NSString *name in [fileManager contentsOfDirectoryAtPath:urlsDirectory error:nil]) {
+        NSString *path = [urlsDirectory stringByAppendingPathComponent:name];
+        NSData *data = [NSData dataWithContentsOfFile:path];
+        NSDictionary *dict = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+        NSString *contentHash = [dict isKindOfClass:[NSDictionary class]] ? [WPNSUtil stringForKey:@"hash" inDictionary:dict] : nil;
+        if (contentHash && [fileManager fileExistsAtPath:[self pathForContentHash:contentHash]]) continue;
+        [fileManager removeItemAtPath:path error:nil];
+    }
+}
+
+- (void) removeAllEntries
+{
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+    @synchronized (self) {
+        self.runningTotalSize = @0;
+    }
+}
+
+@end
@@ -0,0 +1 @@
+../../WPFileDownloader.h
\ No newline at end of file
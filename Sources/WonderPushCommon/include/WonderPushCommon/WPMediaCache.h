@@ -0,0 +1 @@
+../../WPMediaCache.h
\ No newline at end of file
@@ -21,6 +21,7 @@
 #import <WonderPushCommon/WPLog.h>
 #import "WPNotificationCategoryManager.h"
 #import <WonderPushCommon/WPReportingData.h>
+#import <WonderPushCommon/WPFileDownloader.h>
 #import "WonderPush_constants.h"
 
 #import <objc/runtime.h>
@@ -31,16 +32,14 @@
  */
 #define USER_DEFAULTS_DEVICE_ID_KEY @"_wonderpush_deviceId"
 
-@interface WonderPushFileDownloader: NSObject
-@property (nonatomic, strong) NSURL *downloadURL;
-@property (nonatomic, strong) NSURL *fileURL;
-@property (nonatomic, strong) NSURLResponse *response;
-@property (nonatomic, strong) NSURLSessionDownloadTask *task;
-@property (nonatomic, strong) NSError *error;
-@property (nonatomic, strong) dispatch_semaphore_t semaphore;
-- (instancetype) initWithDownloadURL: (NSURL*) downloadURL fileURL: (NSURL*) fileURL;
-- (void) download:(NSError **)error;
-@end
+/**
+ Time we allow ourselves to process a notification, out of the 30 seconds the system gives the extension
+ */
+#define NOTIFICATION_PROCESSING_BUDGET 25
+
+#define MAXIMUM_AUDIO_ATTACHMENT_SIZE (5 * 1024 * 1024)
+#define MAXIMUM_IMAGE_ATTACHMENT_SIZE (10 * 1024 * 1024)
+#define MAXIMUM_VIDEO_ATTACHMENT_SIZE (50 * 1024 * 1024)
 
 
 static WPMeasurementsApiClient *measurementsApiClient = nil;
@@ -112,6 +111,7 @@ const char * const WPNOTIFICATIONSERVICEEXTENSION_CONTENT_ASSOCIATION_KEY = "com
 
 + (BOOL)serviceExtension:(UNNotificationServiceExtension *)extension didReceiveNotificationRequest:(UNNotificationRequest *)request withContentHandler:(void (^)(UNNotificationContent * _Nonnull))contentHandler {
     @try {
+        NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:NOTIFICATION_PROCESSING_BUDGET];
         __block dispatch_semaphore_t measurementsApiSemaphore = nil;
         __block dispatch_semaphore_t installationApiSemaphore = nil;
         WPLog(@"didReceiveNotificationRequest:%@", request);
@@ -181,7 +181,9 @@ const char * const WPNOTIFICATIONSERVICEEXTENSION_CONTENT_ASSOCIATION_KEY = "com
         if (attachments && attachments.count > 0) {
             NSString *documentsDirectory = [NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES) objectAtIndex:0];
             NSURL *documentsDirectoryURL = [NSURL fileURLWithPath:documentsDirectory];
-            NSMutableArray *contentAttachments = [[NSMutableArray alloc] initWithArray:content.attachments];
+            NSMutableArray<WPFileDownload *> *downloads = [NSMutableArray new];
+            NSMutableArray<NSString *> *attachmentIds = [NSMutableArray new];
+            NSMutableArray<NSDictionary *> *attachmentsOptions = [NSMutableArray new];
             int index = -1;
             for (NSDictionary *attachment in attachments) {
                 @try {
@@ -201,45 +203,59 @@ const char * const WPNOTIFICATIONSERVICEEXTENSION_CONTENT_ASSOCIATION_KEY = "com
                         }
                     }
                     NSString *attachmentId = [WPNSUtil stringForKey:@"id" inDictionary:attachment] ?: [NSString stringWithFormat:@"%d", index];
-                    NSError *error = nil;
-                    WPLog(@"downloading %@", attachmentURL);
                     NSURL *fileURL = [NSURL fileURLWithPath:[NSString stringWithFormat:@"%@.%@", attachmentId, attachmentURL.pathExtension ?: @""] relativeToURL:documentsDirectoryURL];
-                    WonderPushFileDownloader *downloader = [[WonderPushFileDownloader alloc] initWithDownloadURL:attachmentURL fileURL:fileURL];
-                    [downloader download:&error];
+                    WPFileDownload *download = [[WPFileDownload alloc] initWithURL:attachmentURL fileURL:fileURL];
+                    download.maximumSize = [self maximumAttachmentSizeForTypeHint:attachmentOptions[UNNotificationAttachmentOptionsTypeHintKey]];
+                    [downloads addObject:download];
+                    [attachmentIds addObject:attachmentId];
+                    [attachmentsOptions addObject:[attachmentOptions copy]];
+                } @catch (NSException *exception) {
+                    WPLog(@"WonderPush/NotificationServiceExtension didReceiveNotificationRequest:withContentHandler: exception when processing %dth attachment: %@", index, exception);
+                }
+            }
+
+            // Download all attachments at once, and keep those that made it before the deadline
+            WPLog(@"downloading %@", [downloads valueForKey:@"URL"]);
+            WPFileDownloader *downloader = [WPFileDownloader new];
+            downloader.cache = [WPMediaCache sharedCache];
+            [downloader download:downloads deadline:deadline];
+
+            NSMutableArray *contentAttachments = [[NSMutableArray alloc] initWithArray:content.attachments];
+            for (NSUInteger i = 0; i < downloads.count; i++) {
+                WPFileDownload *download = downloads[i];
+                if (!download.succeeded) {
+                    WPLog(@"Failed download attachment: %@", download.error);
+                    continue;
+                }
+                @try {
+                    NSError *error = nil;
+                    UNNotificationAttachment *attachment = [UNNotificationAttachment attachmentWithIdentifier:attachmentIds[i]
+                                                                                                          URL:download.fileURL
+                                                                                                      options:attachmentsOptions[i]
+                                                                                                        error:&error];
                     if (error != nil) {
-                        WPLog(@"Failed download attachment: %@", error);
+                        WPLog(@"Failed to create attachment: %@", error);
                         continue;
                     }
-                    @try {
-                        UNNotificationAttachment *attachment = [UNNotificationAttachment attachmentWithIdentifier:attachmentId
-                                                                                                              URL:fileURL
-                                                                                                          options:[attachmentOptions copy]
-                                                                                                            error:&error];
-                        if (error != nil) {
-                            WPLog(@"Failed to create attachment: %@", error);
-                            continue;
-                        }
-                        if (attachment) {
-                            WPLog(@"Adding attachment: %@", attachment);
-                            [contentAttachments addObject:attachment];
-                            content.attachments = [contentAttachments copy];
-                        }
-                    } @catch (NSException *exception) {
-                        WPLog(@"WonderPush/NotificationServiceExtension didReceiveNotificationRequest:withContentHandler: exception when adding attachment: %@", exception);
+                    if (attachment) {
+                        WPLog(@"Adding attachment: %@", attachment);
+                        [contentAttachments addObject:attachment];
+                        content.attachments = [contentAttachments copy];
                     }
                 } @catch (NSException *exception) {
-                    WPLog(@"WonderPush/NotificationServiceExtension didReceiveNotificationRequest:withContentHandler: exception when processing %dth attachment: %@", index, exception);
+                    WPLog(@"WonderPush/NotificationServiceExtension didReceiveNotificationRequest:withContentHandler: exception when adding attachment: %@", exception);
                 }
             }
         }
         
         WPLog(@"Final content: %@", content);
-        // Wait for the measurement API forever
+        // Wait for the measurement API until the deadline, the system would not wait much longer for us anyway
+        dispatch_time_t deadlineTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(MAX(0, [deadline timeIntervalSinceNow]) * NSEC_PER_SEC));
         if (measurementsApiSemaphore) {
-            dispatch_semaphore_wait(measurementsApiSemaphore, DISPATCH_TIME_FOREVER);
+            dispatch_semaphore_wait(measurementsApiSemaphore, deadlineTime);
         }
         if (installationApiSemaphore) {
-            dispatch_semaphore_wait(installationApiSemaphore, DISPATCH_TIME_FOREVER);
+            dispatch_semaphore_wait(installationApiSemaphore, deadlineTime);
         }
         contentHandler(content);
         return YES;
@@ -397,6 +413,17 @@ static const NSString *UTTypeAVIMovie = @"public.avi";
     return mapping[extensionOrMimeTypeOrTypeUTType];
 }
 
+// The limits of UNNotificationAttachment, no need to download more than it would accept
++ (long long)maximumAttachmentSizeForTypeHint:(NSString * _Nullable)typeHint {
+    if ([@[UTTypeAudioInterchangeFileFormat, UTTypeWaveformAudio, UTTypeMP3, UTTypeMPEG4Audio] containsObject:typeHint]) {
+        return MAXIMUM_AUDIO_ATTACHMENT_SIZE;
+    }
+    if ([@[UTTypeJPEG, UTTypeGIF, UTTypePNG] containsObject:typeHint]) {
+        return MAXIMUM_IMAGE_ATTACHMENT_SIZE;
+    }
+    return MAXIMUM_VIDEO_ATTACHMENT_SIZE;
+}
+
 #pragma mark - WonderPush SDK stuff
 
 + (BOOL)isNotificationForWonderPush:(NSDictionary *)userInfo{
@@ -408,37 +435,3 @@ static const NSString *UTTypeAVIMovie = @"public.avi";
 }
 
 @end
-
-
-@implementation WonderPushFileDownloader
-
-- (instancetype) initWithDownloadURL: (NSURL*) downloadURL fileURL: (NSURL*) fileURL {
-    self = [super init];
-    self.fileURL = fileURL;
-    self.downloadURL = downloadURL;
-    self.error = nil;
-    self.task = [[NSURLSession sharedSession] downloadTaskWithURL:downloadURL completionHandler:^(NSURL *downloadedFileURL, NSURLResponse *response, NSError *error) {
-        self.error = error;
-        self.response = response;
-        if (!error && downloadedFileURL) {
-            NSError *moveError = nil;
-            NSFileManager *fileManager = [NSFileManager defaultManager];
-            [fileManager removeItemAtURL:fileURL error:nil];
-            [fileManager moveItemAtURL:downloadedFileURL toURL:fileURL error:&moveError];
-            self.error = moveError;
-        }
-        dispatch_semaphore_signal(self.semaphore);
-    }];
-    return self;
-}
-
-- (void) download:(NSError *__autoreleasing _Nullable * _Nullable)error {
-    self.semaphore = dispatch_semaphore_create(0);
-    [self.task resume];
-    dispatch_semaphore_wait(self.semaphore, DISPATCH_TIME_FOREVER);
-    if (error != nil) {
-        *error = self.error;
-    }
-}
-
-@end
@@ -107,4 +107,68 @@
     XCTAssertFalse([blackWhiteList allow:@"some"]);
 }
 
+- (void)testAllowMatchesRegularExpressions {
+    // How rules used to be matched, one regular expression per rule
+    BOOL (^regexMatches)(NSString *, NSString *) = ^BOOL(NSString *item, NSString *rule) {
+        NSArray *tokens = [rule componentsSeparatedByString:@"*"];
+        NSMutableArray *escaped = [NSMutableArray new];
+        for (NSString *token in tokens) [escaped addObject:[NSRegularExpression escapedPatternForString:token]];
+        NSString *pattern = [NSString stringWithFormat:@"^%@$", [escaped componentsJoinedByString:@".*"]];
+        NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:pattern options:0 error:nil];
+        return [regex numberOfMatchesInString:item options:0 range:NSMakeRange(0, item.length)] > 0;
+    };
+    NSString *(^randomString)(NSString *, NSUInteger) = ^NSString *(NSString *alphabet, NSUInteger maxLength) {
+        NSMutableString *string = [NSMutableString new];
+        NSUInteger length = arc4random_uniform((uint32_t)maxLength + 1);
+        for (NSUInteger i = 0; i < length; i++) {
+            [string appendString:[alphabet substringWithRange:NSMakeRange(arc4random_uniform((uint32_t)alphabet.length), 1)]];
+        }
+        return string;
+    };
+
+    for (int i = 0; i < 300; i++) {
+        NSMutableArray *rules = [NSMutableArray new];
+        NSUInteger ruleCount = arc4random_uniform(5);
+        for (NSUInteger j = 0; j < ruleCount; j++) {
+            [rules addObject:[(arc4random_uniform(2) ? @"-" : @"") stringByAppendingString:randomString(@"ab.*", 5)]];
+        }
+        WPBlackWhiteList *blackWhiteList = [[WPBlackWhiteList alloc] initWithRules:rules];
+        for (int k = 0; k < 20; k++) {
+            NSString *item = randomString(@"ab.", 6);
+            BOOL expected = YES;
+            BOOL whiteListed = NO;
+            for (NSString *rule in blackWhiteList.whiteList) {
+                if (regexMatches(item, rule)) whiteListed = YES;
+            }
+            if (!whiteListed) {
+                for (NSString *rule in blackWhiteList.blackList) {
+                    if (regexMatches(item, rule)) expected = NO;
+                }
+            }
+            XCTAssertEqual(expected, [blackWhiteList allow:item], @"%@ with rules %@", item, rules);
+            for (NSString *rule in rules) {
+                XCTAssertEqual(regexMatches(item, rule), [WPBlackWhiteList item:item matches:rule], @"%@ with rule %@", item, rule);
+            }
+        }
+    }
+}
+
+- (void)testPerformanceAllow {
+    NSMutableArray *rules = [NSMutableArray new];
+    for (int i = 0; i < 20; i++) {
+        [rules addObject:[NSString stringWithFormat:@"-event_%d", i]];
+        [rules addObject:[NSString stringWithFormat:@"-prefix_%d_*", i]];
+        [rules addObject:[NSString stringWithFormat:@"-*_suffix_%d", i]];
+        [rules addObject:[NSString stringWithFormat:@"-in*side_%d*", i]];
+    }
+    [rules addObject:@"@APP_OPEN"];
+    WPBlackWhiteList *blackWhiteList = [[WPBlackWhiteList alloc] initWithRules:rules];
+    NSArray *items = @[@"@APP_OPEN", @"@PRESENCE", @"event_3", @"prefix_7_foo", @"foo_suffix_12", @"inner_side_4_bar", @"purchase"];
+    [self measureBlock:^{
+        for (int i = 0; i < 10000; i++) {
+            [blackWhiteList allow:items[i % items.count]];
+        }
+    }];
+}
+
 @end
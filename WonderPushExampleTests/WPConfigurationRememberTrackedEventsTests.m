@@ -670,4 +670,59 @@
     XCTAssertEqual(21, [occurrences[@"allTime"] integerValue]);
 }
 
+- (void) testTrackedEventsOfType {
+    [WPConfiguration.sharedConfiguration rememberTrackedEvent:[self toJSON:@"{\"type\":\"test\", \"actionDate\": 1000000000000}"]];
+    [WPConfiguration.sharedConfiguration rememberTrackedEvent:[self toJSON:@"{\"type\":\"test\", \"actionDate\": 1000000000000}"]];
+    [WPConfiguration.sharedConfiguration rememberTrackedEvent:[self toJSON:@"{\"type\":\"test\", \"collapsing\": \"campaign\", \"campaignId\": \"c1\", \"actionDate\": 1000000000000}"]];
+    [WPConfiguration.sharedConfiguration rememberTrackedEvent:[self toJSON:@"{\"type\":\"other\", \"actionDate\": 1000000000000}"]];
+
+    NSArray *events = [WPConfiguration.sharedConfiguration trackedEventsOfType:@"test" typePrefix:nil];
+    // 2 uncollapsed, 1 collapsing=last and 1 collapsing=campaign
+    XCTAssertEqual(4, events.count);
+    for (NSDictionary *event in events) {
+        XCTAssertEqualObjects(@"test", event[@"type"]);
+        XCTAssertEqualObjects(@1000000000000, event[@"creationDate"]);
+    }
+    XCTAssertEqual(2, [WPConfiguration.sharedConfiguration trackedEventsOfType:@"other" typePrefix:nil].count);
+    XCTAssertEqual(0, [WPConfiguration.sharedConfiguration trackedEventsOfType:@"unknown" typePrefix:nil].count);
+    XCTAssertEqual(4, [WPConfiguration.sharedConfiguration trackedEventsOfType:nil typePrefix:@"te"].count);
+    XCTAssertEqual(6, [WPConfiguration.sharedConfiguration trackedEventsOfType:nil typePrefix:@""].count);
+    XCTAssertEqual(6, [WPConfiguration.sharedConfiguration trackedEventsOfType:nil typePrefix:nil].count);
+
+    // The completed copies are kept across lookups
+    NSArray *eventsAgain = [WPConfiguration.sharedConfiguration trackedEventsOfType:@"test" typePrefix:nil];
+    for (NSDictionary *event in events) {
+        XCTAssertNotEqual(NSNotFound, [eventsAgain indexOfObjectIdenticalTo:event]);
+    }
+
+    // Setting the whole list resets the index
+    WPConfiguration.sharedConfiguration.trackedEvents = @[
+        @{@"type": @"test", @"actionDate": @1000000000000},
+        @{@"type": @[@"test"], @"actionDate": @1000000000000},
+        @{@"type": [NSNull null], @"actionDate": @1000000000000},
+        @{@"actionDate": @1000000000000},
+    ];
+    // Events whose type is not a string may match any type, except when it is null or missing
+    XCTAssertEqual(2, [WPConfiguration.sharedConfiguration trackedEventsOfType:@"test" typePrefix:nil].count);
+    XCTAssertEqual(1, [WPConfiguration.sharedConfiguration trackedEventsOfType:@"other" typePrefix:nil].count);
+    XCTAssertEqual(1, [WPConfiguration.sharedConfiguration trackedEventsOfType:nil typePrefix:@"other"].count);
+    XCTAssertEqual(4, [WPConfiguration.sharedConfiguration trackedEventsOfType:nil typePrefix:nil].count);
+}
+
+- (void) testTrackedEventsAreNotCopiedAgainAfterAChange {
+    [WPConfiguration.sharedConfiguration rememberTrackedEvent:[self toJSON:@"{\"type\":\"test\", \"actionDate\": 1000000000000}"]];
+    NSArray *events = WPConfiguration.sharedConfiguration.trackedEvents;
+    XCTAssertEqual(2, events.count);
+    XCTAssertEqual(events, WPConfiguration.sharedConfiguration.trackedEvents);
+
+    [WPConfiguration.sharedConfiguration rememberTrackedEvent:[self toJSON:@"{\"type\":\"other\", \"actionDate\": 1000000001000}"]];
+    NSArray *newEvents = WPConfiguration.sharedConfiguration.trackedEvents;
+    XCTAssertEqual(4, newEvents.count);
+    // The events that were kept are the very same objects
+    for (NSDictionary *event in events) {
+        XCTAssertNotEqual(NSNotFound, [newEvents indexOfObjectIdenticalTo:event]);
+        XCTAssertEqualObjects(@1000000000000, event[@"creationDate"]);
+    }
+}
+
 @end
@@ -0,0 +1,168 @@
+//
+//  WPDataManagerTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "WPDataManager.h"
+#import <WonderPushCommon/WPRequest.h>
+#import <WonderPushCommon/WPResponse.h>
+
+@interface WPDataManager (Tests)
+- (NSDictionary *) configurationState;
+- (NSArray<NSString *> *) exportedUserIds;
+- (void) fetchAccessTokenForUserId:(NSString *)userId success:(void (^)(id))success failure:(void (^)(NSError *))failure;
+- (void) executeRequest:(WPRequest *)request;
+@end
+
+/**
+ A data manager answering from a local stand-in for the API, after some latency.
+ Each user has two pages of events, which take longer to fetch for the first users.
+ */
+@interface WPDataManagerTestsDataManager : WPDataManager
+@property (nonatomic, strong) NSArray<NSString *> *userIds;
+@property (nonatomic, assign) NSInteger profileRequestsInFlight;
+@property (nonatomic, assign) NSInteger maxProfileRequestsInFlight;
+@property (nonatomic, assign) NSInteger eventsRequestsInFlight;
+@property (nonatomic, assign) NSInteger maxEventsRequestsInFlight;
+@end
+
+@implementation WPDataManagerTestsDataManager
+
+- (NSDictionary *) configurationState {
+    return @{ @"clientId": @"test" };
+}
+
+- (NSArray<NSString *> *) exportedUserIds {
+    return self.userIds;
+}
+
+- (void) respondAfter:(NSTimeInterval)latency events:(BOOL)events with:(dispatch_block_t)respond {
+    @synchronized (self) {
+        if (events) {
+            self.eventsRequestsInFlight++;
+            self.maxEventsRequestsInFlight = MAX(self.maxEventsRequestsInFlight, self.eventsRequestsInFlight);
+        } else {
+            self.profileRequestsInFlight++;
+            self.maxProfileRequestsInFlight = MAX(self.maxProfileRequestsInFlight, self.profileRequestsInFlight);
+        }
+    }
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(latency * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+        @synchronized (self) {
+            if (events) {
+                self.eventsRequestsInFlight--;
+            } else {
+                self.profileRequestsInFlight--;
+            }
+        }
+        respond();
+    });
+}
+
+- (void) fetchAccessTokenForUserId:(NSString *)userId success:(void (^)(id))success failure:(void (^)(NSError *))failure {
+    [self respondAfter:0.01 events:NO with:^{
+        success(@{ @"token": [@"token-" stringByAppendingString:userId] });
+    }];
+}
+
+- (void) executeRequest:(WPRequest *)request {
+    WPResponse *response = [WPResponse new];
+    NSString *userId = request.userId;
+    if ([request.resource isEqualToString:@"/events"]) {
+        BOOL firstPage = request.params[@"page"] == nil;
+        response.object = @{
+            @"data": @[ @{ @"type": [NSString stringWithFormat:@"%@-%@", userId, firstPage ? @"1" : @"2"] } ],
+            @"pagination": firstPage ? @{ @"next": @"https://api.example.com/v1/events?limit=1000&page=2" } : @{},
+        };
+        NSTimeInterval latency = 0.02 * (self.userIds.count - [self.userIds indexOfObject:userId]);
+        [self respondAfter:latency events:YES with:^{
+            request.handler(response, nil);
+        }];
+        return;
+    }
+    response.object = @{ @"id": userId, @"resource": request.resource };
+    [self respondAfter:0.01 events:NO with:^{
+        request.handler(response, nil);
+    }];
+}
+
+@end
+
+@interface WPDataManagerTests : XCTestCase
+@property (nonatomic, strong) NSString *path;
+@end
+
+@implementation WPDataManagerTests
+
+- (void)setUp {
+    self.path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"%@.ndjson", [[NSUUID UUID] UUIDString]]];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:self.path error:nil];
+}
+
+- (NSArray *)expectedLinesForUserIds:(NSArray<NSString *> *)userIds {
+    NSMutableArray *lines = [NSMutableArray arrayWithObject:@{ @"sharedPreferences": @{ @"clientId": @"test" } }];
+    for (NSString *userId in userIds) {
+        [lines addObjectsFromArray:@[
+            @{ @"accessToken": @{ @"token": [@"token-" stringByAppendingString:userId] } },
+            @{ @"user": @{ @"id": userId, @"resource": @"/user" } },
+            @{ @"installation": @{ @"id": userId, @"resource": @"/installation" } },
+            @{ @"eventsPage": @[ @{ @"type": [userId stringByAppendingString:@"-1"] } ] },
+            @{ @"eventsPage": @[ @{ @"type": [userId stringByAppendingString:@"-2"] } ] },
+        ]];
+    }
+    return lines;
+}
+
+- (NSArray *)linesOfFile:(NSString *)path {
+    NSString *contents = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:nil];
+    NSMutableArray *lines = [NSMutableArray new];
+    for (NSString *line in [contents componentsSeparatedByString:@"\n"]) {
+        if (line.length == 0) continue;
+        [lines addObject:[NSJSONSerialization JSONObjectWithData:[line dataUsingEncoding:NSUTF8StringEncoding] options:0 error:nil] ?: line];
+    }
+    return lines;
+}
+
+- (void)testExportIsOrderedAndFetchesOneUserAtATime {
+    WPDataManagerTestsDataManager *dataManager = [WPDataManagerTestsDataManager new];
+    dataManager.userIds = @[ @"a", @"b", @"c", @"d" ];
+    NSMutableArray *progressCalls = [NSMutableArray new];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"export"];
+    [dataManager downloadAllDataToFile:self.path progress:^(NSUInteger exportedUserCount, NSUInteger userCount) {
+        [progressCalls addObject:@[ @(exportedUserCount), @(userCount) ]];
+    } completion:^(NSError *error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    // Lines of each user are kept together and in order, although later users' events arrive first
+    XCTAssertEqualObjects([self expectedLinesForUserIds:dataManager.userIds], [self linesOfFile:self.path]);
+    XCTAssertEqualObjects((@[ @[ @0, @4 ], @[ @1, @4 ], @[ @2, @4 ], @[ @3, @4 ], @[ @4, @4 ] ]), progressCalls);
+
+    // Access tokens, users and installations are never fetched for several users at once, only events are
+    XCTAssertEqual(1, dataManager.maxProfileRequestsInFlight);
+    XCTAssertGreaterThan(dataManager.maxEventsRequestsInFlight, 1);
+    XCTAssertLessThanOrEqual(dataManager.maxEventsRequestsInFlight, 3);
+}
+
+- (void)testDownloadAllData {
+    WPDataManagerTestsDataManager *dataManager = [WPDataManagerTestsDataManager new];
+    dataManager.userIds = @[ @"a", @"b" ];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"export"];
+    [dataManager downloadAllData:^(NSData *data, NSError *error) {
+        XCTAssertNil(error);
+        [data writeToFile:self.path atomically:YES];
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    XCTAssertEqualObjects([self expectedLinesForUserIds:@[ @"a", @"b" ]], [self linesOfFile:self.path]);
+}
+
+@end
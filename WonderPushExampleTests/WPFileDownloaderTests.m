@@ -0,0 +1,178 @@
+//
+//  WPFileDownloaderTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import <WonderPushCommon/WPFileDownloader.h>
+#import <WonderPushCommon/WPErrors.h>
+
+static NSUInteger requestCount = 0;
+
+/// Serves https://files.test/<name>?latency=<seconds>&size=<bytes>&status=<code>&etag=<etag> after the given latency
+@interface WPFileDownloaderTestsURLProtocol : NSURLProtocol
+@property (nonatomic, strong) NSThread *clientThread;
+@property (atomic, assign) BOOL stopped;
+@end
+
+@implementation WPFileDownloaderTestsURLProtocol
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"files.test"];
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request {
+    return request;
+}
+
+- (NSDictionary<NSString *, NSString *> *)parameters {
+    NSMutableDictionary *parameters = [NSMutableDictionary new];
+    for (NSURLQueryItem *queryItem in [NSURLComponents componentsWithURL:self.request.URL resolvingAgainstBaseURL:NO].queryItems) {
+        if (queryItem.value) parameters[queryItem.name] = queryItem.value;
+    }
+    return parameters;
+}
+
+- (void)startLoading {
+    @synchronized ([WPFileDownloaderTestsURLProtocol class]) {
+        requestCount++;
+    }
+    self.clientThread = [NSThread currentThread];
+    NSTimeInterval latency = [[self parameters][@"latency"] doubleValue];
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(latency * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+        [self performSelector:@selector(respond) onThread:self.clientThread withObject:nil waitUntilDone:NO modes:@[NSRunLoopCommonModes]];
+    });
+}
+
+- (void)respond {
+    if (self.stopped) return;
+    NSDictionary *parameters = [self parameters];
+    NSInteger size = [parameters[@"size"] integerValue];
+    NSInteger status = parameters[@"status"] ? [parameters[@"status"] integerValue] : 200;
+    NSMutableDictionary *headers = [NSMutableDictionary dictionaryWithDictionary:@{@"Content-Length": [@(size) stringValue]}];
+    NSString *etag = parameters[@"etag"];
+    if (etag) {
+        headers[@"ETag"] = etag;
+        if ([[self.request valueForHTTPHeaderField:@"If-None-Match"] isEqualToString:etag]) {
+            status = 304;
+            size = 0;
+            headers[@"Content-Length"] = @"0";
+        }
+    }
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL statusCode:status HTTPVersion:@"HTTP/1.1" headerFields:headers];
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    [self.client URLProtocol:self didLoadData:[NSMutableData dataWithLength:size]];
+    [self.client URLProtocolDidFinishLoading:self];
+}
+
+- (void)stopLoading {
+    self.stopped = YES;
+}
+
+@end
+
+@interface WPFileDownloaderTests : XCTestCase
+@property (nonatomic, strong) NSString *directory;
+@property (nonatomic, strong) WPFileDownloader *downloader;
+@end
+
+@implementation WPFileDownloaderTests
+
+- (void)setUp {
+    requestCount = 0;
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [[NSFileManager defaultManager] createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+    NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+    configuration.protocolClasses = @[[WPFileDownloaderTestsURLProtocol class]];
+    self.downloader = [[WPFileDownloader alloc] initWithSessionConfiguration:configuration];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+}
+
+- (WPFileDownload *)downloadNamed:(NSString *)name query:(NSString *)query {
+    NSURL *URL = [NSURL URLWithString:[NSString stringWithFormat:@"https://files.test/%@?%@", name, query]];
+    NSURL *fileURL = [NSURL fileURLWithPath:[self.directory stringByAppendingPathComponent:name]];
+    return [[WPFileDownload alloc] initWithURL:URL fileURL:fileURL];
+}
+
+- (unsigned long long)sizeOfFile:(NSURL *)fileURL {
+    return [[[NSFileManager defaultManager] attributesOfItemAtPath:fileURL.path error:nil] fileSize];
+}
+
+- (void)testDownloadsInParallel {
+    NSMutableArray<WPFileDownload *> *downloads = [NSMutableArray new];
+    for (int i = 0; i < 4; i++) {
+        [downloads addObject:[self downloadNamed:[NSString stringWithFormat:@"%d.png", i] query:@"latency=0.5&size=1000"]];
+    }
+    NSDate *start = [NSDate date];
+    [self.downloader download:downloads deadline:[NSDate dateWithTimeIntervalSinceNow:10]];
+    // Downloading one after the other would take 2 seconds
+    XCTAssertLessThan([[NSDate date] timeIntervalSinceDate:start], 1.5);
+    for (WPFileDownload *download in downloads) {
+        XCTAssertTrue(download.succeeded, @"%@", download.error);
+        XCTAssertEqual(1000, [self sizeOfFile:download.fileURL]);
+    }
+}
+
+- (void)testDeadlineKeepsCompletedDownloads {
+    WPFileDownload *fast = [self downloadNamed:@"fast.png" query:@"latency=0.1&size=1000"];
+    WPFileDownload *slow = [self downloadNamed:@"slow.png" query:@"latency=5&size=1000"];
+    NSDate *start = [NSDate date];
+    [self.downloader download:@[fast, slow] deadline:[NSDate dateWithTimeIntervalSinceNow:1]];
+    XCTAssertLessThan([[NSDate date] timeIntervalSinceDate:start], 2);
+    XCTAssertTrue(fast.succeeded, @"%@", fast.error);
+    XCTAssertFalse(slow.succeeded);
+    XCTAssertEqualObjects(NSURLErrorDomain, slow.error.domain);
+    XCTAssertEqual(NSURLErrorTimedOut, slow.error.code);
+}
+
+- (void)testMaximumSize {
+    WPFileDownload *small = [self downloadNamed:@"small.png" query:@"size=1000"];
+    small.maximumSize = 1000;
+    WPFileDownload *large = [self downloadNamed:@"large.png" query:@"size=1001"];
+    large.maximumSize = 1000;
+    [self.downloader download:@[small, large] deadline:[NSDate dateWithTimeIntervalSinceNow:10]];
+    XCTAssertTrue(small.succeeded, @"%@", small.error);
+    XCTAssertFalse(large.succeeded);
+    XCTAssertEqualObjects(WPErrorDomain, large.error.domain);
+    XCTAssertEqual(WPErrorFileTooLarge, large.error.code);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:large.fileURL.path]);
+}
+
+- (void)testHTTPFailure {
+    WPFileDownload *missing = [self downloadNamed:@"missing.png" query:@"status=404&size=10"];
+    [self.downloader download:@[missing] deadline:[NSDate dateWithTimeIntervalSinceNow:10]];
+    XCTAssertFalse(missing.succeeded);
+    XCTAssertEqual(WPErrorHTTPFailure, missing.error.code);
+}
+
+- (void)testCache {
+    WPMediaCache *cache = [[WPMediaCache alloc] initWithDirectory:[self.directory stringByAppendingPathComponent:@"cache"] byteBudget:1000000];
+    self.downloader.cache = cache;
+    WPFileDownload *first = [self downloadNamed:@"first.png" query:@"size=1000&etag=v1"];
+    [self.downloader download:@[first] deadline:[NSDate dateWithTimeIntervalSinceNow:10]];
+    XCTAssertTrue(first.succeeded, @"%@", first.error);
+    XCTAssertEqual(1, requestCount);
+
+    // Same URL, another file: served from the cache
+    WPFileDownload *second = [[WPFileDownload alloc] initWithURL:first.URL fileURL:[NSURL fileURLWithPath:[self.directory stringByAppendingPathComponent:@"second.png"]]];
+    [self.downloader download:@[second] deadline:[NSDate dateWithTimeIntervalSinceNow:10]];
+    XCTAssertTrue(second.succeeded, @"%@", second.error);
+    XCTAssertEqual(1, requestCount);
+    XCTAssertEqual(1000, [self sizeOfFile:second.fileURL]);
+
+    // Stale entries are revalidated
+    cache.maxAge = 0;
+    WPFileDownload *third = [[WPFileDownload alloc] initWithURL:first.URL fileURL:[NSURL fileURLWithPath:[self.directory stringByAppendingPathComponent:@"third.png"]]];
+    [self.downloader download:@[third] deadline:[NSDate dateWithTimeIntervalSinceNow:10]];
+    XCTAssertTrue(third.succeeded, @"%@", third.error);
+    XCTAssertEqual(2, requestCount);
+    XCTAssertEqual(1000, [self sizeOfFile:third.fileURL]);
+}
+
+@end
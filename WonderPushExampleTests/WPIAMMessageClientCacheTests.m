@@ -0,0 +1,118 @@
+//
+//  WPIAMMessageClientCacheTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "WPIAMMessageClientCache.h"
+#import "WPIAMFetchResponseParser.h"
+
+@interface WPIAMMessageClientCacheTestsBookKeeper : NSObject<WPIAMBookKeeper>
+@end
+
+@implementation WPIAMMessageClientCacheTestsBookKeeper
+@synthesize lastRateLimitedInAppDisplayTime;
+
+- (void)recordNewImpressionForReportingData:(WPReportingData *)reportingData withStartTimestampInSeconds:(double)timestamp {
+}
+
+- (NSArray<WPIAMImpressionRecord *> *)getImpressions {
+    return @[];
+}
+
+- (NSArray<NSString *> *)getCampaignIdsFromImpressions {
+    return @[];
+}
+
+@end
+
+@interface WPIAMMessageClientCacheTests : XCTestCase
+@property (nonatomic, strong) WPIAMMessageClientCache *cache;
+@end
+
+@implementation WPIAMMessageClientCacheTests
+
+- (void)setUp {
+    self.cache = [[WPIAMMessageClientCache alloc] initWithBookkeeper:[WPIAMMessageClientCacheTestsBookKeeper new]];
+}
+
+- (WPIAMMessageDefinition *)messageWithCampaignId:(NSString *)campaignId triggers:(NSArray *)triggers startDate:(NSTimeInterval)startDate endDate:(NSTimeInterval)endDate {
+    NSDictionary *campaign = @{
+        @"scheduling": @{@"startDate": @(startDate * 1000), @"endDate": @(endDate * 1000)},
+        @"triggers": triggers,
+        @"capping": @{@"maxImpressions": @1000},
+        @"notifications": @[@{
+            @"reporting": @{@"campaignId": campaignId, @"notificationId": campaignId},
+            @"content": @{@"banner": @{
+                @"backgroundHexColor": @"#ffffff",
+                @"title": @{@"hexColor": @"#000000", @"text": campaignId},
+                @"body": @{@"hexColor": @"#000000", @"text": campaignId},
+                @"actions": @[@{@"type": @"close"}],
+            }},
+        }],
+    };
+    WPIAMMessageDefinition *message = [WPIAMFetchResponseParser convertToMessageDefinitionWithCampaignDict:campaign];
+    XCTAssertNotNil(message);
+    return message;
+}
+
+- (NSString *)campaignIdOf:(WPIAMMessageDefinition *)message {
+    return message.renderData.reportingData.campaignId;
+}
+
+- (void)testEventCandidates {
+    NSTimeInterval now = [NSDate date].timeIntervalSince1970;
+    [self.cache setMessageData:@[
+        [self messageWithCampaignId:@"third" triggers:@[@{@"event": @{@"type": @"purchase"}, @"minOccurrences": @3}] startDate:now - 60 endDate:now + 60],
+        [self messageWithCampaignId:@"any" triggers:@[@{@"event": @{@"type": @"purchase"}, @"minOccurrences": @5}, @{@"event": @{@"type": @"purchase"}}] startDate:now - 60 endDate:now + 60],
+        [self messageWithCampaignId:@"other" triggers:@[@{@"event": @{@"type": @"other"}}] startDate:now - 60 endDate:now + 60],
+        [self messageWithCampaignId:@"launch" triggers:@[@{@"systemEvent": @"APP_LAUNCH"}] startDate:now - 60 endDate:now + 60],
+        [self messageWithCampaignId:@"foreground" triggers:@[@{@"systemEvent": @"ON_FOREGROUND"}] startDate:now - 60 endDate:now + 60],
+    ]];
+
+    // Priority order among the messages whose minOccurrences is reached
+    XCTAssertEqualObjects(@"any", [self campaignIdOf:[self.cache nextOnEventDisplayMsg:@"purchase" allTimeOccurrences:1]]);
+    XCTAssertEqualObjects(@"third", [self campaignIdOf:[self.cache nextOnEventDisplayMsg:@"purchase" allTimeOccurrences:3]]);
+    XCTAssertEqualObjects(@"other", [self campaignIdOf:[self.cache nextOnEventDisplayMsg:@"other" allTimeOccurrences:1]]);
+    XCTAssertNil([self.cache nextOnEventDisplayMsg:@"unknown" allTimeOccurrences:1]);
+    XCTAssertEqualObjects(@"launch", [self campaignIdOf:[self.cache nextOnAppLaunchDisplayMsg]]);
+    XCTAssertEqualObjects(@"foreground", [self campaignIdOf:[self.cache nextOnAppOpenDisplayMsg]]);
+
+    // Removed messages are out of the index
+    [self.cache removeMessagesWithCampaignId:@"any"];
+    XCTAssertNil([self.cache nextOnEventDisplayMsg:@"purchase" allTimeOccurrences:1]);
+    XCTAssertEqualObjects(@"third", [self campaignIdOf:[self.cache nextOnEventDisplayMsg:@"purchase" allTimeOccurrences:3]]);
+}
+
+- (void)testStartAndEndTimes {
+    NSTimeInterval now = [NSDate date].timeIntervalSince1970;
+    [self.cache setMessageData:@[
+        [self messageWithCampaignId:@"expired" triggers:@[@{@"event": @{@"type": @"purchase"}}] startDate:now - 60 endDate:now - 30],
+        [self messageWithCampaignId:@"expiring" triggers:@[@{@"event": @{@"type": @"purchase"}}] startDate:now - 60 endDate:now + 0.3],
+        [self messageWithCampaignId:@"starting" triggers:@[@{@"event": @{@"type": @"purchase"}}] startDate:now + 0.2 endDate:now + 60],
+        [self messageWithCampaignId:@"future" triggers:@[@{@"event": @{@"type": @"purchase"}}] startDate:now + 60 endDate:now + 120],
+    ]];
+    XCTAssertEqualObjects(@"expiring", [self campaignIdOf:[self.cache nextOnEventDisplayMsg:@"purchase" allTimeOccurrences:1]]);
+    [NSThread sleepForTimeInterval:0.5];
+    XCTAssertEqualObjects(@"starting", [self campaignIdOf:[self.cache nextOnEventDisplayMsg:@"purchase" allTimeOccurrences:1]]);
+}
+
+- (void)testPerformanceEventDispatch {
+    NSTimeInterval now = [NSDate date].timeIntervalSince1970;
+    NSMutableArray *messages = [NSMutableArray new];
+    for (int i = 0; i < 500; i++) {
+        NSString *eventType = [NSString stringWithFormat:@"event_%d", i];
+        [messages addObject:[self messageWithCampaignId:[NSString stringWithFormat:@"campaign_%d", i] triggers:@[@{@"event": @{@"type": eventType}}] startDate:now - 60 endDate:now + 3600]];
+    }
+    [self.cache setMessageData:messages];
+    [self measureBlock:^{
+        for (int i = 0; i < 1000; i++) {
+            XCTAssertNotNil([self.cache nextOnEventDisplayMsg:[NSString stringWithFormat:@"event_%d", i % 500] allTimeOccurrences:1]);
+        }
+    }];
+}
+
+@end
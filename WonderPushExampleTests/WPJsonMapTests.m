@@ -0,0 +1,265 @@
+//
+//  WPJsonMapTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import <WonderPushCommon/WPJsonUtil.h>
+#import "WPJsonMap.h"
+
+/// A key whose hash is fixed, to put several keys in the same trie slots
+@interface WPJsonMapTestsKey : NSObject <NSCopying>
+@property (nonatomic, copy) NSString *name;
+@property (nonatomic, assign) NSUInteger fixedHash;
+@end
+
+@implementation WPJsonMapTestsKey
+
++ (instancetype)key:(NSString *)name hash:(NSUInteger)hash {
+    WPJsonMapTestsKey *key = [self new];
+    key.name = name;
+    key.fixedHash = hash;
+    return key;
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    return self;
+}
+
+- (NSUInteger)hash {
+    return self.fixedHash;
+}
+
+- (BOOL)isEqual:(id)object {
+    return [object isKindOfClass:[WPJsonMapTestsKey class]] && [((WPJsonMapTestsKey *)object).name isEqualToString:self.name];
+}
+
+@end
+
+@interface WPJsonMapTests : XCTestCase
+
+@end
+
+@implementation WPJsonMapTests
+
+- (NSDictionary *)stateWithPropertyCount:(NSUInteger)count {
+    NSMutableDictionary *custom = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < count; i++) {
+        custom[[NSString stringWithFormat:@"string_property%lu", (unsigned long)i]] = [NSString stringWithFormat:@"value%lu", (unsigned long)i];
+    }
+    return @{@"custom": custom, @"preferences": @{@"subscriptionStatus": @"optIn"}, @"application": @{@"version": @"1.0"}};
+}
+
+- (void)testReadsLikeADictionary {
+    NSDictionary *state = [self stateWithPropertyCount:1000];
+    WPJsonMap *map = [WPJsonMap mapWithDictionary:state];
+    XCTAssertEqual(3, map.count);
+    XCTAssertEqualObjects(state, map);
+    XCTAssertEqualObjects(map, state);
+    XCTAssertTrue([map[@"custom"] isKindOfClass:[WPJsonMap class]]);
+    XCTAssertEqual(1000, [map[@"custom"] count]);
+    XCTAssertEqualObjects(@"value42", map[@"custom"][@"string_property42"]);
+    XCTAssertNil(map[@"custom"][@"missing"]);
+    XCTAssertEqualObjects([NSSet setWithArray:[state[@"custom"] allKeys]], [NSSet setWithArray:[map[@"custom"] allKeys]]);
+    XCTAssertEqual(map, [WPJsonMap mapWithDictionary:map]);
+    XCTAssertEqual(map, [map copy]);
+
+    NSData *data = [NSJSONSerialization dataWithJSONObject:map options:0 error:nil];
+    XCTAssertEqualObjects(state, [NSJSONSerialization JSONObjectWithData:data options:0 error:nil]);
+}
+
+- (void)testSetAndRemove {
+    WPJsonMap *empty = [WPJsonMap new];
+    WPJsonMap *map = empty;
+    for (NSUInteger i = 0; i < 2000; i++) {
+        map = [map mapBySettingObject:@(i) forKey:[NSString stringWithFormat:@"key%lu", (unsigned long)i]];
+    }
+    XCTAssertEqual(0, empty.count);
+    XCTAssertEqual(2000, map.count);
+    for (NSUInteger i = 0; i < 2000; i += 2) {
+        map = [map mapByRemovingObjectForKey:[NSString stringWithFormat:@"key%lu", (unsigned long)i]];
+    }
+    XCTAssertEqual(1000, map.count);
+    for (NSUInteger i = 0; i < 2000; i++) {
+        id expected = i % 2 ? @(i) : nil;
+        XCTAssertEqualObjects(expected, map[[NSString stringWithFormat:@"key%lu", (unsigned long)i]]);
+    }
+    XCTAssertEqual(map, [map mapByRemovingObjectForKey:@"missing"]);
+}
+
+- (void)testCollidingKeys {
+    WPJsonMapTestsKey *a = [WPJsonMapTestsKey key:@"a" hash:42];
+    WPJsonMapTestsKey *b = [WPJsonMapTestsKey key:@"b" hash:42];
+    WPJsonMapTestsKey *c = [WPJsonMapTestsKey key:@"c" hash:42];
+    WPJsonMap *map = [[[[WPJsonMap new] mapBySettingObject:@1 forKey:a] mapBySettingObject:@2 forKey:b] mapBySettingObject:@3 forKey:c];
+    XCTAssertEqual(3, map.count);
+    XCTAssertEqualObjects(@2, map[b]);
+    map = [map mapBySettingObject:@4 forKey:b];
+    XCTAssertEqual(3, map.count);
+    XCTAssertEqualObjects(@4, map[b]);
+    map = [map mapByRemovingObjectForKey:a];
+    XCTAssertEqual(2, map.count);
+    XCTAssertNil(map[a]);
+    map = [map mapByRemovingObjectForKey:c];
+    XCTAssertEqual(1, map.count);
+    XCTAssertEqualObjects(@4, map[b]);
+    XCTAssertNil(map[c]);
+}
+
+- (void)testMergeMatchesJsonUtil {
+    NSDictionary *base = @{
+        @"keep": @"value",
+        @"replace": @1,
+        @"remove": @YES,
+        @"object": @{@"a": @1, @"b": @{@"c": @2}, @"d": @3},
+        @"objectToValue": @{@"a": @1},
+    };
+    NSDictionary *diff = @{
+        @"replace": @2,
+        @"remove": [NSNull null],
+        @"missing": [NSNull null],
+        @"object": @{@"a": [NSNull null], @"b": @{@"e": @4}, @"f": @5},
+        @"objectToValue": @"value",
+        @"added": @{@"x": [NSNull null]},
+    };
+    for (NSNumber *nullFieldRemoves in @[@YES, @NO]) {
+        NSDictionary *expected = [WPJsonUtil merge:base with:diff nullFieldRemoves:nullFieldRemoves.boolValue];
+        NSDictionary *actual = [[WPJsonMap mapWithDictionary:base] mapByMerging:diff nullFieldRemoves:nullFieldRemoves.boolValue];
+        XCTAssertEqualObjects(expected, actual);
+    }
+}
+
+- (void)testDiffMatchesJsonUtil {
+    NSDictionary *from = @{
+        @"same": @"value",
+        @"changed": @1,
+        @"removed": @YES,
+        @"object": @{@"a": @1, @"b": @{@"c": @2}, @"d": @3},
+        @"sameObject": @{@"a": @1},
+    };
+    NSDictionary *to = @{
+        @"same": @"value",
+        @"changed": @2,
+        @"added": @[@1, @2],
+        @"object": @{@"b": @{@"c": @3}, @"d": @3, @"e": @4},
+        @"sameObject": @{@"a": @1},
+    };
+    NSDictionary *expected = [WPJsonUtil diff:from with:to];
+    XCTAssertEqualObjects(expected, [WPJsonMap diff:[WPJsonMap mapWithDictionary:from] with:[WPJsonMap mapWithDictionary:to]]);
+    XCTAssertEqualObjects(expected, [WPJsonMap diff:from with:[WPJsonMap mapWithDictionary:to]]);
+    XCTAssertEqualObjects(expected, [WPJsonMap diff:from with:to]);
+    XCTAssertNil([WPJsonMap diff:from with:nil]);
+    XCTAssertEqualObjects(to, [WPJsonMap diff:nil with:to]);
+}
+
+- (void)testDiffRestrictedToPaths {
+    NSDictionary *from = @{
+        @"same": @"value",
+        @"changed": @1,
+        @"removed": @YES,
+        @"object": @{@"a": @1, @"b": @{@"c": @2}, @"d": @3},
+        @"ignored": @1,
+    };
+    NSDictionary *to = @{
+        @"same": @"value",
+        @"changed": @2,
+        @"added": @[@1, @2],
+        @"object": @{@"b": @{@"c": @3}, @"d": @3, @"e": @4},
+        @"ignored": @2,
+    };
+    NSDictionary *paths = @{
+        @"same": @YES,
+        @"changed": @YES,
+        @"removed": @YES,
+        @"added": @YES,
+        @"missing": @YES,
+        @"object": @{@"a": @YES, @"b": @YES},
+    };
+    NSDictionary *expected = @{
+        @"changed": @2,
+        @"removed": [NSNull null],
+        @"added": @[@1, @2],
+        @"object": @{@"a": [NSNull null], @"b": @{@"c": @3}},
+    };
+    XCTAssertEqualObjects(expected, [WPJsonMap diff:[WPJsonMap mapWithDictionary:from] with:[WPJsonMap mapWithDictionary:to] paths:paths]);
+
+    // Nested paths cover whole values when they are not both objects
+    XCTAssertEqualObjects(@{@"ignored": @2}, [WPJsonMap diff:from with:to paths:@{@"ignored": @{@"x": @YES}}]);
+    XCTAssertEqualObjects(@{}, [WPJsonMap diff:from with:to paths:@{}]);
+}
+
+- (void)testMergeSharesUntouchedValues {
+    WPJsonMap *base = [WPJsonMap mapWithDictionary:[self stateWithPropertyCount:1000]];
+    WPJsonMap *merged = [base mapByMerging:@{@"custom": @{@"string_property42": @"changed"}} nullFieldRemoves:YES];
+    XCTAssertEqual(base[@"preferences"], merged[@"preferences"]);
+    XCTAssertEqual(base[@"custom"][@"string_property41"], merged[@"custom"][@"string_property41"]);
+    XCTAssertEqualObjects(@"value42", base[@"custom"][@"string_property42"]);
+    XCTAssertEqualObjects(@"changed", merged[@"custom"][@"string_property42"]);
+
+    // Merging a diff that changes nothing yields the very same map
+    XCTAssertEqual(merged, [merged mapByMerging:@{@"missing": [NSNull null]} nullFieldRemoves:YES]);
+
+    XCTAssertEqualObjects((@{@"custom": @{@"string_property42": @"changed"}}), [WPJsonMap diff:base with:merged]);
+    XCTAssertEqualObjects(@{}, [WPJsonMap diff:merged with:merged]);
+}
+
+#pragma mark - Performance
+
+- (void)measureWritesWithPropertyCount:(NSUInteger)count persistent:(BOOL)persistent {
+    NSDictionary *state = [self stateWithPropertyCount:count];
+    NSMutableArray<NSDictionary *> *diffs = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 100; i++) {
+        [diffs addObject:@{@"custom": @{[NSString stringWithFormat:@"string_property%lu", (unsigned long)(i * 7919 % count)]: @"changed"}}];
+    }
+    // Like WPJsonSync: each write is merged into the SDK state and the put accumulator, then diffed with the server state
+    [self measureBlock:^{
+        if (persistent) {
+            WPJsonMap *serverState = [WPJsonMap mapWithDictionary:state];
+            WPJsonMap *sdkState = serverState;
+            WPJsonMap *putAccumulator = [WPJsonMap new];
+            for (NSDictionary *diff in diffs) {
+                sdkState = [sdkState mapByMerging:diff nullFieldRemoves:YES];
+                putAccumulator = [putAccumulator mapByMerging:diff nullFieldRemoves:NO];
+                XCTAssertEqual(1, [WPJsonMap diff:serverState with:sdkState].count);
+            }
+        } else {
+            NSDictionary *serverState = state;
+            NSDictionary *sdkState = state;
+            NSDictionary *putAccumulator = @{};
+            for (NSDictionary *diff in diffs) {
+                sdkState = [WPJsonUtil merge:sdkState with:diff];
+                putAccumulator = [WPJsonUtil merge:putAccumulator with:diff nullFieldRemoves:NO];
+                XCTAssertEqual(1, [WPJsonUtil diff:serverState with:sdkState].count);
+            }
+        }
+    }];
+}
+
+- (void)testWritePerformanceWith10Properties {
+    [self measureWritesWithPropertyCount:10 persistent:YES];
+}
+
+- (void)testWritePerformanceWith1kProperties {
+    [self measureWritesWithPropertyCount:1000 persistent:YES];
+}
+
+- (void)testWritePerformanceWith10kProperties {
+    [self measureWritesWithPropertyCount:10000 persistent:YES];
+}
+
+- (void)testJsonUtilWritePerformanceWith10Properties {
+    [self measureWritesWithPropertyCount:10 persistent:NO];
+}
+
+- (void)testJsonUtilWritePerformanceWith1kProperties {
+    [self measureWritesWithPropertyCount:1000 persistent:NO];
+}
+
+- (void)testJsonUtilWritePerformanceWith10kProperties {
+    [self measureWritesWithPropertyCount:10000 persistent:NO];
+}
+
+@end
@@ -0,0 +1,87 @@
+//
+//  WPJsonSyncTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "WPJsonSync.h"
+
+@interface WPJsonSync (Tests)
+- (void) callPatch;
+@end
+
+@interface WPJsonSyncTests : XCTestCase
+@property (nonatomic, strong) WPJsonSync *sync;
+@property (nonatomic, copy) NSDictionary *patchedDiff;
+@property (nonatomic, copy) WPJsonSyncCallback onSuccess;
+@property (nonatomic, copy) WPJsonSyncCallback onFailure;
+@end
+
+@implementation WPJsonSyncTests
+
+- (void)setUp {
+    NSDictionary *state = @{@"custom": @{@"string_a": @"a", @"string_b": @"b"}, @"preferences": @{@"subscriptionStatus": @"optIn"}};
+    __weak WPJsonSyncTests *weakSelf = self;
+    self.sync = [[WPJsonSync alloc] initFromSdkState:state andServerState:state saveCallback:^(NSDictionary *state) {
+    } serverPatchCallback:^(NSDictionary *diff, WPJsonSyncCallback onSuccess, WPJsonSyncCallback onFailure) {
+        weakSelf.patchedDiff = diff;
+        weakSelf.onSuccess = onSuccess;
+        weakSelf.onFailure = onFailure;
+    } schedulePatchCallCallback:^{
+    } upgradeCallback:nil logIdentifier:@"tests"];
+}
+
+- (NSDictionary *)patch {
+    self.patchedDiff = nil;
+    [self.sync callPatch];
+    return self.patchedDiff;
+}
+
+- (void)testPatchesWrittenPaths {
+    XCTAssertNil([self patch]);
+
+    [self.sync put:@{@"custom": @{@"string_a": @"changed"}}];
+    XCTAssertEqualObjects((@{@"custom": @{@"string_a": @"changed"}}), [self patch]);
+    self.onSuccess();
+    XCTAssertNil([self patch]);
+
+    // Writing a value back is no change
+    [self.sync put:@{@"custom": @{@"string_b": @"other"}}];
+    [self.sync put:@{@"custom": @{@"string_b": @"b"}}];
+    XCTAssertNil([self patch]);
+
+    [self.sync put:@{@"custom": @{@"string_b": [NSNull null]}, @"preferences": @"replaced"}];
+    XCTAssertEqualObjects((@{@"custom": @{@"string_b": [NSNull null]}, @"preferences": @"replaced"}), [self patch]);
+    self.onSuccess();
+    XCTAssertEqualObjects((@{@"custom": @{@"string_a": @"changed"}, @"preferences": @"replaced"}), self.sync.serverState);
+}
+
+- (void)testFailedPatchPathsAreSentAgain {
+    [self.sync put:@{@"custom": @{@"string_a": @"changed"}}];
+    XCTAssertEqualObjects((@{@"custom": @{@"string_a": @"changed"}}), [self patch]);
+
+    // Written while the call is inflight
+    [self.sync put:@{@"custom": @{@"string_c": @"c"}}];
+    self.onFailure();
+
+    NSDictionary *expected = @{@"custom": @{@"string_a": @"changed", @"string_c": @"c"}};
+    XCTAssertEqualObjects(expected, [self patch]);
+    self.onSuccess();
+    XCTAssertNil([self patch]);
+    XCTAssertEqualObjects(self.sync.sdkState, self.sync.serverState);
+}
+
+- (void)testReceivedStatesAreFullyDiffed {
+    [self.sync receiveServerState:@{@"custom": @{@"string_a": @"a"}}];
+    XCTAssertEqualObjects((@{@"custom": @{@"string_b": @"b"}, @"preferences": @{@"subscriptionStatus": @"optIn"}}), [self patch]);
+    self.onSuccess();
+
+    [self.sync receiveDiff:@{@"custom": @{@"string_a": @"server"}}];
+    XCTAssertNil([self patch]);
+    XCTAssertEqualObjects(@"server", self.sync.sdkState[@"custom"][@"string_a"]);
+}
+
+@end
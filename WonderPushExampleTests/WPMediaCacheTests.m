@@ -0,0 +1,205 @@
+//
+//  WPMediaCacheTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import <WonderPushCommon/WPMediaCache.h>
+
+@interface WPMediaCacheTests : XCTestCase
+@property (nonatomic, strong) NSString *directory;
+@end
+
+@implementation WPMediaCacheTests
+
+- (void)setUp {
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+}
+
+- (WPMediaCache *)newCacheWithByteBudget:(unsigned long long)byteBudget {
+    return [[WPMediaCache alloc] initWithDirectory:self.directory byteBudget:byteBudget];
+}
+
+- (NSURL *)URL:(NSString *)name {
+    return [NSURL URLWithString:[@"https://media.test/" stringByAppendingString:name]];
+}
+
+- (NSData *)dataOfLength:(NSUInteger)length byte:(uint8_t)byte {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    memset(data.mutableBytes, byte, length);
+    return data;
+}
+
+- (NSHTTPURLResponse *)responseForURL:(NSURL *)URL headers:(NSDictionary *)headers {
+    return [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:headers];
+}
+
+- (NSString *)HTTPDate:(NSDate *)date {
+    NSDateFormatter *formatter = [NSDateFormatter new];
+    formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+    formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+    formatter.dateFormat = @"EEE, dd MMM yyyy HH:mm:ss 'GMT'";
+    return [formatter stringFromDate:date];
+}
+
+- (BOOL)isFresh:(WPMediaCache *)cache headers:(NSDictionary *)headers {
+    NSURL *URL = [self URL:[[NSUUID UUID] UUIDString]];
+    [cache storeData:[[NSUUID UUID].UUIDString dataUsingEncoding:NSUTF8StringEncoding] forURL:URL response:[self responseForURL:URL headers:headers]];
+    // Read back from disk, like another process would
+    return [cache isEntryFresh:[[self newCacheWithByteBudget:cache.byteBudget] entryForURL:URL]];
+}
+
+- (void)testStoreAndLookup {
+    WPMediaCache *cache = [self newCacheWithByteBudget:1000000];
+    XCTAssertNil([cache entryForURL:[self URL:@"a.png"]]);
+
+    NSData *data = [self dataOfLength:100 byte:1];
+    [cache storeData:data forURL:[self URL:@"a.png"] response:[self responseForURL:[self URL:@"a.png"] headers:@{@"Content-Type": @"image/png", @"ETag": @"\"v1\""}]];
+
+    // Another instance sees it, like another process would
+    WPMediaCacheEntry *entry = [[self newCacheWithByteBudget:1000000] entryForURL:[self URL:@"a.png"]];
+    XCTAssertEqualObjects(data, [NSData dataWithContentsOfURL:entry.fileURL]);
+    XCTAssertEqual(100, entry.size);
+    XCTAssertEqualObjects(@"image/png", entry.MIMEType);
+    XCTAssertEqualObjects(@"\"v1\"", entry.ETag);
+    XCTAssertTrue([cache isEntryFresh:entry]);
+    XCTAssertEqualObjects(@"image/png", [cache responseForEntry:entry].MIMEType);
+    XCTAssertNil([cache entryForURL:[self URL:@"b.png"]]);
+}
+
+- (void)testSameContentIsStoredOnce {
+    WPMediaCache *cache = [self newCacheWithByteBudget:1000000];
+    NSData *data = [self dataOfLength:100 byte:1];
+    WPMediaCacheEntry *a = [cache storeData:data forURL:[self URL:@"a.png"] response:nil];
+    WPMediaCacheEntry *b = [cache storeData:data forURL:[self URL:@"b.png"] response:nil];
+    XCTAssertEqualObjects(a.contentHash, b.contentHash);
+    XCTAssertEqual(100, cache.totalSize);
+}
+
+- (void)testStoreFile {
+    WPMediaCache *cache = [self newCacheWithByteBudget:1000000];
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    NSData *data = [self dataOfLength:100 byte:2];
+    [data writeToFile:path atomically:YES];
+    WPMediaCacheEntry *entry = [cache storeFileAtURL:[NSURL fileURLWithPath:path] forURL:[self URL:@"a.png"] response:nil];
+    // Removing the original does not affect the cache
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    XCTAssertEqualObjects(entry.contentHash, [cache entryForURL:[self URL:@"a.png"]].contentHash);
+
+    NSURL *linkURL = [NSURL fileURLWithPath:[self.directory stringByAppendingPathComponent:@"link.png"]];
+    XCTAssertTrue([cache linkEntry:entry toFileURL:linkURL error:nil]);
+    XCTAssertEqualObjects(data, [NSData dataWithContentsOfURL:linkURL]);
+}
+
+- (void)testLeastRecentlyUsedContentsAreEvicted {
+    WPMediaCache *cache = [self newCacheWithByteBudget:2500];
+    [cache storeData:[self dataOfLength:1000 byte:1] forURL:[self URL:@"a.png"] response:nil];
+    [NSThread sleepForTimeInterval:0.01];
+    [cache storeData:[self dataOfLength:1000 byte:2] forURL:[self URL:@"b.png"] response:nil];
+    [NSThread sleepForTimeInterval:0.01];
+    XCTAssertNotNil([cache entryForURL:[self URL:@"a.png"]]);
+    [NSThread sleepForTimeInterval:0.01];
+    [cache storeData:[self dataOfLength:1000 byte:3] forURL:[self URL:@"c.png"] response:nil];
+
+    XCTAssertEqual(2000, cache.totalSize);
+    XCTAssertNotNil([cache entryForURL:[self URL:@"a.png"]]);
+    XCTAssertNil([cache entryForURL:[self URL:@"b.png"]]);
+    XCTAssertNotNil([cache entryForURL:[self URL:@"c.png"]]);
+}
+
+- (void)testRevalidation {
+    WPMediaCache *cache = [self newCacheWithByteBudget:1000000];
+    cache.maxAge = 60;
+    [cache storeData:[self dataOfLength:100 byte:1] forURL:[self URL:@"a.png"] response:[self responseForURL:[self URL:@"a.png"] headers:@{@"ETag": @"\"v1\""}]];
+    WPMediaCacheEntry *entry = [cache entryForURL:[self URL:@"a.png"]];
+    XCTAssertTrue([cache isEntryFresh:entry]);
+    XCTAssertEqualObjects(@"\"v1\"", [[cache requestForURL:entry.URL entry:entry] valueForHTTPHeaderField:@"If-None-Match"]);
+
+    cache.maxAge = 0;
+    XCTAssertFalse([cache isEntryFresh:entry]);
+    cache.maxAge = 60;
+    [NSThread sleepForTimeInterval:0.01];
+    WPMediaCacheEntry *revalidated = [cache revalidateEntry:entry response:nil];
+    XCTAssertEqual(NSOrderedDescending, [revalidated.date compare:entry.date]);
+    XCTAssertEqualObjects(entry.contentHash, [cache entryForURL:[self URL:@"a.png"]].contentHash);
+}
+
+- (void)testNoStore {
+    WPMediaCache *cache = [self newCacheWithByteBudget:1000000];
+    XCTAssertNil([cache storeData:[self dataOfLength:100 byte:1] forURL:[self URL:@"a.png"] response:[self responseForURL:[self URL:@"a.png"] headers:@{@"Cache-Control": @"private, no-store"}]]);
+    XCTAssertNil([cache entryForURL:[self URL:@"a.png"]]);
+}
+
+- (void)testFreshnessFollowsTheResponseHeaders {
+    WPMediaCache *cache = [self newCacheWithByteBudget:1000000];
+    NSDate *now = [NSDate date];
+    XCTAssertTrue([self isFresh:cache headers:@{}]);
+    XCTAssertTrue([self isFresh:cache headers:@{@"Cache-Control": @"public, max-age=60"}]);
+    XCTAssertFalse([self isFresh:cache headers:@{@"Cache-Control": @"max-age=0"}]);
+    XCTAssertFalse([self isFresh:cache headers:@{@"Cache-Control": @"max-age=60", @"Age": @"60"}]);
+    XCTAssertFalse([self isFresh:cache headers:@{@"Cache-Control": @"no-cache, max-age=60"}]);
+
+    // Expires is relative to the date of the server
+    XCTAssertTrue([self isFresh:cache headers:@{@"Date": [self HTTPDate:[now dateByAddingTimeInterval:-7200]], @"Expires": [self HTTPDate:[now dateByAddingTimeInterval:-3600]]}]);
+    XCTAssertFalse([self isFresh:cache headers:@{@"Date": [self HTTPDate:now], @"Expires": [self HTTPDate:[now dateByAddingTimeInterval:-3600]]}]);
+    XCTAssertFalse([self isFresh:cache headers:@{@"Expires": @"0"}]);
+    // Cache-Control wins over Expires
+    XCTAssertTrue([self isFresh:cache headers:@{@"Cache-Control": @"max-age=60", @"Expires": @"0"}]);
+
+    // Fresh for a tenth of the time since the last modification
+    XCTAssertTrue([self isFresh:cache headers:@{@"Date": [self HTTPDate:now], @"Last-Modified": [self HTTPDate:[now dateByAddingTimeInterval:-86400]]}]);
+    XCTAssertFalse([self isFresh:cache headers:@{@"Date": [self HTTPDate:now], @"Last-Modified": [self HTTPDate:now]}]);
+
+    // maxAge caps whatever the server says
+    cache.maxAge = 0;
+    XCTAssertFalse([self isFresh:cache headers:@{@"Cache-Control": @"max-age=31536000"}]);
+}
+
+- (void)testRevalidationUpdatesFreshness {
+    WPMediaCache *cache = [self newCacheWithByteBudget:1000000];
+    WPMediaCacheEntry *entry = [cache storeData:[self dataOfLength:100 byte:1] forURL:[self URL:@"a.png"] response:[self responseForURL:[self URL:@"a.png"] headers:@{@"Cache-Control": @"no-cache", @"ETag": @"\"v1\""}]];
+    XCTAssertFalse([cache isEntryFresh:entry]);
+
+    NSHTTPURLResponse *notModified = [[NSHTTPURLResponse alloc] initWithURL:[self URL:@"a.png"] statusCode:304 HTTPVersion:@"HTTP/1.1" headerFields:@{@"Cache-Control": @"max-age=60"}];
+    entry = [cache revalidateEntry:entry response:notModified];
+    XCTAssertTrue([cache isEntryFresh:entry]);
+    XCTAssertTrue([cache isEntryFresh:[cache entryForURL:[self URL:@"a.png"]]]);
+
+    // Without new information, the entry is fresh as long as it was before
+    entry = [cache revalidateEntry:entry response:nil];
+    XCTAssertEqualWithAccuracy(60, [entry.expirationDate timeIntervalSinceDate:entry.date], 0.01);
+}
+
+- (void)testContentsStoredByAnotherProcessCountTowardsTheBudget {
+    [[self newCacheWithByteBudget:2500] storeData:[self dataOfLength:1000 byte:1] forURL:[self URL:@"a.png"] response:nil];
+    [NSThread sleepForTimeInterval:0.01];
+    WPMediaCache *cache = [self newCacheWithByteBudget:2500];
+    [cache storeData:[self dataOfLength:1000 byte:2] forURL:[self URL:@"b.png"] response:nil];
+    [NSThread sleepForTimeInterval:0.01];
+    [cache storeData:[self dataOfLength:1000 byte:3] forURL:[self URL:@"c.png"] response:nil];
+
+    XCTAssertEqual(2000, cache.totalSize);
+    XCTAssertNil([cache entryForURL:[self URL:@"a.png"]]);
+    XCTAssertNotNil([cache entryForURL:[self URL:@"c.png"]]);
+}
+
+- (void)testEvictionRemovesTheURLsOfEvictedContents {
+    WPMediaCache *cache = [self newCacheWithByteBudget:1500];
+    [cache storeData:[self dataOfLength:1000 byte:1] forURL:[self URL:@"a.png"] response:nil];
+    [cache storeData:[self dataOfLength:1000 byte:1] forURL:[self URL:@"a2.png"] response:nil];
+    [NSThread sleepForTimeInterval:0.01];
+    [cache storeData:[self dataOfLength:1000 byte:2] forURL:[self URL:@"b.png"] response:nil];
+
+    NSArray *URLEntries = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:[self.directory stringByAppendingPathComponent:@"urls"] error:nil];
+    XCTAssertEqual(1, URLEntries.count);
+    XCTAssertNotNil([cache entryForURL:[self URL:@"b.png"]]);
+}
+
+@end
@@ -19,6 +19,13 @@
 }
 @end
 
+@interface WPPresenceManager (Tests)
+@property (nonatomic, strong) NSDate * (^now)(void);
+@property (nonatomic, assign) NSUInteger wakeUpCount;
+- (nullable NSDate *)autoRenewDeadline;
+- (void)autoRenewTimerFired;
+@end
+
 @interface WPPresenceManagerTests : XCTestCase
 @end
 
@@ -204,5 +211,105 @@
     [waiter waitForExpectations:@[expectation] timeout:2];
 }
 
-@end
+/**
+ Ensures auto-renew wakes up once per renewal, and issues the same payloads as polling every tenth of the safety margin did.
+ */
+- (void)testAutoRenewWakesUpOncePerRenewal {
+    NSTimeInterval anticipatedTime = 5 * 60;
+    NSTimeInterval safetyMarginTime = 60;
+    NSTimeInterval duration = 60 * 60;
+    __block NSDate *now = [NSDate dateWithTimeIntervalSince1970:1600000000];
+    NSDate *startDate = now;
+    NSDate *endDate = [startDate dateByAddingTimeInterval:duration];
+
+    // Renew on the single deadline
+    MockPresenceDelegate *delegate = [MockPresenceDelegate new];
+    WPPresenceManager *manager = [[WPPresenceManager alloc]
+                                  initWithAutoRenewDelegate:delegate
+                                  anticipatedTime:anticipatedTime
+                                  safetyMarginTime:safetyMarginTime];
+    manager.now = ^{
+        return now;
+    };
+    [manager presenceDidStart];
+    NSMutableArray *payloads = [NSMutableArray new];
+    while ([manager.autoRenewDeadline compare:endDate] != NSOrderedDescending) {
+        now = manager.autoRenewDeadline;
+        [manager autoRenewTimerFired];
+        XCTAssertNotNil(delegate.presenceToRenew);
+        [payloads addObject:delegate.presenceToRenew.toJSON];
+        delegate.presenceToRenew = nil;
+    }
+    [manager presenceWillStop];
+
+    // Reference: poll every tenth of the safety margin
+    NSMutableArray *expectedPayloads = [NSMutableArray new];
+    NSUInteger pollCount = 0;
+    NSDate *fromDate = startDate;
+    NSDate *untilDate = [startDate dateByAddingTimeInterval:anticipatedTime];
+    for (NSTimeInterval t = safetyMarginTime / 10; t <= duration; t += safetyMarginTime / 10) {
+        pollCount++;
+        NSDate *pollDate = [startDate dateByAddingTimeInterval:t];
+        if ([untilDate timeIntervalSinceDate:pollDate] > safetyMarginTime) continue;
+        untilDate = [pollDate dateByAddingTimeInterval:anticipatedTime];
+        [expectedPayloads addObject:[[WPPresencePayload alloc] initWithFromDate:fromDate untilDate:untilDate].toJSON];
+    }
+
+    XCTAssertEqual(15, payloads.count);
+    XCTAssertEqualObjects(expectedPayloads, payloads);
+    XCTAssertEqual(payloads.count, manager.wakeUpCount);
+    XCTAssertEqual(600, pollCount);
+}
+
+/**
+ Ensures an early wake-up, like after a clock change, re-arms the deadline without renewing.
+ */
+- (void)testEarlyWakeUpDoesNotRenew {
+    __block NSDate *now = [NSDate dateWithTimeIntervalSince1970:1600000000];
+    MockPresenceDelegate *delegate = [MockPresenceDelegate new];
+    WPPresenceManager *manager = [[WPPresenceManager alloc]
+                                  initWithAutoRenewDelegate:delegate
+                                  anticipatedTime:300
+                                  safetyMarginTime:60];
+    manager.now = ^{
+        return now;
+    };
+    WPPresencePayload *startPayload = [manager presenceDidStart];
+    NSDate *deadline = manager.autoRenewDeadline;
+    XCTAssertEqualObjects([startPayload.untilDate dateByAddingTimeInterval:-60], deadline);
+
+    now = [deadline dateByAddingTimeInterval:-1];
+    [manager autoRenewTimerFired];
+    XCTAssertNil(delegate.presenceToRenew);
+    XCTAssertEqualObjects(startPayload, manager.lastPresencePayload);
+    XCTAssertEqualObjects(deadline, manager.autoRenewDeadline);
+
+    [manager presenceWillStop];
+    XCTAssertNil(manager.autoRenewDeadline);
+}
 
+/**
+ Ensures a deadline that is always already passed, when the anticipated time does not exceed the safety margin,
+ renews at most once per tenth of the safety margin instead of in a tight loop.
+ */
+- (void)testPassedDeadlineDoesNotRenewInATightLoop {
+    NSDate *now = [NSDate dateWithTimeIntervalSince1970:1600000000];
+    MockPresenceDelegate *delegate = [MockPresenceDelegate new];
+    WPPresenceManager *manager = [[WPPresenceManager alloc]
+                                  initWithAutoRenewDelegate:delegate
+                                  anticipatedTime:0.5
+                                  safetyMarginTime:1];
+    manager.now = ^{
+        return now;
+    };
+    [manager presenceDidStart];
+    XCTAssertEqual(NSOrderedAscending, [manager.autoRenewDeadline compare:now]);
+
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    [manager presenceWillStop];
+    XCTAssertGreaterThan(manager.wakeUpCount, 0);
+    // 0.5s at one wake-up per 0.1s, with some leeway for timer coalescing
+    XCTAssertLessThanOrEqual(manager.wakeUpCount, 6);
+}
+
+@end
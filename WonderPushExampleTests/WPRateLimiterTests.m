@@ -9,18 +9,30 @@
 #import <XCTest/XCTest.h>
 #import "WPRateLimiter.h"
 
-@interface WPRateLimiterTests : XCTestCase
+@interface WPRateLimiter (Tests)
+@property (nonatomic, strong) NSDate * (^now)(void);
+@end
 
+@interface WPRateLimiterTests : XCTestCase
+@property (nonatomic, strong) NSString *directory;
 @end
 
 @implementation WPRateLimiterTests
 
 - (void)setUp {
-    // Put setup code here. This method is called before the invocation of each test method in the class.
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
 }
 
 - (void)tearDown {
-    // Put teardown code here. This method is called after the invocation of each test method in the class.
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+}
+
+- (NSString *)path {
+    return [self.directory stringByAppendingPathComponent:@"RateLimiter.log"];
+}
+
+- (unsigned long long)fileSize {
+    return [[NSFileManager defaultManager] attributesOfItemAtPath:[self path] error:nil].fileSize;
 }
 
 - (void)testSimple {
@@ -115,6 +127,107 @@
     XCTAssert(![limiter2 isRateLimited:limit]);
  }
 
+- (void)testDecisionsMatchSlidingLog {
+    // Milliseconds, so that increments often fall right on the edge of the window
+    __block long long now = 1600000000000;
+    WPRateLimiter *limiter = [[WPRateLimiter alloc] initWithPath:[self path]];
+    limiter.now = ^{ return [NSDate dateWithTimeIntervalSince1970:now / 1000.]; };
+    NSArray<WPRateLimit *> *limits = @[
+        [[WPRateLimit alloc] initWithKey:@"a" timeToLive:1 limit:5],
+        [[WPRateLimit alloc] initWithKey:@"b" timeToLive:0.5 limit:1],
+        [[WPRateLimit alloc] initWithKey:@"c" timeToLive:3 limit:20],
+    ];
+    // The previous implementation: every increment date is kept until it gets older than the time to live
+    NSMutableDictionary<NSString *, NSMutableArray<NSNumber *> *> *reference = [NSMutableDictionary new];
+    BOOL (^referenceIsRateLimited)(WPRateLimit *) = ^BOOL(WPRateLimit *limit) {
+        NSMutableArray *dates = reference[limit.key];
+        if (!dates) return NO;
+        while (dates.count > 0 && [dates[0] longLongValue] < now - (long long)(limit.timeToLive * 1000)) [dates removeObjectAtIndex:0];
+        return dates.count >= limit.limit;
+    };
+
+    srand48(42);
+    for (int i = 0; i < 5000; i++) {
+        WPRateLimit *limit = limits[lrand48() % limits.count];
+        double action = drand48();
+        if (action < 0.4) {
+            [limiter increment:limit];
+            referenceIsRateLimited(limit);
+            if (!reference[limit.key]) reference[limit.key] = [NSMutableArray new];
+            [reference[limit.key] addObject:@(now)];
+        } else if (action < 0.41) {
+            [limiter clear:limit];
+            [reference removeObjectForKey:limit.key];
+        } else {
+            XCTAssertEqual(referenceIsRateLimited(limit), [limiter isRateLimited:limit], @"step %d", i);
+        }
+        now += lrand48() % 100;
+    }
+
+    // A new instance replays the log, compacted along the way, to the same decisions
+    WPRateLimiter *reloaded = [[WPRateLimiter alloc] initWithPath:[self path]];
+    reloaded.now = limiter.now;
+    for (WPRateLimit *limit in limits) {
+        XCTAssertEqual(referenceIsRateLimited(limit), [reloaded isRateLimited:limit]);
+    }
+    XCTAssertLessThan([self fileSize], 5000 * 20);
+}
+
+- (void)testChecksDoNotWrite {
+    WPRateLimiter *limiter = [[WPRateLimiter alloc] initWithPath:[self path]];
+    WPRateLimit *limit = [[WPRateLimit alloc] initWithKey:@"testLimit" timeToLive:1 limit:5];
+    [limiter increment:limit];
+    unsigned long long size = [self fileSize];
+    XCTAssertGreaterThan(size, 0);
+    for (int i = 0; i < 100; i++) {
+        XCTAssertFalse([limiter isRateLimited:limit]);
+    }
+    XCTAssertEqual(size, [self fileSize]);
+
+    // Increments only append their own record
+    [limiter increment:limit];
+    XCTAssertEqual(2 * size, [self fileSize]);
+}
+
+- (void)testInterruptedRecordIsIgnored {
+    WPRateLimiter *limiter = [[WPRateLimiter alloc] initWithPath:[self path]];
+    WPRateLimit *limit = [[WPRateLimit alloc] initWithKey:@"testLimit" timeToLive:60 limit:2];
+    [limiter increment:limit];
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:[self path]];
+    [fileHandle seekToEndOfFile];
+    [fileHandle writeData:[@"{\"k\":\"testLi" dataUsingEncoding:NSUTF8StringEncoding]];
+    [fileHandle closeFile];
+
+    WPRateLimiter *reloaded = [[WPRateLimiter alloc] initWithPath:[self path]];
+    XCTAssertFalse([reloaded isRateLimited:limit]);
+    [reloaded increment:limit];
+    XCTAssertTrue([[[WPRateLimiter alloc] initWithPath:[self path]] isRateLimited:limit]);
+}
+
+- (void)testPerformanceChecks {
+    WPRateLimiter *limiter = [[WPRateLimiter alloc] initWithPath:[self path]];
+    WPRateLimit *limit = [[WPRateLimit alloc] initWithKey:@"testLimit" timeToLive:60 limit:1000];
+    for (int i = 0; i < 1000; i++) {
+        [limiter increment:limit];
+    }
+    [self measureBlock:^{
+        for (int i = 0; i < 10000; i++) {
+            [limiter isRateLimited:limit];
+        }
+    }];
+}
+
+- (void)testPerformanceIncrements {
+    WPRateLimiter *limiter = [[WPRateLimiter alloc] initWithPath:[self path]];
+    WPRateLimit *limit = [[WPRateLimit alloc] initWithKey:@"testLimit" timeToLive:60 limit:100];
+    [self measureBlock:^{
+        for (int i = 0; i < 1000; i++) {
+            [limiter increment:limit];
+            [limiter isRateLimited:limit];
+        }
+    }];
+}
+
 - (void)waitFor:(NSTimeInterval)timeToWait {
     dispatch_semaphore_t sem = dispatch_semaphore_create(0);
     dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeToWait * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
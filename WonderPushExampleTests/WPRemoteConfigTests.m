@@ -9,6 +9,10 @@
 #import <XCTest/XCTest.h>
 #import "WPRemoteConfig.h"
 #import "WPSemver.h"
+#import "WPBlackWhiteList.h"
+#import "WPConfiguration.h"
+#import "WPIAMMessageDefinition.h"
+#import "WPSPCompiledSegment.h"
 #import <WonderPushCommon/WPErrors.h>
 
 @interface WPRemoteConfig ()
@@ -726,6 +730,63 @@
     XCTAssertNil(error);
 }
 
+- (void)testSnapshot {
+    WPRemoteConfig *config = [[WPRemoteConfig alloc] initWithData:@{
+        WP_REMOTE_CONFIG_EVENTS_BLACK_WHITE_LIST_KEY: @[@"-@*"],
+        WP_REMOTE_CONFIG_DISABLE_JSON_SYNC_KEY: @YES,
+        WP_REMOTE_CONFIG_TRACK_EVENTS_FOR_NON_SUBSCRIBERS: @"true",
+        WP_REMOTE_CONFIG_ANONYMOUS_API_CLIENT_RATE_LIMIT_LIMIT: @3,
+        WP_REMOTE_CONFIG_TRACKED_EVENTS_UNCOLLAPSED_MAXIMUM_COUNT_KEY: @12,
+    } version:@"1.0.0"];
+    WPRemoteConfigSnapshot *snapshot = config.snapshot;
+    XCTAssertNotNil(snapshot.eventsBlackWhiteList);
+    XCTAssertFalse([snapshot.eventsBlackWhiteList allow:@"@APP_OPEN"]);
+    XCTAssertTrue([snapshot.eventsBlackWhiteList allow:@"purchase"]);
+    XCTAssertTrue(snapshot.disableJsonSync);
+    XCTAssertFalse(snapshot.disableApiClient);
+    XCTAssertTrue(snapshot.trackEventsForNonSubscribers);
+    XCTAssertFalse(snapshot.allowAccessTokenForNonSubscribers);
+    XCTAssertEqualObjects(@3, snapshot.anonymousApiClientRateLimitLimit);
+    XCTAssertNil(snapshot.anonymousApiClientRateLimitTimeToLiveMilliseconds);
+    XCTAssertEqual(12, snapshot.trackedEventsUncollapsedMaximumCount);
+    XCTAssertEqual(DEFAULT_MAXIMUM_UNCOLLAPSED_TRACKED_EVENTS_AGE_MS, snapshot.trackedEventsUncollapsedMaximumAgeMs);
+    XCTAssertEqual(0, snapshot.inAppMessages.count);
+
+    // No list at all
+    XCTAssertNil([[WPRemoteConfig alloc] initWithData:@{} version:@"1.0.0"].snapshot.eventsBlackWhiteList);
+    XCTAssertNotNil([[WPRemoteConfig alloc] initWithData:@{WP_REMOTE_CONFIG_EVENTS_BLACK_WHITE_LIST_KEY: @[]} version:@"1.0.0"].snapshot.eventsBlackWhiteList);
+}
+
+- (void)testSnapshotInAppMessages {
+    NSBundle *bundle = [NSBundle bundleForClass:self.class];
+    NSData *configData = [NSData dataWithContentsOfURL:[bundle URLForResource:@"remote-config-example" withExtension:@"json"]];
+    NSMutableDictionary *configJSON = [[NSJSONSerialization JSONObjectWithData:configData options:NSJSONReadingMutableContainers error:nil] mutableCopy];
+    configJSON[@"inAppConfig"][@"campaigns"][0][@"segment"] = @{ @".foo": @{ @"eq": @YES } };
+
+    WPRemoteConfigSnapshot *snapshot = [WPRemoteConfig withJSON:configJSON error:nil].snapshot;
+    XCTAssertGreaterThan(snapshot.inAppMessages.count, 0);
+    NSUInteger compiledCount = 0;
+    for (WPIAMMessageDefinition *message in snapshot.inAppMessages) {
+        id compiled = [snapshot compiledSegmentOfInAppMessage:message];
+        if (message.segmentDefinition) {
+            XCTAssertTrue([compiled isKindOfClass:WPSPCompiledSegment.class]);
+            compiledCount++;
+        } else {
+            XCTAssertNil(compiled);
+        }
+    }
+    XCTAssertEqual(1, compiledCount);
+}
+
+- (void)testSnapshotKeptWhenFetchDateIsRefreshed {
+    self.manager.minimumConfigAge = 0;
+    WPRemoteConfig *config = [[WPRemoteConfig alloc] initWithData:@{} version:@"1.0.0" fetchDate:[NSDate dateWithTimeIntervalSinceNow:-100]];
+    self.storage.storedConfig = config;
+    [self.manager declareVersion:@"1.0.0"];
+    XCTAssertNotEqual(config, self.storage.storedConfig);
+    XCTAssertEqual(config.snapshot, self.storage.storedConfig.snapshot);
+}
+
 /**
  checks that minAge specified at config level is effective.
  */
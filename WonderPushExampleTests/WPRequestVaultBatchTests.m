@@ -0,0 +1,326 @@
+//
+//  WPRequestVaultBatchTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "WPRequestVaultBatch.h"
+#import "WPRequestVault.h"
+#import "WonderPush_private.h"
+#import <WonderPushCommon/WPErrors.h>
+
+/**
+ A local stand-in for the API, answering one request at a time after a fixed round trip latency.
+ It counts the requests handed to the executor, not HTTP exchanges: the HTTP framing of bulk requests is not exercised here.
+ Bulk requests get a successful result for each of their events,
+ unless they are set to fail with a given HTTP status or to get a given response.
+ The first requests can be set to fail because the client is disabled.
+ */
+@interface WPRequestVaultBatchTestsAPI : NSObject <WPRequestExecutor>
+@property (nonatomic, assign) NSTimeInterval latency;
+@property (nonatomic, assign) NSUInteger requestCount;
+@property (nonatomic, assign) NSUInteger eventCount;
+@property (nonatomic, assign) NSUInteger bulkRequestCount;
+@property (nonatomic, assign) NSInteger bulkStatusCode;
+@property (nonatomic, strong) id bulkResponseObject;
+@property (nonatomic, assign) NSUInteger clientDisabledCount;
+/// The most failures the retry scheduler had recorded in a row when a request came
+@property (nonatomic, weak) WPRetryScheduler *retryScheduler;
+@property (nonatomic, assign) NSUInteger maxConsecutiveFailureCount;
+@property (nonatomic, copy) void (^eventsHandled)(NSUInteger eventCount);
+@property (nonatomic, strong) dispatch_queue_t queue;
+@end
+
+@implementation WPRequestVaultBatchTestsAPI
+
+- (instancetype) init {
+    if (self = [super init]) {
+        _queue = dispatch_queue_create("WPRequestVaultBatchTestsAPI", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (void) executeRequest:(WPRequest *)request {
+    dispatch_async(self.queue, ^{
+        [NSThread sleepForTimeInterval:self.latency];
+        self.maxConsecutiveFailureCount = MAX(self.maxConsecutiveFailureCount, self.retryScheduler.consecutiveFailureCount);
+        if (self.clientDisabledCount > 0) {
+            self.clientDisabledCount--;
+            self.requestCount++;
+            if (request.handler) request.handler(nil, [NSError errorWithDomain:WPErrorDomain code:WPErrorClientDisabled userInfo:nil]);
+            return;
+        }
+        WPResponse *response = [WPResponse new];
+        NSUInteger events = 1;
+        if ([request.resource isEqualToString:@"events/bulk"]) {
+            self.bulkRequestCount++;
+        }
+        if ([request.resource isEqualToString:@"events/bulk"] && (self.bulkStatusCode || self.bulkResponseObject)) {
+            self.requestCount++;
+            if (self.bulkStatusCode) {
+                NSHTTPURLResponse *HTTPResponse = [[NSHTTPURLResponse alloc] initWithURL:[NSURL URLWithString:@"https://api.example.com/v1/events/bulk"] statusCode:self.bulkStatusCode HTTPVersion:nil headerFields:nil];
+                if (request.handler) request.handler(nil, [NSError errorWithDomain:WPErrorDomain code:WPErrorHTTPFailure userInfo:@{WPOperationFailingURLResponseErrorKey: HTTPResponse}]);
+            } else {
+                response.object = self.bulkResponseObject;
+                if (request.handler) request.handler(response, nil);
+            }
+            return;
+        } else if ([request.resource isEqualToString:@"events/bulk"]) {
+            NSMutableArray *results = [NSMutableArray new];
+            for (NSDictionary *event in request.params[@"body"][@"events"]) {
+                [results addObject:@{@"id": event[@"id"], @"status": @200}];
+            }
+            events = results.count;
+            response.object = @{@"results": results};
+        } else {
+            response.object = @{@"success": @YES};
+        }
+        self.requestCount++;
+        self.eventCount += events;
+        if (request.handler) request.handler(response, nil);
+        if (self.eventsHandled) self.eventsHandled(self.eventCount);
+    });
+}
+
+@end
+
+@interface WPRequestVault (Tests)
+@property (atomic, strong) NSDate *batchingRejectedUntil;
+- (BOOL) batchingRejected;
+- (BOOL) shouldBatchRequest:(WPRequest *)request;
+@end
+
+@interface WPRequestVaultBatchTests : XCTestCase
+@property (nonatomic, assign) BOOL wasReachable;
+@end
+
+@implementation WPRequestVaultBatchTests
+
+- (void)setUp {
+    self.wasReachable = [WonderPush isReachable];
+    [WonderPush setIsReachable:YES];
+}
+
+- (void)tearDown {
+    [WonderPush setIsReachable:self.wasReachable];
+}
+
+- (WPRequest *)eventRequest:(NSString *)type userId:(NSString *)userId {
+    WPRequest *request = [WPRequest new];
+    request.method = @"POST";
+    request.resource = @"/events";
+    request.userId = userId;
+    request.params = @{@"body": @{@"type": type}, @"timestamp": @"1600000000000"};
+    return request;
+}
+
+- (void)testCanBatchRequest {
+    XCTAssertTrue([WPRequestVaultBatch canBatchRequest:[self eventRequest:@"a" userId:nil]]);
+
+    WPRequest *request = [self eventRequest:@"a" userId:nil];
+    request.method = @"GET";
+    XCTAssertFalse([WPRequestVaultBatch canBatchRequest:request]);
+
+    request = [self eventRequest:@"a" userId:nil];
+    request.resource = @"/installation";
+    XCTAssertFalse([WPRequestVaultBatch canBatchRequest:request]);
+
+    request = [self eventRequest:@"a" userId:nil];
+    request.params = @{@"body": @"not an object"};
+    XCTAssertFalse([WPRequestVaultBatch canBatchRequest:request]);
+}
+
+- (void)testBulkRequest {
+    WPRequest *a = [self eventRequest:@"a" userId:@"user"];
+    WPRequest *b = [self eventRequest:@"b" userId:@"user"];
+    WPRequest *bulkRequest = [[[WPRequestVaultBatch alloc] initWithRequests:@[a, b]] bulkRequest];
+    XCTAssertEqualObjects(@"POST", bulkRequest.method);
+    XCTAssertEqualObjects(@"events/bulk", bulkRequest.resource);
+    XCTAssertEqualObjects(@"user", bulkRequest.userId);
+    NSDictionary *expected = @{@"body": @{@"events": @[
+        @{@"id": a.requestId, @"params": a.params},
+        @{@"id": b.requestId, @"params": b.params},
+    ]}};
+    XCTAssertEqualObjects(expected, bulkRequest.params);
+}
+
+- (void)testRequestsToRetry {
+    NSMutableArray<WPRequest *> *requests = [NSMutableArray new];
+    for (NSString *type in @[@"ok", @"noStatus", @"badRequest", @"tooMany", @"unavailable", @"missing", @"invalidStatus"]) {
+        [requests addObject:[self eventRequest:type userId:nil]];
+    }
+    WPRequestVaultBatch *batch = [[WPRequestVaultBatch alloc] initWithRequests:requests];
+    NSDictionary *response = @{@"results": @[
+        @{@"id": requests[0].requestId, @"status": @200},
+        @{@"id": requests[1].requestId},
+        @{@"id": requests[2].requestId, @"status": @400},
+        @{@"id": requests[3].requestId, @"status": @429},
+        @{@"id": requests[4].requestId, @"status": @503},
+        @"garbage",
+        @{@"id": requests[6].requestId, @"status": @"200"},
+    ]};
+    // Results without a numeric status do not confirm their request
+    NSArray *expected = @[requests[1], requests[3], requests[4], requests[5], requests[6]];
+    XCTAssertEqualObjects(expected, [batch requestsToRetryForResponse:response]);
+
+    // Without one result per request, nothing is known about the requests
+    XCTAssertNil([batch requestsToRetryForResponse:@{@"success": @YES}]);
+    XCTAssertNil([batch requestsToRetryForResponse:nil]);
+    XCTAssertNil([batch requestsToRetryForResponse:@{@"results": @[@{@"id": requests[0].requestId, @"status": @200}]}]);
+}
+
+/// Sends a few events in a single batch through the given API, and waits for them to be delivered.
+- (WPRequestVault *)vaultAfterSendingEventsTo:(WPRequestVaultBatchTestsAPI *)api {
+    return [self vaultAfterSendingEventsTo:api batchMaxCount:WP_REQUEST_VAULT_DEFAULT_BATCH_MAX_COUNT];
+}
+
+- (WPRequestVault *)vaultAfterSendingEventsTo:(WPRequestVaultBatchTestsAPI *)api batchMaxCount:(NSUInteger)batchMaxCount {
+    NSUInteger total = 5;
+    NSString *key = [NSString stringWithFormat:@"WPRequestVaultBatchTests-%@", [[NSUUID UUID] UUIDString]];
+    [WonderPush setIsReachable:NO];
+    WPRequestVault *vault = [[WPRequestVault alloc] initWithRequestExecutor:api userDefaultsKey:key];
+    vault.batchMaxCount = batchMaxCount;
+    vault.batchDelay = 0;
+    vault.clientDisabledRetryDelay = 0.01;
+    api.retryScheduler = vault.retryScheduler;
+    [vault restoreQueue];
+    for (NSUInteger i = 0; i < total; i++) {
+        [vault add:[self eventRequest:[NSString stringWithFormat:@"event%lu", (unsigned long)i] userId:nil]];
+    }
+    XCTestExpectation *expectation = [self expectationWithDescription:@"delivered"];
+    api.eventsHandled = ^(NSUInteger eventCount) {
+        if (eventCount == total) [expectation fulfill];
+    };
+    [WonderPush setIsReachable:YES];
+    [vault reachabilityChanged:WPNetworkReachabilityStatusReachableViaWiFi];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    [vault reset];
+    return vault;
+}
+
+- (void)testUnsupportedBulkRequestsFallBackToSingleRequests {
+    for (NSNumber *statusCode in @[@404, @405, @501]) {
+        WPRequestVaultBatchTestsAPI *api = [WPRequestVaultBatchTestsAPI new];
+        api.bulkStatusCode = statusCode.integerValue;
+        WPRequestVault *vault = [self vaultAfterSendingEventsTo:api];
+        XCTAssertEqual(1, api.bulkRequestCount);
+        XCTAssertTrue(vault.batchingRejected, @"status %@", statusCode);
+
+        // Batching is tried again after a while
+        vault.batchingRejectedUntil = [NSDate dateWithTimeIntervalSinceNow:-1];
+        XCTAssertFalse(vault.batchingRejected);
+        vault.batchingRejectedUntil = nil;
+    }
+}
+
+- (void)testBatchingRejectionSurvivesRelaunch {
+    NSString *key = [NSString stringWithFormat:@"WPRequestVaultBatchTests-%@", [[NSUUID UUID] UUIDString]];
+    WPRequestVaultBatchTestsAPI *api = [WPRequestVaultBatchTestsAPI new];
+    WPRequestVault *vault = [[WPRequestVault alloc] initWithRequestExecutor:api userDefaultsKey:key];
+    vault.batchingRejectedUntil = [NSDate dateWithTimeIntervalSinceNow:WP_REQUEST_VAULT_BATCH_REJECTION_DURATION];
+
+    WPRequestVault *relaunchedVault = [[WPRequestVault alloc] initWithRequestExecutor:api userDefaultsKey:key];
+    XCTAssertTrue(relaunchedVault.batchingRejected);
+    XCTAssertFalse([relaunchedVault shouldBatchRequest:[self eventRequest:@"a" userId:nil]]);
+
+    relaunchedVault.batchingRejectedUntil = nil;
+    relaunchedVault = [[WPRequestVault alloc] initWithRequestExecutor:api userDefaultsKey:key];
+    XCTAssertFalse(relaunchedVault.batchingRejected);
+}
+
+- (void)testRejectedBulkRequestKeepsBatching {
+    for (NSNumber *statusCode in @[@400, @401]) {
+        WPRequestVaultBatchTestsAPI *api = [WPRequestVaultBatchTestsAPI new];
+        api.bulkStatusCode = statusCode.integerValue;
+        WPRequestVault *vault = [self vaultAfterSendingEventsTo:api];
+        // The events were sent one by one, to get their own outcome
+        XCTAssertEqual(1, api.bulkRequestCount);
+        XCTAssertEqual(6, api.requestCount);
+        XCTAssertFalse(vault.batchingRejected, @"status %@", statusCode);
+    }
+}
+
+- (void)testBulkResponseWithoutResultsSendsRequestsOneByOne {
+    for (id responseObject in @[@{@"success": @YES}, @{@"results": @[]}]) {
+        WPRequestVaultBatchTestsAPI *api = [WPRequestVaultBatchTestsAPI new];
+        api.bulkResponseObject = responseObject;
+        WPRequestVault *vault = [self vaultAfterSendingEventsTo:api];
+        XCTAssertEqual(1, api.bulkRequestCount);
+        XCTAssertEqual(6, api.requestCount);
+        XCTAssertFalse(vault.batchingRejected);
+    }
+}
+
+- (void)testFailedAttemptsAreCountedPerRequest {
+    NSString *key = [NSString stringWithFormat:@"WPRequestVaultBatchTests-%@", [[NSUUID UUID] UUIDString]];
+    WPRequestVault *vault = [[WPRequestVault alloc] initWithRequestExecutor:[WPRequestVaultBatchTestsAPI new] userDefaultsKey:key];
+    // Requests sent directly, outside of the vault, are counted too
+    WPRequest *unsaved = [self eventRequest:@"a" userId:nil];
+    XCTAssertEqual(1, [vault recordFailedAttemptOfRequest:unsaved]);
+    XCTAssertEqual(2, [vault recordFailedAttemptOfRequest:unsaved]);
+    XCTAssertEqual(3, [vault recordFailedAttemptOfRequest:[unsaved copy]]);
+    XCTAssertEqual(1, [vault recordFailedAttemptOfRequest:[self eventRequest:@"b" userId:nil]]);
+    [vault reset];
+}
+
+- (void)testClientDisabledRequestsAreRequeuedWithoutCountingAsFailures {
+    for (NSNumber *batchMaxCount in @[@1, @(WP_REQUEST_VAULT_DEFAULT_BATCH_MAX_COUNT)]) {
+        WPRequestVaultBatchTestsAPI *api = [WPRequestVaultBatchTestsAPI new];
+        api.clientDisabledCount = 3;
+        [self vaultAfterSendingEventsTo:api batchMaxCount:batchMaxCount.unsignedIntegerValue];
+        // The requests were delivered once requeued, and the retry scheduler never saw them fail
+        XCTAssertEqual(0, api.maxConsecutiveFailureCount, @"batch max count %@", batchMaxCount);
+    }
+}
+
+/// Measures how the number of requests handed to the executor drives the drain time, each costing one simulated round trip.
+- (void)drainEventsWithBatchMaxCount:(NSUInteger)batchMaxCount {
+    NSUInteger total = 1000;
+    WPRequestVaultBatchTestsAPI *api = [WPRequestVaultBatchTestsAPI new];
+    api.latency = 0.001;
+    NSString *key = [NSString stringWithFormat:@"WPRequestVaultBatchTests-%@", [[NSUUID UUID] UUIDString]];
+
+    // Queue the events while offline
+    [WonderPush setIsReachable:NO];
+    WPRequestVault *vault = [[WPRequestVault alloc] initWithRequestExecutor:api userDefaultsKey:key];
+    vault.batchMaxCount = batchMaxCount;
+    vault.batchDelay = 0;
+    [vault restoreQueue];
+    for (NSUInteger i = 0; i < total; i++) {
+        [vault add:[self eventRequest:[NSString stringWithFormat:@"event%lu", (unsigned long)i] userId:nil]];
+    }
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"drained"];
+    api.eventsHandled = ^(NSUInteger eventCount) {
+        if (eventCount == total) [expectation fulfill];
+    };
+    [self startMeasuring];
+    [WonderPush setIsReachable:YES];
+    [vault reachabilityChanged:WPNetworkReachabilityStatusReachableViaWiFi];
+    [self waitForExpectationsWithTimeout:60 handler:nil];
+    [self stopMeasuring];
+
+    if (batchMaxCount > 1) {
+        XCTAssertEqual(total / batchMaxCount, api.requestCount);
+    } else {
+        XCTAssertEqual(total, api.requestCount);
+    }
+    [vault reset];
+}
+
+- (void)testDrainPerformanceWithoutBatching {
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        [self drainEventsWithBatchMaxCount:1];
+    }];
+}
+
+- (void)testDrainPerformanceWithBatching {
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        [self drainEventsWithBatchMaxCount:WP_REQUEST_VAULT_DEFAULT_BATCH_MAX_COUNT];
+    }];
+}
+
+@end
@@ -0,0 +1,274 @@
+//
+//  WPRequestVaultLogTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "WPRequestVaultLog.h"
+
+@interface WPRequestVaultLogTests : XCTestCase
+@property (nonatomic, strong) NSString *directory;
+@end
+
+@implementation WPRequestVaultLogTests
+
+- (void)setUp {
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+}
+
+- (WPRequestVaultLog *)newLog {
+    return [[WPRequestVaultLog alloc] initWithDirectory:self.directory];
+}
+
+- (NSDictionary *)request:(NSString *)requestId {
+    return @{@"requestId": requestId, @"method": @"POST", @"resource": @"/events", @"params": @{@"body": requestId}};
+}
+
+- (NSArray<NSString *> *)requestIds:(WPRequestVaultLog *)log {
+    return [log.requests valueForKey:@"requestId"];
+}
+
+- (NSArray<NSString *> *)files {
+    return [[[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.directory error:nil] sortedArrayUsingSelector:@selector(compare:)];
+}
+
+- (void)appendBytes:(const char *)bytes toFile:(NSString *)file {
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:[self.directory stringByAppendingPathComponent:file]];
+    [fileHandle seekToEndOfFile];
+    [fileHandle writeData:[NSData dataWithBytes:bytes length:strlen(bytes)]];
+    [fileHandle closeFile];
+}
+
+- (void)testEmpty {
+    WPRequestVaultLog *log = [self newLog];
+    XCTAssertEqualObjects(@[], log.requests);
+    XCTAssertEqual(0, log.segmentCount);
+    XCTAssertEqualObjects(@[], [self files]);
+}
+
+- (void)testAppendAndRemoveSurviveReload {
+    WPRequestVaultLog *log = [self newLog];
+    [log appendRequest:[self request:@"a"]];
+    [log appendRequest:[self request:@"b"]];
+    [log appendRequest:[self request:@"c"]];
+    [log removeRequestId:@"b"];
+    NSArray *expected = @[@"a", @"c"];
+    XCTAssertEqualObjects(expected, [self requestIds:log]);
+
+    WPRequestVaultLog *reloaded = [self newLog];
+    XCTAssertEqualObjects(expected, [self requestIds:reloaded]);
+    XCTAssertEqualObjects([self request:@"a"], reloaded.requests[0]);
+
+    // Appends after a reload go to a new segment
+    [reloaded appendRequest:[self request:@"d"]];
+    [reloaded removeRequestId:@"a"];
+    expected = @[@"c", @"d"];
+    XCTAssertEqualObjects(expected, [self requestIds:[self newLog]]);
+}
+
+- (void)testIgnoresDuplicatesAndUnknownRequests {
+    WPRequestVaultLog *log = [self newLog];
+    [log appendRequest:[self request:@"a"]];
+    [log appendRequest:[self request:@"a"]];
+    [log appendRequest:@{@"method": @"POST"}];
+    [log removeRequestId:@"unknown"];
+    XCTAssertEqualObjects(@[@"a"], [self requestIds:log]);
+    XCTAssertEqualObjects(@[@"a"], [self requestIds:[self newLog]]);
+}
+
+- (void)testPartialWriteIsIgnored {
+    WPRequestVaultLog *log = [self newLog];
+    [log appendRequest:[self request:@"a"]];
+    [log appendRequest:[self request:@"b"]];
+    log = nil;
+
+    // Simulate a crash while appending a record
+    NSString *file = [self files].lastObject;
+    [self appendBytes:"{\"a\":{\"requestId\":\"c\",\"meth" toFile:file];
+
+    WPRequestVaultLog *reloaded = [self newLog];
+    NSArray *expected = @[@"a", @"b"];
+    XCTAssertEqualObjects(expected, [self requestIds:reloaded]);
+
+    // Further records must not be glued to the interrupted one
+    [reloaded appendRequest:[self request:@"d"]];
+    [reloaded removeRequestId:@"a"];
+    expected = @[@"b", @"d"];
+    XCTAssertEqualObjects(expected, [self requestIds:[self newLog]]);
+}
+
+- (void)testPartialTombstoneIsIgnored {
+    WPRequestVaultLog *log = [self newLog];
+    [log appendRequest:[self request:@"a"]];
+    log = nil;
+    [self appendBytes:"{\"t\":\"a\"}" toFile:[self files].lastObject];
+    XCTAssertEqualObjects(@[@"a"], [self requestIds:[self newLog]]);
+}
+
+- (void)testUnreadableRecordIsSkipped {
+    WPRequestVaultLog *log = [self newLog];
+    [log appendRequest:[self request:@"a"]];
+    log = nil;
+    NSString *file = [self files].lastObject;
+    [self appendBytes:"{\"a\":\n" toFile:file];
+    [self appendBytes:"{\"a\":{\"requestId\":\"b\"}}\n" toFile:file];
+    NSArray *expected = @[@"a", @"b"];
+    XCTAssertEqualObjects(expected, [self requestIds:[self newLog]]);
+}
+
+- (void)testSegmentsRollOverAndDeadOnesAreDeleted {
+    WPRequestVaultLog *log = [self newLog];
+    log.segmentMaxBytes = 1;
+    [log appendRequest:[self request:@"a"]];
+    [log appendRequest:[self request:@"b"]];
+    [log appendRequest:[self request:@"c"]];
+    XCTAssertEqual(3, log.segmentCount);
+
+    // The tombstone of a segment in the middle must be kept for its request not to come back
+    [log removeRequestId:@"b"];
+    XCTAssertEqual(4, log.segmentCount);
+    [log removeRequestId:@"a"];
+    XCTAssertEqual(3, log.segmentCount);
+
+    NSArray *expected = @[@"c"];
+    XCTAssertEqualObjects(expected, [self requestIds:[self newLog]]);
+    [log removeRequestId:@"c"];
+    XCTAssertEqualObjects(@[], [self newLog].requests);
+}
+
+- (void)testCompaction {
+    WPRequestVaultLog *log = [self newLog];
+    log.segmentMaxBytes = 200;
+    NSMutableArray *expected = [NSMutableArray new];
+    for (int i = 0; i < 20; i++) {
+        NSString *requestId = [NSString stringWithFormat:@"%d", i];
+        [log appendRequest:[self request:requestId]];
+        if (i % 3 == 0) {
+            [log removeRequestId:requestId];
+        } else {
+            [expected addObject:requestId];
+        }
+    }
+    XCTAssertGreaterThan(log.segmentCount, 1);
+    [log compact];
+    XCTAssertEqual(1, log.segmentCount);
+    XCTAssertEqual(1, [self files].count);
+    XCTAssertEqualObjects(expected, [self requestIds:log]);
+    XCTAssertEqualObjects(expected, [self requestIds:[self newLog]]);
+
+    // Appends and removals keep working on top of the compacted segment
+    [log appendRequest:[self request:@"new"]];
+    [log removeRequestId:@"1"];
+    [expected removeObject:@"1"];
+    [expected addObject:@"new"];
+    XCTAssertEqualObjects(expected, [self requestIds:[self newLog]]);
+
+    // Compacting everything away leaves no file behind
+    for (NSString *requestId in expected) {
+        [log removeRequestId:requestId];
+    }
+    [log compact];
+    XCTAssertEqualObjects(@[], [self files]);
+    XCTAssertEqualObjects(@[], [self newLog].requests);
+}
+
+- (void)testInterruptedCompaction {
+    WPRequestVaultLog *log = [self newLog];
+    log.segmentMaxBytes = 1;
+    for (NSString *requestId in @[@"a", @"b", @"c", @"d"]) {
+        [log appendRequest:[self request:requestId]];
+    }
+    [log removeRequestId:@"b"];
+    [log removeRequestId:@"d"];
+
+    // Simulate a crash after writing the compacted segment but before removing the others
+    NSString *backup = [self.directory stringByAppendingString:@"-backup"];
+    [[NSFileManager defaultManager] copyItemAtPath:self.directory toPath:backup error:nil];
+    [log compact];
+    for (NSString *file in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:backup error:nil]) {
+        [[NSFileManager defaultManager] copyItemAtPath:[backup stringByAppendingPathComponent:file] toPath:[self.directory stringByAppendingPathComponent:file] error:nil];
+    }
+    [[NSFileManager defaultManager] removeItemAtPath:backup error:nil];
+
+    WPRequestVaultLog *reloaded = [self newLog];
+    NSArray *expected = @[@"a", @"c"];
+    XCTAssertEqualObjects(expected, [self requestIds:reloaded]);
+    XCTAssertEqual(1, [self files].count);
+    [reloaded removeRequestId:@"a"];
+    XCTAssertEqualObjects(@[@"c"], [self requestIds:[self newLog]]);
+}
+
+- (void)testBackgroundCompaction {
+    WPRequestVaultLog *log = [self newLog];
+    for (int i = 0; i < 300; i++) {
+        [log appendRequest:[self request:[NSString stringWithFormat:@"%d", i]]];
+    }
+    for (int i = 1; i < 300; i += 2) {
+        [log removeRequestId:[NSString stringWithFormat:@"%d", i]];
+    }
+    XCTestExpectation *expectation = [self expectationWithDescription:@"compacted"];
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        while (![[self files] filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"SELF ENDSWITH '.compact.log'"]].count) {
+            [NSThread sleepForTimeInterval:0.01];
+        }
+        [expectation fulfill];
+    });
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertEqual(150, log.requests.count);
+    // Wait for any running compaction before reading the files from another instance
+    [log compact];
+    XCTAssertEqualObjects([self requestIds:log], [self requestIds:[self newLog]]);
+}
+
+- (void)testAttemptsSurviveReloadAndCompaction {
+    WPRequestVaultLog *log = [self newLog];
+    [log appendRequest:[self request:@"a"]];
+    [log appendRequest:[self request:@"b"]];
+    [log setAttempts:1 forRequestId:@"a"];
+    [log setAttempts:2 forRequestId:@"a"];
+    [log setAttempts:1 forRequestId:@"unknown"];
+    XCTAssertEqual(2, [log attemptsForRequestId:@"a"]);
+    XCTAssertEqual(0, [log attemptsForRequestId:@"b"]);
+    XCTAssertEqual(0, [log attemptsForRequestId:@"unknown"]);
+
+    WPRequestVaultLog *reloaded = [self newLog];
+    XCTAssertEqual(2, [reloaded attemptsForRequestId:@"a"]);
+    [reloaded compact];
+    XCTAssertEqual(2, [[self newLog] attemptsForRequestId:@"a"]);
+
+    [reloaded removeRequestId:@"a"];
+    XCTAssertEqual(0, [reloaded attemptsForRequestId:@"a"]);
+    XCTAssertEqual(0, [[self newLog] attemptsForRequestId:@"a"]);
+}
+
+- (void)testClear {
+    WPRequestVaultLog *log = [self newLog];
+    [log appendRequest:[self request:@"a"]];
+    [log clear];
+    XCTAssertEqualObjects(@[], log.requests);
+    XCTAssertEqualObjects(@[], [self newLog].requests);
+    [log appendRequest:[self request:@"b"]];
+    XCTAssertEqualObjects(@[@"b"], [self requestIds:[self newLog]]);
+}
+
+- (void)testPerformance {
+    [self measureBlock:^{
+        WPRequestVaultLog *log = [self newLog];
+        for (int i = 0; i < 1000; i++) {
+            [log appendRequest:[self request:[NSString stringWithFormat:@"%d", i]]];
+        }
+        for (int i = 0; i < 1000; i++) {
+            [log removeRequestId:[NSString stringWithFormat:@"%d", i]];
+        }
+        [log clear];
+    }];
+}
+
+@end
@@ -0,0 +1,171 @@
+//
+//  WPRetrySchedulerTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "WPRetryScheduler.h"
+
+@interface WPRetryScheduler (Tests)
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) dispatch_queue_t callbackQueue;
+@property (nonatomic, copy) NSTimeInterval (^now)(void);
+- (void) process;
+@end
+
+@interface WPRetrySchedulerTests : XCTestCase
+@property (nonatomic, strong) WPRetryScheduler *scheduler;
+@property (nonatomic, assign) NSTimeInterval time;
+@property (nonatomic, assign) NSUInteger runs;
+@end
+
+@implementation WPRetrySchedulerTests
+
+- (void)setUp {
+    self.scheduler = [[WPRetryScheduler alloc] initWithName:@"tests"];
+    self.scheduler.baseDelay = 1;
+    self.scheduler.maxDelay = 8;
+    self.scheduler.failureThreshold = 3;
+    self.scheduler.releaseInterval = 1;
+    self.scheduler.callbackQueue = dispatch_queue_create("WPRetrySchedulerTests", DISPATCH_QUEUE_SERIAL);
+    self.time = 1000;
+    __weak WPRetrySchedulerTests *weakSelf = self;
+    self.scheduler.now = ^{
+        return weakSelf.time;
+    };
+    self.runs = 0;
+}
+
+/// Waits for the scheduler to handle what it was told, and for the retries it let through to run.
+- (void)settle {
+    dispatch_sync(self.scheduler.queue, ^{});
+    dispatch_sync(self.scheduler.callbackQueue, ^{});
+}
+
+/// Moves the clock forward, and lets the scheduler see it right away instead of waiting for its timer.
+- (void)advanceBy:(NSTimeInterval)interval {
+    self.time += interval;
+    dispatch_sync(self.scheduler.queue, ^{
+        [self.scheduler process];
+    });
+    [self settle];
+}
+
+- (void)scheduleRetries:(NSUInteger)count attempt:(NSUInteger)attempt {
+    for (NSUInteger i = 0; i < count; i++) {
+        [self.scheduler scheduleRetry:^{
+            XCTAssertFalse([NSThread isMainThread]);
+            self.runs++;
+        } attempt:attempt];
+    }
+    [self settle];
+}
+
+- (void)testDelayForAttempt {
+    WPRetryScheduler *scheduler = [[WPRetryScheduler alloc] initWithName:@"delays"];
+    for (int i = 0; i < 100; i++) {
+        NSTimeInterval delay = [scheduler delayForAttempt:1];
+        XCTAssertGreaterThanOrEqual(delay, WP_RETRY_SCHEDULER_DEFAULT_BASE_DELAY / 2.);
+        XCTAssertLessThanOrEqual(delay, WP_RETRY_SCHEDULER_DEFAULT_BASE_DELAY);
+
+        delay = [scheduler delayForAttempt:4];
+        XCTAssertGreaterThanOrEqual(delay, WP_RETRY_SCHEDULER_DEFAULT_BASE_DELAY * 4.);
+        XCTAssertLessThanOrEqual(delay, WP_RETRY_SCHEDULER_DEFAULT_BASE_DELAY * 8.);
+
+        delay = [scheduler delayForAttempt:1000];
+        XCTAssertGreaterThanOrEqual(delay, WP_RETRY_SCHEDULER_DEFAULT_MAX_DELAY / 2.);
+        XCTAssertLessThanOrEqual(delay, WP_RETRY_SCHEDULER_DEFAULT_MAX_DELAY);
+    }
+    // Attempt 0 is read as the first one
+    XCTAssertLessThanOrEqual([scheduler delayForAttempt:0], WP_RETRY_SCHEDULER_DEFAULT_BASE_DELAY);
+}
+
+- (void)testDelaysAreJittered {
+    NSMutableSet *delays = [NSMutableSet new];
+    for (int i = 0; i < 10; i++) {
+        [delays addObject:@([self.scheduler delayForAttempt:3])];
+    }
+    XCTAssertGreaterThan(delays.count, 1);
+}
+
+- (void)testRetriesRunOnceDue {
+    for (NSUInteger attempt = 1; attempt <= 3; attempt++) {
+        [self scheduleRetries:1 attempt:attempt];
+    }
+    // Delays are at least half of the base delay
+    [self advanceBy:0.4];
+    XCTAssertEqual(0, self.runs);
+    XCTAssertEqual(3, self.scheduler.pendingRetryCount);
+
+    [self advanceBy:4];
+    XCTAssertEqual(3, self.runs);
+    XCTAssertEqual(0, self.scheduler.pendingRetryCount);
+    XCTAssertEqual(WPRetrySchedulerStateClosed, self.scheduler.state);
+}
+
+- (void)testRetriesAreHeldWhileUnreachable {
+    [self.scheduler setNetworkReachable:NO];
+    XCTAssertEqual(WPRetrySchedulerStateOpen, self.scheduler.state);
+    [self scheduleRetries:5 attempt:1];
+    [self advanceBy:100];
+    XCTAssertEqual(0, self.runs);
+    XCTAssertEqual(5, self.scheduler.pendingRetryCount);
+
+    // A single retry probes the network once it is back
+    [self.scheduler setNetworkReachable:YES];
+    [self settle];
+    XCTAssertEqual(WPRetrySchedulerStateHalfOpen, self.scheduler.state);
+    XCTAssertEqual(1, self.runs);
+
+    // Its success releases the others, one release interval apart
+    [self.scheduler recordSuccess];
+    [self settle];
+    XCTAssertEqual(WPRetrySchedulerStateClosed, self.scheduler.state);
+    XCTAssertEqual(2, self.runs);
+    [self advanceBy:1];
+    XCTAssertEqual(3, self.runs);
+    [self advanceBy:2];
+    XCTAssertEqual(5, self.runs);
+}
+
+- (void)testCircuitOpensAfterConsecutiveFailures {
+    [self.scheduler recordFailure];
+    [self.scheduler recordFailure];
+    XCTAssertEqual(WPRetrySchedulerStateClosed, self.scheduler.state);
+    [self.scheduler recordFailure];
+    XCTAssertEqual(3, self.scheduler.consecutiveFailureCount);
+    XCTAssertEqual(WPRetrySchedulerStateOpen, self.scheduler.state);
+
+    // The cooldown lasts at least half of the base delay
+    [self scheduleRetries:3 attempt:1];
+    [self advanceBy:0.4];
+    XCTAssertEqual(WPRetrySchedulerStateOpen, self.scheduler.state);
+    XCTAssertEqual(0, self.runs);
+
+    // Once it elapsed, a single probe goes through
+    [self advanceBy:0.7];
+    XCTAssertEqual(WPRetrySchedulerStateHalfOpen, self.scheduler.state);
+    XCTAssertEqual(1, self.runs);
+    [self advanceBy:10];
+    XCTAssertEqual(1, self.runs);
+
+    // A failed probe opens the circuit again, for longer
+    [self.scheduler recordFailure];
+    XCTAssertEqual(WPRetrySchedulerStateOpen, self.scheduler.state);
+    [self advanceBy:0.9];
+    XCTAssertEqual(WPRetrySchedulerStateOpen, self.scheduler.state);
+    XCTAssertEqual(1, self.runs);
+    [self advanceBy:1.2];
+    XCTAssertEqual(2, self.runs);
+
+    [self.scheduler recordSuccess];
+    [self settle];
+    XCTAssertEqual(0, self.scheduler.consecutiveFailureCount);
+    XCTAssertEqual(WPRetrySchedulerStateClosed, self.scheduler.state);
+    XCTAssertEqual(3, self.runs);
+}
+
+@end
@@ -0,0 +1,145 @@
+//
+//  WPSPAbsoluteDateTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "WPSPDefaultValueNodeParser.h"
+
+@interface WPSPAbsoluteDateTests : XCTestCase
+
+@end
+
+@implementation WPSPAbsoluteDateTests
+
+/**
+ The previous implementation, based on a regular expression and a date formatter, kept as a reference.
+ The formatter is pinned to the Gregorian calendar, which switches to the Julian calendar before 1583,
+ where the parser keeps using the proleptic Gregorian calendar.
+ */
++ (NSNumber *) referenceParseAbsoluteDate:(NSString *)input {
+    static NSRegularExpression *regularExpression = nil;
+    static NSDateFormatter *dateFormat = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        regularExpression = [[NSRegularExpression alloc] initWithPattern:@"^([0-9][0-9][0-9][0-9](?:-[0-9][0-9](?:-[0-9][0-9])?)?)(?:T([0-9][0-9](?::[0-9][0-9](?::[0-9][0-9](?:.[0-9][0-9][0-9])?)?)?))?(Z|[+-][0-9][0-9](?::[0-9][0-9](?::[0-9][0-9](?:.[0-9][0-9][0-9])?)?)?)?$" options:0 error:nil];
+        dateFormat = [NSDateFormatter new];
+        dateFormat.calendar = [[NSCalendar alloc] initWithCalendarIdentifier:NSCalendarIdentifierGregorian];
+        dateFormat.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        [dateFormat setDateFormat:@"yyyy-MM-dd'T'HH:mm:ss.SSSZ"];
+    });
+    NSTextCheckingResult *match = [regularExpression firstMatchInString:input options:0 range:NSMakeRange(0, input.length)];
+    if (!match) return nil;
+    NSString *date = [match rangeAtIndex:1].location == NSNotFound ? @"" : [input substringWithRange:[match rangeAtIndex:1]];
+    NSString *time = [match rangeAtIndex:2].location == NSNotFound ? @"" : [input substringWithRange:[match rangeAtIndex:2]];
+    NSString *offset = [match rangeAtIndex:3].location == NSNotFound ? @"" : [input substringWithRange:[match rangeAtIndex:3]];
+    date = [date stringByAppendingString:[@"1970-01-01" substringFromIndex:date.length]];
+    time = [time stringByAppendingString:[@"00:00:00.000" substringFromIndex:time.length]];
+    if ([@"Z" isEqualToString:offset]) offset = @"";
+    offset = [offset stringByAppendingString:[@"+00:00.000" substringFromIndex:offset.length]];
+    offset = [[offset substringWithRange:NSMakeRange(0, 6)] stringByReplacingOccurrencesOfString:@":" withString:@""];
+    NSDate *result = [dateFormat dateFromString:[date stringByAppendingFormat:@"T%@%@", time, offset]];
+    if (!result) return nil;
+    return [NSNumber numberWithLongLong:llround(result.timeIntervalSince1970 * 1000)];
+}
+
++ (NSNumber *) parseAbsoluteDate:(NSString *)input {
+    long long epochMs;
+    return [WPSPDefaultValueNodeParser parseAbsoluteDate:input epochMs:&epochMs] ? [NSNumber numberWithLongLong:epochMs] : nil;
+}
+
+- (void) testParseAbsoluteDate {
+    NSArray *testCases = @[
+        @[@"2020-02-03T04:05:06.007Z", @1580702706007],
+        @[@"2020-02-03T04:05:06.007", @1580702706007],
+        @[@"2020-02-03T04:05:06", @1580702706000],
+        @[@"2020-02-03T04:05", @1580702700000],
+        @[@"2020-02-03T04", @1580702400000],
+        @[@"2020-02-03", @1580688000000],
+        @[@"2020-02", @1580515200000],
+        @[@"2020", @1577836800000],
+        @[@"2020Z", @1577836800000],
+        @[@"2015-10-21T16:29:00-07:00", @1445470140000],
+        @[@"2015-10-21T16:29:00-07", @1445470140000],
+        @[@"2015-10-21T16:29:00+05:30:15.123", @1445425140000], // offset seconds are ignored
+        @[@"2020-05:30", @1577856600000], // a year and an offset, not a month
+        @[@"2020-02-29", @1582934400000],
+        @[@"1969-12-31T23:59:59.999Z", @-1],
+        @[@"1600-03-01", @-11670912000000],
+        @[@"2021-02-29", NSNull.null],
+        @[@"2020-13", NSNull.null],
+        @[@"2020-00", NSNull.null],
+        @[@"2020-01-00", NSNull.null],
+        @[@"2020-01-01T24", NSNull.null],
+        @[@"2020-01-01T00:60", NSNull.null],
+        @[@"2020-01-01T00:00:60", NSNull.null],
+        @[@"2020-01-01T00:00:00.0000", NSNull.null],
+        @[@"2020-01-01T", NSNull.null],
+        @[@"2020-01-01Z00", NSNull.null],
+        @[@"2020-01-01+24:00", NSNull.null],
+        @[@"0000", NSNull.null],
+        @[@"202", NSNull.null],
+        @[@"20200", NSNull.null],
+        @[@"２０２０", NSNull.null],
+        @[@"", NSNull.null],
+        @[@"foo", NSNull.null],
+        @[@"P1D", NSNull.null],
+    ];
+    for (NSArray *testCase in testCases) {
+        NSNumber *expected = testCase[1] == NSNull.null ? nil : testCase[1];
+        XCTAssertEqualObjects([self.class parseAbsoluteDate:testCase[0]], expected, @"%@", testCase[0]);
+    }
+}
+
+- (void) testEquivalenceWithReference {
+    NSArray<NSString *> *offsets = @[@"", @"Z", @"+00", @"-07:00", @"+05:30", @"+14:00", @"-03:30:15", @"+01:00:00.500", @"+24:00", @"-00:60"];
+    srand48(42);
+    for (int i = 0; i < 20000; i++) {
+        NSString *input = [NSString stringWithFormat:@"%04ld-%02ld-%02ldT%02ld:%02ld:%02ld.%03ld",
+                           1583 + lrand48() % 8417, lrand48() % 14, lrand48() % 33,
+                           lrand48() % 26, lrand48() % 62, lrand48() % 62, lrand48() % 1000];
+        // Drop trailing parts, down to the year, and append an offset
+        NSUInteger length = (NSUInteger[]){ 4, 7, 10, 13, 16, 19, 23 }[lrand48() % 7];
+        input = [[input substringToIndex:length] stringByAppendingString:offsets[lrand48() % offsets.count]];
+        XCTAssertEqualObjects([self.class parseAbsoluteDate:input], [self.class referenceParseAbsoluteDate:input], @"%@", input);
+    }
+}
+
+- (void) testFuzz {
+    NSString *alphabet = @"0123456789-:T.Z+ x\n";
+    srand48(1234);
+    for (int i = 0; i < 20000; i++) {
+        NSMutableString *input = [NSMutableString new];
+        if (lrand48() % 2) {
+            // Start from a valid date and garble it
+            [input appendFormat:@"%04ld-%02ld-%02ldT12:34:56.789+01:00", 1583 + lrand48() % 8417, 1 + lrand48() % 12, 1 + lrand48() % 28];
+            NSUInteger start = lrand48() % input.length;
+            [input deleteCharactersInRange:NSMakeRange(start, MIN((NSUInteger)(lrand48() % 3), input.length - start))];
+            NSUInteger index = lrand48() % (input.length + 1);
+            [input insertString:[alphabet substringWithRange:NSMakeRange(lrand48() % alphabet.length, 1)] atIndex:index];
+        } else {
+            for (long length = lrand48() % 40; length > 0; length--) {
+                [input appendString:[alphabet substringWithRange:NSMakeRange(lrand48() % alphabet.length, 1)]];
+            }
+        }
+        // Years before 1583 are read differently by the reference
+        NSNumber *year = input.length >= 4 ? @([input substringToIndex:4].integerValue) : nil;
+        if (year && year.integerValue < 1583) continue;
+        XCTAssertEqualObjects([self.class parseAbsoluteDate:input], [self.class referenceParseAbsoluteDate:input], @"%@", input);
+    }
+}
+
+- (void) testPerformance {
+    NSArray<NSString *> *inputs = @[@"2020-02-03T04:05:06.007Z", @"2015-10-21T16:29:00-07:00", @"2020-02", @"foo"];
+    [self measureBlock:^{
+        long long epochMs;
+        for (int i = 0; i < 10000; i++) {
+            [WPSPDefaultValueNodeParser parseAbsoluteDate:inputs[i % inputs.count] epochMs:&epochMs];
+        }
+    }];
+}
+
+@end
@@ -36,4 +36,34 @@
     NSArray *expectedParts = @[@"a", @"b", @"c", @"d"];
     XCTAssertEqualObjects(fullPath.parts, expectedParts);
 }
+
+- (void)testFieldAccessor {
+    WPSPFieldAccessor *accessor = [[WPSPFieldSource alloc] initWithParent:[[WPSPFieldSource alloc] initWithParent:[WPSPInstallationSource new] fieldPath:[WPSPFieldPath pathByParsing:@"a"]] fieldPath:[WPSPFieldPath pathByParsing:@"1.b"]].accessor;
+    NSArray *expectedParts = @[@"a", @"1", @"b"];
+    XCTAssertEqualObjects(accessor.path.parts, expectedParts);
+    XCTAssertFalse(accessor.readsDates);
+
+    // it should walk dictionaries and arrays
+    XCTAssertEqualObjects([accessor resolveInObject:(@{ @"a": @[ @{}, @{ @"b": @"foo" } ] })], @"foo");
+    XCTAssertNil([accessor resolveInObject:(@{ @"a": @[ @{ @"b": @"foo" } ] })]);
+    XCTAssertNil([accessor resolveInObject:(@{ @"a": @{ @"b": @"foo" } })]);
+    XCTAssertNil([accessor resolveInObject:(@{ @"a": @"foo" })]);
+    XCTAssertNil([accessor resolveInObject:(@{ @"a": @[ @{}, @{ @"b": NSNull.null } ] })]);
+    XCTAssertNil([accessor resolveInObject:nil]);
+
+    // it should return arrays as is, nulls included, and drop single nulls
+    accessor = [[WPSPFieldAccessor alloc] initWithPath:[WPSPFieldPath pathByParsing:@"foo"]];
+    NSArray *values = @[ @1, @"bar" ];
+    XCTAssertEqual([accessor valuesInObject:@{ @"foo": values }], values);
+    NSArray *valuesWithNulls = @[ NSNull.null, @1, NSNull.null, @"bar" ];
+    XCTAssertEqual([accessor valuesInObject:@{ @"foo": valuesWithNulls }], valuesWithNulls);
+    XCTAssertEqualObjects([accessor valuesInObject:@{ @"foo": @1 }], @[ @1 ]);
+    XCTAssertEqualObjects([accessor valuesInObject:@{ @"foo": NSNull.null }], @[]);
+    XCTAssertEqualObjects([accessor valuesInObject:@{}], @[]);
+
+    // it should read custom dates
+    accessor = [[WPSPFieldAccessor alloc] initWithPath:[WPSPFieldPath pathByParsing:@"custom.date_foo"]];
+    XCTAssertTrue(accessor.readsDates);
+    XCTAssertEqualObjects([accessor valuesInObject:(@{ @"custom": @{ @"date_foo": @[ @"2020-01-01T00:00:00.000Z", @1577836800000, @"foo", NSNull.null ] } })], (@[ @1577836800000, @1577836800000, @"foo" ]));
+}
 @end
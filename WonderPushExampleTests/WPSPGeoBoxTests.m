@@ -38,4 +38,18 @@ static const double left = 4;
     XCTAssertEqual(bottom, instance.bottom);
     XCTAssertEqual(left, instance.left);
 }
+
+- (void)testContainsLocation {
+    WPSPGeoBox *instance = [[WPSPGeoBox alloc] initWithTop:10 right:20 bottom:-10 left:-20];
+    XCTAssertTrue([instance containsLocation:[[WPSPGeoLocation alloc] initWithLat:0 lon:0]]);
+    XCTAssertTrue([instance containsLocation:[[WPSPGeoLocation alloc] initWithLat:10 lon:-20]]);
+    XCTAssertFalse([instance containsLocation:[[WPSPGeoLocation alloc] initWithLat:10.5 lon:0]]);
+    XCTAssertFalse([instance containsLocation:[[WPSPGeoLocation alloc] initWithLat:0 lon:-20.5]]);
+
+    // it should handle boxes crossing the antimeridian
+    instance = [[WPSPGeoBox alloc] initWithTop:10 right:-170 bottom:-10 left:170];
+    XCTAssertTrue([instance containsLocation:[[WPSPGeoLocation alloc] initWithLat:0 lon:175]]);
+    XCTAssertTrue([instance containsLocation:[[WPSPGeoLocation alloc] initWithLat:0 lon:-175]]);
+    XCTAssertFalse([instance containsLocation:[[WPSPGeoLocation alloc] initWithLat:0 lon:0]]);
+}
 @end
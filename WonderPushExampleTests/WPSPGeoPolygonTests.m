@@ -0,0 +1,62 @@
+//
+//  WPSPGeoPolygonTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "WPSPGeoPolygon.h"
+
+@interface WPSPGeoPolygonTests : XCTestCase
+@end
+
+@implementation WPSPGeoPolygonTests
+
+- (WPSPGeoPolygon *)polygonWithCoordinates:(NSArray<NSArray<NSNumber *> *> *)coordinates {
+    NSMutableArray<WPSPGeoLocation *> *points = [NSMutableArray new];
+    for (NSArray<NSNumber *> *latLon in coordinates) {
+        [points addObject:[[WPSPGeoLocation alloc] initWithLat:latLon[0].doubleValue lon:latLon[1].doubleValue]];
+    }
+    return [[WPSPGeoPolygon alloc] initWithPoints:points];
+}
+
+- (BOOL)polygon:(WPSPGeoPolygon *)polygon containsLat:(double)lat lon:(double)lon {
+    return [polygon containsLocation:[[WPSPGeoLocation alloc] initWithLat:lat lon:lon]];
+}
+
+- (void)testContainsLocation {
+    WPSPGeoPolygon *polygon = [self polygonWithCoordinates:@[ @[ @-10, @-20 ], @[ @10, @0 ], @[ @-10, @20 ] ]];
+    XCTAssertEqual(10, polygon.boundingBox.top);
+    XCTAssertEqual(20, polygon.boundingBox.right);
+    XCTAssertEqual(-10, polygon.boundingBox.bottom);
+    XCTAssertEqual(-20, polygon.boundingBox.left);
+    XCTAssertTrue([self polygon:polygon containsLat:0 lon:0]);
+    XCTAssertFalse([self polygon:polygon containsLat:5 lon:15]);
+    XCTAssertFalse([self polygon:polygon containsLat:0 lon:30]);
+
+    // it should need at least three points
+    polygon = [self polygonWithCoordinates:@[ @[ @-10, @-20 ], @[ @10, @0 ] ]];
+    XCTAssertFalse([self polygon:polygon containsLat:0 lon:-10]);
+}
+
+- (void)testCrossingTheAntimeridian {
+    // A square around the antimeridian, from 170°E to 170°W
+    WPSPGeoPolygon *polygon = [self polygonWithCoordinates:@[ @[ @-10, @170 ], @[ @10, @170 ], @[ @10, @-170 ], @[ @-10, @-170 ] ]];
+    // it should have a bounding box crossing the antimeridian too, instead of spanning the rest of the world
+    XCTAssertEqual(10, polygon.boundingBox.top);
+    XCTAssertEqual(-170, polygon.boundingBox.right);
+    XCTAssertEqual(-10, polygon.boundingBox.bottom);
+    XCTAssertEqual(170, polygon.boundingBox.left);
+    XCTAssertTrue([self polygon:polygon containsLat:0 lon:175]);
+    XCTAssertTrue([self polygon:polygon containsLat:0 lon:180]);
+    XCTAssertTrue([self polygon:polygon containsLat:0 lon:-180]);
+    XCTAssertTrue([self polygon:polygon containsLat:0 lon:-175]);
+    XCTAssertFalse([self polygon:polygon containsLat:0 lon:0]);
+    XCTAssertFalse([self polygon:polygon containsLat:0 lon:165]);
+    XCTAssertFalse([self polygon:polygon containsLat:0 lon:-165]);
+    XCTAssertFalse([self polygon:polygon containsLat:15 lon:180]);
+}
+
+@end
@@ -82,4 +82,48 @@
     XCTAssertEqualWithAccuracy(bottomRight.lat, self.bottom, self.delta);
     XCTAssertEqualWithAccuracy(bottomRight.lon, self.right, self.delta);
 }
+
+- (void)testParseIsCaseInsensitive {
+    XCTAssertEqualObjects([WPSPGeohash parse:@"EZS42"], [WPSPGeohash parse:self.geohash]);
+    XCTAssertThrows([WPSPGeohash parse:@"ezs4a"]);
+    XCTAssertThrows([WPSPGeohash parse:@"ezs4é"]);
+}
+
+- (void)testEncode {
+    XCTAssertEqualObjects([WPSPGeohash geohashWithLat:self.centerLat lon:self.centerLon precision:5], self.geohash);
+    XCTAssertEqualObjects([WPSPGeohash geohashWithLat:self.centerLat lon:self.centerLon precision:0], @"");
+    // Encoding the center of any geohash gives it back
+    for (NSString *geohash in @[ @"0", @"zzz", @"u09tvw", @"gcpvj0", @"xbp", @"8000000000" ]) {
+        WPSPGeohash *parsed = [WPSPGeohash parse:geohash];
+        XCTAssertEqualObjects([WPSPGeohash geohashWithLat:parsed.centerLat lon:parsed.centerLon precision:geohash.length], geohash);
+    }
+}
+
+- (void)testNeighbours {
+    WPSPGeohash *parsed = [WPSPGeohash parse:@"dqcjq"];
+    XCTAssertEqualObjects([parsed neighbourInDirection:WPSPGeohashDirectionNorth].geohash, @"dqcjw");
+    XCTAssertEqualObjects([parsed neighbourInDirection:WPSPGeohashDirectionEast].geohash, @"dqcjr");
+    XCTAssertEqualObjects([parsed neighbourInDirection:WPSPGeohashDirectionSouth].geohash, @"dqcjn");
+    XCTAssertEqualObjects([parsed neighbourInDirection:WPSPGeohashDirectionWest].geohash, @"dqcjm");
+    XCTAssertEqual(parsed.neighbours.count, 8);
+
+    // it should wrap around the antimeridian
+    XCTAssertEqualObjects([[WPSPGeohash parse:@"xbp"] neighbourInDirection:WPSPGeohashDirectionEast].geohash, @"800");
+
+    // it should stop at the poles
+    XCTAssertNil([[WPSPGeohash parse:@"zzz"] neighbourInDirection:WPSPGeohashDirectionNorth]);
+    XCTAssertEqual([WPSPGeohash parse:@"zzz"].neighbours.count, 5);
+}
+
+- (void)testParsePerformance {
+    NSMutableArray<NSString *> *geohashes = [NSMutableArray new];
+    for (int i = 0; i < 10000; i++) {
+        [geohashes addObject:[WPSPGeohash geohashWithLat:(i % 180) - 89.5 lon:(i % 360) - 179.5 precision:9]];
+    }
+    [self measureBlock:^{
+        for (NSString *geohash in geohashes) {
+            [WPSPGeohash parse:geohash];
+        }
+    }];
+}
 @end
@@ -63,6 +63,9 @@ static const WPSPSegmentationDSLParser *parser = nil;
     { \".field\": { \"gt\": { \"someType1\": 0, \"someType2\": 0 } } }, \
     { \".field\": { \"gt\": { \"date\": false } } }, \
     { \".field\": { \"gt\": { \"date\": \"invalid\" } } }, \
+    { \".field\": { \"gt\": { \"date\": \"2021-02-29\" } } }, \
+    { \".field\": { \"gt\": { \"date\": \"2020-13\" } } }, \
+    { \".field\": { \"gt\": { \"date\": \"2020-01-01T24:00\" } } }, \
     { \".field\": { \"gt\": { \"duration\": false } } }, \
     { \".field\": { \"gt\": { \"duration\": \"42 towels\" } } }, \
     { \".field\": { \"gt\": { \"duration\": \"P nope\" } } }, \
@@ -9,6 +9,7 @@
 #import <XCTest/XCTest.h>
 #import "WPSPSegmenter.h"
 #import "WPUtil.h"
+#import "WPTrackedEventsIndex.h"
 
 @interface WPSPSegmenterTests : XCTestCase
 
@@ -16,6 +17,14 @@
 
 static WPSPSegmenterData * _Nonnull emptyData = nil;
 
+@interface WPSPSegmenterData (Tests)
+
+- (instancetype)initWithPresenceInfo:(WPSPSegmenterPresenceInfo * _Nullable)presenceInfo lastAppOpenDate:(long long)lastAppOpenDate;
+@property (nonatomic, copy, nullable) NSArray<NSDictionary *> *(^allEventsProvider)(void);
+@property (nonatomic, copy, nullable) NSArray<NSDictionary *> *(^typedEventsProvider)(NSString * _Nullable type, NSString * _Nullable typePrefix);
+
+@end
+
 @interface WPSPSegmenterData (private)
 
 - (WPSPSegmenterData *) withInstallation:(NSDictionary *)installation;
@@ -266,6 +275,9 @@ id parseJson(NSString *input) {
     XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:[emptyData withInstallation:@{ @"custom": @{ @"date_foo": @1 } }]] parsedSegmentMatchesInstallation:parsedSegment]);
     XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:[emptyData withInstallation:@{ @"custom": @{ @"date_foo": @NO } }]] parsedSegmentMatchesInstallation:parsedSegment]);
     XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:[emptyData withInstallation:@{ @"custom": @{ @"date_foo": @"foo" } }]] parsedSegmentMatchesInstallation:parsedSegment]);
+    // Data that only looks like a date is kept as a string
+    XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:[emptyData withInstallation:@{ @"custom": @{ @"date_foo": @"2021-02-29" } }]] parsedSegmentMatchesInstallation:parsedSegment]);
+    XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:[emptyData withInstallation:@{ @"custom": @{ @"date_foo": @"2020-13" } }]] parsedSegmentMatchesInstallation:[WPSPSegmenter parseInstallationSegment:@{ @".custom.date_foo": @{ @"eq": @"2020-13" } }]]);
     XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:[emptyData withInstallation:@{ @"custom": @{ @"date_foo": @1577836800000 } }]] parsedSegmentMatchesInstallation:parsedSegment]);
     XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:[emptyData withInstallation:@{ @"custom": @{ @"date_foo": @"2029-09-09T09:09:09.009+09:09" } }]] parsedSegmentMatchesInstallation:parsedSegment]);
     XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:[emptyData withInstallation:@{ @"custom": @{ @"date_foo": @"2020-01-01T01:00:00.000+01:00" } }]] parsedSegmentMatchesInstallation:parsedSegment]);
@@ -658,6 +670,49 @@ id parseJson(NSString *input) {
     XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:[emptyData withPresenceInfo:[[WPSPSegmenterPresenceInfo alloc] initWithFromDate:now + 60000 untilDate:now + 120000 elapsedTime:60000]]] parsedSegmentMatchesInstallation:parsedSegment]); // not present yet, but leave date is gte -PT1M
 }
 
+- (void) testItShouldMatchGeo {
+    long long now = [WPUtil getServerDate];
+    NSDictionary *paris = @{ @"lat": @48.8566, @"lon": @2.3522 };
+    NSDictionary *london = @{ @"lat": @51.5074, @"lon": @-0.1278 };
+    WPSPSegmenterData *inParis = [emptyData withAllEvents:@[
+        @{ @"type": @"@APP_OPEN", @"creationDate": @(now - 7200000), @"location": london },
+        @{ @"type": @"@APP_OPEN", @"creationDate": @(now - 60000), @"location": paris },
+        @{ @"type": @"test", @"creationDate": @(now) },
+    ]];
+    WPSPSegmenterData *installationInLondon = [emptyData withInstallation:@{ @"location": london }];
+    WPSPASTCriterionNode *parsedSegment;
+
+    parsedSegment = [WPSPSegmenter parseInstallationSegment:@{ @"geo": @{} }];
+    XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:emptyData] parsedSegmentMatchesInstallation:parsedSegment]);
+    XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:inParis] parsedSegmentMatchesInstallation:parsedSegment]);
+    XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:installationInLondon] parsedSegmentMatchesInstallation:parsedSegment]);
+
+    parsedSegment = [WPSPSegmenter parseInstallationSegment:@{ @"geo": @{ @"location": @{ @"inside": @{ @"geobox": @"u09" } } } }];
+    XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:emptyData] parsedSegmentMatchesInstallation:parsedSegment]);
+    XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:inParis] parsedSegmentMatchesInstallation:parsedSegment]);
+    XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:installationInLondon] parsedSegmentMatchesInstallation:parsedSegment]);
+
+    parsedSegment = [WPSPSegmenter parseInstallationSegment:@{ @"geo": @{ @"location": @{ @"inside": @{ @"geocircle": @{ @"center": london, @"radius": @400000 } } } } }];
+    XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:inParis] parsedSegmentMatchesInstallation:parsedSegment]); // about 344 km away
+    XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:installationInLondon] parsedSegmentMatchesInstallation:parsedSegment]);
+    parsedSegment = [WPSPSegmenter parseInstallationSegment:@{ @"geo": @{ @"location": @{ @"inside": @{ @"geocircle": @{ @"center": london, @"radius": @300000 } } } } }];
+    XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:inParis] parsedSegmentMatchesInstallation:parsedSegment]);
+
+    // A triangle containing Paris but not London, whose bounding box contains both
+    NSArray *triangle = @[ @{ @"lat": @47, @"lon": @-2 }, @{ @"lat": @52, @"lon": @4 }, @{ @"lat": @47, @"lon": @4 } ];
+    parsedSegment = [WPSPSegmenter parseInstallationSegment:@{ @"geo": @{ @"location": @{ @"inside": @{ @"geopolygon": triangle } } } }];
+    XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:inParis] parsedSegmentMatchesInstallation:parsedSegment]);
+    XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:installationInLondon] parsedSegmentMatchesInstallation:parsedSegment]);
+
+    parsedSegment = [WPSPSegmenter parseInstallationSegment:@{ @"geo": @{ @"date": @{ @"gt": @{ @"date": @"-PT1H" } } } }];
+    XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:inParis] parsedSegmentMatchesInstallation:parsedSegment]);
+    XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:installationInLondon] parsedSegmentMatchesInstallation:parsedSegment]); // the installation location has no date
+
+    parsedSegment = [WPSPSegmenter parseInstallationSegment:@{ @"event": @{ @".location": @{ @"inside": @{ @"geobox": @"gcp" } } } }];
+    XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:inParis] parsedSegmentMatchesInstallation:parsedSegment]);
+    XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:installationInLondon] parsedSegmentMatchesInstallation:parsedSegment]);
+}
+
 - (void) testItShouldMatchPrefix {
     WPSPASTCriterionNode *parsedSegment;
 
@@ -795,4 +850,190 @@ id parseJson(NSString *input) {
     XCTAssertFalse([[[WPSPSegmenter alloc] initWithData:[emptyData withInstallation:(@{ @"foo": @[ @"bar", @NO, @1, NSNull.null ] })]] parsedSegmentMatchesInstallation:parsedSegment]);
 }
 
+- (void) testCompiledSegmentShouldMatchVisitor {
+    long long now = [WPUtil getServerDate];
+    NSArray<NSDictionary *> *segments = @[
+        @{ @".foo": @{ @"eq": @"foo" }, @".bar": @{ @"gt": @1 } },
+        @{ @"or": @[ @{ @".foo": @{ @"any": @[ @"foo", NSNull.null ] } }, @{ @"not": @{ @".bar": @{ @"lte": @2 } } } ] },
+        @{ @".bar": @{ @"gt": @1.5 } },
+        @{ @".bar": @{ @"eq": @2.0 } },
+        @{ @".bar": @{ @"gte": @YES } },
+        @{ @".bar": @{ @"lt": @9007199254740993LL } },
+        @{ @".foo.0": @{ @"prefix": @"fo" } },
+        @{ @".custom.date_foo": @{ @"lt": @{ @"date": @"-P1D" } } },
+        @{ @"event": @{ @".type": @{ @"eq": @"test" }, @".creationDate": @{ @"gte": @{ @"date": @"-PT1H" } } } },
+        @{ @"event": @{ @".type": @{ @"eq": @"test" }, @"installation": @{ @".foo": @{ @"all": @[ @"foo" ] } } } },
+        @{ @"event": @{ @".type": @{ @"prefix": @"te" }, @".campaignId": @{ @"eq": @"campaign1" } } },
+        @{ @"event": @{ @".type": @{ @"eq": @"test" }, @".creationDate": @{ @"gt": @{ @"date": @"-PT90M" } } } },
+        @{ @"event": @{ @".creationDate": @{ @"gte": @(now - 3600000) }, @".custom.foo": @{ @"eq": @"bar" } } },
+        @{ @"lastActivityDate": @{ @"gt": @{ @"date": @"-PT1M" } } },
+        @{ @"presence": @{ @"present": @YES, @"elapsedTime": @{ @"gt": @30000 } } },
+        @{ @"subscriptionStatus": @"optIn" },
+        @{ @"geo": @{ @"location": @{ @"inside": @{ @"geobox": @"u09" } }, @"date": @{ @"gt": @{ @"date": @"-PT1H" } } } },
+        @{ @"geo": @{ @"location": @{ @"inside": @{ @"geocircle": @{ @"center": @"gcpvj", @"radius": @1000 } } } } },
+        @{ @"event": @{ @".location": @{ @"inside": @{ @"geopolygon": @[ @"u09", @"u0d", @"u06" ] } } } },
+    ];
+    NSArray<WPSPSegmenterData *> *datas = @[
+        emptyData,
+        [emptyData withInstallation:(@{ @"foo": @"foo", @"bar": @2 })],
+        [emptyData withInstallation:(@{ @"foo": @[ @"foo", NSNull.null ], @"bar": @3 })],
+        [emptyData withInstallation:(@{ @"bar": @[ @1.5, @YES, @"2" ] })],
+        [emptyData withInstallation:(@{ @"bar": @9007199254740992LL })],
+        [emptyData withInstallation:(@{ @"bar": @(ULLONG_MAX) })],
+        [emptyData withInstallation:(@{ @"custom": @{ @"date_foo": @"2020-01-01T00:00:00.000Z" } })],
+        [emptyData withInstallation:(@{ @"pushToken": @{ @"data": @"token" } })],
+        [[emptyData withInstallation:@{ @"foo": @"foo" }] withNewerEvent:@{ @"type": @"test", @"creationDate": @(now) }],
+        [[emptyData withNewerEvent:@{ @"type": @"test", @"creationDate": @(now - 7200000) }] withLastAppOpenDate:now],
+        [emptyData withPresenceInfo:[[WPSPSegmenterPresenceInfo alloc] initWithFromDate:now - 60000 untilDate:now + 60000 elapsedTime:120000]],
+        [emptyData withAllEvents:@[
+            @{ @"type": @"test", @"creationDate": @(now - 7200000), @"custom": @{ @"foo": @"bar" } },
+            @{ @"type": @"tested", @"campaignId": @"campaign1", @"creationDate": @(now - 60000) },
+            @{ @"type": @"test", @"campaignId": @"campaign2", @"creationDate": @(now - 3600000), @"custom": @{ @"foo": @"bar" } },
+            @{ @"type": @"other", @"campaignId": @"campaign1", @"creationDate": @(now) },
+            @{ @"type": @[ @"test" ], @"custom": @{ @"foo": @"bar" } },
+        ]],
+        [emptyData withInstallation:(@{ @"location": @{ @"lat": @51.5074, @"lon": @-0.1278 } })],
+        [emptyData withAllEvents:@[
+            @{ @"type": @"test", @"creationDate": @(now - 7200000), @"location": @"gcpvj" },
+            @{ @"type": @"test", @"creationDate": @(now - 60000), @"location": @{ @"lat": @48.8566, @"lon": @2.3522 } },
+        ]],
+    ];
+    for (NSDictionary *segment in segments) {
+        WPSPASTCriterionNode *parsedSegment = [WPSPSegmenter parseInstallationSegment:segment];
+        WPSPCompiledSegment *compiledSegment = [[WPSPCompiledSegment alloc] initWithCriterion:parsedSegment];
+        for (WPSPSegmenterData *data in datas) {
+            BOOL expected = [[parsedSegment accept:[[WPSPInstallationVisitor alloc] initWithData:data now:now]] boolValue];
+            XCTAssertEqual(expected, [compiledSegment matchesInstallationWithData:data now:now], @"segment %@ with installation %@", segment, data.installation);
+        }
+    }
+}
+
+- (void) testParsedSegmentsAreCompiledOnce {
+    WPSPASTCriterionNode *parsedSegment = [WPSPSegmenter parseInstallationSegment:@{ @".foo": @{ @"eq": @"foo" } }];
+    WPSPCompiledSegment *compiledSegment = [WPSPSegmenter compiledSegmentOfParsedSegment:parsedSegment];
+    XCTAssertNotNil(compiledSegment);
+    XCTAssertEqual(compiledSegment, [WPSPSegmenter compiledSegmentOfParsedSegment:parsedSegment]);
+    XCTAssertTrue([[[WPSPSegmenter alloc] initWithData:[emptyData withInstallation:@{ @"foo": @"foo" }]] parsedSegmentMatchesInstallation:parsedSegment]);
+    XCTAssertEqual(compiledSegment, [WPSPSegmenter compiledSegmentOfParsedSegment:parsedSegment]);
+
+    // An equal segment parsed again is a different segment
+    WPSPASTCriterionNode *otherParsedSegment = [WPSPSegmenter parseInstallationSegment:@{ @".foo": @{ @"eq": @"foo" } }];
+    XCTAssertNotEqual(compiledSegment, [WPSPSegmenter compiledSegmentOfParsedSegment:otherParsedSegment]);
+}
+
+- (void) testEvaluationUsesASingleNow {
+    // Whole seconds, so that relative dates fall on exact milliseconds
+    long long now = [WPUtil getServerDate] / 1000 * 1000;
+    NSMutableArray<NSDictionary *> *events = [NSMutableArray new];
+    for (int i = 0; i < 100; i++) {
+        [events addObject:@{ @"type": @"test", @"creationDate": @(now - 3600000 - i) }];
+    }
+    WPSPSegmenterData *data = [[emptyData withAllEvents:events] withPresenceInfo:[[WPSPSegmenterPresenceInfo alloc] initWithFromDate:now - 60000 untilDate:now elapsedTime:60000]];
+    NSArray<NSDictionary *> *segments = @[
+        @{ @"event": @{ @".type": @{ @"eq": @"test" }, @".creationDate": @{ @"gte": @{ @"date": @"-PT1H" } } } },
+        @{ @"event": @{ @".type": @{ @"eq": @"test" }, @".creationDate": @{ @"lt": @{ @"date": @"-PT1H" } } } },
+        @{ @"presence": @{ @"present": @YES, @"sinceDate": @{ @"gte": @{ @"date": @"-PT1M" } } } },
+    ];
+    NSArray<NSArray<NSNumber *> *> *expectations = @[
+        // At now, then a second later
+        @[ @YES, @NO ],
+        @[ @YES, @YES ],
+        @[ @YES, @NO ],
+    ];
+    for (NSUInteger i = 0; i < segments.count; i++) {
+        WPSPASTCriterionNode *parsedSegment = [WPSPSegmenter parseInstallationSegment:segments[i]];
+        WPSPCompiledSegment *compiledSegment = [[WPSPCompiledSegment alloc] initWithCriterion:parsedSegment];
+        for (NSUInteger j = 0; j < 2; j++) {
+            BOOL expected = expectations[i][j].boolValue;
+            XCTAssertEqual(expected, [compiledSegment matchesInstallationWithData:data now:now + j * 1000], @"segment %@ at now + %lus", segments[i], (unsigned long)j);
+            XCTAssertEqual(expected, [[parsedSegment accept:[[WPSPInstallationVisitor alloc] initWithData:data now:now + j * 1000]] boolValue], @"segment %@ at now + %lus", segments[i], (unsigned long)j);
+        }
+    }
+}
+
+- (void) testEventsOfType {
+    NSDictionary *older = @{ @"type": @"test", @"campaignId": @"campaign1", @"creationDate": @1000 };
+    NSDictionary *newer = @{ @"type": @"test", @"creationDate": @2000 };
+    NSDictionary *undated = @{ @"type": @"tested" };
+    NSDictionary *other = @{ @"type": @"other", @"campaignId": @"campaign1", @"creationDate": @3000 };
+    NSDictionary *irregular = @{ @"type": @[ @"test" ], @"campaignId": @[ @"campaign2" ], @"creationDate": @1500 };
+    WPSPSegmenterData *data = [emptyData withAllEvents:@[ older, newer, undated, other, irregular ]];
+    XCTAssertEqualObjects([data eventsOfType:nil typePrefix:nil campaignId:nil], (@[ undated, other, newer, irregular, older ]));
+    XCTAssertEqualObjects([data eventsOfType:@"test" typePrefix:nil campaignId:nil], (@[ newer, irregular, older ]));
+    XCTAssertEqualObjects([data eventsOfType:nil typePrefix:@"te" campaignId:nil], (@[ undated, newer, irregular, older ]));
+    XCTAssertEqualObjects([data eventsOfType:@"test" typePrefix:nil campaignId:@"campaign1"], (@[ irregular, older ]));
+    XCTAssertEqualObjects([data eventsOfType:nil typePrefix:nil campaignId:@"campaign1"], (@[ other, irregular, older ]));
+    XCTAssertEqualObjects([data eventsOfType:@"missing" typePrefix:nil campaignId:nil], (@[ irregular ]));
+}
+
+- (void) testEventsOfTypeFromTrackedEventsIndex {
+    NSDictionary *older = @{ @"type": @"test", @"campaignId": @"campaign1", @"actionDate": @1000 };
+    NSDictionary *newer = @{ @"type": @"test", @"actionDate": @2000 };
+    NSDictionary *undated = @{ @"type": @"tested" };
+    NSDictionary *other = @{ @"type": @"other", @"campaignId": @"campaign1", @"actionDate": @3000 };
+    NSDictionary *irregular = @{ @"type": @[ @"test" ], @"campaignId": @[ @"campaign2" ], @"actionDate": @1500 };
+    WPTrackedEventsIndex *index = [[WPTrackedEventsIndex alloc] initWithEvents:@[ older, newer, undated, other, irregular ]];
+    WPSPSegmenterData *data = [[WPSPSegmenterData alloc] initWithPresenceInfo:nil lastAppOpenDate:0];
+    __block NSUInteger allEventsCount = 0;
+    data.allEventsProvider = ^NSArray<NSDictionary *> *{
+        allEventsCount++;
+        return [index eventsWithCreationDateOfType:nil typePrefix:nil];
+    };
+    data.typedEventsProvider = ^NSArray<NSDictionary *> *(NSString *type, NSString *typePrefix) {
+        return [index eventsWithCreationDateOfType:type typePrefix:typePrefix];
+    };
+    NSArray *(^types)(NSArray<NSDictionary *> *) = ^NSArray *(NSArray<NSDictionary *> *events) {
+        return [events valueForKey:@"type"];
+    };
+
+    // Typed lookups do not read the whole list of events
+    XCTAssertEqualObjects(types([data eventsOfType:@"test" typePrefix:nil campaignId:nil]), types(@[ newer, irregular, older ]));
+    XCTAssertEqualObjects(types([data eventsOfType:nil typePrefix:@"te" campaignId:nil]), types(@[ undated, newer, irregular, older ]));
+    XCTAssertEqualObjects(types([data eventsOfType:@"test" typePrefix:nil campaignId:@"campaign1"]), types(@[ irregular, older ]));
+    XCTAssertEqualObjects(types([data eventsOfType:@"missing" typePrefix:nil campaignId:nil]), types(@[ irregular ]));
+    XCTAssertEqualObjects([data eventsOfType:@"test" typePrefix:nil campaignId:nil][0][@"creationDate"], @2000);
+    XCTAssertEqual(0, allEventsCount);
+
+    XCTAssertEqualObjects(types([data eventsOfType:nil typePrefix:nil campaignId:@"campaign1"]), types(@[ other, irregular, older ]));
+    XCTAssertEqual(1, allEventsCount);
+}
+
+- (WPSPSegmenterData *) dataWithEventsCount:(NSUInteger)count {
+    long long now = [WPUtil getServerDate];
+    NSMutableArray<NSDictionary *> *events = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        [events addObject:@{
+            @"type": [NSString stringWithFormat:@"type%lu", (unsigned long)(i % 50)],
+            @"creationDate": @(now - (long long)i * 60000),
+            @"custom": @{ @"string_foo": @"bar", @"int_foo": @(i) },
+        }];
+    }
+    return [[emptyData withInstallation:(@{ @"custom": @{ @"string_foo": @"bar" } })] withAllEvents:events];
+}
+
+- (NSDictionary *) performanceSegment {
+    // Does not match, so that every event gets evaluated
+    return @{ @".custom.string_foo": @{ @"eq": @"bar" }, @"event": @{ @".type": @{ @"eq": @"missing" }, @".creationDate": @{ @"gte": @{ @"date": @"-P7D" } }, @".custom.int_foo": @{ @"gt": @10 } } };
+}
+
+- (void) testVisitorPerformance {
+    WPSPSegmenterData *data = [self dataWithEventsCount:1000];
+    WPSPASTCriterionNode *parsedSegment = [WPSPSegmenter parseInstallationSegment:[self performanceSegment]];
+    [self measureBlock:^{
+        for (int i = 0; i < 10; i++) {
+            XCTAssertFalse([[parsedSegment accept:[[WPSPInstallationVisitor alloc] initWithData:data]] boolValue]);
+        }
+    }];
+}
+
+- (void) testCompiledSegmentPerformance {
+    WPSPSegmenterData *data = [self dataWithEventsCount:1000];
+    WPSPCompiledSegment *compiledSegment = [[WPSPCompiledSegment alloc] initWithCriterion:[WPSPSegmenter parseInstallationSegment:[self performanceSegment]]];
+    [self measureBlock:^{
+        for (int i = 0; i < 10; i++) {
+            XCTAssertFalse([compiledSegment matchesInstallationWithData:data]);
+        }
+    }];
+}
+
 @end
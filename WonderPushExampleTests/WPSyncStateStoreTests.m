@@ -0,0 +1,131 @@
+//
+//  WPSyncStateStoreTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "WPSyncStateStore.h"
+
+@interface WPSyncStateStoreTests : XCTestCase
+@property (nonatomic, strong) NSString *directory;
+@end
+
+@implementation WPSyncStateStoreTests
+
+- (void)setUp {
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+}
+
+- (WPSyncStateStore *)newStore {
+    WPSyncStateStore *store = [[WPSyncStateStore alloc] initWithDirectory:self.directory];
+    store.maxStaleness = 60;
+    return store;
+}
+
+- (NSUInteger)fileCount {
+    return [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.directory error:nil].count;
+}
+
+- (void)testEmpty {
+    WPSyncStateStore *store = [self newStore];
+    XCTAssertEqualObjects(@{}, store.states);
+    XCTAssertFalse(store.exists);
+    [store flush];
+    XCTAssertEqual(0, store.writeCount);
+}
+
+- (void)testSavesAreCoalescedUntilFlushed {
+    WPSyncStateStore *store = [self newStore];
+    for (int i = 0; i < 10; i++) {
+        [store setState:@{@"sdkState": @{@"custom": @{@"int_count": @(i)}}} forKey:@"user"];
+    }
+    [store setState:@{@"sdkState": @{}} forKey:@""];
+    XCTAssertEqualObjects(@9, store.states[@"user"][@"sdkState"][@"custom"][@"int_count"]);
+    XCTAssertFalse(store.exists);
+
+    [store flush];
+    XCTAssertEqual(11, store.saveCount);
+    XCTAssertEqual(9, store.avoidedWriteCount);
+    XCTAssertEqual(2, store.writeCount);
+    XCTAssertEqual(2, [self fileCount]);
+
+    NSDictionary *expected = @{
+        @"user": @{@"sdkState": @{@"custom": @{@"int_count": @9}}},
+        @"": @{@"sdkState": @{}},
+    };
+    XCTAssertEqualObjects(expected, [self newStore].states);
+}
+
+- (void)testOneFilePerKey {
+    WPSyncStateStore *store = [self newStore];
+    // Keys that would collide once made safe for the file system
+    [store setState:@{@"a": @1} forKey:@"a:b"];
+    [store setState:@{@"a": @2} forKey:@"a_b"];
+    [store setState:@{@"a": @3} forKey:@"ü/🙂"];
+    [store flush];
+    XCTAssertEqual(3, [self fileCount]);
+    XCTAssertEqualObjects((@{@"a:b": @{@"a": @1}, @"a_b": @{@"a": @2}, @"ü/🙂": @{@"a": @3}}), [self newStore].states);
+
+    // Rewriting one key leaves the other files alone
+    [store setState:@{@"a": @4} forKey:@"a_b"];
+    [store flush];
+    XCTAssertEqual(4, store.writeCount);
+    XCTAssertEqualObjects(@{@"a": @1}, [self newStore].states[@"a:b"]);
+    XCTAssertEqualObjects(@{@"a": @4}, [self newStore].states[@"a_b"]);
+}
+
+- (void)testLongKeys {
+    WPSyncStateStore *store = [self newStore];
+    NSString *longKey = [@"" stringByPaddingToLength:1000 withString:@"ü" startingAtIndex:0];
+    [store setState:@{@"a": @1} forKey:longKey];
+    [store flush];
+    XCTAssertEqual(1, store.writeCount);
+    XCTAssertEqualObjects(@{longKey: @{@"a": @1}}, [self newStore].states);
+}
+
+- (void)testRemove {
+    WPSyncStateStore *store = [self newStore];
+    [store setState:@{@"a": @1} forKey:@"user"];
+    [store flush];
+    [store setState:nil forKey:@"user"];
+    XCTAssertNil(store.states[@"user"]);
+    [store flush];
+    XCTAssertEqual(0, [self fileCount]);
+    XCTAssertEqualObjects(@{}, [self newStore].states);
+}
+
+- (void)testPendingStatesAreWrittenAfterMaxStaleness {
+    WPSyncStateStore *store = [self newStore];
+    store.maxStaleness = 0.05;
+    [store setState:@{@"a": @1} forKey:@"user"];
+    [store setState:@{@"a": @2} forKey:@"user"];
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:5];
+    while (!store.exists && [deadline timeIntervalSinceNow] > 0) {
+        [NSThread sleepForTimeInterval:0.01];
+    }
+    XCTAssertEqualObjects(@{@"a": @2}, [self newStore].states[@"user"]);
+    // Waits for the scheduled write to complete, with nothing left to write
+    [store flush];
+    XCTAssertEqual(1, store.writeCount);
+}
+
+- (void)testClear {
+    WPSyncStateStore *store = [self newStore];
+    [store setState:@{@"a": @1} forKey:@"user"];
+    [store flush];
+    [store setState:@{@"a": @2} forKey:@"other"];
+    [store clear];
+    XCTAssertEqualObjects(@{}, store.states);
+    [store flush];
+    XCTAssertFalse(store.exists);
+    XCTAssertEqualObjects(@{}, [self newStore].states);
+}
+
+@end
@@ -0,0 +1,211 @@
+//
+//  WPTrackedEventsJournalTests.m
+//  WonderPushExampleTests
+//
+//  Created by WonderPush on 17/10/2026.
+//  Copyright © 2026 WonderPush. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "WPTrackedEventsJournal.h"
+#import "WPConfiguration.h"
+
+@class WPTrackedEventsIndex;
+
+@interface WPConfiguration (Testing)
+
+@property (nonatomic, strong) NSDate * (^now)(void);
+
+@property (nonatomic, strong) WPTrackedEventsJournal *trackedEventsJournal;
+
+@property (nonatomic, strong) WPTrackedEventsIndex *trackedEventsIndex;
+
+- (void)setTrackedEvents:(NSArray *)trackedEvents;
+
+@end
+
+@interface WPTrackedEventsJournalTests : XCTestCase
+@property (nonatomic, strong) NSString *directory;
+@end
+
+@implementation WPTrackedEventsJournalTests
+
+- (void)setUp {
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+    WPConfiguration.sharedConfiguration.now = nil;
+    WPConfiguration.sharedConfiguration.maximumUncollapsedTrackedEventsCount = DEFAULT_MAXIMUM_UNCOLLAPSED_TRACKED_EVENTS_COUNT;
+    WPConfiguration.sharedConfiguration.maximumCollapsedLastCustomTrackedEventsCount = DEFAULT_MAXIMUM_COLLAPSED_LAST_CUSTOM_TRACKED_EVENTS_COUNT;
+}
+
+- (WPTrackedEventsJournal *)newJournal {
+    return [[WPTrackedEventsJournal alloc] initWithDirectory:self.directory name:@"test"];
+}
+
+- (NSString *)journalPath {
+    return [self.directory stringByAppendingPathComponent:@"test.journal"];
+}
+
+- (void)testEmpty {
+    WPTrackedEventsJournal *journal = [self newJournal];
+    XCTAssertFalse(journal.exists);
+    XCTAssertEqualObjects(@[], journal.events);
+}
+
+- (void)testCommitAppendsToJournal {
+    WPTrackedEventsJournal *journal = [self newJournal];
+    NSDictionary *a = @{@"type": @"a"};
+    NSDictionary *b = @{@"type": @"b"};
+    NSDictionary *c = @{@"type": @"c"};
+    [journal commitRemovedIndexes:@[] insertions:@[@[@0, a], @[@1, b]]];
+    [journal commitRemovedIndexes:@[@0] insertions:@[@[@1, c]]];
+    XCTAssertEqual(2, journal.journalRecordCount);
+    XCTAssertTrue(journal.exists);
+
+    WPTrackedEventsJournal *reloaded = [self newJournal];
+    NSArray *expected = @[b, c];
+    XCTAssertEqualObjects(expected, reloaded.events);
+    XCTAssertEqual(2, reloaded.journalRecordCount);
+}
+
+- (void)testCommitInsertsInTheMiddle {
+    WPTrackedEventsJournal *journal = [self newJournal];
+    NSDictionary *a = @{@"type": @"a"};
+    NSDictionary *b = @{@"type": @"b"};
+    NSDictionary *c = @{@"type": @"c"};
+    NSDictionary *d = @{@"type": @"d"};
+    [journal replaceEvents:@[a, b, c]];
+    [journal commitRemovedIndexes:@[@1] insertions:@[@[@0, d]]];
+    XCTAssertEqual(1, journal.journalRecordCount);
+
+    NSArray *expected = @[d, a, c];
+    XCTAssertEqualObjects(expected, [self newJournal].events);
+}
+
+- (void)testChangesThatDoNotApplyAreIgnored {
+    WPTrackedEventsJournal *journal = [self newJournal];
+    NSDictionary *a = @{@"type": @"a"};
+    [journal replaceEvents:@[a]];
+    [journal commitRemovedIndexes:@[@1] insertions:@[]];
+    [journal commitRemovedIndexes:@[] insertions:@[@[@2, a]]];
+    XCTAssertEqual(0, journal.journalRecordCount);
+
+    NSArray *expected = @[a];
+    XCTAssertEqualObjects(expected, journal.events);
+    XCTAssertEqualObjects(expected, [self newJournal].events);
+}
+
+- (void)testEventsAreOnlyCopiedWhenChanged {
+    WPTrackedEventsJournal *journal = [self newJournal];
+    NSDictionary *a = @{@"type": @"a"};
+    [journal replaceEvents:@[a]];
+    NSArray *events = journal.events;
+    XCTAssertEqual(events, journal.events);
+
+    [journal commitRemovedIndexes:@[] insertions:@[@[@1, a]]];
+    XCTAssertNotEqual(events, journal.events);
+    NSArray *expected = @[a, a];
+    XCTAssertEqualObjects(expected, journal.events);
+    // The previous array was not modified
+    XCTAssertEqual(1, events.count);
+}
+
+- (void)testCompactionFoldsJournal {
+    WPTrackedEventsJournal *journal = [self newJournal];
+    NSMutableArray *events = [NSMutableArray new];
+    for (NSInteger i = 0; i < 250; i++) {
+        [events addObject:@{@"type": @"a", @"i": @(i)}];
+        [journal commitRemovedIndexes:@[] insertions:@[@[@(i), events.lastObject]]];
+    }
+    XCTAssertLessThanOrEqual(journal.journalRecordCount, events.count);
+    XCTAssertEqualObjects(events, [self newJournal].events);
+}
+
+- (void)testInterruptedRecordIsIgnored {
+    WPTrackedEventsJournal *journal = [self newJournal];
+    NSDictionary *a = @{@"type": @"a"};
+    [journal commitRemovedIndexes:@[] insertions:@[@[@0, a]]];
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:self.journalPath];
+    [fileHandle seekToEndOfFile];
+    [fileHandle writeData:[@"{\"g\":1,\"i\":[[1,{\"type\":" dataUsingEncoding:NSUTF8StringEncoding]];
+    [fileHandle closeFile];
+
+    WPTrackedEventsJournal *reloaded = [self newJournal];
+    NSArray *expected = @[a];
+    XCTAssertEqualObjects(expected, reloaded.events);
+    // The unreadable tail has been dropped
+    XCTAssertEqual(0, reloaded.journalRecordCount);
+    XCTAssertEqualObjects(expected, [self newJournal].events);
+}
+
+- (void)testStaleRecordsAreIgnoredAfterReplace {
+    WPTrackedEventsJournal *journal = [self newJournal];
+    NSDictionary *a = @{@"type": @"a"};
+    NSDictionary *b = @{@"type": @"b"};
+    [journal commitRemovedIndexes:@[] insertions:@[@[@0, a]]];
+    NSData *staleJournal = [NSData dataWithContentsOfFile:self.journalPath];
+    [journal replaceEvents:@[b]];
+    // Simulate an interruption between the snapshot write and the journal removal
+    [staleJournal writeToFile:self.journalPath atomically:YES];
+
+    NSArray *expected = @[b];
+    XCTAssertEqualObjects(expected, [self newJournal].events);
+}
+
+- (void)testClear {
+    WPTrackedEventsJournal *journal = [self newJournal];
+    [journal commitRemovedIndexes:@[] insertions:@[@[@0, @{@"type": @"a"}]]];
+    [journal clear];
+    XCTAssertFalse(journal.exists);
+    XCTAssertEqualObjects(@[], journal.events);
+    XCTAssertEqualObjects(@[], [self newJournal].events);
+}
+
+#pragma mark - Benchmark
+
+- (void)measureRememberTrackedEventWithStoredEventsCount:(NSInteger)storedEventsCount {
+    WPConfiguration *configuration = WPConfiguration.sharedConfiguration;
+    // Keep the stored events of the app out of reach
+    WPTrackedEventsJournal *previousJournal = configuration.trackedEventsJournal;
+    configuration.trackedEventsJournal = [[WPTrackedEventsJournal alloc] initWithDirectory:self.directory name:@"benchmark"];
+    configuration.trackedEventsIndex = nil;
+    configuration.maximumUncollapsedTrackedEventsCount = storedEventsCount + 1000;
+    configuration.maximumCollapsedLastCustomTrackedEventsCount = storedEventsCount + 1000;
+    __block NSInteger now = 1000000000000;
+    configuration.now = ^{
+        return [NSDate dateWithTimeIntervalSince1970:now / 1000.];
+    };
+
+    NSMutableArray *storedEvents = [NSMutableArray new];
+    for (NSInteger i = 0; i < storedEventsCount; i++) {
+        [storedEvents addObject:@{@"type": [NSString stringWithFormat:@"stored%ld", (long)(i % 50)], @"actionDate": @(now - storedEventsCount + i), @"creationDate": @(now - storedEventsCount + i)}];
+    }
+    [configuration setTrackedEvents:storedEvents];
+
+    NSInteger iterations = 100;
+    [self measureBlock:^{
+        for (NSInteger i = 0; i < iterations; i++) {
+            now += 1;
+            [configuration rememberTrackedEvent:@{@"type": @"benchmark", @"actionDate": @(now), @"creationDate": @(now)}];
+        }
+    }];
+    configuration.trackedEventsJournal = previousJournal;
+    configuration.trackedEventsIndex = nil;
+}
+
+- (void)testPerformanceRememberTrackedEventWith100StoredEvents {
+    [self measureRememberTrackedEventWithStoredEventsCount:100];
+}
+
+- (void)testPerformanceRememberTrackedEventWith1000StoredEvents {
+    [self measureRememberTrackedEventWithStoredEventsCount:1000];
+}
+
+- (void)testPerformanceRememberTrackedEventWith10000StoredEvents {
+    [self measureRememberTrackedEventWithStoredEventsCount:10000];
+}
+
+@end